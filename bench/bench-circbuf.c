@@ -0,0 +1,101 @@
+#include "bench.h"
+
+#include "circbuf.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define OPS 4096
+
+CIRCBUF_DECLARE(small_ring, uint64_t, 16);
+CIRCBUF_DECLARE(large_ring, uint64_t, 4096);
+
+/*
+ * Generates workloads over a circbuf type: a queue kept half full, a deque
+ * pushed and popped at both ends, and filling up and draining.
+ */
+#define RING_WORKLOADS(RING_TYPE)                                   \
+  static void RING_TYPE##_queue(void* ctx) {                        \
+    RING_TYPE* ring = (RING_TYPE*)ctx;                              \
+    uint64_t sum = 0;                                               \
+    uint64_t x = 0;                                                 \
+    size_t i;                                                       \
+                                                                    \
+    for (i = 0; i < OPS; ++i) {                                     \
+      CIRCBUF_PUSH_BACK(ring, i);                                   \
+      CIRCBUF_POP_FRONT(&x, ring);                                  \
+      sum += x;                                                     \
+    }                                                               \
+    bench_keep(sum);                                                \
+  }                                                                 \
+                                                                    \
+  static void RING_TYPE##_deque(void* ctx) {                        \
+    RING_TYPE* ring = (RING_TYPE*)ctx;                              \
+    uint64_t sum = 0;                                               \
+    uint64_t x = 0;                                                 \
+    size_t i;                                                       \
+                                                                    \
+    for (i = 0; i < OPS / 2; ++i) {                                 \
+      CIRCBUF_PUSH_FRONT(ring, i);                                  \
+      CIRCBUF_POP_BACK(&x, ring);                                   \
+      sum += x;                                                     \
+      CIRCBUF_PUSH_BACK(ring, i);                                   \
+      CIRCBUF_POP_FRONT(&x, ring);                                  \
+      sum += x;                                                     \
+    }                                                               \
+    bench_keep(sum);                                                \
+  }                                                                 \
+                                                                    \
+  static void RING_TYPE##_fill_drain(void* ctx) {                   \
+    RING_TYPE* ring = (RING_TYPE*)ctx;                              \
+    uint64_t sum = 0;                                               \
+    uint64_t x = 0;                                                 \
+    size_t done = 0;                                                \
+    size_t i = 0;                                                   \
+                                                                    \
+    while (done < OPS) {                                            \
+      while (done < OPS && CIRCBUF_PUSH_BACK(ring, i)) {            \
+        ++i;                                                        \
+        ++done;                                                     \
+      }                                                             \
+      while (done < OPS && CIRCBUF_POP_FRONT(&x, ring)) {           \
+        sum += x;                                                   \
+        ++done;                                                     \
+      }                                                             \
+    }                                                               \
+    bench_keep(sum);                                                \
+  }                                                                 \
+                                                                    \
+  static void RING_TYPE##_run(bench* b, size_t limit) {             \
+    static RING_TYPE ring;                                          \
+    char params[32];                                                \
+    size_t i;                                                       \
+                                                                    \
+    snprintf(params, sizeof(params), "limit=%zu", limit);           \
+                                                                    \
+    CIRCBUF_INIT(&ring, limit);                                     \
+    for (i = 0; i < limit / 2; ++i) {                               \
+      CIRCBUF_PUSH_BACK(&ring, i);                                  \
+    }                                                               \
+    bench_run(b, "queue", params, OPS, RING_TYPE##_queue, &ring);   \
+    bench_run(b, "deque", params, OPS, RING_TYPE##_deque, &ring);   \
+                                                                    \
+    CIRCBUF_INIT(&ring, limit);                                     \
+    bench_run(b, "fill_drain", params, OPS, RING_TYPE##_fill_drain, \
+              &ring);                                               \
+  }
+
+RING_WORKLOADS(small_ring)
+RING_WORKLOADS(large_ring)
+
+int main(int argc, char** argv) {
+  bench b;
+
+  if (!bench_init(&b, "circbuf", argc, argv)) {
+    return 1;
+  }
+  small_ring_run(&b, 16);
+  large_ring_run(&b, 4096);
+  return bench_finish(&b);
+}
@@ -0,0 +1,86 @@
+#include "bench.h"
+
+#include "cochan.hpp"
+
+#include <cstdint>
+
+/*
+ * Coroutines handing values back and forth on one executor, so each op is a
+ * suspend, a resume and a trip through a channel.
+ */
+
+#define OPS 100000
+
+static convoy::task ping(convoy::channel<int, 2>& out,
+                         convoy::channel<int, 2>& in,
+                         int n) {
+  for (int i = 0; i < n; ++i) {
+    co_await out.push(i);
+    co_await in.pop();
+  }
+}
+
+static convoy::task pong(convoy::channel<int, 2>& in,
+                         convoy::channel<int, 2>& out,
+                         int n) {
+  for (int i = 0; i < n; ++i) {
+    int x = co_await in.pop();
+    co_await out.push(x);
+  }
+}
+
+static convoy::task send(convoy::channel<int, 8>& chan, int n) {
+  for (int i = 0; i < n; ++i) {
+    co_await chan.push(i);
+  }
+}
+
+static convoy::task fan_in(convoy::channel<int, 8>& a,
+                           convoy::channel<int, 8>& b,
+                           int n,
+                           std::uint64_t& sum) {
+  for (int i = 0; i < n; ++i) {
+    auto [index, x] = co_await convoy::select(a, b);
+    sum += index + static_cast<std::uint64_t>(x);
+  }
+}
+
+/*
+ * Each op is a round trip, a push and a pop on both channels.
+ */
+static void ping_pong(void*) {
+  convoy::channel<int, 2> there;
+  convoy::channel<int, 2> back;
+  convoy::executor exec;
+
+  exec.spawn(ping(there, back, OPS));
+  exec.spawn(pong(there, back, OPS));
+  exec.run();
+}
+
+/*
+ * Each op is one value selected out of two channels.
+ */
+static void select_two(void*) {
+  convoy::channel<int, 8> a;
+  convoy::channel<int, 8> b;
+  convoy::executor exec;
+  std::uint64_t sum = 0;
+
+  exec.spawn(fan_in(a, b, OPS, sum));
+  exec.spawn(send(a, OPS / 2));
+  exec.spawn(send(b, OPS / 2));
+  exec.run();
+  bench_keep(sum);
+}
+
+int main(int argc, char** argv) {
+  bench b;
+
+  if (!bench_init(&b, "cochan", argc, argv)) {
+    return 1;
+  }
+  bench_run(&b, "ping_pong", "limit=2", OPS, ping_pong, nullptr);
+  bench_run(&b, "select_two", "limit=8", OPS, select_two, nullptr);
+  return bench_finish(&b);
+}
@@ -0,0 +1,241 @@
+#include "bench.h"
+
+#include "circbuf.h"
+#include "convoy.hpp"
+#include "dlist.h"
+#include "splat.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Runs the same workloads through convoy.hpp and through the C macros it
+ * wraps, so the wrappers can be held to costing nothing extra.
+ */
+
+#define OPS 4096
+#define NODES 1024
+#define KEYS 100000
+
+struct node {
+  DLIST_DECLARE_LINK(node, dlink);
+  SPLAT_LINK(node, link);
+  int key;
+};
+
+DLIST_DECLARE(node_list, node);
+SPLAT_NEW(node_tree, node);
+
+#define CMP(a, b) (((a) > (b)) - ((a) < (b)))
+
+SPLAT_LIB(node_tree, node, int, CMP, link, key)
+
+CIRCBUF_DECLARE(ring, std::uint64_t, 64);
+
+static void dlist_macros(void* ctx) {
+  node_list* list = static_cast<node_list*>(ctx);
+  node* n;
+
+  for (int i = 0; i < OPS; ++i) {
+    DLIST_POP_FRONT(list, n, dlink);
+    DLIST_PUSH_BACK(list, n, dlink);
+  }
+}
+
+static void dlist_template(void* ctx) {
+  auto* list = static_cast<convoy::intrusive_dlist<node, &node::dlink>*>(ctx);
+
+  for (int i = 0; i < OPS; ++i) {
+    list->push_back(*list->pop_front());
+  }
+}
+
+static void circbuf_macros(void* ctx) {
+  ring* r = static_cast<ring*>(ctx);
+  std::uint64_t sum = 0;
+  std::uint64_t x = 0;
+
+  for (std::uint64_t i = 0; i < OPS; ++i) {
+    CIRCBUF_PUSH_BACK(r, i);
+    CIRCBUF_POP_FRONT(&x, r);
+    sum += x;
+  }
+  bench_keep(sum);
+}
+
+static void circbuf_template(void* ctx) {
+  auto* r = static_cast<convoy::circbuf<std::uint64_t, 64>*>(ctx);
+  std::uint64_t sum = 0;
+  std::uint64_t x = 0;
+
+  for (std::uint64_t i = 0; i < OPS; ++i) {
+    r->push_back(i);
+    r->pop_front(x);
+    sum += x;
+  }
+  bench_keep(sum);
+}
+
+/*
+ * KEYS nodes in one tree, searched in a fixed random order.
+ */
+struct tree_state {
+  std::vector<node> nodes;
+  std::vector<std::size_t> order;
+  std::size_t next = 0;
+  node_tree macros = SPLAT_STATIC_INIT;
+  convoy::splay_tree<node, int, &node::key> tree;
+
+  int next_key() {
+    int key = static_cast<int>(order[next]);
+    next = (next + 1) % order.size();
+    return key;
+  }
+};
+
+static void splay_macros(void* ctx) {
+  tree_state* s = static_cast<tree_state*>(ctx);
+  std::uint64_t sum = 0;
+
+  for (int i = 0; i < OPS; ++i) {
+    sum += static_cast<std::uint64_t>(
+      node_tree_search(&s->macros, s->next_key())->key);
+  }
+  bench_keep(sum);
+}
+
+static void splay_template(void* ctx) {
+  tree_state* s = static_cast<tree_state*>(ctx);
+  std::uint64_t sum = 0;
+
+  for (int i = 0; i < OPS; ++i) {
+    sum += static_cast<std::uint64_t>(s->tree.find(s->next_key())->key);
+  }
+  bench_keep(sum);
+}
+
+struct host {
+  SPLAT_LINK(host, link);
+  std::string name;
+};
+
+/*
+ * Hosts keyed by names too long for the small string optimization, looked up
+ * by std::string_view.  A transparent comparator searches with the view
+ * itself; otherwise every lookup builds a std::string.
+ */
+struct host_state {
+  std::vector<host> hosts;
+  std::vector<std::string_view> names;
+  std::size_t next = 0;
+  convoy::splay_tree<host, std::string, &host::name, std::less<>> by_view;
+  convoy::splay_tree<host, std::string, &host::name> by_string;
+};
+
+static void find_transparent(void* ctx) {
+  host_state* s = static_cast<host_state*>(ctx);
+  std::uint64_t sum = 0;
+
+  for (int i = 0; i < OPS; ++i) {
+    sum += s->by_view.find(s->names[s->next])->name.size();
+    s->next = (s->next + 1) % s->names.size();
+  }
+  bench_keep(sum);
+}
+
+static void find_temporary(void* ctx) {
+  host_state* s = static_cast<host_state*>(ctx);
+  std::uint64_t sum = 0;
+
+  for (int i = 0; i < OPS; ++i) {
+    sum += s->by_string.find(std::string(s->names[s->next]))->name.size();
+    s->next = (s->next + 1) % s->names.size();
+  }
+  bench_keep(sum);
+}
+
+int main(int argc, char** argv) {
+  bench b;
+
+  if (!bench_init(&b, "convoy", argc, argv)) {
+    return 1;
+  }
+
+  {
+    std::vector<node> nodes(NODES);
+    node_list list = DLIST_STATIC_INIT;
+    convoy::intrusive_dlist<node, &node::dlink> wrapped;
+
+    for (node& n : nodes) {
+      DLIST_ELEM_INIT(&n, dlink);
+      DLIST_PUSH_BACK(&list, &n, dlink);
+    }
+    bench_run(&b, "dlist_macros", "n=1024", OPS, dlist_macros, &list);
+    while (!DLIST_IS_EMPTY(&list)) {
+      node* n;
+      DLIST_POP_FRONT(&list, n, dlink);
+      wrapped.push_back(*n);
+    }
+    bench_run(&b, "dlist_template", "n=1024", OPS, dlist_template, &wrapped);
+  }
+
+  {
+    static ring r;
+    static convoy::circbuf<std::uint64_t, 64> wrapped;
+
+    CIRCBUF_INIT(&r, 64);
+    bench_run(&b, "circbuf_macros", "limit=64", OPS, circbuf_macros, &r);
+    bench_run(&b, "circbuf_template", "limit=64", OPS, circbuf_template,
+              &wrapped);
+  }
+
+  {
+    tree_state s;
+
+    s.nodes.resize(KEYS);
+    s.order.resize(KEYS);
+    bench_shuffle(s.order.data(), KEYS, KEYS);
+    for (std::size_t i = 0; i < KEYS; ++i) {
+      s.nodes[i].key = static_cast<int>(s.order[i]);
+      SPLAT_ELEM_INIT(&s.nodes[i], link);
+      node_tree_insert(&s.macros, &s.nodes[i]);
+    }
+    bench_run(&b, "splay_macros", "n=100000", OPS, splay_macros, &s);
+
+    node_tree_clear(&s.macros, nullptr);
+    for (node& n : s.nodes) {
+      SPLAT_ELEM_INIT(&n, link);
+      s.tree.insert(n);
+    }
+    bench_run(&b, "splay_template", "n=100000", OPS, splay_template, &s);
+  }
+
+  {
+    host_state s;
+
+    s.hosts.resize(KEYS);
+    for (std::size_t i = 0; i < KEYS; ++i) {
+      s.hosts[i].name = "host-" + std::to_string(i) + ".rack.example.internal";
+      SPLAT_ELEM_INIT(&s.hosts[i], link);
+      s.by_view.insert(s.hosts[i]);
+    }
+    for (std::size_t i = 0; i < KEYS; i += 7) {
+      s.names.push_back(s.hosts[i].name);
+    }
+    bench_run(&b, "find_transparent", "n=100000", OPS, find_transparent, &s);
+
+    s.by_view.clear();
+    for (host& h : s.hosts) {
+      SPLAT_ELEM_INIT(&h, link);
+      s.by_string.insert(h);
+    }
+    bench_run(&b, "find_temporary", "n=100000", OPS, find_temporary, &s);
+  }
+
+  return bench_finish(&b);
+}
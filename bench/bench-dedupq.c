@@ -0,0 +1,106 @@
+#include "bench.h"
+
+#include "circbuf.h"
+#include "dedupq.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Bursts of keys drawn from a small hot set, so about 70% of each burst
+ * repeats a key that's already pending, drained after every burst.  The
+ * dedupq drops the repeats on push; the plain circbuf queues them all and
+ * hands them to the consumer.
+ */
+
+#define OPS 4096
+#define BURST 64
+#define HOT 20
+
+DEDUPQ_DECLARE(keyq, uint64_t, 128);
+DEDUPQ_LIB(keyq, uint64_t, dedupq_hash_u64, DEDUPQ_EQ)
+
+CIRCBUF_DECLARE(key_ring, uint64_t, 128);
+
+struct state {
+  uint64_t keys[OPS];
+  keyq q;
+  key_ring ring;
+};
+
+static void dedupq_bursts(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  uint64_t sum = 0;
+  uint64_t key;
+  size_t i;
+  size_t j;
+
+  for (i = 0; i < OPS; i += BURST) {
+    for (j = i; j < i + BURST; ++j) {
+      keyq_push(&s->q, s->keys[j]);
+    }
+    while (keyq_pop(&s->q, &key)) {
+      sum += key;
+    }
+  }
+  bench_keep(sum);
+}
+
+static void dedupq_batches(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  uint64_t out[BURST];
+  uint64_t sum = 0;
+  size_t i;
+  size_t n;
+
+  for (i = 0; i < OPS; i += BURST) {
+    keyq_push_n(&s->q, s->keys + i, BURST);
+    n = keyq_pop_n(&s->q, out, BURST);
+    while (n > 0) {
+      sum += out[--n];
+    }
+  }
+  bench_keep(sum);
+}
+
+static void circbuf_bursts(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  uint64_t sum = 0;
+  uint64_t key = 0;
+  size_t i;
+  size_t j;
+
+  for (i = 0; i < OPS; i += BURST) {
+    for (j = i; j < i + BURST; ++j) {
+      CIRCBUF_PUSH_BACK(&s->ring, s->keys[j]);
+    }
+    while (CIRCBUF_POP_FRONT(&key, &s->ring)) {
+      sum += key;
+    }
+  }
+  bench_keep(sum);
+}
+
+int main(int argc, char** argv) {
+  static struct state s;
+  uint64_t seed = OPS;
+  bench b;
+  size_t i;
+
+  if (!bench_init(&b, "dedupq", argc, argv)) {
+    return 1;
+  }
+
+  for (i = 0; i < OPS; ++i) {
+    s.keys[i] = bench_rand(&seed) % HOT;
+  }
+  DEDUPQ_INIT(&s.q);
+  CIRCBUF_INIT(&s.ring, 128);
+
+  bench_run(&b, "dedupq_bursts", "burst=64,keys=20", OPS, dedupq_bursts, &s);
+  bench_run(&b, "dedupq_batches", "burst=64,keys=20", OPS, dedupq_batches,
+            &s);
+  bench_run(&b, "circbuf_bursts", "burst=64,keys=20", OPS, circbuf_bursts,
+            &s);
+  return bench_finish(&b);
+}
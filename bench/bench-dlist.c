@@ -0,0 +1,118 @@
+#include "bench.h"
+
+#include "dlist.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OPS 4096
+
+struct node {
+  DLIST_DECLARE_LINK(node, link);
+  uint64_t val;
+};
+
+DLIST_DECLARE(node_list, node);
+
+/*
+ * A list of N nodes linked in a random order, so that walking it jumps around
+ * memory once N outgrows the caches.
+ */
+struct state {
+  node_list list;
+  struct node* nodes;
+  size_t* order;
+  size_t n;
+  size_t next;
+};
+
+static void rotate(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* node;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    DLIST_POP_FRONT(&s->list, node, link);
+    DLIST_PUSH_BACK(&s->list, node, link);
+  }
+}
+
+/*
+ * Takes the same turns as popping the front and pushing it back, by rotating.
+ */
+static void round_robin(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* node;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    DLIST_ROUND_ROBIN(&s->list, node, link);
+  }
+  (void)node;
+}
+
+static void walk(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* curr;
+  uint64_t sum = 0;
+
+  DLIST_FOREACH(curr, &s->list, link, sum += curr->val);
+  bench_keep(sum);
+}
+
+static void remove_push(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    struct node* node = &s->nodes[s->order[s->next]];
+    s->next = (s->next + 1) % s->n;
+    DLIST_REMOVE(&s->list, node, link);
+    DLIST_PUSH_BACK(&s->list, node, link);
+  }
+}
+
+static void run(bench* b, size_t n) {
+  struct state s;
+  char params[32];
+  size_t i;
+
+  s.nodes = malloc(n * sizeof(*s.nodes));
+  s.order = malloc(n * sizeof(*s.order));
+  s.n = n;
+  s.next = 0;
+  if (s.nodes == NULL || s.order == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  DLIST_INIT(&s.list);
+  bench_shuffle(s.order, n, n);
+  for (i = 0; i < n; ++i) {
+    struct node* node = &s.nodes[s.order[i]];
+    node->val = i;
+    DLIST_ELEM_INIT(node, link);
+    DLIST_PUSH_BACK(&s.list, node, link);
+  }
+
+  snprintf(params, sizeof(params), "n=%zu", n);
+  bench_run(b, "rotate", params, OPS, rotate, &s);
+  bench_run(b, "round_robin", params, OPS, round_robin, &s);
+  bench_run(b, "walk", params, n, walk, &s);
+  bench_run(b, "remove_push", params, OPS, remove_push, &s);
+
+  free(s.order);
+  free(s.nodes);
+}
+
+int main(int argc, char** argv) {
+  bench b;
+
+  if (!bench_init(&b, "dlist", argc, argv)) {
+    return 1;
+  }
+  run(&b, 1024);
+  run(&b, 1 << 20);
+  return bench_finish(&b);
+}
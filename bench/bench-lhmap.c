@@ -0,0 +1,117 @@
+#include "bench.h"
+
+#include "lhmap.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * An LRU cache of a thousand entries over twice as many keys, so about half
+ * of the lookups miss and evict the oldest entry.  Then the same number of
+ * entries in a map sized for a peak sixty-four times larger, iterated once in
+ * order and once by scanning the buckets, which is what a plain hash map
+ * would have to do.
+ */
+
+#define CACHE 1024
+#define KEYS 2048
+#define OPS 4096
+#define SPARSE 65536
+
+struct entry {
+  LHMAP_DECLARE_LINK(entry, link);
+  uint64_t key;
+};
+
+LHMAP_DECLARE(cache_map, entry, 2 * CACHE);
+LHMAP_LIB(cache_map, entry, uint64_t, lhmap_hash_u64, LHMAP_EQ, link, key)
+
+LHMAP_DECLARE(sparse_map, entry, SPARSE);
+LHMAP_LIB(sparse_map, entry, uint64_t, lhmap_hash_u64, LHMAP_EQ, link, key)
+
+struct state {
+  uint64_t keys[OPS];
+  struct entry entries[CACHE];
+  cache_map cache;
+  sparse_map sparse;
+};
+
+static void lru(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct entry* elem;
+  uint64_t misses = 0;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    elem = cache_map_find(&s->cache, s->keys[i]);
+    if (elem != NULL) {
+      cache_map_move_to_back(&s->cache, elem);
+    } else {
+      elem = cache_map_pop_front(&s->cache);
+      elem->key = s->keys[i];
+      cache_map_insert(&s->cache, elem);
+      ++misses;
+    }
+  }
+  bench_keep(misses);
+}
+
+static void iterate_order(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct entry* curr;
+  uint64_t sum = 0;
+
+  LHMAP_FOREACH(curr, &s->sparse, link, { sum += curr->key; });
+  bench_keep(sum);
+}
+
+static void iterate_buckets(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct entry* curr;
+  uint64_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < SPARSE; ++i) {
+    for (curr = s->sparse.buckets[i]; curr != NULL; curr = curr->link.chain) {
+      sum += curr->key;
+    }
+  }
+  bench_keep(sum);
+}
+
+int main(int argc, char** argv) {
+  static struct state s;
+  uint64_t seed = OPS;
+  char params[32];
+  size_t i;
+  bench b;
+
+  if (!bench_init(&b, "lhmap", argc, argv)) {
+    return 1;
+  }
+
+  for (i = 0; i < OPS; ++i) {
+    s.keys[i] = bench_rand(&seed) % KEYS;
+  }
+  LHMAP_INIT(&s.cache);
+  for (i = 0; i < CACHE; ++i) {
+    s.entries[i].key = i;
+    LHMAP_ELEM_INIT(&s.entries[i], link);
+    cache_map_insert(&s.cache, &s.entries[i]);
+  }
+  snprintf(params, sizeof(params), "n=%d,keys=%d", CACHE, KEYS);
+  bench_run(&b, "lru", params, OPS, lru, &s);
+
+  /* Move the entries over to the sparse map. */
+  LHMAP_INIT(&s.sparse);
+  while (cache_map_pop_front(&s.cache) != NULL) {
+  }
+  for (i = 0; i < CACHE; ++i) {
+    sparse_map_insert(&s.sparse, &s.entries[i]);
+  }
+  snprintf(params, sizeof(params), "n=%d,buckets=%d", CACHE, SPARSE);
+  bench_run(&b, "iterate_order", params, CACHE, iterate_order, &s);
+  bench_run(&b, "iterate_buckets", params, CACHE, iterate_buckets, &s);
+
+  return bench_finish(&b);
+}
@@ -0,0 +1,186 @@
+#include "bench.h"
+
+#include "dlist.h"
+#include "slist.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Sorting lists of N nodes linked in a random order by random 32-bit and
+ * 64-bit keys, with the radix sort and, as the comparison sort baseline, a
+ * bottom-up merge sort of the slist.  Each run first relinks the nodes in
+ * the same shuffled order, so every sort gets the same input, and each op is
+ * relinking and sorting one node's worth.
+ */
+
+struct node {
+  SLIST_DECLARE_LINK(node, slink);
+  DLIST_DECLARE_LINK(node, dlink);
+  uint64_t key;
+};
+
+SLIST_DECLARE(node_queue, node);
+DLIST_DECLARE(node_deque, node);
+
+#define KEY(NODE) ((NODE)->key)
+
+struct state {
+  node_queue queue;
+  node_deque deque;
+  struct node* nodes;
+  size_t* order;
+  size_t n;
+};
+
+static void link_queue(struct state* s) {
+  size_t i;
+
+  SLIST_INIT(&s->queue);
+  for (i = 0; i < s->n; ++i) {
+    SLIST_PUSH_BACK(&s->queue, &s->nodes[s->order[i]], slink);
+  }
+}
+
+static void link_deque(struct state* s) {
+  size_t i;
+
+  DLIST_INIT(&s->deque);
+  for (i = 0; i < s->n; ++i) {
+    DLIST_PUSH_BACK(&s->deque, &s->nodes[s->order[i]], dlink);
+  }
+}
+
+static void radix_slist(void* ctx) {
+  struct state* s = (struct state*)ctx;
+
+  link_queue(s);
+  SLIST_RADIX_SORT(&s->queue, node, slink, KEY);
+  bench_keep(s->queue.back->key);
+}
+
+static void radix_dlist(void* ctx) {
+  struct state* s = (struct state*)ctx;
+
+  link_deque(s);
+  DLIST_RADIX_SORT(&s->deque, node, dlink, KEY);
+  bench_keep(s->deque.back->key);
+}
+
+/*
+ * Sorts a list by merging sorted runs of 1, 2, 4, ... nodes, stably.
+ */
+static void merge_sort(node_queue* queue) {
+  struct node* list = queue->front;
+  struct node* left;
+  struct node* right;
+  struct node* back;
+  struct node* next;
+  size_t lefts;
+  size_t rights;
+  size_t merges;
+  size_t width;
+
+  queue->back->slink = NULL;
+  for (width = 1;; width *= 2) {
+    left = list;
+    list = NULL;
+    back = NULL;
+    merges = 0;
+    while (left != NULL) {
+      ++merges;
+      right = left;
+      for (lefts = 0; lefts < width && right != NULL; ++lefts) {
+        right = right->slink;
+      }
+      rights = width;
+      while (lefts > 0 || (rights > 0 && right != NULL)) {
+        if (lefts == 0 ||
+            (rights > 0 && right != NULL && right->key < left->key)) {
+          next = right;
+          right = right->slink;
+          --rights;
+        } else {
+          next = left;
+          left = left->slink;
+          --lefts;
+        }
+        if (back == NULL) {
+          list = next;
+        } else {
+          back->slink = next;
+        }
+        back = next;
+      }
+      left = right;
+    }
+    back->slink = NULL;
+    if (merges <= 1) {
+      break;
+    }
+  }
+
+  queue->front = list;
+  queue->back = back;
+  back->slink = list;
+}
+
+static void merge_slist(void* ctx) {
+  struct state* s = (struct state*)ctx;
+
+  link_queue(s);
+  merge_sort(&s->queue);
+  bench_keep(s->queue.back->key);
+}
+
+static void run(bench* b, size_t n) {
+  struct state s;
+  uint64_t seed = n;
+  char params[48];
+  size_t i;
+
+  s.nodes = malloc(n * sizeof(*s.nodes));
+  s.order = malloc(n * sizeof(*s.order));
+  s.n = n;
+  if (s.nodes == NULL || s.order == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  bench_shuffle(s.order, n, n);
+
+  for (i = 0; i < n; ++i) {
+    s.nodes[i].key = bench_rand(&seed) & UINT32_MAX;
+  }
+  snprintf(params, sizeof(params), "n=%zu,key=u32", n);
+  bench_run(b, "radix_slist", params, n, radix_slist, &s);
+  bench_run(b, "radix_dlist", params, n, radix_dlist, &s);
+  bench_run(b, "merge_slist", params, n, merge_slist, &s);
+
+  for (i = 0; i < n; ++i) {
+    s.nodes[i].key = bench_rand(&seed);
+  }
+  snprintf(params, sizeof(params), "n=%zu,key=u64", n);
+  bench_run(b, "radix_slist", params, n, radix_slist, &s);
+  bench_run(b, "radix_dlist", params, n, radix_dlist, &s);
+  bench_run(b, "merge_slist", params, n, merge_slist, &s);
+
+  free(s.order);
+  free(s.nodes);
+}
+
+int main(int argc, char** argv) {
+  bench b;
+
+  if (!bench_init(&b, "listsort", argc, argv)) {
+    return 1;
+  }
+  run(&b, 10000);
+  run(&b, 100000);
+  /* Too slow to be worth it when only checking that workloads run. */
+  if (!b.quick) {
+    run(&b, 1000000);
+    run(&b, 10000000);
+  }
+  return bench_finish(&b);
+}
@@ -0,0 +1,198 @@
+#include "bench.h"
+
+#include "lslist.h"
+#include "slist.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * The same random pushes and pops run against an slist and an lslist that
+ * never hold more than a few elements, so that slist's empty and single
+ * element cases come up unpredictably and show in the branch misses.  There
+ * are enough steps that the branch predictor can't learn them.  A queue of a
+ * thousand elements, where those cases never come up, is the control.
+ */
+
+#define POOL 4
+#define STEPS 65536
+#define QUEUE 1024
+#define OPS 4096
+
+enum { PUSH_FRONT, PUSH_BACK, POP_FRONT };
+
+struct step {
+  unsigned char op;
+  unsigned char node;
+};
+
+struct node {
+  SLIST_DECLARE_LINK(node, link);
+  LSLIST_DECLARE_LINK(node, llink);
+  uint64_t val;
+};
+
+SLIST_DECLARE(node_list, node);
+LSLIST_DECLARE(node_llist, node);
+
+struct state {
+  struct step steps[STEPS + POOL];
+  size_t nsteps;
+  struct node pool[POOL];
+  struct node queue[QUEUE];
+  node_list list;
+  node_llist llist;
+};
+
+/*
+ * Picks STEPS random steps that are valid in turn, starting from and ending
+ * with an empty list, by running them against an slist.  Pops are as likely
+ * as pushes.
+ */
+static void plan(struct state* s) {
+  node_list list = SLIST_STATIC_INIT;
+  struct node* node;
+  uint64_t seed = 1;
+  uint64_t r;
+  size_t n = 0;
+  size_t i;
+
+  for (i = 0; i < POOL; ++i) {
+    SLIST_ELEM_INIT(&s->pool[i], link);
+  }
+  for (s->nsteps = 0; s->nsteps < STEPS;) {
+    r = bench_rand(&seed);
+    s->steps[s->nsteps].op = (unsigned char)((r & 1) ? POP_FRONT : r % 4 / 2);
+    if (n == POOL) {
+      s->steps[s->nsteps].op = POP_FRONT;
+    } else if (n == 0) {
+      s->steps[s->nsteps].op = (unsigned char)(r % 4 / 2);
+    }
+    r /= 4;
+
+    if (s->steps[s->nsteps].op == POP_FRONT) {
+      SLIST_POP_FRONT(&list, node, link);
+      --n;
+    } else {
+      do {
+        node = &s->pool[r++ % POOL];
+      } while (SLIST_IS_ELEM_INSERTED(node, link));
+      if (s->steps[s->nsteps].op == PUSH_FRONT) {
+        SLIST_PUSH_FRONT(&list, node, link);
+      } else {
+        SLIST_PUSH_BACK(&list, node, link);
+      }
+      ++n;
+    }
+    s->steps[s->nsteps++].node = (unsigned char)(node - s->pool);
+  }
+  while (n-- > 0) {
+    s->steps[s->nsteps++].op = POP_FRONT;
+  }
+}
+
+static void churn_slist(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* node;
+  uint64_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < s->nsteps; ++i) {
+    node = &s->pool[s->steps[i].node];
+    switch (s->steps[i].op) {
+      case PUSH_FRONT:
+        SLIST_PUSH_FRONT(&s->list, node, link);
+        break;
+      case PUSH_BACK:
+        SLIST_PUSH_BACK(&s->list, node, link);
+        break;
+      default:
+        SLIST_POP_FRONT(&s->list, node, link);
+        sum += node->val;
+        break;
+    }
+  }
+  bench_keep(sum);
+}
+
+static void churn_lslist(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* node;
+  uint64_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < s->nsteps; ++i) {
+    node = &s->pool[s->steps[i].node];
+    switch (s->steps[i].op) {
+      case PUSH_FRONT:
+        LSLIST_PUSH_FRONT(&s->llist, node, llink);
+        break;
+      case PUSH_BACK:
+        LSLIST_PUSH_BACK(&s->llist, node, llink);
+        break;
+      default:
+        LSLIST_POP_FRONT(&s->llist, node, llink);
+        sum += node->val;
+        break;
+    }
+  }
+  bench_keep(sum);
+}
+
+static void queue_slist(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* node;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    SLIST_POP_FRONT(&s->list, node, link);
+    SLIST_PUSH_BACK(&s->list, node, link);
+  }
+}
+
+static void queue_lslist(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* node;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    LSLIST_POP_FRONT(&s->llist, node, llink);
+    LSLIST_PUSH_BACK(&s->llist, node, llink);
+  }
+}
+
+int main(int argc, char** argv) {
+  static struct state s;
+  char params[32];
+  size_t i;
+  bench b;
+
+  if (!bench_init(&b, "lslist", argc, argv)) {
+    return 1;
+  }
+
+  plan(&s);
+  SLIST_INIT(&s.list);
+  LSLIST_INIT(&s.llist);
+  for (i = 0; i < POOL; ++i) {
+    s.pool[i].val = i;
+    SLIST_ELEM_INIT(&s.pool[i], link);
+    LSLIST_ELEM_INIT(&s.pool[i], llink);
+  }
+  snprintf(params, sizeof(params), "pool=%d", POOL);
+  bench_run(&b, "churn_slist", params, s.nsteps, churn_slist, &s);
+  bench_run(&b, "churn_lslist", params, s.nsteps, churn_lslist, &s);
+
+  for (i = 0; i < QUEUE; ++i) {
+    s.queue[i].val = i;
+    SLIST_ELEM_INIT(&s.queue[i], link);
+    LSLIST_ELEM_INIT(&s.queue[i], llink);
+    SLIST_PUSH_BACK(&s.list, &s.queue[i], link);
+    LSLIST_PUSH_BACK(&s.llist, &s.queue[i], llink);
+  }
+  snprintf(params, sizeof(params), "n=%d", QUEUE);
+  bench_run(&b, "queue_slist", params, OPS, queue_slist, &s);
+  bench_run(&b, "queue_lslist", params, OPS, queue_lslist, &s);
+
+  return bench_finish(&b);
+}
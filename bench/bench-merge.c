@@ -0,0 +1,131 @@
+#include "bench.h"
+
+#include "circbuf.h"
+#include "merge.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Merging 8 to 1024 streams of 64 sorted timestamps each, popped in batches
+ * through the loser tree and, as the baseline, by scanning every stream's
+ * head for the lowest one.
+ */
+
+#define DEPTH 64
+#define MAX_INPUTS 1024
+#define BATCH 256
+
+CIRCBUF_DECLARE(stream, uint64_t, 128);
+
+#define TS(E) (E)
+#define CMP(A, B) (((A) > (B)) - ((A) < (B)))
+
+MERGE_DECLARE(merger, stream, uint64_t, MAX_INPUTS);
+MERGE_LIB(merger, stream, uint64_t, uint64_t, TS, CMP)
+
+struct state {
+  size_t n;
+  uint64_t ts[MAX_INPUTS][DEPTH];
+  stream streams[MAX_INPUTS];
+  stream* inputs[MAX_INPUTS];
+  merger m;
+};
+
+/*
+ * Refills every stream with its timestamps.
+ */
+static void fill(struct state* s) {
+  size_t i;
+  size_t j;
+
+  for (i = 0; i < s->n; ++i) {
+    CIRCBUF_INIT(&s->streams[i], 128);
+    for (j = 0; j < DEPTH; ++j) {
+      CIRCBUF_PUSH_BACK(&s->streams[i], s->ts[i][j]);
+    }
+    s->inputs[i] = &s->streams[i];
+  }
+}
+
+static void loser_tree(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  uint64_t out[BATCH];
+  uint64_t sum = 0;
+  size_t i;
+  size_t n;
+
+  fill(s);
+  merger_init(&s->m, s->inputs, s->n, 0);
+  for (i = 0; i < s->n; ++i) {
+    merger_close(&s->m, i);
+  }
+  while ((n = merger_pop_n(&s->m, out, BATCH)) > 0) {
+    while (n > 0) {
+      sum += out[--n];
+    }
+  }
+  bench_keep(sum);
+}
+
+static void linear_scan(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  uint64_t sum = 0;
+  uint64_t best;
+  uint64_t ts = 0;
+  size_t winner;
+  size_t i;
+
+  fill(s);
+  for (;;) {
+    winner = s->n;
+    best = UINT64_MAX;
+    for (i = 0; i < s->n; ++i) {
+      if (!CIRCBUF_ISEMPTY(&s->streams[i])) {
+        CIRCBUF_PEEK_FRONT(&ts, &s->streams[i]);
+        if (ts < best) {
+          best = ts;
+          winner = i;
+        }
+      }
+    }
+    if (winner == s->n) {
+      break;
+    }
+    CIRCBUF_POP_FRONT(&ts, &s->streams[winner]);
+    sum += ts;
+  }
+  bench_keep(sum);
+}
+
+int main(int argc, char** argv) {
+  static const size_t counts[] = { 8, 64, 1024 };
+  static struct state s;
+  uint64_t seed = 42;
+  char params[32];
+  size_t c;
+  size_t i;
+  size_t j;
+  bench b;
+
+  if (!bench_init(&b, "merge", argc, argv)) {
+    return 1;
+  }
+
+  /* Each stream's timestamps climb by random steps, so they interleave. */
+  for (i = 0; i < MAX_INPUTS; ++i) {
+    s.ts[i][0] = bench_rand(&seed) % 1000;
+    for (j = 1; j < DEPTH; ++j) {
+      s.ts[i][j] = s.ts[i][j - 1] + bench_rand(&seed) % 1000;
+    }
+  }
+
+  for (c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+    s.n = counts[c];
+    snprintf(params, sizeof(params), "inputs=%zu", s.n);
+    bench_run(&b, "loser_tree", params, s.n * DEPTH, loser_tree, &s);
+    bench_run(&b, "linear_scan", params, s.n * DEPTH, linear_scan, &s);
+  }
+
+  return bench_finish(&b);
+}
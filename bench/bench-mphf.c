@@ -0,0 +1,90 @@
+#include "bench.h"
+
+#include "mphf.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OPS 4096
+
+struct state {
+  mphf m;
+  mphf_config config;
+  uint64_t* keys;
+  size_t n;
+  size_t next;
+};
+
+static void build(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  mphf m;
+
+  if (!mphf_build(&m, s->keys, s->n, &s->config)) {
+    fprintf(stderr, "mphf_build failed\n");
+    exit(1);
+  }
+  mphf_free(&m);
+}
+
+static void lookup(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  uint64_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    sum += mphf_lookup(&s->m, s->keys[s->next]);
+    s->next = (s->next + 7919) % s->n;
+  }
+  bench_keep(sum);
+}
+
+static void run(bench* b, size_t n, unsigned threads) {
+  mphf_config config = MPHF_CONFIG_STATIC_INIT;
+  struct state s;
+  char params[48];
+  uint64_t seed = n;
+  size_t i;
+
+  s.keys = malloc(n * sizeof(*s.keys));
+  s.n = n;
+  s.next = 0;
+  if (s.keys == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  for (i = 0; i < n; ++i) {
+    s.keys[i] = bench_rand(&seed);
+  }
+
+  config.threads = threads;
+  s.config = config;
+  snprintf(params, sizeof(params), "n=%zu,threads=%u", n, threads);
+  bench_run(b, "build", params, n, build, &s);
+
+  if (!mphf_build(&s.m, s.keys, n, &s.config)) {
+    fprintf(stderr, "mphf_build failed\n");
+    exit(1);
+  }
+  snprintf(params, sizeof(params), "n=%zu", n);
+  bench_run(b, "lookup", params, OPS, lookup, &s);
+
+  mphf_free(&s.m);
+  free(s.keys);
+}
+
+int main(int argc, char** argv) {
+  bench b;
+  unsigned cpus;
+
+  if (!bench_init(&b, "mphf", argc, argv)) {
+    return 1;
+  }
+  cpus = (unsigned)bench_cpus();
+  run(&b, 10000, 1);
+  run(&b, 1000000, 1);
+  if (cpus > 1) {
+    run(&b, 1000000, cpus < MPHF_MAX_THREADS ? cpus : MPHF_MAX_THREADS);
+  }
+  return bench_finish(&b);
+}
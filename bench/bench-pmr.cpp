@@ -0,0 +1,140 @@
+#include "bench.h"
+
+#include "pmr.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Container churn against convoy's resources and the standard ones, with
+ * new/delete as the baseline.
+ */
+
+#define ELEMS 1000
+#define THREADS 4
+#define ROUNDS 10000
+
+struct target {
+  std::pmr::memory_resource* mr;
+  std::function<void()> release;
+};
+
+/*
+ * Builds and tears down a list, one allocation per element.
+ */
+static void list_churn(void* ctx) {
+  target* t = static_cast<target*>(ctx);
+  {
+    std::pmr::list<int> list(t->mr);
+    for (int i = 0; i < ELEMS; ++i) {
+      list.push_back(i);
+    }
+    bench_keep(list.size());
+  }
+  t->release();
+}
+
+/*
+ * Builds and tears down a map of strings too long to be stored inline.
+ */
+static void map_churn(void* ctx) {
+  target* t = static_cast<target*>(ctx);
+  {
+    std::pmr::unordered_map<int, std::pmr::string> map(t->mr);
+    for (int i = 0; i < ELEMS; ++i) {
+      map.emplace(i, "a value that is too long for the small string buffer");
+    }
+    bench_keep(map.size());
+  }
+  t->release();
+}
+
+/*
+ * Threads allocating and freeing mixed sizes out of one shared resource.
+ */
+static void threads_churn(void* ctx) {
+  target* t = static_cast<target*>(ctx);
+  std::vector<std::thread> threads;
+
+  for (int n = 0; n < THREADS; ++n) {
+    threads.emplace_back([t] {
+      void* held[64];
+      std::size_t sizes[64];
+      int count = 0;
+
+      for (int i = 0; i < ROUNDS; ++i) {
+        sizes[count] = 8 + static_cast<std::size_t>(i % 13) * 24;
+        held[count] = t->mr->allocate(sizes[count]);
+        if (++count == 64) {
+          while (count > 0) {
+            --count;
+            t->mr->deallocate(held[count], sizes[count]);
+          }
+        }
+      }
+      while (count > 0) {
+        --count;
+        t->mr->deallocate(held[count], sizes[count]);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  t->release();
+}
+
+static void run(bench* b, const char* params, target& t, bool shared) {
+  bench_run(b, "list_churn", params, ELEMS, list_churn, &t);
+  bench_run(b, "map_churn", params, ELEMS, map_churn, &t);
+  if (shared) {
+    bench_run(b, "threads_churn", params, THREADS * ROUNDS, threads_churn, &t);
+  }
+}
+
+int main(int argc, char** argv) {
+  bench b;
+
+  if (!bench_init(&b, "pmr", argc, argv)) {
+    return 1;
+  }
+
+  {
+    target t{ std::pmr::new_delete_resource(), [] {} };
+    run(&b, "resource=new_delete", t, true);
+  }
+  {
+    std::pmr::unsynchronized_pool_resource pool;
+    target t{ &pool, [] {} };
+    run(&b, "resource=unsynchronized_pool", t, false);
+  }
+  {
+    std::pmr::synchronized_pool_resource pool;
+    target t{ &pool, [] {} };
+    run(&b, "resource=synchronized_pool", t, true);
+  }
+  {
+    convoy::pool_resource pool;
+    target t{ &pool, [] {} };
+    run(&b, "resource=convoy_pool", t, true);
+  }
+  {
+    std::pmr::monotonic_buffer_resource mono;
+    target t{ &mono, [&mono] { mono.release(); } };
+    run(&b, "resource=monotonic_buffer", t, false);
+  }
+  {
+    alignas(std::max_align_t) static unsigned char buf[64 * 1024];
+    convoy::arena_resource arena(buf, sizeof(buf));
+    target t{ &arena, [&arena] { arena.release(); } };
+    run(&b, "resource=convoy_arena", t, false);
+  }
+
+  return bench_finish(&b);
+}
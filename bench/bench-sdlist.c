@@ -0,0 +1,226 @@
+#include "bench.h"
+
+#include "dlist.h"
+#include "sdlist.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * The same random pushes, pops and removes run against a dlist and an sdlist
+ * that never hold more than a few elements, so that dlist's empty, single
+ * element and end cases come up unpredictably and show in the branch misses.
+ * There are enough steps that the branch predictor can't learn them.  A queue
+ * of a thousand elements, where those cases never come up, is the control.
+ */
+
+#define POOL 4
+#define STEPS 65536
+#define QUEUE 1024
+#define OPS 4096
+
+enum { PUSH_FRONT, PUSH_BACK, POP_FRONT, POP_BACK, REMOVE };
+
+struct step {
+  unsigned char op;
+  unsigned char node;
+};
+
+struct node {
+  DLIST_DECLARE_LINK(node, link);
+  SDLIST_DECLARE_LINK(slink);
+  uint64_t val;
+};
+
+DLIST_DECLARE(node_list, node);
+SDLIST_DECLARE(node_slist);
+
+struct state {
+  struct step steps[STEPS + POOL];
+  size_t nsteps;
+  struct node pool[POOL];
+  struct node queue[QUEUE];
+  node_list list;
+  node_slist slist;
+};
+
+/*
+ * Picks STEPS random steps that are valid in turn, starting from and ending
+ * with an empty list, by running them against a dlist.
+ */
+static void plan(struct state* s) {
+  node_list list = DLIST_STATIC_INIT;
+  struct node* node;
+  uint64_t seed = 1;
+  uint64_t r;
+  size_t n = 0;
+  size_t i;
+
+  for (i = 0; i < POOL; ++i) {
+    DLIST_ELEM_INIT(&s->pool[i], link);
+  }
+  for (s->nsteps = 0; s->nsteps < STEPS;) {
+    r = bench_rand(&seed);
+    s->steps[s->nsteps].op = (unsigned char)(r % 5);
+    if (n == POOL && s->steps[s->nsteps].op <= PUSH_BACK) {
+      s->steps[s->nsteps].op = POP_FRONT;
+    } else if (n == 0 && s->steps[s->nsteps].op >= POP_FRONT) {
+      s->steps[s->nsteps].op = PUSH_BACK;
+    }
+    r /= 5;
+
+    switch (s->steps[s->nsteps].op) {
+      case PUSH_FRONT:
+      case PUSH_BACK:
+        do {
+          node = &s->pool[r++ % POOL];
+        } while (DLIST_IS_ELEM_INSERTED(node, link));
+        if (s->steps[s->nsteps].op == PUSH_FRONT) {
+          DLIST_PUSH_FRONT(&list, node, link);
+        } else {
+          DLIST_PUSH_BACK(&list, node, link);
+        }
+        ++n;
+        break;
+      case POP_FRONT:
+        DLIST_POP_FRONT(&list, node, link);
+        --n;
+        break;
+      case POP_BACK:
+        DLIST_POP_BACK(&list, node, link);
+        --n;
+        break;
+      default:
+        do {
+          node = &s->pool[r++ % POOL];
+        } while (!DLIST_IS_ELEM_INSERTED(node, link));
+        DLIST_REMOVE(&list, node, link);
+        --n;
+        break;
+    }
+    s->steps[s->nsteps++].node = (unsigned char)(node - s->pool);
+  }
+  while (n-- > 0) {
+    s->steps[s->nsteps++].op = POP_FRONT;
+  }
+}
+
+static void churn_dlist(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* node;
+  uint64_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < s->nsteps; ++i) {
+    node = &s->pool[s->steps[i].node];
+    switch (s->steps[i].op) {
+      case PUSH_FRONT:
+        DLIST_PUSH_FRONT(&s->list, node, link);
+        break;
+      case PUSH_BACK:
+        DLIST_PUSH_BACK(&s->list, node, link);
+        break;
+      case POP_FRONT:
+        DLIST_POP_FRONT(&s->list, node, link);
+        sum += node->val;
+        break;
+      case POP_BACK:
+        DLIST_POP_BACK(&s->list, node, link);
+        sum += node->val;
+        break;
+      default:
+        DLIST_REMOVE(&s->list, node, link);
+        break;
+    }
+  }
+  bench_keep(sum);
+}
+
+static void churn_sdlist(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* node;
+  uint64_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < s->nsteps; ++i) {
+    node = &s->pool[s->steps[i].node];
+    switch (s->steps[i].op) {
+      case PUSH_FRONT:
+        SDLIST_PUSH_FRONT(&s->slist, node, slink);
+        break;
+      case PUSH_BACK:
+        SDLIST_PUSH_BACK(&s->slist, node, slink);
+        break;
+      case POP_FRONT:
+        SDLIST_POP_FRONT(&s->slist, node, node, slink);
+        sum += node->val;
+        break;
+      case POP_BACK:
+        SDLIST_POP_BACK(&s->slist, node, node, slink);
+        sum += node->val;
+        break;
+      default:
+        SDLIST_REMOVE(node, slink);
+        break;
+    }
+  }
+  bench_keep(sum);
+}
+
+static void queue_dlist(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* node;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    DLIST_POP_FRONT(&s->list, node, link);
+    DLIST_PUSH_BACK(&s->list, node, link);
+  }
+}
+
+static void queue_sdlist(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* node;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    SDLIST_POP_FRONT(&s->slist, node, node, slink);
+    SDLIST_PUSH_BACK(&s->slist, node, slink);
+  }
+}
+
+int main(int argc, char** argv) {
+  static struct state s;
+  char params[32];
+  size_t i;
+  bench b;
+
+  if (!bench_init(&b, "sdlist", argc, argv)) {
+    return 1;
+  }
+
+  plan(&s);
+  DLIST_INIT(&s.list);
+  SDLIST_INIT(&s.slist);
+  for (i = 0; i < POOL; ++i) {
+    s.pool[i].val = i;
+    DLIST_ELEM_INIT(&s.pool[i], link);
+    SDLIST_ELEM_INIT(&s.pool[i], slink);
+  }
+  snprintf(params, sizeof(params), "pool=%d", POOL);
+  bench_run(&b, "churn_dlist", params, s.nsteps, churn_dlist, &s);
+  bench_run(&b, "churn_sdlist", params, s.nsteps, churn_sdlist, &s);
+
+  for (i = 0; i < QUEUE; ++i) {
+    s.queue[i].val = i;
+    DLIST_ELEM_INIT(&s.queue[i], link);
+    SDLIST_ELEM_INIT(&s.queue[i], slink);
+    DLIST_PUSH_BACK(&s.list, &s.queue[i], link);
+    SDLIST_PUSH_BACK(&s.slist, &s.queue[i], slink);
+  }
+  snprintf(params, sizeof(params), "n=%d", QUEUE);
+  bench_run(&b, "queue_dlist", params, OPS, queue_dlist, &s);
+  bench_run(&b, "queue_sdlist", params, OPS, queue_sdlist, &s);
+
+  return bench_finish(&b);
+}
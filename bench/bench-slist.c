@@ -0,0 +1,121 @@
+#include "bench.h"
+
+#include "slist.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OPS 4096
+
+struct node {
+  SLIST_DECLARE_LINK(node, link);
+  uint64_t val;
+};
+
+SLIST_DECLARE(node_list, node);
+
+/*
+ * A list of N nodes linked in a random order, so that walking it jumps around
+ * memory once N outgrows the caches.
+ */
+struct state {
+  node_list list;
+  struct node* nodes;
+  size_t* order;
+  size_t n;
+};
+
+static void queue(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* node;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    SLIST_POP_FRONT(&s->list, node, link);
+    SLIST_PUSH_BACK(&s->list, node, link);
+  }
+}
+
+/*
+ * Takes the same turns as popping the front and pushing it back, by rotating.
+ */
+static void round_robin(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* node;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    SLIST_ROUND_ROBIN(&s->list, node, link);
+  }
+  (void)node;
+}
+
+static void stack(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* stash[OPS / 8];
+  size_t i;
+  size_t j;
+
+  for (i = 0; i < OPS; i += 2 * OPS / 8) {
+    for (j = 0; j < OPS / 8; ++j) {
+      SLIST_POP_FRONT(&s->list, stash[j], link);
+    }
+    while (j > 0) {
+      --j;
+      SLIST_PUSH_FRONT(&s->list, stash[j], link);
+    }
+  }
+}
+
+static void walk(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  struct node* curr;
+  uint64_t sum = 0;
+
+  SLIST_FOREACH(curr, &s->list, link, sum += curr->val);
+  bench_keep(sum);
+}
+
+static void run(bench* b, size_t n) {
+  struct state s;
+  char params[32];
+  size_t i;
+
+  s.nodes = malloc(n * sizeof(*s.nodes));
+  s.order = malloc(n * sizeof(*s.order));
+  s.n = n;
+  if (s.nodes == NULL || s.order == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  SLIST_INIT(&s.list);
+  bench_shuffle(s.order, n, n);
+  for (i = 0; i < n; ++i) {
+    struct node* node = &s.nodes[s.order[i]];
+    node->val = i;
+    SLIST_ELEM_INIT(node, link);
+    SLIST_PUSH_BACK(&s.list, node, link);
+  }
+
+  snprintf(params, sizeof(params), "n=%zu", n);
+  bench_run(b, "queue", params, OPS, queue, &s);
+  bench_run(b, "round_robin", params, OPS, round_robin, &s);
+  bench_run(b, "stack", params, OPS, stack, &s);
+  bench_run(b, "walk", params, n, walk, &s);
+
+  free(s.order);
+  free(s.nodes);
+}
+
+int main(int argc, char** argv) {
+  bench b;
+
+  if (!bench_init(&b, "slist", argc, argv)) {
+    return 1;
+  }
+  run(&b, 1024);
+  run(&b, 1 << 20);
+  return bench_finish(&b);
+}
@@ -0,0 +1,102 @@
+#include "bench.h"
+
+#include "sortset.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Two sets of random ids and room for their union.  With ids drawn from a
+ * universe four times the larger set's size, about a quarter of the smaller
+ * set is shared.
+ */
+struct state {
+  sortset a;
+  sortset b;
+  sortset out;
+};
+
+static void fill(sortset* set, size_t n, uint64_t seed) {
+  uint32_t* ids = malloc(n * sizeof(*ids));
+  size_t i;
+
+  if (ids == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  for (i = 0; i < n; ++i) {
+    ids[i] = (uint32_t)(bench_rand(&seed) % (4 * n));
+  }
+  sortset_from_array(set, ids, n);
+  free(ids);
+}
+
+static void intersect(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  bench_keep(sortset_intersect(&s->out, &s->a, &s->b));
+}
+
+static void unite(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  bench_keep(sortset_union(&s->out, &s->a, &s->b));
+}
+
+static void contains(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  uint64_t found = 0;
+  size_t i;
+
+  for (i = 0; i < s->a.len; ++i) {
+    found += sortset_contains(&s->b, s->a.ids[i]);
+  }
+  bench_keep(found);
+}
+
+/*
+ * Runs every workload over a set of NA ids and one of NB ids.  Ops count the
+ * ids in both inputs, except for lookups, where they count lookups.
+ */
+static void run(bench* b, size_t na, size_t nb) {
+  struct state s;
+  char params[48];
+
+  SORTSET_INIT(&s.a, malloc(na * sizeof(uint32_t)), na);
+  SORTSET_INIT(&s.b, malloc(nb * sizeof(uint32_t)), nb);
+  SORTSET_INIT(&s.out, malloc((na + nb) * sizeof(uint32_t)), na + nb);
+  if (s.a.ids == NULL || s.b.ids == NULL || s.out.ids == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  /* Both draw from a universe sized to the larger set. */
+  fill(&s.a, na, 1);
+  fill(&s.b, nb, 2);
+  if (na < nb) {
+    size_t i;
+    for (i = 0; i < s.a.len; ++i) {
+      s.a.ids[i] = s.a.ids[i] * (uint32_t)(nb / na);
+    }
+  }
+
+  snprintf(params, sizeof(params), "a=%zu,b=%zu", na, nb);
+  bench_run(b, "intersect", params, s.a.len + s.b.len, intersect, &s);
+  bench_run(b, "union", params, s.a.len + s.b.len, unite, &s);
+  bench_run(b, "contains", params, s.a.len, contains, &s);
+
+  free(s.out.ids);
+  free(s.b.ids);
+  free(s.a.ids);
+}
+
+int main(int argc, char** argv) {
+  bench b;
+
+  if (!bench_init(&b, "sortset", argc, argv)) {
+    return 1;
+  }
+  run(&b, 1000, 1000);
+  run(&b, 100000, 100000);
+  run(&b, 100, 100000);
+  return bench_finish(&b);
+}
@@ -0,0 +1,202 @@
+#include "bench.h"
+
+#include "splat.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef SPLAT_BRANCHLESS
+#define SUITE "splat-branchless"
+#else
+#define SUITE "splat"
+#endif
+
+#define OPS 4096
+
+typedef struct block {
+  SPLAT_LINK(block, link);
+  int key;
+} block_t;
+
+SPLAT_NEW(blocks, block);
+
+#define CMP(a, b) (((a) > (b)) - ((a) < (b)))
+
+SPLAT_LIB(blocks, block, int, CMP, link, key)
+
+typedef struct slot {
+  SPLAT_IDX_LINK(link);
+  int key;
+} slot_t;
+
+SPLAT_IDX_NEW(slots, slot);
+
+SPLAT_IDX_LIB(slots, slot, int, CMP, link, key)
+
+/*
+ * N blocks keyed 0 to N - 1, and the same keys in a pool whose slot 0 is
+ * the nil slot.  ORDER is a random permutation of the keys.
+ */
+struct state {
+  blocks tree;
+  block_t* blocks;
+  slots idx_tree;
+  slot_t* pool;
+  size_t* order;
+  size_t n;
+  size_t next;
+};
+
+/*
+ * Gets the next key from the random permutation.
+ */
+static int next_key(struct state* s) {
+  int key = (int)s->order[s->next];
+  s->next = (s->next + 1) % s->n;
+  return key;
+}
+
+static void reset(struct state* s) {
+  size_t i;
+
+  SPLAT_INIT(&s->tree);
+  for (i = 0; i < s->n; ++i) {
+    SPLAT_ELEM_INIT(&s->blocks[i], link);
+  }
+}
+
+static void insert_random(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  size_t i;
+
+  reset(s);
+  for (i = 0; i < s->n; ++i) {
+    blocks_insert(&s->tree, &s->blocks[s->order[i]]);
+  }
+}
+
+static void insert_sorted(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  size_t i;
+
+  reset(s);
+  for (i = 0; i < s->n; ++i) {
+    blocks_insert(&s->tree, &s->blocks[i]);
+  }
+}
+
+static void insert_hint_sorted(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  block_t* hint = NULL;
+  size_t i;
+
+  reset(s);
+  for (i = 0; i < s->n; ++i) {
+    blocks_insert_hint(&s->tree, hint, &s->blocks[i]);
+    hint = &s->blocks[i];
+  }
+}
+
+static void search_random(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  uint64_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    sum += (uint64_t)blocks_search(&s->tree, next_key(s))->key;
+  }
+  bench_keep(sum);
+}
+
+/*
+ * Nine in ten searches go to one key in a hundred, which splaying keeps near
+ * the root.
+ */
+static void search_skewed(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  uint64_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    int key = next_key(s);
+    if (i % 10 != 0) {
+      key %= (int)(s->n / 100);
+    }
+    sum += (uint64_t)blocks_search(&s->tree, key)->key;
+  }
+  bench_keep(sum);
+}
+
+static void remove_insert(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    block_t* block = blocks_remove(&s->tree, next_key(s));
+    blocks_insert(&s->tree, block);
+  }
+}
+
+static void idx_search_random(void* ctx) {
+  struct state* s = (struct state*)ctx;
+  uint64_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    sum += (uint64_t)slots_search(&s->idx_tree, next_key(s))->key;
+  }
+  bench_keep(sum);
+}
+
+static void run(bench* b, size_t n) {
+  struct state s;
+  char params[32];
+  size_t i;
+
+  s.blocks = malloc(n * sizeof(*s.blocks));
+  s.pool = malloc((n + 1) * sizeof(*s.pool));
+  s.order = malloc(n * sizeof(*s.order));
+  s.n = n;
+  s.next = 0;
+  if (s.blocks == NULL || s.pool == NULL || s.order == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  bench_shuffle(s.order, n, n);
+  SPLAT_IDX_INIT(&s.idx_tree, s.pool);
+  for (i = 0; i < n; ++i) {
+    s.blocks[i].key = (int)i;
+    s.pool[i + 1].key = (int)s.order[i];
+    SPLAT_IDX_ELEM_INIT(&s.pool[i + 1], link);
+    slots_insert(&s.idx_tree, &s.pool[i + 1]);
+  }
+
+  snprintf(params, sizeof(params), "n=%zu", n);
+  bench_run(b, "insert_random", params, n, insert_random, &s);
+  bench_run(b, "insert_sorted", params, n, insert_sorted, &s);
+  bench_run(b, "insert_hint_sorted", params, n, insert_hint_sorted, &s);
+
+  insert_random(&s);
+  bench_run(b, "search_random", params, OPS, search_random, &s);
+  bench_run(b, "search_skewed", params, OPS, search_skewed, &s);
+  bench_run(b, "remove_insert", params, OPS, remove_insert, &s);
+  bench_run(b, "idx_search_random", params, OPS, idx_search_random, &s);
+
+  free(s.order);
+  free(s.pool);
+  free(s.blocks);
+}
+
+int main(int argc, char** argv) {
+  bench b;
+
+  if (!bench_init(&b, SUITE, argc, argv)) {
+    return 1;
+  }
+  run(&b, 1000);
+  run(&b, 100000);
+  return bench_finish(&b);
+}
@@ -0,0 +1,111 @@
+#include "bench.h"
+
+#include "convoy.hpp"
+#include "spsc.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+/*
+ * Sends heap-allocated strings from a producer thread to the main thread,
+ * through spsc_channel, which moves them, and through a convoy::circbuf
+ * behind a mutex, which copies them in and out.
+ */
+
+#define OPS 100000
+#define LIMIT 1024
+
+static const std::string payload(64, 'x');
+
+struct state {
+  int cpu;
+  convoy::spsc_channel<std::string, LIMIT> chan;
+  std::mutex mutex;
+  convoy::circbuf<std::string, LIMIT> ring;
+};
+
+static void spsc_move(void* ctx) {
+  state* s = static_cast<state*>(ctx);
+  std::uint64_t sum = 0;
+
+  std::thread producer([s] {
+    bench_pin(s->cpu + 1);
+    for (int i = 0; i < OPS; ++i) {
+      std::string elem = payload;
+      while (!s->chan.try_push(std::move(elem))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  for (int i = 0; i < OPS; ++i) {
+    std::optional<std::string> elem;
+    while (!(elem = s->chan.try_pop())) {
+      std::this_thread::yield();
+    }
+    sum += elem->size();
+  }
+  producer.join();
+  bench_keep(sum);
+}
+
+static void mutex_copy(void* ctx) {
+  state* s = static_cast<state*>(ctx);
+  std::uint64_t sum = 0;
+
+  std::thread producer([s] {
+    bench_pin(s->cpu + 1);
+    for (int i = 0; i < OPS; ++i) {
+      const std::string elem = payload;
+      bool pushed;
+      do {
+        {
+          std::lock_guard<std::mutex> lock(s->mutex);
+          pushed = s->ring.push_back(elem);
+        }
+        if (!pushed) {
+          std::this_thread::yield();
+        }
+      } while (!pushed);
+    }
+  });
+  for (int i = 0; i < OPS; ++i) {
+    std::string elem;
+    std::string dropped;
+    bool popped;
+    do {
+      {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        popped = !s->ring.empty();
+        if (popped) {
+          elem = std::as_const(s->ring.front());
+          s->ring.pop_front(dropped);
+        }
+      }
+      if (!popped) {
+        std::this_thread::yield();
+      }
+    } while (!popped);
+    sum += elem.size();
+  }
+  producer.join();
+  bench_keep(sum);
+}
+
+int main(int argc, char** argv) {
+  bench b;
+
+  if (!bench_init(&b, "spsc", argc, argv)) {
+    return 1;
+  }
+
+  static state s;
+  s.cpu = b.cpu;
+  bench_run(&b, "spsc_move", "limit=1024", OPS, spsc_move, &s);
+  bench_run(&b, "mutex_copy", "limit=1024", OPS, mutex_copy, &s);
+
+  return bench_finish(&b);
+}
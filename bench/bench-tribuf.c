@@ -0,0 +1,190 @@
+#include "bench.h"
+
+#include "tribuf.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Publishing 128-byte snapshots through a tribuf, alone and bounced between
+ * two threads, with a mutex-guarded copy as the baseline for the latter.
+ */
+
+#define OPS 4096
+#define PINGS 20000
+
+typedef struct snapshot {
+  uint64_t seq;
+  uint64_t words[15];
+} snapshot_t;
+
+TRIBUF_DECLARE(mailbox, snapshot_t);
+
+static void fill(snapshot_t* snap, uint64_t seq) {
+  size_t i;
+
+  snap->seq = seq;
+  for (i = 0; i < 15; ++i) {
+    snap->words[i] = seq + i;
+  }
+}
+
+/*
+ * Each op fills the writer's buffer in place and publishes it.
+ */
+static void publish(void* ctx) {
+  mailbox* mb = (mailbox*)ctx;
+  uint64_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    fill(TRIBUF_WRITE_BUF(mb), i);
+    TRIBUF_PUBLISH(mb);
+  }
+}
+
+/*
+ * Each op publishes and then reads the value back on the same thread.
+ */
+static void publish_read(void* ctx) {
+  mailbox* mb = (mailbox*)ctx;
+  uint64_t sum = 0;
+  uint64_t i;
+
+  for (i = 0; i < OPS; ++i) {
+    fill(TRIBUF_WRITE_BUF(mb), i);
+    TRIBUF_PUBLISH(mb);
+    sum += TRIBUF_READ(mb)->words[7];
+  }
+  bench_keep(sum);
+}
+
+struct pair {
+  int cpu;
+  mailbox there;
+  mailbox back;
+  pthread_mutex_t mutex;
+  snapshot_t shared_there;
+  snapshot_t shared_back;
+};
+
+/*
+ * Echoes every snapshot it reads from THERE back through BACK.
+ */
+static void* echo(void* arg) {
+  struct pair* p = (struct pair*)arg;
+  uint64_t seq;
+
+  bench_pin(p->cpu + 1);
+  for (seq = 1; seq <= PINGS; ++seq) {
+    while (!TRIBUF_UPDATE(&p->there)) {
+      sched_yield();
+    }
+    *TRIBUF_WRITE_BUF(&p->back) = *TRIBUF_PEEK(&p->there);
+    TRIBUF_PUBLISH(&p->back);
+  }
+  return NULL;
+}
+
+/*
+ * Each op is a round trip: a snapshot published to the other thread and its
+ * echo read back.
+ */
+static void ping_pong(void* ctx) {
+  struct pair* p = (struct pair*)ctx;
+  pthread_t thread;
+  uint64_t seq;
+
+  TRIBUF_INIT(&p->there);
+  TRIBUF_INIT(&p->back);
+  pthread_create(&thread, NULL, echo, p);
+  for (seq = 1; seq <= PINGS; ++seq) {
+    fill(TRIBUF_WRITE_BUF(&p->there), seq);
+    TRIBUF_PUBLISH(&p->there);
+    while (!TRIBUF_UPDATE(&p->back)) {
+      sched_yield();
+    }
+  }
+  pthread_join(thread, NULL);
+  bench_keep(TRIBUF_PEEK(&p->back)->seq);
+}
+
+/*
+ * Reads the latest snapshot out of SHARED under the mutex, if it is newer
+ * than LAST.
+ */
+static bool take_newer(struct pair* p,
+                       const snapshot_t* shared,
+                       snapshot_t* out,
+                       uint64_t last) {
+  bool newer;
+
+  pthread_mutex_lock(&p->mutex);
+  newer = shared->seq > last;
+  if (newer) {
+    *out = *shared;
+  }
+  pthread_mutex_unlock(&p->mutex);
+  return newer;
+}
+
+static void* echo_mutex(void* arg) {
+  struct pair* p = (struct pair*)arg;
+  snapshot_t snap;
+  uint64_t seq;
+
+  bench_pin(p->cpu + 1);
+  for (seq = 1; seq <= PINGS; ++seq) {
+    while (!take_newer(p, &p->shared_there, &snap, seq - 1)) {
+      sched_yield();
+    }
+    pthread_mutex_lock(&p->mutex);
+    p->shared_back = snap;
+    pthread_mutex_unlock(&p->mutex);
+  }
+  return NULL;
+}
+
+static void ping_pong_mutex(void* ctx) {
+  struct pair* p = (struct pair*)ctx;
+  pthread_t thread;
+  snapshot_t snap;
+  uint64_t seq;
+
+  fill(&p->shared_there, 0);
+  fill(&p->shared_back, 0);
+  pthread_create(&thread, NULL, echo_mutex, p);
+  for (seq = 1; seq <= PINGS; ++seq) {
+    fill(&snap, seq);
+    pthread_mutex_lock(&p->mutex);
+    p->shared_there = snap;
+    pthread_mutex_unlock(&p->mutex);
+    while (!take_newer(p, &p->shared_back, &snap, seq - 1)) {
+      sched_yield();
+    }
+  }
+  pthread_join(thread, NULL);
+  bench_keep(snap.seq);
+}
+
+int main(int argc, char** argv) {
+  static mailbox mb = TRIBUF_STATIC_INIT;
+  static struct pair p;
+  bench b;
+
+  if (!bench_init(&b, "tribuf", argc, argv)) {
+    return 1;
+  }
+
+  bench_run(&b, "publish", "bytes=128", OPS, publish, &mb);
+  bench_run(&b, "publish_read", "bytes=128", OPS, publish_read, &mb);
+
+  p.cpu = b.cpu;
+  pthread_mutex_init(&p.mutex, NULL);
+  bench_run(&b, "ping_pong", "bytes=128", PINGS, ping_pong, &p);
+  bench_run(&b, "ping_pong_mutex", "bytes=128", PINGS, ping_pong_mutex, &p);
+  pthread_mutex_destroy(&p.mutex);
+
+  return bench_finish(&b);
+}
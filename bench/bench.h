@@ -0,0 +1,484 @@
+/*
+ * A small benchmark harness shared by the programs in bench/.
+ *
+ * A workload is a function that performs a fixed number of operations on some
+ * state.  bench_run() warms it up, sizes batches of calls to it so that each
+ * sample takes long enough to time, and keeps taking samples until the median
+ * time per operation settles.  Each workload's result is written as one JSON
+ * object, so runs before and after a change can be compared with
+ * bench/compare.py.
+ *
+ * Cycles, instructions, cache misses and branch misses are counted with
+ * perf_event_open(2) for the sampled thread and any threads it starts.  Where
+ * the kernel doesn't allow that, e.g. under a strict perf_event_paranoid or in
+ * a VM without a virtual PMU, those counters are reported as null and only
+ * times are collected.
+ *
+ * This header must be included before any system header, since it needs
+ * _GNU_SOURCE for thread pinning.
+ *
+ * Usage:
+ *
+ *   static void push_pop(void* ctx) {
+ *     ... 1000 operations on ctx ...
+ *   }
+ *
+ *   int main(int argc, char** argv) {
+ *     bench b;
+ *     if (!bench_init(&b, "circbuf", argc, argv)) {
+ *       return 1;
+ *     }
+ *     bench_run(&b, "push_pop", "limit=64", 1000, push_pop, &ring);
+ *     return bench_finish(&b);
+ *   }
+ *
+ * Every program takes the same options:
+ *
+ *   --json PATH    write the JSON results to PATH instead of stdout
+ *   --filter STR   only run workloads whose name contains STR
+ *   --cpu N        pin the main thread to CPU N, -1 to leave it unpinned
+ *   --quick        take a few short samples, to check that workloads run
+ */
+
+#ifndef __CONVOY_BENCH_H__
+#define __CONVOY_BENCH_H__
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Most samples a workload takes before giving up on it settling.
+ */
+#define BENCH_MAX_SAMPLES 64
+
+/*
+ * Fewest samples a workload takes before checking whether it has settled.
+ */
+#define BENCH_MIN_SAMPLES 5
+
+/*
+ * A workload has settled once the median absolute deviation of its samples
+ * is within this fraction of their median.
+ */
+#define BENCH_SPREAD 0.01
+
+/*
+ * Hardware counters, in the order they are reported.
+ */
+enum {
+  BENCH_CYCLES,
+  BENCH_INSTRUCTIONS,
+  BENCH_CACHE_MISSES,
+  BENCH_BRANCH_MISSES,
+  BENCH_COUNTERS
+};
+
+/*
+ * A benchmark program's options, output and counters.
+ */
+typedef struct bench {
+  const char* suite;
+  const char* filter;
+  FILE* out;
+  int cpu;
+  bool quick;
+  size_t results;
+  uint64_t warmup_ns;
+  uint64_t sample_ns;
+  int fds[BENCH_COUNTERS];
+} bench;
+
+/*
+ * Gets the time from a monotonic clock, in nanoseconds.
+ */
+static inline uint64_t bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Keeps the compiler from optimizing away the computation of VALUE.
+ */
+static inline void bench_keep(uint64_t value) {
+  __asm__ volatile("" : : "r"(value) : "memory");
+}
+
+/*
+ * Steps a splitmix64 generator, for workloads that need reproducible keys.
+ */
+static inline uint64_t bench_rand(uint64_t* state) {
+  uint64_t z = (*state += UINT64_C(0x9e3779b97f4a7c15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return z ^ (z >> 31);
+}
+
+/*
+ * Shuffles N indices in ORDER into a random permutation of [0, N).
+ */
+static inline void bench_shuffle(size_t* order, size_t n, uint64_t seed) {
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    order[i] = i;
+  }
+  for (i = n; i > 1; --i) {
+    size_t j = (size_t)(bench_rand(&seed) % i);
+    size_t tmp = order[i - 1];
+    order[i - 1] = order[j];
+    order[j] = tmp;
+  }
+}
+
+/*
+ * Gets how many CPUs are online.
+ */
+static inline int bench_cpus(void) {
+#ifdef __linux__
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#else
+  return 1;
+#endif
+}
+
+/*
+ * Pins the calling thread to CPU, wrapping around the CPUs that are online.
+ * Returns false if the thread couldn't be pinned.
+ */
+static inline bool bench_pin(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+
+  if (cpu < 0) {
+    return false;
+  }
+  CPU_ZERO(&set);
+  CPU_SET(cpu % bench_cpus(), &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+static inline void bench_counters_open_(bench* b) {
+  int i;
+
+  for (i = 0; i < BENCH_COUNTERS; ++i) {
+    b->fds[i] = -1;
+  }
+#ifdef __linux__
+  {
+    static const uint64_t configs[BENCH_COUNTERS] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES,
+    };
+
+    for (i = 0; i < BENCH_COUNTERS; ++i) {
+      struct perf_event_attr attr;
+
+      memset(&attr, 0, sizeof(attr));
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = configs[i];
+      attr.disabled = 1;
+      attr.inherit = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      b->fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+  }
+#endif
+}
+
+static inline void bench_counters_start_(bench* b) {
+#ifdef __linux__
+  int i;
+
+  for (i = 0; i < BENCH_COUNTERS; ++i) {
+    if (b->fds[i] >= 0) {
+      ioctl(b->fds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(b->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#else
+  (void)b;
+#endif
+}
+
+/*
+ * Stops the counters and stores what they counted in COUNTS.  A counter that
+ * can't be read is closed and skipped from then on.
+ */
+static inline void bench_counters_stop_(bench* b, uint64_t* counts) {
+  int i;
+
+  for (i = 0; i < BENCH_COUNTERS; ++i) {
+    counts[i] = 0;
+  }
+#ifdef __linux__
+  for (i = 0; i < BENCH_COUNTERS; ++i) {
+    if (b->fds[i] >= 0) {
+      ioctl(b->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+      if (read(b->fds[i], &counts[i], sizeof(counts[i])) !=
+          (ssize_t)sizeof(counts[i])) {
+        close(b->fds[i]);
+        b->fds[i] = -1;
+      }
+    }
+  }
+#endif
+}
+
+static inline int bench_cmp_double_(const void* a, const void* b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Sorts the N values in VALUES and gets their median.
+ */
+static inline double bench_median_(double* values, size_t n) {
+  qsort(values, n, sizeof(*values), bench_cmp_double_);
+  return (n % 2 == 1) ? values[n / 2]
+                      : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+/*
+ * Gets the median absolute deviation of N values around MEDIAN.
+ */
+static inline double bench_mad_(const double* values, size_t n, double median) {
+  double devs[BENCH_MAX_SAMPLES];
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    devs[i] = values[i] > median ? values[i] - median : median - values[i];
+  }
+  return bench_median_(devs, n);
+}
+
+static inline void bench_write_string_(FILE* f, const char* str) {
+  fputc('"', f);
+  for (; *str != '\0'; ++str) {
+    unsigned char c = (unsigned char)*str;
+    if (c == '"' || c == '\\') {
+      fprintf(f, "\\%c", c);
+    } else if (c < 0x20) {
+      fprintf(f, "\\u%04x", c);
+    } else {
+      fputc(c, f);
+    }
+  }
+  fputc('"', f);
+}
+
+/*
+ * Parses the command line and starts the JSON output for the program's
+ * SUITE of workloads.  Returns false on bad arguments.
+ */
+static inline bool bench_init(bench* b, const char* suite, int argc,
+                              char** argv) {
+  const char* path = NULL;
+  int i;
+
+  b->suite = suite;
+  b->filter = NULL;
+  b->out = stdout;
+  b->cpu = 0;
+  b->quick = false;
+  b->results = 0;
+
+  for (i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      b->filter = argv[++i];
+    } else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+      b->cpu = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--quick") == 0) {
+      b->quick = true;
+    } else {
+      fprintf(stderr,
+              "usage: %s [--json PATH] [--filter STR] [--cpu N] [--quick]\n",
+              argv[0]);
+      return false;
+    }
+  }
+
+  b->warmup_ns = b->quick ? UINT64_C(1000000) : UINT64_C(100000000);
+  b->sample_ns = b->quick ? UINT64_C(1000000) : UINT64_C(20000000);
+
+  if (path != NULL) {
+    b->out = fopen(path, "w");
+    if (b->out == NULL) {
+      fprintf(stderr, "%s: can't write %s\n", argv[0], path);
+      return false;
+    }
+  }
+
+  if (b->cpu >= 0 && !bench_pin(b->cpu)) {
+    b->cpu = -1;
+  }
+  bench_counters_open_(b);
+
+  fprintf(b->out, "{\n  \"suite\": ");
+  bench_write_string_(b->out, suite);
+  fprintf(b->out, ",\n  \"cpu\": %d,\n  \"counters\": %s,\n", b->cpu,
+          b->fds[BENCH_CYCLES] >= 0 ? "true" : "false");
+  fprintf(b->out, "  \"results\": [");
+  return true;
+}
+
+/*
+ * Runs a workload and writes out its results.  FN performs OPS operations on
+ * CTX each call, and PARAMS describes the workload's parameters, like
+ * "n=1000".  Workloads whose name doesn't match the filter are skipped.
+ */
+static inline void bench_run(bench* b,
+                             const char* name,
+                             const char* params,
+                             size_t ops,
+                             void (*fn)(void*),
+                             void* ctx) {
+  static const char* const counter_names[BENCH_COUNTERS] = {
+    "cycles",
+    "instructions",
+    "cache_misses",
+    "branch_misses",
+  };
+  double times[BENCH_MAX_SAMPLES];
+  double counters[BENCH_COUNTERS][BENCH_MAX_SAMPLES];
+  double sorted[BENCH_MAX_SAMPLES];
+  size_t max_samples = b->quick ? BENCH_MIN_SAMPLES : BENCH_MAX_SAMPLES;
+  size_t samples = 0;
+  size_t calls = 0;
+  size_t batch;
+  double median = 0;
+  double mad = 0;
+  double best;
+  bool settled = false;
+  uint64_t start;
+  uint64_t elapsed;
+  size_t i;
+  int c;
+
+  if (b->filter != NULL && strstr(name, b->filter) == NULL) {
+    return;
+  }
+
+  /* Warm up, and size batches from how long calls took meanwhile. */
+  start = bench_now_ns();
+  do {
+    fn(ctx);
+    ++calls;
+    elapsed = bench_now_ns() - start;
+  } while (elapsed < b->warmup_ns);
+  batch = (size_t)(b->sample_ns * calls / (elapsed != 0 ? elapsed : 1));
+  if (batch == 0) {
+    batch = 1;
+  }
+
+  while (samples < max_samples && !settled) {
+    uint64_t counts[BENCH_COUNTERS];
+    double per_op = (double)batch * (double)ops;
+
+    bench_counters_start_(b);
+    start = bench_now_ns();
+    for (i = 0; i < batch; ++i) {
+      fn(ctx);
+    }
+    elapsed = bench_now_ns() - start;
+    bench_counters_stop_(b, counts);
+
+    times[samples] = (double)elapsed / per_op;
+    for (c = 0; c < BENCH_COUNTERS; ++c) {
+      counters[c][samples] = (double)counts[c] / per_op;
+    }
+    ++samples;
+
+    memcpy(sorted, times, samples * sizeof(*times));
+    median = bench_median_(sorted, samples);
+    mad = bench_mad_(times, samples, median);
+    settled = samples >= BENCH_MIN_SAMPLES && mad <= median * BENCH_SPREAD;
+  }
+  best = sorted[0];
+
+  fprintf(b->out, "%s\n    {\n      \"name\": ", b->results++ ? "," : "");
+  bench_write_string_(b->out, name);
+  fprintf(b->out, ",\n      \"params\": ");
+  bench_write_string_(b->out, params);
+  fprintf(b->out, ",\n      \"ops\": %zu,\n", ops);
+  fprintf(b->out, "      \"batch\": %zu,\n", batch);
+  fprintf(b->out, "      \"samples\": %zu,\n      \"settled\": %s,\n", samples,
+          settled ? "true" : "false");
+  fprintf(b->out, "      \"ns_per_op\": %.4f,\n", median);
+  fprintf(b->out, "      \"ns_per_op_mad\": %.4f,\n", mad);
+  fprintf(b->out, "      \"ns_per_op_min\": %.4f", best);
+  for (c = 0; c < BENCH_COUNTERS; ++c) {
+    fprintf(b->out, ",\n      \"%s\": ", counter_names[c]);
+    if (b->fds[c] >= 0) {
+      fprintf(b->out, "%.4f", bench_median_(counters[c], samples));
+    } else {
+      fprintf(b->out, "null");
+    }
+  }
+  fprintf(b->out, "\n    }");
+  fflush(b->out);
+
+  fprintf(stderr, "%s/%s %s: %.2f ns/op +- %.1f%%", b->suite, name, params,
+          median, median > 0 ? 100 * mad / median : 0.0);
+  if (b->fds[BENCH_CYCLES] >= 0 && b->fds[BENCH_INSTRUCTIONS] >= 0) {
+    fprintf(stderr, ", %.1f cycles/op, %.2f IPC",
+            bench_median_(counters[BENCH_CYCLES], samples),
+            bench_median_(counters[BENCH_INSTRUCTIONS], samples) /
+              bench_median_(counters[BENCH_CYCLES], samples));
+  }
+  fprintf(stderr, "%s\n", settled ? "" : " (unsettled)");
+}
+
+/*
+ * Finishes the JSON output and closes the counters.  Returns the program's
+ * exit status.
+ */
+static inline int bench_finish(bench* b) {
+  int status = 0;
+  int i;
+
+  fprintf(b->out, "\n  ]\n}\n");
+  if (b->out != stdout && fclose(b->out) != 0) {
+    status = 1;
+  }
+#ifdef __linux__
+  for (i = 0; i < BENCH_COUNTERS; ++i) {
+    if (b->fds[i] >= 0) {
+      close(b->fds[i]);
+    }
+  }
+#else
+  (void)i;
+#endif
+  return status;
+}
+
+#endif
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""Compares two runs of a benchmark program from bench/.
+
+Usage:
+
+  bench/compare.py OLD.json NEW.json
+
+Prints each workload's median time per op in both runs and the change.
+Changes within the two runs' combined median absolute deviation are marked
+as noise.  Counter columns show per-op changes where both runs have them.
+"""
+
+import json
+import sys
+
+COUNTERS = ("cycles", "instructions", "cache_misses", "branch_misses")
+
+
+def load(path):
+    with open(path) as f:
+        run = json.load(f)
+    return run, {(r["name"], r["params"]): r for r in run["results"]}
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write("usage: compare.py OLD.json NEW.json\n")
+        return 1
+
+    old_run, old = load(argv[1])
+    new_run, new = load(argv[2])
+    if old_run["suite"] != new_run["suite"]:
+        sys.stderr.write("comparing suite %s against %s\n" %
+                         (old_run["suite"], new_run["suite"]))
+
+    for key, n in new.items():
+        o = old.get(key)
+        label = "%s %s" % key
+        if o is None:
+            print("%-48s %10s -> %10.2f ns/op  (new)" %
+                  (label, "", n["ns_per_op"]))
+            continue
+
+        change = (n["ns_per_op"] - o["ns_per_op"]) / o["ns_per_op"] * 100
+        noise = abs(n["ns_per_op"] - o["ns_per_op"]) <= (
+            n["ns_per_op_mad"] + o["ns_per_op_mad"])
+        line = "%-48s %10.2f -> %10.2f ns/op %+7.1f%%%s" % (
+            label, o["ns_per_op"], n["ns_per_op"], change,
+            "  (noise)" if noise else "")
+        for counter in COUNTERS:
+            if o.get(counter) is not None and n.get(counter) is not None:
+                line += "  %s %+.2f" % (counter, n[counter] - o[counter])
+        print(line)
+
+    for key in old:
+        if key not in new:
+            print("%-48s  (gone)" % ("%s %s" % key))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
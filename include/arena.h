@@ -0,0 +1,105 @@
+/*
+ * Implementation of a bump arena.  The arena does not own its storage, the
+ * caller hands it a buffer and its size with ARENA_INIT().
+ *
+ * Allocating moves a cursor forward and freeing single allocations is not
+ * supported.  Everything is released at once by resetting the arena, or
+ * back to an earlier point with ARENA_RELEASE().
+ */
+
+#ifndef __CONVOY_ARENA_H__
+#define __CONVOY_ARENA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Used to give macros a void return value.
+ */
+#define ARENA_VOID ((void)0)
+
+#ifdef ARENA_ASSERTS
+#include <assert.h>
+#define ARENA_ASSERT(...) assert(__VA_ARGS__)
+#else
+#define ARENA_ASSERT(...) ARENA_VOID
+#endif
+
+/*
+ * A bump arena over CAP bytes at BASE, of which the first USED are taken.
+ */
+typedef struct arena {
+  unsigned char* base;
+  size_t used;
+  size_t cap;
+} arena;
+
+/*
+ * Initializes an arena over the buffer BUF, which is CAP bytes long.
+ */
+#define ARENA_INIT(ARENA, BUF, CAP)       \
+  ((ARENA)->base = (unsigned char*)(BUF), \
+   (ARENA)->used = 0,                     \
+   (ARENA)->cap = (CAP),                  \
+                                          \
+   ARENA_VOID)
+
+/*
+ * Statically initializes an arena.
+ */
+#define ARENA_STATIC_INIT(BUF, CAP) \
+  { .base = (unsigned char*)(BUF), .used = 0, .cap = (CAP) }
+
+/*
+ * Gets the number of bytes left in an arena, ignoring alignment.
+ */
+#define ARENA_REMAINING(ARENA) ((ARENA)->cap - (ARENA)->used)
+
+/*
+ * Releases every allocation in an arena.
+ */
+#define ARENA_RESET(ARENA) \
+  ((ARENA)->used = 0,      \
+                           \
+   ARENA_VOID)
+
+/*
+ * Records the current end of an arena, to be released back to later.
+ *
+ * Usage:
+ *
+ *   size_t mark = ARENA_MARK(arena);
+ *   ...
+ *   ARENA_RELEASE(arena, mark);
+ */
+#define ARENA_MARK(ARENA) ((ARENA)->used)
+
+/*
+ * Releases every allocation made since MARK was taken.
+ */
+#define ARENA_RELEASE(ARENA, MARK)        \
+  (ARENA_ASSERT((MARK) <= (ARENA)->used), \
+                                          \
+   (ARENA)->used = (MARK),                \
+                                          \
+   ARENA_VOID)
+
+/*
+ * Allocates SIZE bytes aligned to ALIGN, which must be a power of two.
+ * Returns NULL if the arena doesn't have room.
+ */
+static inline void* arena_alloc(arena* a, size_t size, size_t align) {
+  ARENA_ASSERT(a != NULL);
+  ARENA_ASSERT(align != 0 && (align & (align - 1)) == 0);
+
+  unsigned char* at = a->base + a->used;
+  size_t pad = (size_t)(-(uintptr_t)at & (align - 1));
+
+  if (pad > a->cap - a->used || size > a->cap - a->used - pad) {
+    return NULL;
+  }
+  a->used += pad + size;
+  return at + pad;
+}
+
+#endif
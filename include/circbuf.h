@@ -22,6 +22,37 @@
 #define CIRCBUF_ASSERT(...) CIRCBUF_VOID
 #endif
 
+/*
+ * USDT probes, for bpftrace, perf or SystemTap to attach to in a running
+ * process.  Define CONVOY_USDT to compile them in where sys/sdt.h is
+ * available; otherwise they compile to nothing.  An unattached probe is a
+ * single nop.  See tools/usdt/circbuf.bt.
+ *
+ *   convoy:circbuf_full(cbuf, limit)   a push found the buffer full
+ *   convoy:circbuf_empty(cbuf, limit)  a pop found the buffer empty
+ */
+#if defined(CONVOY_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+
+static inline void circbuf_probe_full_(const void* cbuf, size_t limit) {
+  DTRACE_PROBE2(convoy, circbuf_full, cbuf, limit);
+}
+
+static inline void circbuf_probe_empty_(const void* cbuf, size_t limit) {
+  DTRACE_PROBE2(convoy, circbuf_empty, cbuf, limit);
+}
+
+#define CIRCBUF_PROBE_FULL(CBUF) circbuf_probe_full_((CBUF), (CBUF)->limit)
+#define CIRCBUF_PROBE_EMPTY(CBUF) circbuf_probe_empty_((CBUF), (CBUF)->limit)
+#endif
+#endif
+
+#ifndef CIRCBUF_PROBE_FULL
+#define CIRCBUF_PROBE_FULL(CBUF) CIRCBUF_VOID
+#define CIRCBUF_PROBE_EMPTY(CBUF) CIRCBUF_VOID
+#endif
+
 /*
  * Declares a new circular buffer type.
  *
@@ -83,7 +114,7 @@
  */
 #define CIRCBUF_POP_FRONT(DEST, CBUF)                               \
   ((CIRCBUF_ISEMPTY(CBUF))                                          \
-     ? (false)                                                      \
+     ? (CIRCBUF_PROBE_EMPTY(CBUF), false)                           \
      : (/* Move the first element into the destination. */          \
         *(DEST) = (CBUF)->elems[(CBUF)->front],                     \
                                                                     \
@@ -100,7 +131,7 @@
  */
 #define CIRCBUF_POP_BACK(DEST, CBUF)                                       \
   ((CIRCBUF_ISEMPTY(CBUF))                                                 \
-     ? (false)                                                             \
+     ? (CIRCBUF_PROBE_EMPTY(CBUF), false)                                  \
      : (/* Move the last element into the destination. */                  \
         *(DEST) = (CBUF)->elems[ROTATE_LEFT((CBUF)->back, (CBUF)->limit)], \
                                                                            \
@@ -116,7 +147,7 @@
  */
 #define CIRCBUF_PUSH_FRONT(CBUF, ELEM)                                        \
   ((CIRCBUF_ISFULL(CBUF))                                                     \
-     ? (false)                                                                \
+     ? (CIRCBUF_PROBE_FULL(CBUF), false)                                      \
      : (/* Move the new element to the front of the circbuf. */               \
         (CBUF)->elems[ROTATE_LEFT((CBUF)->front, (CBUF)->limit)] = (ELEM),    \
                                                                               \
@@ -132,7 +163,7 @@
  */
 #define CIRCBUF_PUSH_BACK(CBUF, ELEM)                                    \
   ((CIRCBUF_ISFULL(CBUF))                                                \
-     ? (false)                                                           \
+     ? (CIRCBUF_PROBE_FULL(CBUF), false)                                 \
      : (/* Move the new element to the rear of the circbuf. */           \
         (CBUF)->elems[(CBUF)->back] = (ELEM),                            \
                                                                          \
@@ -159,6 +190,13 @@
    /* A circbuf is full when inserting another element would make it empty. */ \
    (CBUF)->front == ROTATE_RIGHT((CBUF)->back, (CBUF)->limit))
 
+/*
+ * Gets the number of bytes taken up by a circular buffer.  Every slot is
+ * stored in-place whether or not it holds an element, so this is fixed by
+ * the buffer's type and is a compile-time constant.
+ */
+#define CIRCBUF_FOOTPRINT(CBUF) sizeof(*(CBUF))
+
 /*
  * Iterates through all elements of a circular buffer.
  *
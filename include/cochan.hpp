@@ -0,0 +1,489 @@
+/*
+ * Implementation of a bounded channel for C++20 coroutines.
+ *
+ * co_await chan.pop() suspends while the channel is empty and co_await
+ * chan.push(x) suspends while it is full; the matching operation on the other
+ * end hands over the element and puts the waiter back on its executor's run
+ * queue.  Everything runs on one thread.
+ *
+ * Elements live in N raw slots like an spsc_channel, so the channel holds
+ * N - 1 of them.  Suspended coroutines wait on intrusive_dlists whose links
+ * are embedded in the awaiters, which live in the coroutine frames, so
+ * neither waiting nor waking allocates.
+ *
+ * Usage:
+ *
+ *   convoy::task consume(convoy::channel<int, 8>& chan) {
+ *     for (;;) {
+ *       int x = co_await chan.pop();
+ *       ...
+ *     }
+ *   }
+ *
+ *   convoy::executor exec;
+ *   exec.spawn(consume(chan));
+ *   exec.run();
+ */
+
+#ifndef __CONVOY_COCHAN_HPP__
+#define __CONVOY_COCHAN_HPP__
+
+#include "convoy.hpp"
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace convoy {
+
+class executor;
+class waiter_list;
+
+/*
+ * A suspended coroutine, parked either on a channel or on its executor's run
+ * queue.  LIST names whichever list it is on, so it can be unlinked when its
+ * frame is destroyed.
+ */
+struct waiter {
+  struct link_type {
+    waiter* prev = nullptr;
+    waiter* next = nullptr;
+  };
+
+  waiter() noexcept = default;
+  waiter(const waiter&) = delete;
+  waiter& operator=(const waiter&) = delete;
+
+  ~waiter() { detach(); }
+
+  void park(waiter_list& to) noexcept;
+  void detach() noexcept;
+
+  /*
+   * Pops the first waiter off a list, or returns nullptr if it is empty.
+   */
+  static waiter* take(waiter_list& from) noexcept;
+
+  link_type link;
+  waiter_list* list = nullptr;
+  std::coroutine_handle<> handle;
+  executor* exec = nullptr;
+};
+
+class waiter_list : public intrusive_dlist<waiter, &waiter::link> {};
+
+inline void waiter::park(waiter_list& to) noexcept {
+  CONVOY_ASSERT(list == nullptr);
+  list = &to;
+  to.push_back(*this);
+}
+
+inline void waiter::detach() noexcept {
+  if (list != nullptr) {
+    list->remove(*this);
+    list = nullptr;
+  }
+}
+
+inline waiter* waiter::take(waiter_list& from) noexcept {
+  waiter* w = from.pop_front();
+  if (w != nullptr) {
+    w->list = nullptr;
+  }
+  return w;
+}
+
+/*
+ * A fire-and-forget coroutine run by an executor.  The task starts suspended,
+ * and its frame goes away when it finishes or when its executor does.
+ */
+class task {
+ public:
+  struct promise_type {
+    struct link_type {
+      promise_type* prev = nullptr;
+      promise_type* next = nullptr;
+    };
+
+    promise_type() noexcept = default;
+    ~promise_type();
+
+    task get_return_object() noexcept {
+      return task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+
+    link_type live;
+    waiter start;
+    executor* exec = nullptr;
+  };
+
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  task(task&& other) noexcept
+    : handle_(std::exchange(other.handle_, nullptr)) {}
+
+  task& operator=(task&& other) noexcept {
+    std::swap(handle_, other.handle_);
+    return *this;
+  }
+
+  ~task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+ private:
+  friend class executor;
+
+  explicit task(handle_type handle) noexcept : handle_(handle) {}
+
+  handle_type handle_;
+};
+
+/*
+ * A single-threaded run queue.  Destroying the executor destroys the frames
+ * of any tasks that haven't finished, so it has to go before anything those
+ * frames still refer to.
+ */
+class executor {
+ public:
+  executor() noexcept = default;
+  executor(const executor&) = delete;
+  executor& operator=(const executor&) = delete;
+
+  ~executor() {
+    while (!live_.empty()) {
+      task::handle_type::from_promise(live_.front()).destroy();
+    }
+  }
+
+  /*
+   * Takes ownership of a task and queues it to start on the next run().
+   */
+  void spawn(task t) noexcept {
+    task::handle_type handle = std::exchange(t.handle_, nullptr);
+    task::promise_type& promise = handle.promise();
+
+    promise.exec = this;
+    live_.push_back(promise);
+    promise.start.handle = handle;
+    promise.start.exec = this;
+    schedule(promise.start);
+  }
+
+  void schedule(waiter& w) noexcept {
+    CONVOY_ASSERT(w.exec == this);
+    w.park(ready_);
+  }
+
+  /*
+   * Resumes queued coroutines until none are left, returning how many were
+   * resumed.
+   */
+  std::size_t run() {
+    std::size_t count = 0;
+    for (waiter* w; (w = waiter::take(ready_)) != nullptr; ++count) {
+      w->handle.resume();
+    }
+    return count;
+  }
+
+  /*
+   * Counts the spawned tasks that haven't finished yet.
+   */
+  std::size_t live() const noexcept {
+    return static_cast<std::size_t>(std::distance(live_.begin(), live_.end()));
+  }
+
+ private:
+  friend struct task::promise_type;
+
+  waiter_list ready_;
+  intrusive_dlist<task::promise_type, &task::promise_type::live> live_;
+};
+
+inline task::promise_type::~promise_type() {
+  if (exec != nullptr) {
+    exec->live_.remove(*this);
+  }
+}
+
+/*
+ * A coroutine waiting to receive into VALUE.  A select parks one of these on
+ * every channel it waits on, all sharing a group.
+ */
+template <class T>
+struct channel_receiver : waiter {
+  struct group_type {
+    channel_receiver* nodes;
+    std::size_t count;
+    std::size_t winner;
+  };
+
+  std::optional<T>* value = nullptr;
+  group_type* group = nullptr;
+};
+
+/*
+ * A coroutine waiting to send VALUE.
+ */
+template <class T>
+struct channel_sender : waiter {
+  T* value = nullptr;
+};
+
+template <class T, std::size_t... Ns>
+class select_awaiter;
+
+/*
+ * A bounded channel of N - 1 elements.  Awaiting push() or pop() is only
+ * supported from a task, since waking needs the task's executor.
+ */
+template <class T, std::size_t N>
+class channel {
+  static_assert(N > 1, "the limit is exclusive, so it must be at least 2");
+
+  using receiver = channel_receiver<T>;
+  using sender = channel_sender<T>;
+
+ public:
+  class push_awaiter {
+   public:
+    push_awaiter(channel& chan, T&& value) noexcept(
+      std::is_nothrow_move_constructible_v<T>)
+      : chan_(chan), value_(std::move(value)) {}
+
+    push_awaiter(const push_awaiter&) = delete;
+    push_awaiter& operator=(const push_awaiter&) = delete;
+
+    bool await_ready() { return chan_.try_push(std::move(value_)); }
+
+    void await_suspend(task::handle_type handle) noexcept {
+      node_.handle = handle;
+      node_.exec = handle.promise().exec;
+      node_.value = &value_;
+      node_.park(chan_.senders_);
+    }
+
+    void await_resume() const noexcept {}
+
+   private:
+    channel& chan_;
+    T value_;
+    sender node_;
+  };
+
+  class pop_awaiter {
+   public:
+    explicit pop_awaiter(channel& chan) noexcept : chan_(chan) {}
+
+    pop_awaiter(const pop_awaiter&) = delete;
+    pop_awaiter& operator=(const pop_awaiter&) = delete;
+
+    bool await_ready() { return chan_.try_pop(value_); }
+
+    void await_suspend(task::handle_type handle) noexcept {
+      node_.handle = handle;
+      node_.exec = handle.promise().exec;
+      node_.value = &value_;
+      node_.park(chan_.receivers_);
+    }
+
+    T await_resume() { return std::move(*value_); }
+
+   private:
+    channel& chan_;
+    std::optional<T> value_;
+    receiver node_;
+  };
+
+  channel() noexcept = default;
+  channel(const channel&) = delete;
+  channel& operator=(const channel&) = delete;
+
+  /*
+   * Destroys the buffered elements.  Coroutines still waiting are unlinked
+   * but not resumed, so they stay suspended until their executor goes away.
+   */
+  ~channel() {
+    for (; front_ != back_; front_ = rotate_right(front_)) {
+      slot(front_)->~T();
+    }
+    while (waiter::take(receivers_) != nullptr) {
+    }
+    while (waiter::take(senders_) != nullptr) {
+    }
+  }
+
+  static constexpr std::size_t capacity() noexcept { return N - 1; }
+
+  bool empty() const noexcept { return front_ == back_; }
+  bool full() const noexcept { return front_ == rotate_right(back_); }
+
+  std::size_t size() const noexcept { return (N + back_ - front_) % N; }
+
+  /*
+   * Hands an element to a waiting receiver or buffers it, returning false,
+   * without touching ELEM, if the channel is full.
+   */
+  bool try_push(T&& elem) {
+    if (waiter* w = waiter::take(receivers_)) {
+      deliver(static_cast<receiver&>(*w), std::move(elem));
+      return true;
+    }
+    if (full()) {
+      return false;
+    }
+    ::new (static_cast<void*>(slots_[back_].bytes)) T(std::move(elem));
+    back_ = rotate_right(back_);
+    return true;
+  }
+
+  /*
+   * Moves the front element into DEST, returning false if the channel is
+   * empty.  Frees up a slot for the first waiting sender, if any.
+   */
+  bool try_pop(std::optional<T>& dest) {
+    if (empty()) {
+      return false;
+    }
+    T* elem = slot(front_);
+    dest.emplace(std::move(*elem));
+    elem->~T();
+    front_ = rotate_right(front_);
+
+    if (waiter* w = waiter::take(senders_)) {
+      sender& s = static_cast<sender&>(*w);
+      ::new (static_cast<void*>(slots_[back_].bytes)) T(std::move(*s.value));
+      back_ = rotate_right(back_);
+      s.exec->schedule(s);
+    }
+    return true;
+  }
+
+  push_awaiter push(T elem) noexcept(std::is_nothrow_move_constructible_v<T>) {
+    return push_awaiter(*this, std::move(elem));
+  }
+
+  pop_awaiter pop() noexcept { return pop_awaiter(*this); }
+
+ private:
+  template <class U, std::size_t... Ns>
+  friend class select_awaiter;
+
+  /*
+   * Receivers only wait while the channel is empty, so an element pushed
+   * while one waits skips the buffer.
+   */
+  static void deliver(receiver& r, T&& elem) {
+    r.value->emplace(std::move(elem));
+    if (r.group != nullptr) {
+      typename receiver::group_type& group = *r.group;
+      group.winner = static_cast<std::size_t>(&r - group.nodes);
+      for (std::size_t i = 0; i < group.count; ++i) {
+        group.nodes[i].detach();
+      }
+    }
+    r.exec->schedule(r);
+  }
+
+  static constexpr std::size_t rotate_right(std::size_t i) noexcept {
+    return (i + 1) % N;
+  }
+
+  T* slot(std::size_t i) noexcept {
+    return std::launder(reinterpret_cast<T*>(slots_[i].bytes));
+  }
+
+  struct storage {
+    alignas(T) unsigned char bytes[sizeof(T)];
+  };
+
+  storage slots_[N];
+  std::size_t front_ = 0;
+  std::size_t back_ = 0;
+  waiter_list receivers_;
+  waiter_list senders_;
+};
+
+/*
+ * Waits on several channels of the same element type at once and resumes
+ * with the index of the first one to produce an element, and the element.
+ * Ties between channels that are already ready go to the earliest argument.
+ */
+template <class T, std::size_t... Ns>
+class select_awaiter {
+  static constexpr std::size_t count = sizeof...(Ns);
+  static_assert(count > 0, "there must be a channel to select on");
+
+  using receiver = channel_receiver<T>;
+
+ public:
+  explicit select_awaiter(channel<T, Ns>&... chans) noexcept
+    : chans_(chans...) {}
+
+  select_awaiter(const select_awaiter&) = delete;
+  select_awaiter& operator=(const select_awaiter&) = delete;
+
+  bool await_ready() {
+    return std::apply(
+      [this](auto&... chans) {
+        std::size_t i = 0;
+        return ((chans.try_pop(value_) ? (group_.winner = i, true)
+                                       : (++i, false)) ||
+                ...);
+      },
+      chans_);
+  }
+
+  void await_suspend(task::handle_type handle) noexcept {
+    std::size_t i = 0;
+    for (receiver& node : nodes_) {
+      node.handle = handle;
+      node.exec = handle.promise().exec;
+      node.value = &value_;
+      node.group = &group_;
+    }
+    std::apply([&](auto&... chans) { (nodes_[i++].park(list(chans)), ...); },
+               chans_);
+  }
+
+  std::pair<std::size_t, T> await_resume() {
+    return { group_.winner, std::move(*value_) };
+  }
+
+ private:
+  template <std::size_t M>
+  static waiter_list& list(channel<T, M>& chan) noexcept {
+    return chan.receivers_;
+  }
+
+  std::tuple<channel<T, Ns>&...> chans_;
+  std::optional<T> value_;
+  receiver nodes_[count];
+  typename receiver::group_type group_{ nodes_, count, count };
+};
+
+/*
+ * Usage: auto [index, elem] = co_await convoy::select(a, b, c);
+ */
+template <class T, std::size_t... Ns>
+select_awaiter<T, Ns...> select(channel<T, Ns>&... chans) noexcept {
+  return select_awaiter<T, Ns...>(chans...);
+}
+
+}  // namespace convoy
+
+#endif
@@ -0,0 +1,882 @@
+/*
+ * C++ wrappers for the convoy containers.
+ *
+ * These are header-only templates that work on the same intrusive links as
+ * the C macros, so an element declared with DLIST_DECLARE_LINK(),
+ * SLIST_DECLARE_LINK() or SPLAT_LINK() can be put in a container from either
+ * language.  Links are named by pointer-to-member, comparators are stateless
+ * function objects, and nothing allocates.
+ *
+ * Usage:
+ *
+ *   struct point {
+ *     DLIST_DECLARE_LINK(point, link);
+ *     int x;
+ *   };
+ *
+ *   convoy::intrusive_dlist<point, &point::link> points;
+ *   points.push_back(p);
+ *   for (point& q : points) { ... }
+ */
+
+#ifndef __CONVOY_HPP__
+#define __CONVOY_HPP__
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#ifdef CONVOY_ASSERTS
+#include <cassert>
+#define CONVOY_ASSERT(...) assert(__VA_ARGS__)
+#else
+#define CONVOY_ASSERT(...) ((void)0)
+#endif
+
+namespace convoy {
+
+/*
+ * A circular, doubly linked intrusive list, with the same layout and
+ * invariants as a list from DLIST_DECLARE().  It keeps no count, so it
+ * matches the C layout only when DLIST_COUNTED is not defined.
+ */
+template <class T, auto Link>
+class intrusive_dlist {
+ public:
+  class iterator {
+   public:
+    using iterator_concept = std::bidirectional_iterator_tag;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T*;
+    using reference = T&;
+
+    iterator() noexcept = default;
+
+    T& operator*() const noexcept { return *curr_; }
+    T* operator->() const noexcept { return curr_; }
+
+    iterator& operator++() noexcept {
+      curr_ = (curr_->*Link).next;
+      if (curr_ == list_->front_) {
+        curr_ = nullptr;
+      }
+      return *this;
+    }
+
+    iterator operator++(int) noexcept {
+      iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    iterator& operator--() noexcept {
+      curr_ = (curr_ == nullptr) ? list_->back_ : (curr_->*Link).prev;
+      return *this;
+    }
+
+    iterator operator--(int) noexcept {
+      iterator old = *this;
+      --*this;
+      return old;
+    }
+
+    friend bool operator==(const iterator& a, const iterator& b) noexcept {
+      return a.curr_ == b.curr_;
+    }
+
+   private:
+    friend class intrusive_dlist;
+
+    iterator(const intrusive_dlist* list, T* curr) noexcept
+      : list_(list), curr_(curr) {}
+
+    const intrusive_dlist* list_ = nullptr;
+    T* curr_ = nullptr;
+  };
+
+  intrusive_dlist() noexcept = default;
+  intrusive_dlist(const intrusive_dlist&) = delete;
+  intrusive_dlist& operator=(const intrusive_dlist&) = delete;
+
+  intrusive_dlist(intrusive_dlist&& other) noexcept
+    : front_(std::exchange(other.front_, nullptr)),
+      back_(std::exchange(other.back_, nullptr)) {}
+
+  intrusive_dlist& operator=(intrusive_dlist&& other) noexcept {
+    std::swap(front_, other.front_);
+    std::swap(back_, other.back_);
+    return *this;
+  }
+
+  bool empty() const noexcept { return front_ == nullptr; }
+
+  T& front() const noexcept {
+    CONVOY_ASSERT(!empty());
+    return *front_;
+  }
+
+  T& back() const noexcept {
+    CONVOY_ASSERT(!empty());
+    return *back_;
+  }
+
+  /*
+   * Checks if an element is inserted into a list, in constant time.
+   */
+  static bool is_linked(const T& elem) noexcept {
+    return (elem.*Link).next != nullptr;
+  }
+
+  void push_front(T& elem) noexcept {
+    link_back(elem);
+    front_ = &elem;
+  }
+
+  void push_back(T& elem) noexcept {
+    link_back(elem);
+    back_ = &elem;
+  }
+
+  /*
+   * Inserts ELEM after an element INS already in the list.
+   */
+  void insert_next(T& ins, T& elem) noexcept {
+    CONVOY_ASSERT(is_linked(ins));
+    CONVOY_ASSERT(!is_linked(elem));
+
+    (elem.*Link).prev = &ins;
+    (elem.*Link).next = (ins.*Link).next;
+    if (&ins == back_) {
+      back_ = &elem;
+    }
+    ((ins.*Link).next->*Link).prev = &elem;
+    (ins.*Link).next = &elem;
+  }
+
+  /*
+   * Pops the first element, or returns nullptr if the list is empty.
+   */
+  T* pop_front() noexcept {
+    T* elem = front_;
+    if (elem != nullptr) {
+      remove(*elem);
+    }
+    return elem;
+  }
+
+  /*
+   * Pops the last element, or returns nullptr if the list is empty.
+   */
+  T* pop_back() noexcept {
+    T* elem = back_;
+    if (elem != nullptr) {
+      remove(*elem);
+    }
+    return elem;
+  }
+
+  void remove(T& elem) noexcept {
+    CONVOY_ASSERT(is_linked(elem));
+
+    if (front_ == back_) {
+      front_ = nullptr;
+      back_ = nullptr;
+    } else {
+      ((elem.*Link).prev->*Link).next = (elem.*Link).next;
+      ((elem.*Link).next->*Link).prev = (elem.*Link).prev;
+      if (front_ == &elem) {
+        front_ = (elem.*Link).next;
+      }
+      if (back_ == &elem) {
+        back_ = (elem.*Link).prev;
+      }
+    }
+    (elem.*Link).next = nullptr;
+    (elem.*Link).prev = nullptr;
+  }
+
+  iterator begin() const noexcept { return iterator(this, front_); }
+  iterator end() const noexcept { return iterator(this, nullptr); }
+
+ private:
+  /*
+   * Links an element in between the back and the front, which makes it
+   * either of them depending on which end the caller moves.
+   */
+  void link_back(T& elem) noexcept {
+    CONVOY_ASSERT(!is_linked(elem));
+
+    if (front_ == nullptr) {
+      (elem.*Link).next = &elem;
+      (elem.*Link).prev = &elem;
+      front_ = &elem;
+      back_ = &elem;
+      return;
+    }
+    (elem.*Link).next = front_;
+    (elem.*Link).prev = back_;
+    (front_->*Link).prev = &elem;
+    (back_->*Link).next = &elem;
+  }
+
+  T* front_ = nullptr;
+  T* back_ = nullptr;
+};
+
+/*
+ * A circular, singly linked intrusive list, with the same layout and
+ * invariants as a list from SLIST_DECLARE().  It keeps no count, so it
+ * matches the C layout only when SLIST_COUNTED is not defined.
+ */
+template <class T, auto Link>
+class intrusive_slist {
+ public:
+  class iterator {
+   public:
+    using iterator_concept = std::forward_iterator_tag;
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T*;
+    using reference = T&;
+
+    iterator() noexcept = default;
+
+    T& operator*() const noexcept { return *curr_; }
+    T* operator->() const noexcept { return curr_; }
+
+    iterator& operator++() noexcept {
+      curr_ = curr_->*Link;
+      if (curr_ == list_->front_) {
+        curr_ = nullptr;
+      }
+      return *this;
+    }
+
+    iterator operator++(int) noexcept {
+      iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    friend bool operator==(const iterator& a, const iterator& b) noexcept {
+      return a.curr_ == b.curr_;
+    }
+
+   private:
+    friend class intrusive_slist;
+
+    iterator(const intrusive_slist* list, T* curr) noexcept
+      : list_(list), curr_(curr) {}
+
+    const intrusive_slist* list_ = nullptr;
+    T* curr_ = nullptr;
+  };
+
+  intrusive_slist() noexcept = default;
+  intrusive_slist(const intrusive_slist&) = delete;
+  intrusive_slist& operator=(const intrusive_slist&) = delete;
+
+  intrusive_slist(intrusive_slist&& other) noexcept
+    : front_(std::exchange(other.front_, nullptr)),
+      back_(std::exchange(other.back_, nullptr)) {}
+
+  intrusive_slist& operator=(intrusive_slist&& other) noexcept {
+    std::swap(front_, other.front_);
+    std::swap(back_, other.back_);
+    return *this;
+  }
+
+  bool empty() const noexcept { return front_ == nullptr; }
+
+  T& front() const noexcept {
+    CONVOY_ASSERT(!empty());
+    return *front_;
+  }
+
+  T& back() const noexcept {
+    CONVOY_ASSERT(!empty());
+    return *back_;
+  }
+
+  static bool is_linked(const T& elem) noexcept {
+    return elem.*Link != nullptr;
+  }
+
+  void push_front(T& elem) noexcept {
+    CONVOY_ASSERT(!is_linked(elem));
+
+    if (front_ == nullptr) {
+      back_ = &elem;
+    } else {
+      elem.*Link = front_;
+    }
+    front_ = &elem;
+    back_->*Link = front_;
+  }
+
+  void push_back(T& elem) noexcept {
+    CONVOY_ASSERT(!is_linked(elem));
+
+    if (front_ == nullptr) {
+      front_ = &elem;
+    } else {
+      back_->*Link = &elem;
+    }
+    back_ = &elem;
+    back_->*Link = front_;
+  }
+
+  /*
+   * Pops the first element, or returns nullptr if the list is empty.
+   */
+  T* pop_front() noexcept {
+    T* elem = front_;
+    if (elem == nullptr) {
+      return nullptr;
+    }
+    if (front_ == back_) {
+      front_ = nullptr;
+      back_ = nullptr;
+    } else {
+      front_ = elem->*Link;
+      back_->*Link = front_;
+    }
+    elem->*Link = nullptr;
+    return elem;
+  }
+
+  iterator begin() const noexcept { return iterator(this, front_); }
+  iterator end() const noexcept { return iterator(this, nullptr); }
+
+ private:
+  T* front_ = nullptr;
+  T* back_ = nullptr;
+};
+
+/*
+ * A fixed-size circular buffer of N - 1 elements stored in place, like a
+ * buffer from CIRCBUF_DECLARE() with a compile-time limit.
+ *
+ * Every slot holds a live T, so T must be default constructible and
+ * assignable.  Pushes, pops and moves assign over a slot's old contents
+ * rather than destroying them, and popped elements are left moved-from.
+ */
+template <class T, std::size_t N>
+class circbuf {
+  static_assert(N > 0, "the limit is exclusive, so it can't be zero");
+
+ public:
+  template <class Elem>
+  class basic_iterator {
+   public:
+    using iterator_concept = std::bidirectional_iterator_tag;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = std::remove_const_t<Elem>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Elem*;
+    using reference = Elem&;
+
+    basic_iterator() noexcept = default;
+
+    Elem& operator*() const noexcept { return elems_[index_]; }
+    Elem* operator->() const noexcept { return &elems_[index_]; }
+
+    basic_iterator& operator++() noexcept {
+      index_ = rotate_right(index_);
+      return *this;
+    }
+
+    basic_iterator operator++(int) noexcept {
+      basic_iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    basic_iterator& operator--() noexcept {
+      index_ = rotate_left(index_);
+      return *this;
+    }
+
+    basic_iterator operator--(int) noexcept {
+      basic_iterator old = *this;
+      --*this;
+      return old;
+    }
+
+    friend bool operator==(const basic_iterator& a,
+                           const basic_iterator& b) noexcept {
+      return a.index_ == b.index_;
+    }
+
+   private:
+    friend class circbuf;
+
+    basic_iterator(Elem* elems, std::size_t index) noexcept
+      : elems_(elems), index_(index) {}
+
+    Elem* elems_ = nullptr;
+    std::size_t index_ = 0;
+  };
+
+  using iterator = basic_iterator<T>;
+  using const_iterator = basic_iterator<const T>;
+
+  circbuf() = default;
+
+  circbuf(circbuf&& other) noexcept(std::is_nothrow_move_assignable_v<T>)
+    : front_(other.front_), back_(other.back_) {
+    for (std::size_t i = front_; i != back_; i = rotate_right(i)) {
+      elems_[i] = std::move(other.elems_[i]);
+    }
+    other.front_ = other.back_ = 0;
+  }
+
+  circbuf& operator=(circbuf&& other) noexcept(
+    std::is_nothrow_move_assignable_v<T>) {
+    if (this != &other) {
+      front_ = other.front_;
+      back_ = other.back_;
+      for (std::size_t i = front_; i != back_; i = rotate_right(i)) {
+        elems_[i] = std::move(other.elems_[i]);
+      }
+      other.front_ = other.back_ = 0;
+    }
+    return *this;
+  }
+
+  static constexpr std::size_t capacity() noexcept { return N - 1; }
+
+  bool empty() const noexcept { return front_ == back_; }
+  bool full() const noexcept { return front_ == rotate_right(back_); }
+
+  std::size_t size() const noexcept { return (N + back_ - front_) % N; }
+
+  T& front() noexcept {
+    CONVOY_ASSERT(!empty());
+    return elems_[front_];
+  }
+
+  T& back() noexcept {
+    CONVOY_ASSERT(!empty());
+    return elems_[rotate_left(back_)];
+  }
+
+  /*
+   * Inserts an element at the back, returning false if the buffer is full.
+   */
+  template <class U>
+  bool push_back(U&& elem) noexcept(std::is_nothrow_assignable_v<T&, U>) {
+    if (full()) {
+      return false;
+    }
+    elems_[back_] = std::forward<U>(elem);
+    back_ = rotate_right(back_);
+    return true;
+  }
+
+  /*
+   * Inserts an element at the front, returning false if the buffer is full.
+   */
+  template <class U>
+  bool push_front(U&& elem) noexcept(std::is_nothrow_assignable_v<T&, U>) {
+    if (full()) {
+      return false;
+    }
+    elems_[rotate_left(front_)] = std::forward<U>(elem);
+    front_ = rotate_left(front_);
+    return true;
+  }
+
+  /*
+   * Moves the first element into DEST, returning false if the buffer is
+   * empty.
+   */
+  bool pop_front(T& dest) noexcept(std::is_nothrow_move_assignable_v<T>) {
+    if (empty()) {
+      return false;
+    }
+    dest = std::move(elems_[front_]);
+    front_ = rotate_right(front_);
+    return true;
+  }
+
+  /*
+   * Moves the last element into DEST, returning false if the buffer is
+   * empty.
+   */
+  bool pop_back(T& dest) noexcept(std::is_nothrow_move_assignable_v<T>) {
+    if (empty()) {
+      return false;
+    }
+    back_ = rotate_left(back_);
+    dest = std::move(elems_[back_]);
+    return true;
+  }
+
+  iterator begin() noexcept { return iterator(elems_, front_); }
+  iterator end() noexcept { return iterator(elems_, back_); }
+  const_iterator begin() const noexcept {
+    return const_iterator(elems_, front_);
+  }
+  const_iterator end() const noexcept { return const_iterator(elems_, back_); }
+
+ private:
+  static constexpr std::size_t rotate_left(std::size_t i) noexcept {
+    return (N + i - 1) % N;
+  }
+
+  static constexpr std::size_t rotate_right(std::size_t i) noexcept {
+    return (i + 1) % N;
+  }
+
+  T elems_[N];
+  std::size_t front_ = 0;
+  std::size_t back_ = 0;
+};
+
+/*
+ * A splay tree over elements with a SPLAT_LINK(), generating the same
+ * top-down splay as SPLAT_LIB().
+ *
+ * Iterating splays each element to the root in turn, which costs amortized
+ * O(1) per step by the sequential access theorem, but means that iteration
+ * changes the tree's shape like any other access.
+ */
+template <class T,
+          class Key,
+          Key T::*KeyField,
+          class Compare = std::less<Key>,
+          auto Link = &T::link>
+class splay_tree {
+  using link_type = std::remove_reference_t<decltype(std::declval<T&>().*Link)>;
+
+  static constexpr bool transparent =
+    requires { typename Compare::is_transparent; };
+
+ public:
+  class iterator {
+   public:
+    using iterator_concept = std::bidirectional_iterator_tag;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T*;
+    using reference = T&;
+
+    iterator() noexcept = default;
+
+    T& operator*() const noexcept { return *curr_; }
+    T* operator->() const noexcept { return curr_; }
+
+    iterator& operator++() {
+      curr_ = tree_->successor(curr_);
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    iterator& operator--() {
+      curr_ = (curr_ == nullptr) ? tree_->max() : tree_->predecessor(curr_);
+      return *this;
+    }
+
+    iterator operator--(int) {
+      iterator old = *this;
+      --*this;
+      return old;
+    }
+
+    friend bool operator==(const iterator& a, const iterator& b) noexcept {
+      return a.curr_ == b.curr_;
+    }
+
+   private:
+    friend class splay_tree;
+
+    iterator(splay_tree* tree, T* curr) noexcept : tree_(tree), curr_(curr) {}
+
+    splay_tree* tree_ = nullptr;
+    T* curr_ = nullptr;
+  };
+
+  splay_tree() = default;
+  splay_tree(const splay_tree&) = delete;
+  splay_tree& operator=(const splay_tree&) = delete;
+
+  splay_tree(splay_tree&& other) noexcept
+    : root_(std::exchange(other.root_, nullptr)) {}
+
+  splay_tree& operator=(splay_tree&& other) noexcept {
+    std::swap(root_, other.root_);
+    return *this;
+  }
+
+  bool empty() const noexcept { return root_ == nullptr; }
+
+  /*
+   * Inserts an element.  If an element with an equal key is already in the
+   * tree, the tree is unchanged and the existing element is returned with
+   * false.
+   */
+  std::pair<iterator, bool> insert(T& elem) {
+    CONVOY_ASSERT(link(&elem).prev == nullptr);
+    CONVOY_ASSERT(link(&elem).next == nullptr);
+
+    if (root_ == nullptr) {
+      root_ = &elem;
+      return { iterator(this, root_), true };
+    }
+
+    splay(elem.*KeyField);
+
+    int c = compare(elem.*KeyField, root_->*KeyField);
+    if (c == 0) {
+      return { iterator(this, root_), false };
+    }
+    if (c < 0) {
+      link(&elem).prev = link(root_).prev;
+      link(&elem).next = root_;
+      link(root_).prev = nullptr;
+    } else {
+      link(&elem).next = link(root_).next;
+      link(&elem).prev = root_;
+      link(root_).next = nullptr;
+    }
+    root_ = &elem;
+    return { iterator(this, root_), true };
+  }
+
+  /*
+   * Lookups also have overloads for any key type the comparator can compare
+   * against Key, when it is transparent like std::less<>.  A tree keyed by
+   * std::string can then be searched by std::string_view or const char*
+   * without building a temporary std::string.
+   */
+  iterator find(const Key& key) { return iterator(this, search(key)); }
+
+  template <class K>
+    requires transparent
+  iterator find(const K& key) {
+    return iterator(this, search(key));
+  }
+
+  bool contains(const Key& key) { return search(key) != nullptr; }
+
+  template <class K>
+    requires transparent
+  bool contains(const K& key) {
+    return search(key) != nullptr;
+  }
+
+  /*
+   * Finds the first element whose key is not less than KEY.
+   */
+  iterator lower_bound(const Key& key) { return lower_bound_of(key); }
+
+  template <class K>
+    requires transparent
+  iterator lower_bound(const K& key) {
+    return lower_bound_of(key);
+  }
+
+  /*
+   * Removes the element with key KEY, returning it, or nullptr if there is
+   * no such element.
+   */
+  T* erase(const Key& key) { return erase_of(key); }
+
+  template <class K>
+    requires transparent
+  T* erase(const K& key) {
+    return erase_of(key);
+  }
+
+  /*
+   * Removes every element, calling FN on each in key order, in O(n) time and
+   * O(1) space.  Links are reset before FN is called.
+   */
+  template <class Fn>
+  void clear(Fn&& fn) {
+    T* elem = root_;
+    root_ = nullptr;
+    while (elem != nullptr) {
+      if (link(elem).prev != nullptr) {
+        T* temp = link(elem).prev;
+        link(elem).prev = link(temp).next;
+        link(temp).next = elem;
+        elem = temp;
+        continue;
+      }
+      T* next = link(elem).next;
+      link(elem).next = nullptr;
+      fn(*elem);
+      elem = next;
+    }
+  }
+
+  void clear() {
+    clear([](T&) noexcept {});
+  }
+
+  iterator begin() { return iterator(this, min_of(root_)); }
+  iterator end() noexcept { return iterator(this, nullptr); }
+
+ private:
+  static link_type& link(T* elem) noexcept { return elem->*Link; }
+
+  template <class A, class B>
+  static int compare(const A& a, const B& b) {
+    Compare comp;
+    return comp(a, b) ? -1 : comp(b, a) ? 1 : 0;
+  }
+
+  template <class K>
+  T* search(const K& key) {
+    if (root_ == nullptr) {
+      return nullptr;
+    }
+    splay(key);
+    return compare(key, root_->*KeyField) == 0 ? root_ : nullptr;
+  }
+
+  template <class K>
+  iterator lower_bound_of(const K& key) {
+    if (root_ == nullptr) {
+      return end();
+    }
+    splay(key);
+    if (compare(root_->*KeyField, key) >= 0) {
+      return iterator(this, root_);
+    }
+    return iterator(this, min_of(link(root_).next));
+  }
+
+  template <class K>
+  T* erase_of(const K& key) {
+    T* removed = search(key);
+    if (removed == nullptr) {
+      return nullptr;
+    }
+    if (link(removed).prev == nullptr) {
+      root_ = link(removed).next;
+    } else {
+      T* next = link(removed).next;
+      root_ = link(removed).prev;
+      splay(key);
+      link(root_).next = next;
+    }
+    link(removed).prev = nullptr;
+    link(removed).next = nullptr;
+    return removed;
+  }
+
+  static T* min_of(T* elem) noexcept {
+    if (elem != nullptr) {
+      while (link(elem).prev != nullptr) {
+        elem = link(elem).prev;
+      }
+    }
+    return elem;
+  }
+
+  T* max() noexcept {
+    T* elem = root_;
+    if (elem != nullptr) {
+      while (link(elem).next != nullptr) {
+        elem = link(elem).next;
+      }
+    }
+    return elem;
+  }
+
+  T* successor(T* elem) {
+    splay(elem->*KeyField);
+    return min_of(link(root_).next);
+  }
+
+  T* predecessor(T* elem) {
+    splay(elem->*KeyField);
+    T* pred = link(root_).prev;
+    if (pred != nullptr) {
+      while (link(pred).next != nullptr) {
+        pred = link(pred).next;
+      }
+    }
+    return pred;
+  }
+
+  /*
+   * Top-down splay, as in SPLAT_LIB().  The side trees are assembled on a
+   * bare link rather than a whole element, so T needn't be constructible.
+   */
+  template <class K>
+  void splay(const K& key) {
+    link_type assembler{};
+    link_type* prev = &assembler;
+    link_type* next = &assembler;
+    T* elem = root_;
+
+    while (true) {
+      int c = compare(key, elem->*KeyField);
+      if (c < 0) {
+        if (link(elem).prev == nullptr) {
+          break;
+        }
+        if (compare(key, link(elem).prev->*KeyField) < 0) {
+          T* temp = link(elem).prev;
+          link(elem).prev = link(temp).next;
+          link(temp).next = elem;
+          elem = temp;
+          if (link(elem).prev == nullptr) {
+            break;
+          }
+        }
+        /* Link next. */
+        next->prev = elem;
+        next = &link(elem);
+        elem = link(elem).prev;
+      } else if (c > 0) {
+        if (link(elem).next == nullptr) {
+          break;
+        }
+        if (compare(key, link(elem).next->*KeyField) > 0) {
+          T* temp = link(elem).next;
+          link(elem).next = link(temp).prev;
+          link(temp).prev = elem;
+          elem = temp;
+          if (link(elem).next == nullptr) {
+            break;
+          }
+        }
+        /* Link prev. */
+        prev->next = elem;
+        prev = &link(elem);
+        elem = link(elem).next;
+      } else {
+        break;
+      }
+    }
+    /* Assemble. */
+    prev->next = link(elem).prev;
+    next->prev = link(elem).next;
+    link(elem).prev = assembler.next;
+    link(elem).next = assembler.prev;
+
+    root_ = elem;
+  }
+
+  T* root_ = nullptr;
+};
+
+}  // namespace convoy
+
+#endif
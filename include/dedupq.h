@@ -0,0 +1,262 @@
+/*
+ * Implementation of a deduplicating FIFO queue of keys.
+ *
+ * Keys wait in a circbuf, and an open-addressed hash set remembers which
+ * keys are pending.  Pushing a key that is already pending does nothing, and
+ * popping a key clears it, so a key is queued at most once however many
+ * times it is pushed before the consumer gets to it.
+ *
+ * The set's slots hold indices into the circbuf rather than copies of the
+ * keys, so it costs 4 bytes per slot.  It has twice as many slots as the
+ * circbuf, which keeps it at most half full, and uses linear probing with
+ * backward-shift deletion, so it never fills up with tombstones.
+ */
+
+#ifndef __CONVOY_DEDUPQ_H__
+#define __CONVOY_DEDUPQ_H__
+
+#include "circbuf.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Used to give macros a void return value.
+ */
+#define DEDUPQ_VOID ((void)0)
+
+#ifdef DEDUPQ_ASSERTS
+#include <assert.h>
+#define DEDUPQ_ASSERT(...) assert(__VA_ARGS__)
+#else
+#define DEDUPQ_ASSERT(...) DEDUPQ_VOID
+#endif
+
+/*
+ * The set slot value that marks a slot empty.  Other values are one past an
+ * index into the circbuf.
+ */
+#define DEDUPQ_EMPTY ((uint32_t)0)
+
+/*
+ * Declares a new deduplicating queue type.
+ *
+ * KEY_TYPE is the type of the keys, which are copied in and out like
+ * circbuf elements.  LIMIT is the length of the queue's circbuf (exclusive,
+ * so it holds LIMIT - 1 keys), and must be a power of two below 2^31.  Any
+ * other LIMIT would leave some slots out of reach of the probe mask, so it
+ * fails to compile, on an array of negative size.
+ */
+#define DEDUPQ_DECLARE(DQ_TYPE, KEY_TYPE, LIMIT)              \
+  typedef char DQ_TYPE##_limit_must_be_a_power_of_two_        \
+    [((LIMIT) > 0 && ((LIMIT) & ((LIMIT)-1)) == 0) ? 1 : -1]; \
+                                                              \
+  CIRCBUF_DECLARE(DQ_TYPE##_ring, KEY_TYPE, LIMIT);           \
+                                                              \
+  typedef struct DQ_TYPE {                                    \
+    DQ_TYPE##_ring ring;                                      \
+    uint32_t slots[2 * (LIMIT)];                              \
+  } DQ_TYPE
+
+/*
+ * Initializes a deduplicating queue.
+ */
+#define DEDUPQ_INIT(DQ)                          \
+  (CIRCBUF_INIT(&(DQ)->ring, DEDUPQ_LIMIT_(DQ)), \
+   memset((DQ)->slots, 0, sizeof((DQ)->slots)),  \
+                                                 \
+   DEDUPQ_VOID)
+
+/*
+ * Statically initializes a deduplicating queue.
+ */
+#define DEDUPQ_STATIC_INIT(LIMIT) \
+  { .ring = CIRCBUF_STATIC_INIT(LIMIT), .slots = { 0 } }
+
+/*
+ * Checks whether a deduplicating queue is empty.
+ */
+#define DEDUPQ_ISEMPTY(DQ) CIRCBUF_ISEMPTY(&(DQ)->ring)
+
+/*
+ * Checks whether a deduplicating queue is full.  A full queue still accepts
+ * keys that are already pending.
+ */
+#define DEDUPQ_ISFULL(DQ) CIRCBUF_ISFULL(&(DQ)->ring)
+
+/*
+ * Gets the number of keys pending in a deduplicating queue.
+ */
+#define DEDUPQ_COUNT(DQ)                                     \
+  (((DQ)->ring.back + (DQ)->ring.limit - (DQ)->ring.front) % \
+   (DQ)->ring.limit)
+
+/*
+ * Gets the length of a queue's circbuf, from its type.
+ */
+#define DEDUPQ_LIMIT_(DQ) \
+  (sizeof((DQ)->ring.elems) / sizeof((DQ)->ring.elems[0]))
+
+/*
+ * Mixes the bits of a 64-bit integer key, for use as HASH.  This is the
+ * finalizer from MurmurHash3.
+ */
+static inline uint64_t dedupq_hash_u64(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+/*
+ * Compares two scalar keys for equality, for use as EQ.
+ */
+#define DEDUPQ_EQ(A, B) ((A) == (B))
+
+/*
+ * Defines a new deduplicating queue library.
+ *
+ * @param DQ_TYPE the type of the queue
+ * @param KEY_TYPE the type of the keys
+ * @param HASH a hash function/macro that takes a key and returns an integer
+ * @param EQ an equality function/macro that takes two keys
+ */
+#define DEDUPQ_LIB(DQ_TYPE, KEY_TYPE, HASH, EQ)                               \
+                                                                              \
+  /*                                                                          \
+   * Finds the slot holding KEY, or the empty slot where it would go.         \
+   */                                                                         \
+  static size_t DQ_TYPE##_probe(const DQ_TYPE* dq, KEY_TYPE key) {            \
+    const size_t mask = sizeof(dq->slots) / sizeof(dq->slots[0]) - 1;         \
+    size_t i = (size_t)HASH(key) & mask;                                      \
+                                                                              \
+    while (dq->slots[i] != DEDUPQ_EMPTY &&                                    \
+           !EQ(dq->ring.elems[dq->slots[i] - 1], key)) {                      \
+      i = (i + 1) & mask;                                                     \
+    }                                                                         \
+    return i;                                                                 \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Empties slot I, then shifts back any later slots in its probe run that   \
+   * would no longer be found past the hole.                                  \
+   */                                                                         \
+  static void DQ_TYPE##_unlink(DQ_TYPE* dq, size_t i) {                       \
+    const size_t mask = sizeof(dq->slots) / sizeof(dq->slots[0]) - 1;         \
+    size_t j = i;                                                             \
+    size_t home;                                                              \
+                                                                              \
+    for (;;) {                                                                \
+      j = (j + 1) & mask;                                                     \
+      if (dq->slots[j] == DEDUPQ_EMPTY) {                                     \
+        break;                                                                \
+      }                                                                       \
+      home = (size_t)HASH(dq->ring.elems[dq->slots[j] - 1]) & mask;           \
+      /* Move it if its home is not cyclically within (i, j]. */              \
+      if (((j - home) & mask) >= ((j - i) & mask)) {                          \
+        dq->slots[i] = dq->slots[j];                                          \
+        i = j;                                                                \
+      }                                                                       \
+    }                                                                         \
+    dq->slots[i] = DEDUPQ_EMPTY;                                              \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Checks whether KEY is pending.                                           \
+   */                                                                         \
+  bool DQ_TYPE##_contains(const DQ_TYPE* dq, KEY_TYPE key) {                  \
+    DEDUPQ_ASSERT(dq != NULL);                                                \
+                                                                              \
+    return dq->slots[DQ_TYPE##_probe(dq, key)] != DEDUPQ_EMPTY;               \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Pushes KEY onto the back of the queue, unless it is already pending.     \
+   * Returns true if KEY is pending afterwards, which is false only when the  \
+   * queue was full and KEY was not already in it.                            \
+   */                                                                         \
+  bool DQ_TYPE##_push(DQ_TYPE* dq, KEY_TYPE key) {                            \
+    size_t i;                                                                 \
+                                                                              \
+    DEDUPQ_ASSERT(dq != NULL);                                                \
+                                                                              \
+    i = DQ_TYPE##_probe(dq, key);                                             \
+    if (dq->slots[i] != DEDUPQ_EMPTY) {                                       \
+      return true;                                                            \
+    }                                                                         \
+    if (DEDUPQ_ISFULL(dq)) {                                                  \
+      return false;                                                           \
+    }                                                                         \
+    dq->slots[i] = (uint32_t)dq->ring.back + 1;                               \
+    CIRCBUF_PUSH_BACK(&dq->ring, key);                                        \
+    return true;                                                              \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Pops the key at the front of the queue into *DEST, and clears it so that \
+   * it can be pushed again.  Returns false if the queue was empty.           \
+   */                                                                         \
+  bool DQ_TYPE##_pop(DQ_TYPE* dq, KEY_TYPE* dest) {                           \
+    const size_t mask = sizeof(dq->slots) / sizeof(dq->slots[0]) - 1;         \
+    const uint32_t front = (uint32_t)dq->ring.front + 1;                      \
+    size_t i;                                                                 \
+                                                                              \
+    DEDUPQ_ASSERT(dq != NULL);                                                \
+    DEDUPQ_ASSERT(dest != NULL);                                              \
+                                                                              \
+    if (DEDUPQ_ISEMPTY(dq)) {                                                 \
+      return false;                                                           \
+    }                                                                         \
+                                                                              \
+    /* Find the slot by index rather than by key, so EQ isn't called. */      \
+    i = (size_t)HASH(dq->ring.elems[dq->ring.front]) & mask;                  \
+    while (dq->slots[i] != front) {                                           \
+      DEDUPQ_ASSERT(dq->slots[i] != DEDUPQ_EMPTY);                            \
+      i = (i + 1) & mask;                                                     \
+    }                                                                         \
+    DQ_TYPE##_unlink(dq, i);                                                  \
+    CIRCBUF_POP_FRONT(dest, &dq->ring);                                       \
+    return true;                                                              \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Pushes the N keys in KEYS in order, skipping those already pending.      \
+   * Stops at the first key that doesn't fit.  Returns the number of keys     \
+   * consumed from KEYS, duplicates included.                                 \
+   */                                                                         \
+  size_t DQ_TYPE##_push_n(DQ_TYPE* dq, KEY_TYPE const* keys, size_t n) {      \
+    size_t done;                                                              \
+                                                                              \
+    DEDUPQ_ASSERT(dq != NULL);                                                \
+    DEDUPQ_ASSERT(keys != NULL || n == 0);                                    \
+                                                                              \
+    for (done = 0; done < n; ++done) {                                        \
+      if (!DQ_TYPE##_push(dq, keys[done])) {                                  \
+        break;                                                                \
+      }                                                                       \
+    }                                                                         \
+    return done;                                                              \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Pops up to N keys into DEST, in order.  Returns the number popped.       \
+   */                                                                         \
+  size_t DQ_TYPE##_pop_n(DQ_TYPE* dq, KEY_TYPE* dest, size_t n) {             \
+    size_t done;                                                              \
+                                                                              \
+    DEDUPQ_ASSERT(dq != NULL);                                                \
+    DEDUPQ_ASSERT(dest != NULL || n == 0);                                    \
+                                                                              \
+    for (done = 0; done < n; ++done) {                                        \
+      if (!DQ_TYPE##_pop(dq, &dest[done])) {                                  \
+        break;                                                                \
+      }                                                                       \
+    }                                                                         \
+    return done;                                                              \
+  }
+
+#endif
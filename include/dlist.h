@@ -13,12 +13,75 @@
 #define DLIST_ASSERT(...) DLIST_VOID
 #endif
 
+/*
+ * USDT probes, for bpftrace, perf or SystemTap to attach to in a running
+ * process.  Define CONVOY_USDT to compile them in where sys/sdt.h is
+ * available; otherwise they compile to nothing.  An unattached probe is a
+ * single nop.  See tools/usdt/lists.bt.
+ *
+ *   convoy:dlist_push(list, elem)  an element was pushed onto either end
+ *   convoy:dlist_pop(list, elem)   an element, or NULL, was popped off
+ */
+#if defined(CONVOY_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+
+static inline void dlist_probe_push_(const void* list, const void* elem) {
+  DTRACE_PROBE2(convoy, dlist_push, list, elem);
+}
+
+static inline void dlist_probe_pop_(const void* list, const void* elem) {
+  DTRACE_PROBE2(convoy, dlist_pop, list, elem);
+}
+
+#define DLIST_PROBE_PUSH(LIST, ELEM) dlist_probe_push_((LIST), (ELEM))
+#define DLIST_PROBE_POP(LIST, ELEM) dlist_probe_pop_((LIST), (ELEM))
+#endif
+#endif
+
+#ifndef DLIST_PROBE_PUSH
+#define DLIST_PROBE_PUSH(LIST, ELEM) DLIST_VOID
+#define DLIST_PROBE_POP(LIST, ELEM) DLIST_VOID
+#endif
+
 #include <stddef.h>
+#include <stdint.h>
+
+/*
+ * When DLIST_COUNTED is defined, every list also keeps a count of its
+ * elements, so DLIST_COUNT() and DLIST_FOOTPRINT() run in O(1) time.
+ */
+#ifdef DLIST_COUNTED
+#define DLIST_COUNT_FIELD size_t count;
+#define DLIST_COUNT_STATIC_INIT .count = 0,
+#define DLIST_COUNT_RESET(LIST) ((LIST)->count = 0)
+#define DLIST_COUNT_ADD(LIST, N) ((LIST)->count += (N))
+#define DLIST_COUNT_SUB(LIST, N) ((LIST)->count -= (N))
+
+/*
+ * Gets the number of elements in a list.
+ */
+#define DLIST_COUNT(LIST) ((LIST)->count)
+
+/*
+ * Gets the number of bytes taken up by a list and its elements, counting
+ * each element as sizeof(*(LIST)->front).
+ */
+#define DLIST_FOOTPRINT(LIST) \
+  (sizeof(*(LIST)) + (LIST)->count * sizeof(*(LIST)->front))
+#else
+#define DLIST_COUNT_FIELD
+#define DLIST_COUNT_STATIC_INIT
+#define DLIST_COUNT_RESET(LIST) DLIST_VOID
+#define DLIST_COUNT_ADD(LIST, N) DLIST_VOID
+#define DLIST_COUNT_SUB(LIST, N) DLIST_VOID
+#endif
 
 /*
  * Declares a new list type.
  *
- * ELEM_TYPE must be the name of a struct type with a declared link.
+ * ELEM_TYPE must be the name of a struct type with a declared link.  When
+ * DLIST_COUNTED is defined, the list also carries a size_t named count.
  *
  * Usage:
  *
@@ -29,6 +92,7 @@
   typedef struct LIST_TYPE {                \
     struct ELEM_TYPE* front;                \
     struct ELEM_TYPE* back;                 \
+    DLIST_COUNT_FIELD                       \
   } LIST_TYPE
 
 /*
@@ -53,17 +117,18 @@
 /*
  * Initializes a list.
  */
-#define DLIST_INIT(LIST) \
-  ((LIST)->front = NULL, \
-   (LIST)->back = NULL,  \
-                         \
+#define DLIST_INIT(LIST)    \
+  ((LIST)->front = NULL,    \
+   (LIST)->back = NULL,     \
+   DLIST_COUNT_RESET(LIST), \
+                            \
    DLIST_VOID)
 
 /*
  * Statically initializes a list.
  */
 #define DLIST_STATIC_INIT \
-  { .front = NULL, .back = NULL, }
+  { .front = NULL, .back = NULL, DLIST_COUNT_STATIC_INIT }
 
 /*
  * Initializes the list link of an element.
@@ -137,6 +202,9 @@
    /* Point the list's front at our new element. */              \
    (LIST)->front = (ELEM),                                       \
                                                                  \
+   DLIST_COUNT_ADD(LIST, 1),                                     \
+   DLIST_PROBE_PUSH(LIST, ELEM),                                 \
+                                                                 \
    DLIST_VOID)
 
 /*
@@ -159,6 +227,9 @@
    /* Point the list's back at our new element. */               \
    (LIST)->back = (ELEM),                                        \
                                                                  \
+   DLIST_COUNT_ADD(LIST, 1),                                     \
+   DLIST_PROBE_PUSH(LIST, ELEM),                                 \
+                                                                 \
    DLIST_VOID)
 
 /*
@@ -182,6 +253,7 @@
    /* Splice in the new element into the list. */                       \
    (INS)->LINK.next->LINK.prev = (NEW),                                 \
    (INS)->LINK.next = (NEW),                                            \
+   DLIST_COUNT_ADD(LIST, 1),                                            \
                                                                         \
    DLIST_VOID)
 
@@ -206,6 +278,7 @@
    /* splice in the new element into the list/ */                          \
    (INS)->LINK.prev->LINK.next = (NEW),                                    \
    (INS)->LINK.prev = (NEW),                                               \
+   DLIST_COUNT_ADD(LIST, 1),                                               \
                                                                            \
    DLIST_VOID)
 
@@ -229,6 +302,7 @@
                                   (LIST)->front = NULL,                       \
                                   (LIST)->back = NULL,                        \
                                                                               \
+                                  DLIST_COUNT_SUB(LIST, 1),                   \
                                   /* Clean up the old node's link. */         \
                                   DLIST_ELEM_INIT(DEST, LINK))                \
                                : ((DEST) = (LIST)->front,                     \
@@ -240,8 +314,11 @@
                                   /* Make the back point to the new front. */ \
                                   (LIST)->back->LINK.next = (LIST)->front,    \
                                                                               \
+                                  DLIST_COUNT_SUB(LIST, 1),                   \
                                   /* Clean up the old node's link. */         \
-                                  DLIST_ELEM_INIT(DEST, LINK)))
+                                  DLIST_ELEM_INIT(DEST, LINK)),               \
+                                                                              \
+   DLIST_PROBE_POP(LIST, DEST))
 
 /*
  * Pops the last element off of LIST and sets it to DEST.
@@ -255,6 +332,10 @@
         DLIST_VOID)                                                        \
      : (DLIST_IS_SINGLE(LIST)) ? ((DEST) = (LIST)->front,                  \
                                                                            \
+                                  (LIST)->front = NULL,                    \
+                                  (LIST)->back = NULL,                     \
+                                                                           \
+                                  DLIST_COUNT_SUB(LIST, 1),                \
                                   /* Clean up the old node's link. */      \
                                   DLIST_ELEM_INIT(DEST, LINK))             \
                                : ((DEST) = (LIST)->back,                   \
@@ -264,8 +345,68 @@
                                   (LIST)->front->LINK.prev = (LIST)->back, \
                                   (LIST)->back->LINK.next = (LIST)->front, \
                                                                            \
+                                  DLIST_COUNT_SUB(LIST, 1),                \
                                   /* Clean up the old node's link. */      \
-                                  DLIST_ELEM_INIT(DEST, LINK)))
+                                  DLIST_ELEM_INIT(DEST, LINK)),            \
+                                                                           \
+   DLIST_PROBE_POP(LIST, DEST))
+
+/*
+ * Rotates a list forward by one, so that its front becomes its back.  Since
+ * the list is circular, this only moves the list's ends, and no links.
+ */
+#define DLIST_ROTATE_FORWARD(LIST, LINK)                                      \
+  (DLIST_CHECK(LIST, LINK),                                                   \
+                                                                              \
+   /*                                                                         \
+    * The back is stored even when the list is empty, since it is NULL just   \
+    * like the front then.  Storing both ends under one condition lets        \
+    * compilers merge them into a single vector store, which later reads of   \
+    * the front would stall on.                                               \
+    */                                                                        \
+   (LIST)->back = (LIST)->front,                                              \
+   ((LIST)->back != NULL) ? ((LIST)->front = (LIST)->back->LINK.next) : NULL, \
+                                                                              \
+   DLIST_VOID)
+
+/*
+ * Rotates a list backward by one, so that its back becomes its front.  This
+ * only moves the list's ends, and no links.
+ */
+#define DLIST_ROTATE_BACKWARD(LIST, LINK)                                      \
+  (DLIST_CHECK(LIST, LINK),                                                    \
+                                                                               \
+   (LIST)->front = (LIST)->back,                                               \
+   ((LIST)->front != NULL) ? ((LIST)->back = (LIST)->front->LINK.prev) : NULL, \
+                                                                               \
+   DLIST_VOID)
+
+/*
+ * Rotates a list so that ELEM, one of its elements, is its front.  This only
+ * moves the list's ends, and no links.
+ */
+#define DLIST_ROTATE_TO(LIST, ELEM, LINK)            \
+  (DLIST_CHECK(LIST, LINK),                          \
+   DLIST_ASSERT(DLIST_IS_ELEM_INSERTED(ELEM, LINK)), \
+                                                     \
+   (LIST)->front = (ELEM),                           \
+   (LIST)->back = (ELEM)->LINK.prev,                 \
+                                                     \
+   DLIST_VOID)
+
+/*
+ * Sets DEST to the front of a list and rotates it to the back, to take turns
+ * among a list's elements without popping and pushing them.  Sets DEST to
+ * NULL if the list is empty.
+ *
+ * Usage:
+ *
+ *   ELEM_TYPE* var;
+ *   DLIST_ROUND_ROBIN(list, var, linkname);
+ */
+#define DLIST_ROUND_ROBIN(LIST, DEST, LINK) \
+  ((DEST) = (LIST)->front,                  \
+   DLIST_ROTATE_FORWARD(LIST, LINK))
 
 /*
  * Removes an element ELEM from LIST.
@@ -294,12 +435,15 @@
      ? ((LIST)->back = (ELEM)->LINK.prev)                                    \
      : ((ELEM)->LINK.next->LINK.prev = (ELEM)->LINK.prev),                   \
                                                                              \
-   (!DLIST_IS_SINGLE(LIST)) ? ((LIST)->front->LINK.prev = (LIST)->back,      \
-                               (LIST)->back->LINK.next = (LIST)->front)      \
-                            : ((LIST)->front = NULL, (LIST)->back = NULL),   \
+   /* The element was alone exactly when it linked to itself. */             \
+   ((ELEM)->LINK.next != (ELEM))                                             \
+     ? ((LIST)->front->LINK.prev = (LIST)->back,                             \
+        (LIST)->back->LINK.next = (LIST)->front)                             \
+     : ((LIST)->front = NULL, (LIST)->back = NULL),                          \
                                                                              \
    /* The element is no longer inserted in the list. */                      \
    DLIST_ELEM_INIT(ELEM, LINK),                                              \
+   DLIST_COUNT_SUB(LIST, 1),                                                 \
                                                                              \
    DLIST_VOID)
 
@@ -321,8 +465,235 @@
   }
 
 /*
- * Checks the validity of a list.
+ * Measures the number of bytes taken up by a list and its elements, as
+ * sizeof(*(LIST)) plus FN(CURR) for every element, and sets DEST to it.  FN
+ * should count anything the element owns along with the element itself.
+ *
+ * CURR will hold the address of the element currently being measured.
+ *
+ * Usage:
+ *
+ *   size_t bytes;
+ *   ELEM_TYPE* var;
+ *   DLIST_FOOTPRINT_DEEP(bytes, var, list, linkname, elem_size);
+ */
+#define DLIST_FOOTPRINT_DEEP(DEST, CURR, LIST, LINK, FN) \
+  {                                                      \
+    (DEST) = sizeof(*(LIST));                            \
+    DLIST_FOREACH(CURR, LIST, LINK, (DEST) += FN(CURR)); \
+  }
+
+/*
+ * Sorts a list by an unsigned integer key of up to 64 bits, in place.
+ *
+ * This is an LSD radix sort: every pass deals the elements out by one byte of
+ * their keys into 256 bucket chains strung through their next links, and
+ * then strings the chains back together.  It is stable, allocates nothing
+ * beyond the buckets on the stack, and runs in O(n) time per pass.  Bytes
+ * that are the same in every key are skipped.  The prev links are only
+ * rebuilt once, at the end.
+ *
+ * ELEM_TYPE is the name of the elements' struct type.  KEY is a function or
+ * macro that takes an element and returns its key, and is called once per
+ * element per pass plus once more.
+ *
+ * Usage:
+ *
+ *   #define EXPIRY(TIMER) ((TIMER)->expiry)
+ *   DLIST_RADIX_SORT(list, timer, linkname, EXPIRY);
+ */
+#define DLIST_RADIX_SORT(LIST, ELEM_TYPE, LINK, KEY)                           \
+  {                                                                            \
+    struct ELEM_TYPE* heads_[256];                                             \
+    struct ELEM_TYPE* tails_[256];                                             \
+    struct ELEM_TYPE* curr_;                                                   \
+    struct ELEM_TYPE* back_;                                                   \
+    uint64_t ones_ = 0;                                                        \
+    uint64_t alls_ = ~(uint64_t)0;                                             \
+    uint64_t key_;                                                             \
+    unsigned shift_;                                                           \
+    unsigned byte_;                                                            \
+                                                                               \
+    DLIST_CHECK(LIST, LINK);                                                   \
+    if (!DLIST_IS_EMPTY(LIST)) {                                               \
+      /* Cut the circle, and find the bits that differ between keys. */        \
+      (LIST)->back->LINK.next = NULL;                                          \
+      for (curr_ = (LIST)->front; curr_ != NULL; curr_ = curr_->LINK.next) {   \
+        key_ = (uint64_t)KEY(curr_);                                           \
+        ones_ |= key_;                                                         \
+        alls_ &= key_;                                                         \
+      }                                                                        \
+      ones_ ^= alls_;                                                          \
+                                                                               \
+      for (shift_ = 0; shift_ < 64 && (ones_ >> shift_) != 0; shift_ += 8) {   \
+        if (((ones_ >> shift_) & 0xff) == 0) {                                 \
+          continue;                                                            \
+        }                                                                      \
+                                                                               \
+        for (byte_ = 0; byte_ < 256; ++byte_) {                                \
+          heads_[byte_] = NULL;                                                \
+        }                                                                      \
+        for (curr_ = (LIST)->front; curr_ != NULL; curr_ = curr_->LINK.next) { \
+          byte_ = (unsigned)(((uint64_t)KEY(curr_) >> shift_) & 0xff);         \
+          if (heads_[byte_] == NULL) {                                         \
+            heads_[byte_] = curr_;                                             \
+          } else {                                                             \
+            tails_[byte_]->LINK.next = curr_;                                  \
+          }                                                                    \
+          tails_[byte_] = curr_;                                               \
+        }                                                                      \
+                                                                               \
+        back_ = NULL;                                                          \
+        for (byte_ = 0; byte_ < 256; ++byte_) {                                \
+          if (heads_[byte_] != NULL) {                                         \
+            if (back_ == NULL) {                                               \
+              (LIST)->front = heads_[byte_];                                   \
+            } else {                                                           \
+              back_->LINK.next = heads_[byte_];                                \
+            }                                                                  \
+            back_ = tails_[byte_];                                             \
+          }                                                                    \
+        }                                                                      \
+        back_->LINK.next = NULL;                                               \
+        (LIST)->back = back_;                                                  \
+      }                                                                        \
+                                                                               \
+      /* Rebuild the prev links, and close the circle again. */                \
+      back_ = (LIST)->back;                                                    \
+      for (curr_ = (LIST)->front; curr_ != NULL; curr_ = curr_->LINK.next) {   \
+        curr_->LINK.prev = back_;                                              \
+        back_ = curr_;                                                         \
+      }                                                                        \
+      (LIST)->back->LINK.next = (LIST)->front;                                 \
+    }                                                                          \
+  }
+
+/*
+ * Removes every element of a list for which PRED holds, in one pass, and
+ * calls ON_REMOVE on each one after unlinking it, so ON_REMOVE may free it.
+ * The survivors keep their order, and the ends and circular links are fixed
+ * up once at the end.
+ *
+ * ELEM_TYPE is the name of the elements' struct type.  PRED and ON_REMOVE
+ * are functions or macros that take an element.
+ *
+ * Usage:
+ *
+ *   #define EXPIRED(TIMER) ((TIMER)->expiry <= now)
+ *   DLIST_REMOVE_IF(list, timer, linkname, EXPIRED, free);
+ */
+#define DLIST_REMOVE_IF(LIST, ELEM_TYPE, LINK, PRED, ON_REMOVE)   \
+  {                                                               \
+    struct ELEM_TYPE* curr_;                                      \
+    struct ELEM_TYPE* next_;                                      \
+    struct ELEM_TYPE* back_ = NULL;                               \
+                                                                  \
+    DLIST_CHECK(LIST, LINK);                                      \
+    if (!DLIST_IS_EMPTY(LIST)) {                                  \
+      /* Cut the circle, and relink the survivors as we go. */    \
+      (LIST)->back->LINK.next = NULL;                             \
+      for (curr_ = (LIST)->front; curr_ != NULL; curr_ = next_) { \
+        next_ = curr_->LINK.next;                                 \
+        if (PRED(curr_)) {                                        \
+          DLIST_ELEM_INIT(curr_, LINK);                           \
+          DLIST_COUNT_SUB(LIST, 1);                               \
+          ON_REMOVE(curr_);                                       \
+        } else {                                                  \
+          if (back_ == NULL) {                                    \
+            (LIST)->front = curr_;                                \
+          } else {                                                \
+            back_->LINK.next = curr_;                             \
+          }                                                       \
+          curr_->LINK.prev = back_;                               \
+          back_ = curr_;                                          \
+        }                                                         \
+      }                                                           \
+                                                                  \
+      /* Close the circle again, if anything is left. */          \
+      if (back_ != NULL) {                                        \
+        back_->LINK.next = (LIST)->front;                         \
+        (LIST)->front->LINK.prev = back_;                         \
+      } else {                                                    \
+        (LIST)->front = NULL;                                     \
+      }                                                           \
+      (LIST)->back = back_;                                       \
+    }                                                             \
+  }
+
+/*
+ * Moves every element of LIST for which PRED holds onto the back of DEST, in
+ * one pass.  The elements keep their order in both lists, and the ends and
+ * circular links of both are fixed up once at the end.
+ *
+ * ELEM_TYPE is the name of the elements' struct type.  PRED is a function or
+ * macro that takes an element.
+ *
+ * Usage:
+ *
+ *   #define IS_URGENT(PKT) ((PKT)->prio > 7)
+ *   DLIST_PARTITION(list, urgent, packet, linkname, IS_URGENT);
+ */
+#define DLIST_PARTITION(LIST, DEST, ELEM_TYPE, LINK, PRED)        \
+  {                                                               \
+    struct ELEM_TYPE* curr_;                                      \
+    struct ELEM_TYPE* next_;                                      \
+    struct ELEM_TYPE* back_ = NULL;                               \
+    struct ELEM_TYPE* moved_ = NULL;                              \
+                                                                  \
+    DLIST_CHECK(LIST, LINK);                                      \
+    DLIST_CHECK(DEST, LINK);                                      \
+    DLIST_ASSERT((LIST) != (DEST));                               \
+    if (!DLIST_IS_EMPTY(LIST)) {                                  \
+      /* Cut both circles, and deal the elements out as we go. */ \
+      (LIST)->back->LINK.next = NULL;                             \
+      if (!DLIST_IS_EMPTY(DEST)) {                                \
+        moved_ = (DEST)->back;                                    \
+        moved_->LINK.next = NULL;                                 \
+      }                                                           \
+      for (curr_ = (LIST)->front; curr_ != NULL; curr_ = next_) { \
+        next_ = curr_->LINK.next;                                 \
+        if (PRED(curr_)) {                                        \
+          if (moved_ == NULL) {                                   \
+            (DEST)->front = curr_;                                \
+          } else {                                                \
+            moved_->LINK.next = curr_;                            \
+          }                                                       \
+          curr_->LINK.prev = moved_;                              \
+          moved_ = curr_;                                         \
+          DLIST_COUNT_SUB(LIST, 1);                               \
+          DLIST_COUNT_ADD(DEST, 1);                               \
+        } else {                                                  \
+          if (back_ == NULL) {                                    \
+            (LIST)->front = curr_;                                \
+          } else {                                                \
+            back_->LINK.next = curr_;                             \
+          }                                                       \
+          curr_->LINK.prev = back_;                               \
+          back_ = curr_;                                          \
+        }                                                         \
+      }                                                           \
+                                                                  \
+      /* Close both circles again, where anything is left. */     \
+      if (back_ != NULL) {                                        \
+        back_->LINK.next = (LIST)->front;                         \
+        (LIST)->front->LINK.prev = back_;                         \
+      } else {                                                    \
+        (LIST)->front = NULL;                                     \
+      }                                                           \
+      (LIST)->back = back_;                                       \
+      if (moved_ != NULL) {                                       \
+        moved_->LINK.next = (DEST)->front;                        \
+        (DEST)->front->LINK.prev = moved_;                        \
+      }                                                           \
+      (DEST)->back = moved_;                                      \
+    }                                                             \
+  }
+
+/*
+ * Checks the validity of a list.  Without DLIST_ASSERTS this is a no-op, so
+ * that it doesn't leave behind an expression with no effect.
  */
+#ifdef DLIST_ASSERTS
 #define DLIST_CHECK(LIST, LINK)                                    \
   (((LIST)->front == NULL || (LIST)->back == NULL)                 \
      ? (DLIST_ASSERT((LIST)->front == NULL),                       \
@@ -338,15 +709,22 @@
           DLIST_ASSERT((LIST)->back->LINK.prev == (LIST)->back),   \
           DLIST_ASSERT((LIST)->back->LINK.next == (LIST)->back))   \
        : (DLIST_VOID))
+#else
+#define DLIST_CHECK(LIST, LINK) DLIST_VOID
+#endif
 
 /*
  * Checks the validity of a list element.
  */
+#ifdef DLIST_ASSERTS
 #define DLIST_CHECK_ELEM(ELEM, LINK)                        \
   (((ELEM)->LINK.next == NULL || (ELEM)->LINK.prev == NULL) \
      ? (DLIST_ASSERT((ELEM)->LINK.next == NULL),            \
         DLIST_ASSERT((ELEM)->LINK.prev == NULL))            \
      : (DLIST_ASSERT((ELEM)->LINK.next != NULL),            \
         DLIST_ASSERT((ELEM)->LINK.prev != NULL)))
+#else
+#define DLIST_CHECK_ELEM(ELEM, LINK) DLIST_VOID
+#endif
 
 #endif
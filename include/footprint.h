@@ -0,0 +1,135 @@
+/*
+ * A registry of containers whose memory footprints can be dumped together.
+ *
+ * Each container is registered under a name with a callback that measures
+ * it, typically with CIRCBUF_FOOTPRINT(), one of the counted footprints, or a
+ * deep walk.  Entries are intrusive and caller-owned, so registering never
+ * allocates.  A program keeps one registry for all of its containers by
+ * defining it once and declaring it extern everywhere else.
+ *
+ * A registry is not synchronized.  Callers that register from, or measure
+ * containers shared by, several threads must hold their own lock around
+ * these calls.
+ */
+
+#ifndef __CONVOY_FOOTPRINT_H__
+#define __CONVOY_FOOTPRINT_H__
+
+#include "dlist.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Used to give macros a void return value.
+ */
+#define FOOTPRINT_VOID ((void)0)
+
+#ifdef FOOTPRINT_ASSERTS
+#include <assert.h>
+#define FOOTPRINT_ASSERT(...) assert(__VA_ARGS__)
+#else
+#define FOOTPRINT_ASSERT(...) FOOTPRINT_VOID
+#endif
+
+/*
+ * A registered container.  SIZE is called with CONTAINER and returns the
+ * number of bytes it takes up.
+ */
+struct footprint_entry {
+  DLIST_DECLARE_LINK(footprint_entry, link);
+  const char* name;
+  const void* container;
+  size_t (*size)(const void* container);
+};
+
+DLIST_DECLARE(footprint_registry, footprint_entry);
+
+/*
+ * Statically initializes a registry.
+ *
+ * Usage:
+ *
+ *   footprint_registry footprints = FOOTPRINT_STATIC_INIT;
+ */
+#define FOOTPRINT_STATIC_INIT DLIST_STATIC_INIT
+
+/*
+ * Initializes a registry.
+ */
+static inline void footprint_init(footprint_registry* reg) {
+  FOOTPRINT_ASSERT(reg != NULL);
+
+  DLIST_INIT(reg);
+}
+
+/*
+ * Registers CONTAINER under NAME, using the caller-owned ENTRY, which must
+ * stay alive until it is unregistered.  NAME is not copied.
+ */
+static inline void footprint_register(footprint_registry* reg,
+                                      struct footprint_entry* entry,
+                                      const char* name,
+                                      const void* container,
+                                      size_t (*size)(const void*)) {
+  FOOTPRINT_ASSERT(reg != NULL);
+  FOOTPRINT_ASSERT(entry != NULL);
+  FOOTPRINT_ASSERT(name != NULL);
+  FOOTPRINT_ASSERT(size != NULL);
+
+  entry->name = name;
+  entry->container = container;
+  entry->size = size;
+  DLIST_ELEM_INIT(entry, link);
+  DLIST_PUSH_BACK(reg, entry, link);
+}
+
+/*
+ * Unregisters the container registered with ENTRY.
+ */
+static inline void footprint_unregister(footprint_registry* reg,
+                                        struct footprint_entry* entry) {
+  FOOTPRINT_ASSERT(reg != NULL);
+  FOOTPRINT_ASSERT(entry != NULL);
+
+  DLIST_REMOVE(reg, entry, link);
+}
+
+/*
+ * Measures every registered container and returns the sum.
+ */
+static inline size_t footprint_total(const footprint_registry* reg) {
+  FOOTPRINT_ASSERT(reg != NULL);
+
+  struct footprint_entry* entry;
+  size_t total = 0;
+
+  DLIST_FOREACH(entry, reg, link, total += entry->size(entry->container));
+  return total;
+}
+
+/*
+ * Measures every registered container, in the order they were registered,
+ * and writes the results to OUT in the Prometheus text format, with every
+ * sample labelled container="NAME".  Returns the sum.
+ */
+static inline size_t footprint_dump(const footprint_registry* reg,
+                                    FILE* out) {
+  FOOTPRINT_ASSERT(reg != NULL);
+  FOOTPRINT_ASSERT(out != NULL);
+
+  struct footprint_entry* entry;
+  size_t bytes;
+  size_t total = 0;
+
+  DLIST_FOREACH(entry, reg, link, {
+    bytes = entry->size(entry->container);
+    total += bytes;
+    fprintf(out, "convoy_footprint_bytes{container=\"%s\"} %zu\n",
+            entry->name, bytes);
+  });
+  fprintf(out, "convoy_footprint_bytes_total %zu\n", total);
+  return total;
+}
+
+#endif
@@ -0,0 +1,322 @@
+/*
+ * Implementation of an insertion-ordered hash map, or linked hash map.
+ *
+ * Elements embed a link with two halves: a dlist link that keeps every
+ * element in the order it was inserted, and a hash chain link that files it
+ * under its key in one of the map's buckets.  Lookups only walk the hash
+ * chains, and ordered iteration only walks the dlist, so iterating never
+ * touches the bucket array however sparse it is.
+ *
+ * A chain link points back at whatever points to it, either a bucket or the
+ * previous element in the chain, so an element can be unlinked in O(1)
+ * without hashing its key again.  The link also caches the key's hash, which
+ * lets lookups skip EQ for most elements that merely share a bucket.
+ *
+ * The number of buckets is fixed by the map's type, so the map never
+ * allocates.  Lookups stay O(1) on average for as long as the map holds no
+ * more elements than it has buckets.
+ *
+ * Popping the oldest element and moving an element to the back, as a cache
+ * does on a hit, are both O(1), so a map makes for an LRU or a TTL cache that
+ * expires from the front.
+ */
+
+#ifndef __CONVOY_LHMAP_H__
+#define __CONVOY_LHMAP_H__
+
+#include "dlist.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Used to give macros a void return value.
+ */
+#define LHMAP_VOID ((void)0)
+
+#ifdef LHMAP_ASSERTS
+#include <assert.h>
+#define LHMAP_ASSERT(...) assert(__VA_ARGS__)
+#else
+#define LHMAP_ASSERT(...) LHMAP_VOID
+#endif
+
+/*
+ * Declares a new map type.
+ *
+ * ELEM_TYPE must be the name of a struct type with a declared link.  BUCKETS
+ * is the number of hash buckets, and must be a power of two.  Any other
+ * BUCKETS would leave some buckets out of reach of the hash mask, so it fails
+ * to compile, on an array of negative size.
+ *
+ * Usage:
+ *
+ *   struct entry { ... };
+ *   LHMAP_DECLARE(entry_map, entry, 1024);
+ */
+#define LHMAP_DECLARE(MAP_TYPE, ELEM_TYPE, BUCKETS)                 \
+  typedef char MAP_TYPE##_buckets_must_be_a_power_of_two_           \
+    [((BUCKETS) > 0 && ((BUCKETS) & ((BUCKETS)-1)) == 0) ? 1 : -1]; \
+                                                                    \
+  DLIST_DECLARE(MAP_TYPE##_order, ELEM_TYPE);                       \
+                                                                    \
+  typedef struct MAP_TYPE {                                         \
+    MAP_TYPE##_order order;                                         \
+    size_t count;                                                   \
+    struct ELEM_TYPE* buckets[BUCKETS];                             \
+  } MAP_TYPE
+
+/*
+ * Declares a link in a struct for use with a map.
+ *
+ * ELEM_TYPE must be the name of a struct type.
+ *
+ * Usage:
+ *
+ *   struct entry {
+ *     LHMAP_DECLARE_LINK(entry, linkname);
+ *     uint64_t key;
+ *     int value;
+ *   };
+ */
+#define LHMAP_DECLARE_LINK(ELEM_TYPE, LINK) \
+  struct {                                  \
+    DLIST_DECLARE_LINK(ELEM_TYPE, order);   \
+    struct ELEM_TYPE* chain;                \
+    struct ELEM_TYPE** pchain;              \
+    size_t hash;                            \
+  } LINK
+
+/*
+ * Initializes a map.
+ */
+#define LHMAP_INIT(MAP)                               \
+  (DLIST_INIT(&(MAP)->order),                         \
+   (MAP)->count = 0,                                  \
+   memset((MAP)->buckets, 0, sizeof((MAP)->buckets)), \
+                                                      \
+   LHMAP_VOID)
+
+/*
+ * Statically initializes a map.
+ */
+#define LHMAP_STATIC_INIT \
+  { .order = DLIST_STATIC_INIT, .count = 0, .buckets = { NULL } }
+
+/*
+ * Initializes the map link of an element.
+ */
+#define LHMAP_ELEM_INIT(ELEM, LINK)   \
+  (DLIST_ELEM_INIT(ELEM, LINK.order), \
+   (ELEM)->LINK.chain = NULL,         \
+   (ELEM)->LINK.pchain = NULL,        \
+                                      \
+   LHMAP_VOID)
+
+/*
+ * Checks if a map is empty.
+ */
+#define LHMAP_IS_EMPTY(MAP) DLIST_IS_EMPTY(&(MAP)->order)
+
+/*
+ * Gets the number of elements in a map.
+ */
+#define LHMAP_COUNT(MAP) ((MAP)->count)
+
+/*
+ * Checks if an element is inserted into a map.
+ *
+ * Does not search any maps, runs in constant time.
+ */
+#define LHMAP_IS_ELEM_INSERTED(ELEM, LINK) ((ELEM)->LINK.pchain != NULL)
+
+/*
+ * Gets the oldest element in a map, the one inserted or moved to the back
+ * longest ago.
+ */
+#define LHMAP_PEEK_FRONT(MAP, LINK) DLIST_PEEK_FRONT(&(MAP)->order, LINK.order)
+
+/*
+ * Gets the newest element in a map.
+ */
+#define LHMAP_PEEK_BACK(MAP, LINK) DLIST_PEEK_BACK(&(MAP)->order, LINK.order)
+
+/*
+ * Iterates through all elements of a map, oldest first.
+ *
+ * CURR will hold the address of the element currently being iterated over.
+ * BODY is the code fragment to execute on each iteration.  BODY must not
+ * insert or erase elements.
+ */
+#define LHMAP_FOREACH(CURR, MAP, LINK, BODY) \
+  DLIST_FOREACH(CURR, &(MAP)->order, LINK.order, BODY)
+
+/*
+ * Gets the number of buckets in a map, from its type.
+ */
+#define LHMAP_BUCKETS_(MAP) \
+  (sizeof((MAP)->buckets) / sizeof((MAP)->buckets[0]))
+
+/*
+ * Mixes the bits of a 64-bit integer key, for use as HASH.  This is the
+ * finalizer from MurmurHash3, whose low bits are as good as its high ones.
+ */
+static inline uint64_t lhmap_hash_u64(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+/*
+ * Compares two scalar keys for equality, for use as EQ.
+ */
+#define LHMAP_EQ(A, B) ((A) == (B))
+
+/*
+ * Defines a new map library.
+ *
+ * @param MAP_TYPE the type of the map
+ * @param ELEM_TYPE the type of the map's elements
+ * @param KEY_TYPE the type of the elements' keys
+ * @param HASH a hash function/macro that takes a key and returns an integer
+ * @param EQ an equality function/macro that takes two keys
+ * @param LINK the name of the link field
+ * @param KEY the name of the key field
+ */
+#define LHMAP_LIB(MAP_TYPE, ELEM_TYPE, KEY_TYPE, HASH, EQ, LINK, KEY)        \
+                                                                             \
+  /*                                                                         \
+   * Finds the element with KEY, given its hash, or returns NULL.            \
+   */                                                                        \
+  static struct ELEM_TYPE* MAP_TYPE##_find_hashed(const MAP_TYPE* map,       \
+                                                  KEY_TYPE key,              \
+                                                  size_t hash) {             \
+    struct ELEM_TYPE* curr;                                                  \
+                                                                             \
+    curr = map->buckets[hash & (LHMAP_BUCKETS_(map) - 1)];                   \
+    while (curr != NULL &&                                                   \
+           (curr->LINK.hash != hash || !EQ(curr->KEY, key))) {               \
+      curr = curr->LINK.chain;                                               \
+    }                                                                        \
+    return curr;                                                             \
+  }                                                                          \
+                                                                             \
+  /*                                                                         \
+   * Finds the element with KEY, or returns NULL.                            \
+   */                                                                        \
+  struct ELEM_TYPE* MAP_TYPE##_find(const MAP_TYPE* map, KEY_TYPE key) {     \
+    LHMAP_ASSERT(map != NULL);                                               \
+                                                                             \
+    return MAP_TYPE##_find_hashed(map, key, (size_t)HASH(key));              \
+  }                                                                          \
+                                                                             \
+  /*                                                                         \
+   * Inserts ELEM at the back of the map, unless an element with the same    \
+   * key is already in it.  Returns NULL if ELEM was inserted, and otherwise \
+   * the element already holding the key, leaving ELEM out and the map       \
+   * unchanged.                                                              \
+   */                                                                        \
+  struct ELEM_TYPE* MAP_TYPE##_insert(MAP_TYPE* map,                         \
+                                      struct ELEM_TYPE* elem) {              \
+    struct ELEM_TYPE** head;                                                 \
+    struct ELEM_TYPE* dup;                                                   \
+    size_t hash;                                                             \
+                                                                             \
+    LHMAP_ASSERT(map != NULL);                                               \
+    LHMAP_ASSERT(elem != NULL);                                              \
+    LHMAP_ASSERT(!LHMAP_IS_ELEM_INSERTED(elem, LINK));                       \
+                                                                             \
+    hash = (size_t)HASH(elem->KEY);                                          \
+    dup = MAP_TYPE##_find_hashed(map, elem->KEY, hash);                      \
+    if (dup != NULL) {                                                       \
+      return dup;                                                            \
+    }                                                                        \
+                                                                             \
+    head = &map->buckets[hash & (LHMAP_BUCKETS_(map) - 1)];                  \
+    elem->LINK.hash = hash;                                                  \
+    elem->LINK.chain = *head;                                                \
+    elem->LINK.pchain = head;                                                \
+    if (*head != NULL) {                                                     \
+      (*head)->LINK.pchain = &elem->LINK.chain;                              \
+    }                                                                        \
+    *head = elem;                                                            \
+                                                                             \
+    DLIST_PUSH_BACK(&map->order, elem, LINK.order);                          \
+    ++map->count;                                                            \
+    return NULL;                                                             \
+  }                                                                          \
+                                                                             \
+  /*                                                                         \
+   * Erases ELEM, which must be in the map.  Runs in O(1) without hashing.   \
+   */                                                                        \
+  void MAP_TYPE##_erase(MAP_TYPE* map, struct ELEM_TYPE* elem) {             \
+    LHMAP_ASSERT(map != NULL);                                               \
+    LHMAP_ASSERT(elem != NULL);                                              \
+    LHMAP_ASSERT(LHMAP_IS_ELEM_INSERTED(elem, LINK));                        \
+                                                                             \
+    *elem->LINK.pchain = elem->LINK.chain;                                   \
+    if (elem->LINK.chain != NULL) {                                          \
+      elem->LINK.chain->LINK.pchain = elem->LINK.pchain;                     \
+    }                                                                        \
+    elem->LINK.chain = NULL;                                                 \
+    elem->LINK.pchain = NULL;                                                \
+                                                                             \
+    DLIST_REMOVE(&map->order, elem, LINK.order);                             \
+    --map->count;                                                            \
+  }                                                                          \
+                                                                             \
+  /*                                                                         \
+   * Erases the element with KEY and returns it, or returns NULL if there is \
+   * none.                                                                   \
+   */                                                                        \
+  struct ELEM_TYPE* MAP_TYPE##_remove(MAP_TYPE* map, KEY_TYPE key) {         \
+    struct ELEM_TYPE* elem;                                                  \
+                                                                             \
+    LHMAP_ASSERT(map != NULL);                                               \
+                                                                             \
+    elem = MAP_TYPE##_find(map, key);                                        \
+    if (elem != NULL) {                                                      \
+      MAP_TYPE##_erase(map, elem);                                           \
+    }                                                                        \
+    return elem;                                                             \
+  }                                                                          \
+                                                                             \
+  /*                                                                         \
+   * Erases the oldest element and returns it, or returns NULL if the map is \
+   * empty.                                                                  \
+   */                                                                        \
+  struct ELEM_TYPE* MAP_TYPE##_pop_front(MAP_TYPE* map) {                    \
+    struct ELEM_TYPE* elem;                                                  \
+                                                                             \
+    LHMAP_ASSERT(map != NULL);                                               \
+                                                                             \
+    elem = map->order.front;                                                 \
+    if (elem != NULL) {                                                      \
+      MAP_TYPE##_erase(map, elem);                                           \
+    }                                                                        \
+    return elem;                                                             \
+  }                                                                          \
+                                                                             \
+  /*                                                                         \
+   * Moves ELEM, which must be in the map, to the back, as if it had just    \
+   * been inserted.  The hash chains are left alone.                         \
+   */                                                                        \
+  void MAP_TYPE##_move_to_back(MAP_TYPE* map, struct ELEM_TYPE* elem) {      \
+    LHMAP_ASSERT(map != NULL);                                               \
+    LHMAP_ASSERT(elem != NULL);                                              \
+    LHMAP_ASSERT(LHMAP_IS_ELEM_INSERTED(elem, LINK));                        \
+                                                                             \
+    /* The front becomes the back by rotating, which writes no links. */     \
+    if (elem == map->order.front) {                                          \
+      DLIST_ROTATE_FORWARD(&map->order, LINK.order);                         \
+    } else if (elem != map->order.back) {                                    \
+      DLIST_REMOVE(&map->order, elem, LINK.order);                           \
+      DLIST_PUSH_BACK(&map->order, elem, LINK.order);                        \
+    }                                                                        \
+  }
+
+#endif
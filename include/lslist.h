@@ -0,0 +1,195 @@
+/*
+ * Implementation of a linear, singly linked list.
+ *
+ * This is slist without the circle: the back element's link is NULL, so
+ * pushing onto the back no longer has to point the new back at the front,
+ * and popping off the front no longer has to point the back at the new
+ * front.  What is left of the empty and single element cases picks between
+ * two addresses or two values, which compilers turn into conditional moves,
+ * so pushes are branch-free and a pop only branches on an empty list.
+ */
+
+#ifndef __CONVOY_LSLIST_H__
+#define __CONVOY_LSLIST_H__
+
+#include <stddef.h>
+
+/*
+ * Used to give macros a void return value.
+ */
+#define LSLIST_VOID ((void)0)
+
+#ifdef LSLIST_ASSERTS
+#include <assert.h>
+#define LSLIST_ASSERT(...) assert(__VA_ARGS__)
+#else
+#define LSLIST_ASSERT(...) LSLIST_VOID
+#endif
+
+/*
+ * Declares a new list type.
+ *
+ * ELEM_TYPE must be the name of a struct type with a declared link.
+ *
+ * Usage:
+ *
+ *   struct point { ... };
+ *   LSLIST_DECLARE(point_queue, point);
+ */
+#define LSLIST_DECLARE(LIST_TYPE, ELEM_TYPE) \
+  typedef struct LIST_TYPE {                 \
+    struct ELEM_TYPE* front;                 \
+    struct ELEM_TYPE* back;                  \
+  } LIST_TYPE
+
+/*
+ * Declares a link in a struct for use with a list.
+ *
+ * ELEM_TYPE must be the name of a struct type.
+ *
+ * Usage:
+ *
+ *   struct point {
+ *     LSLIST_DECLARE_LINK(point, linkname);
+ *     int x;
+ *     int y;
+ *   };
+ */
+#define LSLIST_DECLARE_LINK(ELEM_TYPE, LINK) struct ELEM_TYPE* LINK
+
+/*
+ * Initializes a list.
+ */
+#define LSLIST_INIT(LIST) \
+  ((LIST)->front = NULL,  \
+   (LIST)->back = NULL,   \
+                          \
+   LSLIST_VOID)
+
+/*
+ * Statically initializes a list.
+ */
+#define LSLIST_STATIC_INIT \
+  { .front = NULL, .back = NULL }
+
+/*
+ * Initializes the list link of an element.
+ */
+#define LSLIST_ELEM_INIT(ELEM, LINK) \
+  ((ELEM)->LINK = NULL,              \
+                                     \
+   LSLIST_VOID)
+
+/*
+ * Statically initializes the list link of an element.
+ */
+#define LSLIST_LINK_STATIC_INIT NULL
+
+/*
+ * Checks whether a list is empty.
+ */
+#define LSLIST_IS_EMPTY(LIST) ((LIST)->front == NULL)
+
+/*
+ * Gets the first element in a list.  Returns NULL if the list is empty.
+ */
+#define LSLIST_PEEK_FRONT(LIST) ((LIST)->front)
+
+/*
+ * Gets the last element in a list.  Returns NULL if the list is empty.
+ */
+#define LSLIST_PEEK_BACK(LIST) ((LIST)->back)
+
+/*
+ * Pushes an element onto the front of a list.
+ */
+#define LSLIST_PUSH_FRONT(LIST, ELEM, LINK)                        \
+  (LSLIST_CHECK(LIST, LINK),                                       \
+                                                                   \
+   (ELEM)->LINK = (LIST)->front,                                   \
+                                                                   \
+   /* The new element is also the back if the list was empty. */   \
+   (LIST)->back = ((LIST)->front == NULL) ? (ELEM) : (LIST)->back, \
+   (LIST)->front = (ELEM),                                         \
+                                                                   \
+   LSLIST_VOID)
+
+/*
+ * Pushes an element onto the back of a list.
+ */
+#define LSLIST_PUSH_BACK(LIST, ELEM, LINK)                              \
+  (LSLIST_CHECK(LIST, LINK),                                            \
+                                                                        \
+   (ELEM)->LINK = NULL,                                                 \
+                                                                        \
+   /* Link it after the back, or as the front if the list was empty. */ \
+   *(((LIST)->back != NULL) ? &(LIST)->back->LINK : &(LIST)->front) =   \
+     (ELEM),                                                            \
+   (LIST)->back = (ELEM),                                               \
+                                                                        \
+   LSLIST_VOID)
+
+/*
+ * Pops the first element off of a list into DEST, or sets DEST to NULL if the
+ * list is empty.
+ */
+#define LSLIST_POP_FRONT(LIST, DEST, LINK)                            \
+  (LSLIST_CHECK(LIST, LINK),                                          \
+                                                                      \
+   (DEST) = (LIST)->front,                                            \
+   ((DEST) != NULL)                                                   \
+     ? ((LIST)->front = (DEST)->LINK,                                 \
+                                                                      \
+        /* The list is empty now if that was the back. */             \
+        (LIST)->back = ((LIST)->front == NULL) ? NULL : (LIST)->back, \
+        (DEST)->LINK = NULL,                                          \
+                                                                      \
+        LSLIST_VOID)                                                  \
+     : LSLIST_VOID)
+
+/*
+ * Pops the element after PREV, which must have one, into DEST.
+ */
+#define LSLIST_POP_NEXT(LIST, PREV, DEST, LINK)                     \
+  (LSLIST_CHECK(LIST, LINK),                                        \
+   LSLIST_ASSERT((PREV)->LINK != NULL),                             \
+                                                                    \
+   (DEST) = (PREV)->LINK,                                           \
+   (PREV)->LINK = (DEST)->LINK,                                     \
+                                                                    \
+   /* PREV is the back now if DEST was. */                          \
+   (LIST)->back = ((LIST)->back == (DEST)) ? (PREV) : (LIST)->back, \
+   (DEST)->LINK = NULL,                                             \
+                                                                    \
+   LSLIST_VOID)
+
+/*
+ * Iterates through all elements of a list.
+ *
+ * Usage:
+ *
+ *   LSLIST_FOREACH(var, list, linkname, printf("%p\n", var));
+ */
+#define LSLIST_FOREACH(CURR, LIST, LINK, BODY)   \
+  {                                              \
+    for ((CURR) = (LIST)->front; (CURR) != NULL; \
+         (CURR) = (CURR)->LINK) {                \
+      BODY;                                      \
+    }                                            \
+  }
+
+/*
+ * Checks the validity of a list.  Without LSLIST_ASSERTS this is a no-op, so
+ * that it doesn't leave behind an expression with no effect.
+ */
+#ifdef LSLIST_ASSERTS
+#define LSLIST_CHECK(LIST, LINK)                   \
+  (((LIST)->front == NULL || (LIST)->back == NULL) \
+     ? (LSLIST_ASSERT((LIST)->front == NULL),      \
+        LSLIST_ASSERT((LIST)->back == NULL))       \
+     : LSLIST_ASSERT((LIST)->back->LINK == NULL))
+#else
+#define LSLIST_CHECK(LIST, LINK) LSLIST_VOID
+#endif
+
+#endif
@@ -0,0 +1,273 @@
+/*
+ * Implementation of a k-way merge of sorted circbuf streams.
+ *
+ * A merge reads from N input circbufs whose elements are each in key order,
+ * and pops elements off of them in key order overall.  It keeps the inputs'
+ * heads in a tournament tree of losers: every internal node remembers the
+ * input that lost the match played there, and the root remembers the
+ * overall winner.  Popping the winner replays only the matches on its path
+ * to the root, so each element costs O(log N) comparisons instead of the N
+ * of scanning every head.
+ *
+ * An input that is empty for now has a watermark, a key that the input
+ * promises its future elements won't be less than.  An empty input plays its
+ * watermark, so elements with keys up to it can still be merged, and the
+ * merge stalls rather than overtake it.  Closing an input says it will never
+ * get more elements.
+ *
+ * Inputs are only looked at again when they surface as the winner, so
+ * pushing onto an input, raising its watermark or closing it between pops
+ * needs no notification.  Equal keys from different inputs may come out in
+ * either order.
+ */
+
+#ifndef __CONVOY_MERGE_H__
+#define __CONVOY_MERGE_H__
+
+#include "circbuf.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Used to give macros a void return value.
+ */
+#define MERGE_VOID ((void)0)
+
+#ifdef MERGE_ASSERTS
+#include <assert.h>
+#define MERGE_ASSERT(...) assert(__VA_ARGS__)
+#else
+#define MERGE_ASSERT(...) MERGE_VOID
+#endif
+
+/*
+ * The states of an input, in the order they sort in on equal keys.
+ */
+#define MERGE_READY 0 /* has an element, playing its key */
+#define MERGE_WAITING 1 /* is empty, playing its watermark */
+#define MERGE_DONE 2 /* is empty and closed, and loses to everything */
+
+/*
+ * Declares a new merge type over inputs of type RING_TYPE, a type produced
+ * by CIRCBUF_DECLARE().
+ *
+ * KEY_TYPE is the type of the elements' keys.  LIMIT is the most inputs a
+ * merge of this type can take.
+ */
+#define MERGE_DECLARE(MERGE_TYPE, RING_TYPE, KEY_TYPE, LIMIT) \
+  typedef struct MERGE_TYPE {                                 \
+    RING_TYPE* inputs[LIMIT];                                 \
+    KEY_TYPE keys[LIMIT];                                     \
+    KEY_TYPE watermarks[LIMIT];                               \
+    unsigned char states[LIMIT];                              \
+    bool closed[LIMIT];                                       \
+    size_t tree[LIMIT];                                       \
+    size_t n;                                                 \
+  } MERGE_TYPE
+
+/*
+ * Defines a new merge library.
+ *
+ * @param MERGE_TYPE the type of the merge
+ * @param RING_TYPE the type of the input circbufs
+ * @param ELEM_TYPE the type of the inputs' elements
+ * @param KEY_TYPE the type of the elements' keys
+ * @param KEY a function/macro that takes an element and returns its key
+ * @param CMP a compare function/macro that works on keys
+ */
+#define MERGE_LIB(MERGE_TYPE, RING_TYPE, ELEM_TYPE, KEY_TYPE, KEY, CMP)       \
+                                                                              \
+  /*                                                                          \
+   * Checks whether input A sorts before input B.  Index N is a placeholder   \
+   * used while building the tree, and sorts before everything.               \
+   */                                                                         \
+  static bool MERGE_TYPE##_beats(const MERGE_TYPE* merge,                     \
+                                 size_t a,                                    \
+                                 size_t b) {                                  \
+    int c;                                                                    \
+                                                                              \
+    if (a == merge->n || b == merge->n) {                                     \
+      return a == merge->n;                                                   \
+    }                                                                         \
+    if (merge->states[a] == MERGE_DONE || merge->states[b] == MERGE_DONE) {   \
+      if (merge->states[a] != merge->states[b]) {                             \
+        return merge->states[b] == MERGE_DONE;                                \
+      }                                                                       \
+      return a < b;                                                           \
+    }                                                                         \
+    c = CMP(merge->keys[a], merge->keys[b]);                                  \
+    if (c != 0) {                                                             \
+      return c < 0;                                                           \
+    }                                                                         \
+    if (merge->states[a] != merge->states[b]) {                               \
+      return merge->states[a] < merge->states[b];                             \
+    }                                                                         \
+    return a < b;                                                             \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Reloads the key and state of input I from its circbuf.                   \
+   */                                                                         \
+  static void MERGE_TYPE##_refresh(MERGE_TYPE* merge, size_t i) {             \
+    RING_TYPE* ring = merge->inputs[i];                                       \
+                                                                              \
+    if (!CIRCBUF_ISEMPTY(ring)) {                                             \
+      merge->keys[i] = KEY(ring->elems[ring->front]);                         \
+      merge->states[i] = MERGE_READY;                                         \
+    } else {                                                                  \
+      merge->keys[i] = merge->watermarks[i];                                  \
+      merge->states[i] = merge->closed[i] ? MERGE_DONE : MERGE_WAITING;       \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Replays the matches from input I's leaf up to the root.                  \
+   */                                                                         \
+  static void MERGE_TYPE##_replay(MERGE_TYPE* merge, size_t i) {              \
+    size_t node = (i + merge->n) / 2;                                         \
+    size_t loser;                                                             \
+                                                                              \
+    while (node > 0) {                                                        \
+      loser = merge->tree[node];                                              \
+      if (MERGE_TYPE##_beats(merge, loser, i)) {                              \
+        merge->tree[node] = i;                                                \
+        i = loser;                                                            \
+      }                                                                       \
+      node /= 2;                                                              \
+    }                                                                         \
+    merge->tree[0] = i;                                                       \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Initializes a merge of the N circbufs in INPUTS, which must each be in   \
+   * key order.  Every input starts with the watermark START.                 \
+   */                                                                         \
+  void MERGE_TYPE##_init(MERGE_TYPE* merge,                                   \
+                         RING_TYPE* const* inputs,                            \
+                         size_t n,                                            \
+                         KEY_TYPE start) {                                    \
+    size_t i;                                                                 \
+                                                                              \
+    MERGE_ASSERT(merge != NULL);                                              \
+    MERGE_ASSERT(inputs != NULL);                                             \
+    MERGE_ASSERT(n > 0);                                                      \
+    MERGE_ASSERT(n <= sizeof(merge->tree) / sizeof(merge->tree[0]));          \
+                                                                              \
+    merge->n = n;                                                             \
+    for (i = 0; i < n; ++i) {                                                 \
+      merge->inputs[i] = inputs[i];                                           \
+      merge->watermarks[i] = start;                                           \
+      merge->closed[i] = false;                                               \
+      MERGE_TYPE##_refresh(merge, i);                                         \
+      merge->tree[i] = n;                                                     \
+    }                                                                         \
+                                                                              \
+    /* Every leaf knocks a placeholder out of the first node it reaches. */   \
+    for (i = n; i > 0; --i) {                                                 \
+      MERGE_TYPE##_replay(merge, i - 1);                                      \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Raises the watermark of input I to KEY.  Watermarks never go down, and   \
+   * popping an element raises its input's watermark to its key.              \
+   */                                                                         \
+  void MERGE_TYPE##_watermark(MERGE_TYPE* merge, size_t i, KEY_TYPE key) {    \
+    MERGE_ASSERT(merge != NULL);                                              \
+    MERGE_ASSERT(i < merge->n);                                               \
+    MERGE_ASSERT(CMP(key, merge->watermarks[i]) >= 0);                        \
+                                                                              \
+    merge->watermarks[i] = key;                                               \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Closes input I.  Once it is empty, the merge no longer waits for it.     \
+   */                                                                         \
+  void MERGE_TYPE##_close(MERGE_TYPE* merge, size_t i) {                      \
+    MERGE_ASSERT(merge != NULL);                                              \
+    MERGE_ASSERT(i < merge->n);                                               \
+                                                                              \
+    merge->closed[i] = true;                                                  \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Refreshes the winner for as long as it is an empty input that has been   \
+   * pushed onto, had its watermark raised or been closed since it was last   \
+   * looked at.  Returns the state of the winner that sticks.                 \
+   */                                                                         \
+  static unsigned char MERGE_TYPE##_settle(MERGE_TYPE* merge) {               \
+    size_t winner;                                                            \
+    unsigned char state;                                                      \
+    KEY_TYPE key;                                                             \
+                                                                              \
+    for (;;) {                                                                \
+      winner = merge->tree[0];                                                \
+      state = merge->states[winner];                                          \
+      if (state != MERGE_WAITING) {                                           \
+        return state;                                                         \
+      }                                                                       \
+      key = merge->keys[winner];                                              \
+      MERGE_TYPE##_refresh(merge, winner);                                    \
+      if (merge->states[winner] == state &&                                   \
+          CMP(merge->keys[winner], key) == 0) {                               \
+        return state;                                                         \
+      }                                                                       \
+      MERGE_TYPE##_replay(merge, winner);                                     \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Pops the next element in key order into *DEST.  Returns false if there   \
+   * is none yet, because an empty input's watermark is the lowest key, or if \
+   * every input is closed and empty.                                         \
+   */                                                                         \
+  bool MERGE_TYPE##_pop(MERGE_TYPE* merge, ELEM_TYPE* dest) {                 \
+    size_t winner;                                                            \
+                                                                              \
+    MERGE_ASSERT(merge != NULL);                                              \
+    MERGE_ASSERT(dest != NULL);                                               \
+                                                                              \
+    if (MERGE_TYPE##_settle(merge) != MERGE_READY) {                          \
+      return false;                                                           \
+    }                                                                         \
+    winner = merge->tree[0];                                                  \
+    CIRCBUF_POP_FRONT(dest, merge->inputs[winner]);                           \
+                                                                              \
+    /* The input is in key order, so nothing below this key can follow. */    \
+    if (CMP(KEY(*dest), merge->watermarks[winner]) > 0) {                     \
+      merge->watermarks[winner] = KEY(*dest);                                 \
+    }                                                                         \
+    MERGE_TYPE##_refresh(merge, winner);                                      \
+    MERGE_TYPE##_replay(merge, winner);                                       \
+    return true;                                                              \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Pops up to N elements in key order into DEST.  Returns the number        \
+   * popped, which is less than N only when _pop() would return false.        \
+   */                                                                         \
+  size_t MERGE_TYPE##_pop_n(MERGE_TYPE* merge, ELEM_TYPE* dest, size_t n) {   \
+    size_t done;                                                              \
+                                                                              \
+    MERGE_ASSERT(merge != NULL);                                              \
+    MERGE_ASSERT(dest != NULL || n == 0);                                     \
+                                                                              \
+    for (done = 0; done < n; ++done) {                                        \
+      if (!MERGE_TYPE##_pop(merge, &dest[done])) {                            \
+        break;                                                                \
+      }                                                                       \
+    }                                                                         \
+    return done;                                                              \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Checks whether every input is closed and empty.                          \
+   */                                                                         \
+  bool MERGE_TYPE##_is_done(MERGE_TYPE* merge) {                              \
+    MERGE_ASSERT(merge != NULL);                                              \
+                                                                              \
+    return MERGE_TYPE##_settle(merge) == MERGE_DONE;                          \
+  }
+
+#endif
@@ -0,0 +1,598 @@
+/*
+ * Implementation of a minimal perfect hash function over 64-bit keys, in the
+ * style of BBHash.
+ *
+ * An mphf maps each of the n keys it was built from to a distinct index in
+ * [0, n), so a dense payload array indexed by mphf_lookup() can stand in for
+ * a tree.  Keys outside the set map to an arbitrary index or to MPHF_NONE,
+ * so payloads that need to reject them should store their key.
+ *
+ * Keys are hashed into a bit array per level, about GAMMA bits per remaining
+ * key.  Keys that land on a bit alone keep it, and keys that collide move on
+ * to the next level.  A lookup finds the first level where its key's bit is
+ * set and ranks that bit among all set bits, which together with a rank
+ * sample every 512 bits costs about 3 bits per key at GAMMA = 1.
+ *
+ * The built function is four flat arrays, so mphf_write() can dump it and
+ * mphf_view() can use it in place out of an mmap()ed file.
+ */
+
+#ifndef __CONVOY_MPHF_H__
+#define __CONVOY_MPHF_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef MPHF_NO_THREADS
+#include <pthread.h>
+#endif
+
+/*
+ * Used to give macros a void return value.
+ */
+#define MPHF_VOID ((void)0)
+
+#ifdef MPHF_ASSERTS
+#include <assert.h>
+#define MPHF_ASSERT(...) assert(__VA_ARGS__)
+#else
+#define MPHF_ASSERT(...) MPHF_VOID
+#endif
+
+/*
+ * Levels to try before the keys still colliding go to the fallback array.
+ */
+#define MPHF_MAX_LEVELS 32
+
+/*
+ * Most threads a build will use.
+ */
+#define MPHF_MAX_THREADS 64
+
+/*
+ * Returned by mphf_lookup() for keys it can tell aren't in the set.
+ */
+#define MPHF_NONE SIZE_MAX
+
+/*
+ * Bits between rank samples.
+ */
+#define MPHF_RANK_BITS 512
+#define MPHF_RANK_WORDS (MPHF_RANK_BITS / 64)
+
+/*
+ * A minimal perfect hash function.  LEVELS[l] is the first bit of level l,
+ * and LEVELS[NLEVELS] is the total number of bits.  RANKS[i] counts the set
+ * bits before bit i * MPHF_RANK_BITS.  Keys that collided on every level are
+ * kept sorted in FALLBACK and numbered after the ranked ones.
+ */
+typedef struct mphf {
+  uint64_t nkeys;
+  uint64_t seed;
+  uint64_t nlevels;
+  uint64_t levels[MPHF_MAX_LEVELS + 1];
+  uint64_t nfallback;
+  const uint64_t* bits;
+  const uint64_t* ranks;
+  const uint64_t* fallback;
+  void* owned;
+} mphf;
+
+/*
+ * Build parameters.  GAMMA trades space for build and lookup speed, and
+ * should be at least 1.
+ */
+typedef struct mphf_config {
+  double gamma;
+  unsigned threads;
+  uint64_t seed;
+} mphf_config;
+
+/*
+ * Statically initializes a build configuration with the defaults.
+ */
+#define MPHF_CONFIG_STATIC_INIT { .gamma = 1.0, .threads = 1, .seed = 0 }
+
+/*
+ * Where MPHF_KEYS_FROM_SPLAT() collects keys.
+ */
+struct mphf_splat_keys_ {
+  uint64_t* buf;
+  size_t cap;
+  size_t len;
+};
+
+/*
+ * Defines the callback that MPHF_KEYS_FROM_SPLAT() hands to the _walk() of a
+ * splat tree of type SPLAT_TYPE.
+ *
+ * Usage:
+ *
+ *   SPLAT_LIB(splat, block, int, CMP, link, key)
+ *   MPHF_SPLAT_LIB(splat, block, key)
+ */
+#define MPHF_SPLAT_LIB(SPLAT_TYPE, ELEM_TYPE, KEY)                 \
+  static void SPLAT_TYPE##_mphf_key_(struct ELEM_TYPE* elem,       \
+                                     size_t depth,                 \
+                                     void* ctx) {                  \
+    struct mphf_splat_keys_* keys = (struct mphf_splat_keys_*)ctx; \
+                                                                   \
+    (void)depth;                                                   \
+    if (keys->len < keys->cap) {                                   \
+      keys->buf[keys->len] = (uint64_t)elem->KEY;                  \
+    }                                                              \
+    ++keys->len;                                                   \
+  }
+
+/*
+ * Fills an array with the keys of a splat tree of type SPLAT_TYPE, in order,
+ * and sets LEN to how many there were.  The tree needs an MPHF_SPLAT_LIB().
+ * If the array runs out of room, the remaining keys are dropped, but LEN
+ * still counts them and the walk still finishes so the tree is restored.
+ *
+ * Usage:
+ *
+ *   size_t len;
+ *   MPHF_KEYS_FROM_SPLAT(&tree, splat, buf, cap, len);
+ */
+#define MPHF_KEYS_FROM_SPLAT(TREE, SPLAT_TYPE, BUF, CAP, LEN)       \
+  do {                                                              \
+    struct mphf_splat_keys_ mphf_keys_;                             \
+                                                                    \
+    mphf_keys_.buf = (BUF);                                         \
+    mphf_keys_.cap = (CAP);                                         \
+    mphf_keys_.len = 0;                                             \
+    SPLAT_TYPE##_walk((TREE), SPLAT_TYPE##_mphf_key_, &mphf_keys_); \
+    (LEN) = mphf_keys_.len;                                         \
+  } while (0)
+
+static inline uint64_t mphf_hash_(uint64_t key, uint64_t seed) {
+  uint64_t h = key ^ (seed * UINT64_C(0x9e3779b97f4a7c15));
+
+  h ^= h >> 33;
+  h *= UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  h *= UINT64_C(0xc4ceb9fe1a85ec53);
+  h ^= h >> 33;
+  return h;
+}
+
+/*
+ * Gets the bit of KEY within level L.
+ */
+static inline uint64_t mphf_bit_(const mphf* m, uint64_t key, uint64_t l) {
+  uint64_t size = m->levels[l + 1] - m->levels[l];
+
+  return m->levels[l] + mphf_hash_(key, m->seed + l) % size;
+}
+
+static inline size_t mphf_rank_(const mphf* m, uint64_t bit) {
+  uint64_t word = bit / 64;
+  uint64_t w = word - word % MPHF_RANK_WORDS;
+  uint64_t rank = m->ranks[bit / MPHF_RANK_BITS];
+
+  for (; w < word; ++w) {
+    rank += (uint64_t)__builtin_popcountll(m->bits[w]);
+  }
+  rank += (uint64_t)__builtin_popcountll(m->bits[word] &
+                                         ((UINT64_C(1) << (bit % 64)) - 1));
+  return (size_t)rank;
+}
+
+/*
+ * Gets the index of KEY, which is in [0, nkeys) and distinct for every key
+ * the function was built from.
+ */
+static inline size_t mphf_lookup(const mphf* m, uint64_t key) {
+  MPHF_ASSERT(m != NULL);
+
+  uint64_t l;
+  size_t lo = 0;
+  size_t hi = (size_t)m->nfallback;
+
+  for (l = 0; l < m->nlevels; ++l) {
+    uint64_t bit = mphf_bit_(m, key, l);
+    if ((m->bits[bit / 64] >> (bit % 64)) & 1) {
+      return mphf_rank_(m, bit);
+    }
+  }
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (m->fallback[mid] < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo < m->nfallback && m->fallback[lo] == key) {
+    return (size_t)(m->nkeys - m->nfallback) + lo;
+  }
+  return MPHF_NONE;
+}
+
+/*
+ * One thread's share of a level: the keys in [BEGIN, END), of which KEPT
+ * collided and were moved to the front.
+ */
+struct mphf_job_ {
+  uint64_t* keys;
+  size_t begin;
+  size_t end;
+  size_t kept;
+  uint64_t* seen;
+  uint64_t* collided;
+  const mphf* m;
+  uint64_t level;
+};
+
+static inline void* mphf_mark_(void* arg) {
+  struct mphf_job_* job = (struct mphf_job_*)arg;
+  size_t i;
+
+  for (i = job->begin; i < job->end; ++i) {
+    uint64_t bit = mphf_bit_(job->m, job->keys[i], job->level) -
+                   job->m->levels[job->level];
+    uint64_t mask = UINT64_C(1) << (bit % 64);
+    uint64_t old =
+      __atomic_fetch_or(&job->seen[bit / 64], mask, __ATOMIC_RELAXED);
+    if (old & mask) {
+      __atomic_fetch_or(&job->collided[bit / 64], mask, __ATOMIC_RELAXED);
+    }
+  }
+  return NULL;
+}
+
+static inline void* mphf_sift_(void* arg) {
+  struct mphf_job_* job = (struct mphf_job_*)arg;
+  size_t i;
+
+  job->kept = 0;
+  for (i = job->begin; i < job->end; ++i) {
+    uint64_t key = job->keys[i];
+    uint64_t bit =
+      mphf_bit_(job->m, key, job->level) - job->m->levels[job->level];
+    if ((job->collided[bit / 64] >> (bit % 64)) & 1) {
+      job->keys[job->begin + job->kept++] = key;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Runs FN over every job, on its own thread where possible.
+ */
+static inline void mphf_run_(void* (*fn)(void*),
+                             struct mphf_job_* jobs,
+                             unsigned njobs) {
+#ifndef MPHF_NO_THREADS
+  pthread_t threads[MPHF_MAX_THREADS];
+  bool started[MPHF_MAX_THREADS];
+  unsigned i;
+
+  for (i = 1; i < njobs; ++i) {
+    started[i] = pthread_create(&threads[i], NULL, fn, &jobs[i]) == 0;
+    if (!started[i]) {
+      fn(&jobs[i]);
+    }
+  }
+  fn(&jobs[0]);
+  for (i = 1; i < njobs; ++i) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+#else
+  unsigned i;
+
+  for (i = 0; i < njobs; ++i) {
+    fn(&jobs[i]);
+  }
+#endif
+}
+
+static inline int mphf_cmp_(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a;
+  uint64_t y = *(const uint64_t*)b;
+
+  return (x > y) - (x < y);
+}
+
+/*
+ * Builds a function over N distinct keys, which are not modified.  Returns
+ * false if memory runs out or if KEYS has duplicates.  Release the result
+ * with mphf_free().
+ */
+static inline bool mphf_build(mphf* m,
+                              const uint64_t* keys,
+                              size_t n,
+                              const mphf_config* config) {
+  MPHF_ASSERT(m != NULL);
+  MPHF_ASSERT(keys != NULL || n == 0);
+  MPHF_ASSERT(config != NULL && config->gamma >= 1.0);
+
+  struct mphf_job_ jobs[MPHF_MAX_THREADS];
+  uint64_t* level_bits[MPHF_MAX_LEVELS];
+  uint64_t* scratch = (uint64_t*)malloc((n != 0 ? n : 1) * sizeof(*scratch));
+  uint64_t* collided = NULL;
+  uint64_t* out;
+  size_t left = n;
+  size_t nwords;
+  size_t nranks;
+  size_t i;
+  unsigned j;
+  unsigned njobs;
+  bool ok = scratch != NULL;
+
+  memset(m, 0, sizeof(*m));
+  m->nkeys = n;
+  m->seed = config->seed;
+
+  if (ok) {
+    memcpy(scratch, keys, n * sizeof(*keys));
+  }
+
+  while (ok && left > 0 && m->nlevels < MPHF_MAX_LEVELS) {
+    uint64_t l = m->nlevels;
+    size_t words = (size_t)(config->gamma * (double)left) / 64 + 1;
+    size_t chunk;
+
+    level_bits[l] = (uint64_t*)calloc(words, sizeof(uint64_t));
+    collided = (uint64_t*)calloc(words, sizeof(uint64_t));
+    if (level_bits[l] == NULL || collided == NULL) {
+      free(level_bits[l]);
+      free(collided);
+      ok = false;
+      break;
+    }
+    m->levels[l + 1] = m->levels[l] + (uint64_t)words * 64;
+    ++m->nlevels;
+
+    /* Small levels aren't worth a thread each. */
+    njobs = config->threads;
+    if (njobs > MPHF_MAX_THREADS) {
+      njobs = MPHF_MAX_THREADS;
+    }
+    if (njobs > left / 4096 + 1) {
+      njobs = (unsigned)(left / 4096 + 1);
+    }
+    if (njobs == 0) {
+      njobs = 1;
+    }
+    chunk = (left + njobs - 1) / njobs;
+    for (j = 0; j < njobs; ++j) {
+      jobs[j].keys = scratch;
+      jobs[j].begin = (j * chunk < left) ? j * chunk : left;
+      jobs[j].end = (jobs[j].begin + chunk < left) ? jobs[j].begin + chunk
+                                                   : left;
+      jobs[j].seen = level_bits[l];
+      jobs[j].collided = collided;
+      jobs[j].m = m;
+      jobs[j].level = l;
+    }
+
+    mphf_run_(mphf_mark_, jobs, njobs);
+    mphf_run_(mphf_sift_, jobs, njobs);
+
+    /* Keys that collided move on; the rest keep their bits. */
+    left = 0;
+    for (j = 0; j < njobs; ++j) {
+      memmove(scratch + left,
+              scratch + jobs[j].begin,
+              jobs[j].kept * sizeof(*scratch));
+      left += jobs[j].kept;
+    }
+    for (i = 0; i < words; ++i) {
+      level_bits[l][i] &= ~collided[i];
+    }
+    free(collided);
+    collided = NULL;
+  }
+
+  /* Whatever collided on every level is looked up by binary search. */
+  if (ok) {
+    qsort(scratch, left, sizeof(*scratch), mphf_cmp_);
+    for (i = 1; i < left; ++i) {
+      if (scratch[i - 1] == scratch[i]) {
+        ok = false;
+        break;
+      }
+    }
+  }
+
+  nwords = (size_t)(m->levels[m->nlevels] / 64);
+  nranks = nwords / MPHF_RANK_WORDS + 1;
+  out = NULL;
+  if (ok) {
+    out = (uint64_t*)malloc((nwords + nranks + left + 1) * sizeof(*out));
+    ok = out != NULL;
+  }
+  if (ok) {
+    uint64_t rank = 0;
+    uint64_t* bits = out;
+    uint64_t* ranks = out + nwords;
+    size_t w = 0;
+    uint64_t l;
+
+    for (l = 0; l < m->nlevels; ++l) {
+      size_t words = (size_t)((m->levels[l + 1] - m->levels[l]) / 64);
+      memcpy(bits + w, level_bits[l], words * sizeof(*bits));
+      w += words;
+    }
+    for (i = 0; i < nwords; ++i) {
+      if (i % MPHF_RANK_WORDS == 0) {
+        ranks[i / MPHF_RANK_WORDS] = rank;
+      }
+      rank += (uint64_t)__builtin_popcountll(bits[i]);
+    }
+    if (nwords % MPHF_RANK_WORDS == 0) {
+      ranks[nwords / MPHF_RANK_WORDS] = rank;
+    }
+    memcpy(ranks + nranks, scratch, left * sizeof(*scratch));
+
+    m->nfallback = left;
+    m->bits = bits;
+    m->ranks = ranks;
+    m->fallback = ranks + nranks;
+    m->owned = out;
+  }
+
+  for (i = 0; i < m->nlevels; ++i) {
+    free(level_bits[i]);
+  }
+  free(scratch);
+  if (!ok) {
+    memset(m, 0, sizeof(*m));
+  }
+  return ok;
+}
+
+/*
+ * Releases a function from mphf_build().  Does nothing for mphf_view().
+ */
+static inline void mphf_free(mphf* m) {
+  MPHF_ASSERT(m != NULL);
+
+  free(m->owned);
+  memset(m, 0, sizeof(*m));
+}
+
+/*
+ * The serialized layout: this header, then the bits, the rank samples and
+ * the fallback keys, all as native-endian 64-bit words.
+ */
+#define MPHF_MAGIC UINT64_C(0x3148504d59564e43) /* "CNVYMPH1" */
+
+struct mphf_file_header {
+  uint64_t magic;
+  uint64_t nkeys;
+  uint64_t seed;
+  uint64_t nlevels;
+  uint64_t levels[MPHF_MAX_LEVELS + 1];
+  uint64_t nfallback;
+};
+
+static inline size_t mphf_nwords_(const mphf* m) {
+  return (size_t)(m->levels[m->nlevels] / 64);
+}
+
+/*
+ * Gets the number of bytes mphf_write() will write.
+ */
+static inline size_t mphf_serialized_size(const mphf* m) {
+  size_t nwords = mphf_nwords_(m);
+
+  return sizeof(struct mphf_file_header) +
+         (nwords + nwords / MPHF_RANK_WORDS + 1 + (size_t)m->nfallback) *
+           sizeof(uint64_t);
+}
+
+/*
+ * Writes a function to F.  Returns false on a write error.
+ */
+static inline bool mphf_write(const mphf* m, FILE* f) {
+  MPHF_ASSERT(m != NULL);
+  MPHF_ASSERT(f != NULL);
+
+  struct mphf_file_header header;
+  size_t nwords = mphf_nwords_(m);
+  size_t nranks = nwords / MPHF_RANK_WORDS + 1;
+
+  memset(&header, 0, sizeof(header));
+  header.magic = MPHF_MAGIC;
+  header.nkeys = m->nkeys;
+  header.seed = m->seed;
+  header.nlevels = m->nlevels;
+  memcpy(header.levels, m->levels, sizeof(header.levels));
+  header.nfallback = m->nfallback;
+
+  if (fwrite(&header, sizeof(header), 1, f) != 1) {
+    return false;
+  }
+  if (nwords != 0 &&
+      fwrite(m->bits, sizeof(uint64_t), nwords, f) != nwords) {
+    return false;
+  }
+  if (m->ranks != NULL &&
+      fwrite(m->ranks, sizeof(uint64_t), nranks, f) != nranks) {
+    return false;
+  }
+  if (m->nfallback != 0 &&
+      fwrite(m->fallback, sizeof(uint64_t), (size_t)m->nfallback, f) !=
+        m->nfallback) {
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Points a function at SIZE bytes of DATA written by mphf_write(), such as
+ * an mmap()ed file, without copying.  DATA must be 8-byte aligned and
+ * outlive the function.  Returns false if DATA isn't a valid function.
+ */
+static inline bool mphf_view(mphf* m, const void* data, size_t size) {
+  MPHF_ASSERT(m != NULL);
+
+  const struct mphf_file_header* header =
+    (const struct mphf_file_header*)data;
+  const uint64_t* words = (const uint64_t*)(header + 1);
+  size_t avail;
+  size_t nwords;
+  size_t nranks;
+  uint64_t rank;
+  size_t w;
+  uint64_t l;
+
+  if (size < sizeof(*header) || header->magic != MPHF_MAGIC ||
+      header->nlevels > MPHF_MAX_LEVELS || header->levels[0] != 0) {
+    return false;
+  }
+  for (l = 0; l < header->nlevels; ++l) {
+    if (header->levels[l + 1] <= header->levels[l] ||
+        header->levels[l + 1] % 64 != 0) {
+      return false;
+    }
+  }
+
+  /* Check each part against what's left, so no sum of them can wrap. */
+  avail = (size - sizeof(*header)) / sizeof(uint64_t);
+  if (header->levels[header->nlevels] / 64 > avail) {
+    return false;
+  }
+  nwords = (size_t)(header->levels[header->nlevels] / 64);
+  avail -= nwords;
+  nranks = nwords / MPHF_RANK_WORDS + 1;
+  if (nranks > avail) {
+    return false;
+  }
+  avail -= nranks;
+  if (header->nfallback > avail || header->nfallback > header->nkeys) {
+    return false;
+  }
+
+  /* The set bits past the final rank sample bring it to the ranked keys. */
+  rank = words[nwords + nranks - 1];
+  for (w = (nranks - 1) * MPHF_RANK_WORDS; w < nwords; ++w) {
+    rank += (uint64_t)__builtin_popcountll(words[w]);
+  }
+  if (rank != header->nkeys - header->nfallback) {
+    return false;
+  }
+
+  memset(m, 0, sizeof(*m));
+  m->nkeys = header->nkeys;
+  m->seed = header->seed;
+  m->nlevels = header->nlevels;
+  memcpy(m->levels, header->levels, sizeof(m->levels));
+  m->nfallback = header->nfallback;
+  m->bits = words;
+  m->ranks = words + nwords;
+  m->fallback = words + nwords + nranks;
+  return true;
+}
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * Hashing for the perfect hash tables generated by tools/phgen.c.
+ *
+ * The generator and the tables it writes both include this header, so a key
+ * hashes the same way at build time and at lookup time.  A lookup hashes the
+ * key once, reads the displacement of the key's bucket, and lands on the only
+ * slot the key can be in, which it then compares against.
+ */
+
+#ifndef __CONVOY_PHASH_H__
+#define __CONVOY_PHASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Finalizes a 64-bit hash so that every input bit affects every output bit.
+ * The mix is a bijection on 64-bit values.
+ */
+static inline uint64_t phash_mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  h *= UINT64_C(0xc4ceb9fe1a85ec53);
+  h ^= h >> 33;
+  return h;
+}
+
+/*
+ * Hashes LEN bytes at KEY with SEED.
+ */
+static inline uint64_t phash_bytes(const void* key, size_t len, uint64_t seed) {
+  const unsigned char* bytes = (const unsigned char*)key;
+  uint64_t h = UINT64_C(0xcbf29ce484222325) ^ phash_mix(seed);
+  size_t i;
+
+  for (i = 0; i < len; ++i) {
+    h ^= bytes[i];
+    h *= UINT64_C(0x100000001b3);
+  }
+  return phash_mix(h ^ len);
+}
+
+/*
+ * Gets the bucket of a key with hash H, out of BUCKETS.
+ */
+static inline size_t phash_bucket(uint64_t h, size_t buckets) {
+  return (size_t)((h >> 32) % buckets);
+}
+
+/*
+ * Gets the slot of a key with hash H, out of SIZE, given its bucket's
+ * displacement DISP.
+ */
+static inline size_t phash_slot(uint64_t h, uint32_t disp, size_t size) {
+  return (size_t)(phash_mix(h ^ disp) % size);
+}
+
+#endif
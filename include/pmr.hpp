@@ -0,0 +1,432 @@
+/*
+ * std::pmr::memory_resource adapters over arena.h and pool.h, so std::pmr
+ * containers and convoy elements can share one region and be released
+ * together.
+ *
+ * Usage:
+ *
+ *   alignas(std::max_align_t) unsigned char buf[4096];
+ *   convoy::arena_resource request(buf, sizeof(buf));
+ *   std::pmr::vector<int> ids(&request);
+ *   ...
+ *   request.release();
+ */
+
+#ifndef __CONVOY_PMR_HPP__
+#define __CONVOY_PMR_HPP__
+
+#include "arena.h"
+#include "dlist.h"
+#include "pool.h"
+#include "slist.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+
+namespace convoy {
+
+/*
+ * Chunks taken from an upstream resource to refill an arena, each headed by
+ * its size and a link.
+ */
+class upstream_chunks {
+ public:
+  upstream_chunks() noexcept = default;
+  upstream_chunks(const upstream_chunks&) = delete;
+  upstream_chunks& operator=(const upstream_chunks&) = delete;
+
+  /*
+   * Points ARENA at a new chunk with room for at least BYTES aligned to
+   * ALIGN.  Chunk sizes double, starting from FIRST.
+   */
+  void grow(arena& to,
+            std::pmr::memory_resource* upstream,
+            std::size_t bytes,
+            std::size_t align,
+            std::size_t first) {
+    std::size_t size = std::max(next_ != 0 ? next_ : first,
+                                sizeof(chunk) + bytes + align);
+    chunk* c = static_cast<chunk*>(upstream->allocate(size, alignof(chunk)));
+
+    c->size = size;
+    SLIST_ELEM_INIT(c, link);
+    SLIST_PUSH_FRONT(&chunks_, c, link);
+    ARENA_INIT(&to, c + 1, size - sizeof(chunk));
+    next_ = size * 2;
+  }
+
+  /*
+   * Hands every chunk back to UPSTREAM.
+   */
+  void release(std::pmr::memory_resource* upstream) noexcept {
+    chunk* c;
+    while (true) {
+      SLIST_POP_FRONT(&chunks_, c, link);
+      if (c == nullptr) {
+        break;
+      }
+      upstream->deallocate(c, c->size, alignof(chunk));
+    }
+    next_ = 0;
+  }
+
+ private:
+  struct alignas(std::max_align_t) chunk {
+    SLIST_DECLARE_LINK(chunk, link);
+    std::size_t size;
+  };
+
+  SLIST_DECLARE(chunk_list, chunk);
+
+  chunk_list chunks_ = SLIST_STATIC_INIT;
+  std::size_t next_ = 0;
+};
+
+/*
+ * A bump allocator over a caller-provided buffer, which takes doubling chunks
+ * from UPSTREAM once the buffer runs out.  Deallocation is a no-op, and
+ * release() frees everything at once.  Like monotonic_buffer_resource, it is
+ * not thread-safe.
+ */
+class arena_resource : public std::pmr::memory_resource {
+ public:
+  explicit arena_resource(
+    std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+    : arena_resource(nullptr, 0, upstream) {}
+
+  arena_resource(
+    void* buf,
+    std::size_t size,
+    std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+    : buf_(buf), size_(size), upstream_(upstream) {
+    ARENA_INIT(&arena_, buf, size);
+  }
+
+  arena_resource(const arena_resource&) = delete;
+  arena_resource& operator=(const arena_resource&) = delete;
+
+  ~arena_resource() override { release(); }
+
+  /*
+   * Frees every allocation, handing chunks back upstream and rewinding to
+   * the start of the initial buffer.
+   */
+  void release() noexcept {
+    chunks_.release(upstream_);
+    ARENA_INIT(&arena_, buf_, size_);
+  }
+
+  std::pmr::memory_resource* upstream_resource() const noexcept {
+    return upstream_;
+  }
+
+ protected:
+  void* do_allocate(std::size_t bytes, std::size_t align) override {
+    void* p = arena_alloc(&arena_, bytes, align);
+    if (p == nullptr) {
+      chunks_.grow(arena_, upstream_, bytes, align, first_chunk);
+      p = arena_alloc(&arena_, bytes, align);
+    }
+    return p;
+  }
+
+  void do_deallocate(void*, std::size_t, std::size_t) override {}
+
+  bool do_is_equal(
+    const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+ private:
+  static constexpr std::size_t first_chunk = 4096;
+
+  arena arena_;
+  void* buf_;
+  std::size_t size_;
+  std::pmr::memory_resource* upstream_;
+  upstream_chunks chunks_;
+};
+
+/*
+ * A thread-safe pool over pool.h, whose arena is refilled with chunks from
+ * UPSTREAM.  Requests larger than POOL_MAX_SIZE or aligned past POOL_MIN_SIZE
+ * go straight to UPSTREAM.
+ *
+ * Each thread keeps up to cache_limit free blocks per size class for each of
+ * the last cache_slots pool_resources it used, so most allocations and
+ * deallocations take no lock, and a thread can go back and forth between a
+ * few resources without refilling from scratch.  A thread hands its cached
+ * blocks back to their resource's shared pool when it exits, or when it
+ * needs the slot for yet another resource.
+ */
+class pool_resource : public std::pmr::memory_resource {
+ public:
+  static constexpr std::size_t cache_limit = 32;
+  static constexpr std::size_t cache_slots = 4;
+
+  explicit pool_resource(
+    std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+    : id_(next_id()), upstream_(upstream) {
+    ARENA_INIT(&arena_, nullptr, 0);
+    pool_init(&pool_, &arena_);
+
+    live_resources& live = live_resources_();
+    std::lock_guard<std::mutex> lock(live.mutex);
+    entry_.resource = this;
+    DLIST_ELEM_INIT(&entry_, link);
+    DLIST_PUSH_BACK(&live.list, &entry_, link);
+  }
+
+  pool_resource(const pool_resource&) = delete;
+  pool_resource& operator=(const pool_resource&) = delete;
+
+  ~pool_resource() override {
+    {
+      live_resources& live = live_resources_();
+      std::lock_guard<std::mutex> lock(live.mutex);
+      DLIST_REMOVE(&live.list, &entry_, link);
+    }
+    release();
+  }
+
+  /*
+   * Frees every pooled block at once.  Must not race with allocations, but
+   * other threads' caches are invalidated and needn't be flushed first.
+   */
+  void release() noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+    id_ = next_id();
+    chunks_.release(upstream_);
+    ARENA_INIT(&arena_, nullptr, 0);
+    pool_init(&pool_, &arena_);
+  }
+
+  std::pmr::memory_resource* upstream_resource() const noexcept {
+    return upstream_;
+  }
+
+ protected:
+  void* do_allocate(std::size_t bytes, std::size_t align) override {
+    if (bytes > POOL_MAX_SIZE || align > POOL_MIN_SIZE) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return upstream_->allocate(bytes, align);
+    }
+
+    int cls = pool_class(bytes);
+    cache& local = local_cache();
+    struct pool_block* block;
+
+    if (local.count[cls] == 0) {
+      refill(local, cls);
+    }
+    SLIST_POP_FRONT(&local.free[cls], block, link);
+    --local.count[cls];
+    return block;
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t align) override {
+    if (bytes > POOL_MAX_SIZE || align > POOL_MIN_SIZE) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      upstream_->deallocate(p, bytes, align);
+      return;
+    }
+
+    int cls = pool_class(bytes);
+    cache& local = local_cache();
+    struct pool_block* block = static_cast<struct pool_block*>(p);
+
+    SLIST_ELEM_INIT(block, link);
+    SLIST_PUSH_FRONT(&local.free[cls], block, link);
+    if (++local.count[cls] > cache_limit) {
+      spill(local, cls);
+    }
+  }
+
+  bool do_is_equal(
+    const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+ private:
+  static constexpr std::size_t first_chunk = 64 * 1024;
+
+  /*
+   * One thread's free blocks for RESOURCE, as of when its id was OWNER.  An
+   * unclaimed cache has an OWNER of 0.
+   */
+  struct cache {
+    std::uint64_t owner = 0;
+    pool_resource* resource = nullptr;
+    std::uint64_t used = 0;
+    pool_list free[POOL_CLASSES];
+    std::size_t count[POOL_CLASSES];
+  };
+
+  /*
+   * One thread's caches, which go back to their resources when it exits.
+   */
+  struct cache_table {
+    cache slots[cache_slots];
+    std::uint64_t clock = 0;
+
+    ~cache_table() {
+      for (cache& c : slots) {
+        flush(c);
+      }
+    }
+  };
+
+  /*
+   * Every pool_resource that is still alive, so that a thread can tell
+   * whether the resource behind one of its caches can take its blocks back.
+   */
+  struct live_entry {
+    DLIST_DECLARE_LINK(live_entry, link);
+    pool_resource* resource;
+  };
+
+  DLIST_DECLARE(live_list, live_entry);
+
+  struct live_resources {
+    std::mutex mutex;
+    live_list list = DLIST_STATIC_INIT;
+  };
+
+  static live_resources& live_resources_() noexcept {
+    static live_resources live;
+    return live;
+  }
+
+  static std::uint64_t next_id() noexcept {
+    static std::atomic<std::uint64_t> ids{ 1 };
+    return ids.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /*
+   * Gets this thread's cache for this resource.  If the thread has none, it
+   * flushes its least recently used cache and claims that.  Ids are never
+   * reused, so a cache left over from before a release() is never touched.
+   */
+  cache& local_cache() noexcept {
+    thread_local cache_table table;
+    cache* victim = &table.slots[0];
+
+    for (cache& c : table.slots) {
+      if (c.owner == id_) {
+        c.used = ++table.clock;
+        return c;
+      }
+      if (c.used < victim->used) {
+        victim = &c;
+      }
+    }
+
+    flush(*victim);
+    victim->owner = id_;
+    victim->resource = this;
+    victim->used = ++table.clock;
+    for (int i = 0; i < POOL_CLASSES; ++i) {
+      SLIST_INIT(&victim->free[i]);
+      victim->count[i] = 0;
+    }
+    return *victim;
+  }
+
+  /*
+   * Hands LOCAL's blocks back to its resource's shared pool and unclaims it.
+   * The blocks are dropped instead if the resource has since been destroyed
+   * or released, since they went with its chunks.
+   */
+  static void flush(cache& local) noexcept {
+    live_resources& live = live_resources_();
+    live_entry* curr;
+
+    if (local.owner == 0) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(live.mutex);
+      DLIST_FOREACH(curr, &live.list, link, {
+        if (curr->resource == local.resource) {
+          curr->resource->reclaim(local);
+          break;
+        }
+      });
+    }
+    local.owner = 0;
+    local.resource = nullptr;
+  }
+
+  /*
+   * Moves all of LOCAL's blocks back to the shared pool, if they are still
+   * this resource's.
+   */
+  void reclaim(cache& local) noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (local.owner != id_) {
+      return;
+    }
+    for (int cls = 0; cls < POOL_CLASSES; ++cls) {
+      std::size_t size = POOL_CLASS_SIZE(cls);
+      while (local.count[cls] > 0) {
+        struct pool_block* block;
+        SLIST_POP_FRONT(&local.free[cls], block, link);
+        pool_free(&pool_, block, size);
+        --local.count[cls];
+      }
+    }
+  }
+
+  /*
+   * Moves half a cache's worth of blocks of class CLS from the shared pool
+   * into LOCAL, carving new ones if the pool has none.
+   */
+  void refill(cache& local, int cls) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t size = POOL_CLASS_SIZE(cls);
+
+    while (local.count[cls] < cache_limit / 2) {
+      struct pool_block* block =
+        static_cast<struct pool_block*>(pool_alloc(&pool_, size));
+      if (block == nullptr) {
+        chunks_.grow(arena_, upstream_, size, POOL_MIN_SIZE, first_chunk);
+        continue;
+      }
+      SLIST_ELEM_INIT(block, link);
+      SLIST_PUSH_FRONT(&local.free[cls], block, link);
+      ++local.count[cls];
+    }
+  }
+
+  /*
+   * Moves half of LOCAL's blocks of class CLS back to the shared pool.
+   */
+  void spill(cache& local, int cls) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t size = POOL_CLASS_SIZE(cls);
+
+    while (local.count[cls] > cache_limit / 2) {
+      struct pool_block* block;
+      SLIST_POP_FRONT(&local.free[cls], block, link);
+      pool_free(&pool_, block, size);
+      --local.count[cls];
+    }
+  }
+
+  std::uint64_t id_;
+  std::pmr::memory_resource* upstream_;
+  std::mutex mutex_;
+  arena arena_;
+  pool pool_;
+  upstream_chunks chunks_;
+  live_entry entry_;
+};
+
+}  // namespace convoy
+
+#endif
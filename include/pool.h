@@ -0,0 +1,140 @@
+/*
+ * Implementation of a size-class pool allocator.
+ *
+ * Requests are rounded up to a power of two between POOL_MIN_SIZE and
+ * POOL_MAX_SIZE.  Each size class keeps its freed blocks on an slist, and
+ * when a class's list runs dry a new block is carved out of the arena the
+ * pool draws from.  Blocks are never returned to the arena individually, the
+ * whole pool goes away when its arena is reset.
+ */
+
+#ifndef __CONVOY_POOL_H__
+#define __CONVOY_POOL_H__
+
+#include "arena.h"
+#include "slist.h"
+
+#include <stddef.h>
+
+/*
+ * Used to give macros a void return value.
+ */
+#define POOL_VOID ((void)0)
+
+#ifdef POOL_ASSERTS
+#include <assert.h>
+#define POOL_ASSERT(...) assert(__VA_ARGS__)
+#else
+#define POOL_ASSERT(...) POOL_VOID
+#endif
+
+/*
+ * Number of size classes, which sets the largest size the pool serves.
+ */
+#ifndef POOL_CLASSES
+#define POOL_CLASSES 8
+#endif
+
+/*
+ * Size of the smallest class, and the alignment of every block.
+ */
+#define POOL_MIN_SIZE 16
+
+/*
+ * Size of the largest class.
+ */
+#define POOL_MAX_SIZE ((size_t)POOL_MIN_SIZE << (POOL_CLASSES - 1))
+
+/*
+ * Gets the size of the blocks in class CLS.
+ */
+#define POOL_CLASS_SIZE(CLS) ((size_t)POOL_MIN_SIZE << (CLS))
+
+/*
+ * A free block, threaded onto its class's list through its first word.
+ */
+struct pool_block {
+  SLIST_DECLARE_LINK(pool_block, link);
+};
+
+SLIST_DECLARE(pool_list, pool_block);
+
+/*
+ * A pool carving blocks out of SOURCE, with one free list per size class.
+ */
+typedef struct pool {
+  arena* source;
+  pool_list free[POOL_CLASSES];
+} pool;
+
+/*
+ * Initializes a pool that carves its blocks out of SOURCE.
+ */
+static inline void pool_init(pool* p, arena* source) {
+  POOL_ASSERT(p != NULL);
+
+  int i;
+
+  p->source = source;
+  for (i = 0; i < POOL_CLASSES; ++i) {
+    SLIST_INIT(&p->free[i]);
+  }
+}
+
+/*
+ * Gets the size class for a request of SIZE bytes, or -1 if it is larger
+ * than POOL_MAX_SIZE.
+ */
+static inline int pool_class(size_t size) {
+  size_t block = POOL_MIN_SIZE;
+  int cls = 0;
+
+  if (size > POOL_MAX_SIZE) {
+    return -1;
+  }
+  while (block < size) {
+    block <<= 1;
+    ++cls;
+  }
+  return cls;
+}
+
+/*
+ * Allocates a block of at least SIZE bytes.  Returns NULL if SIZE is larger
+ * than POOL_MAX_SIZE, or if the class's list is empty and the arena is out of
+ * room.
+ */
+static inline void* pool_alloc(pool* p, size_t size) {
+  POOL_ASSERT(p != NULL);
+
+  int cls = pool_class(size);
+  struct pool_block* block;
+
+  if (cls < 0) {
+    return NULL;
+  }
+  SLIST_POP_FRONT(&p->free[cls], block, link);
+  if (block != NULL) {
+    return block;
+  }
+  return arena_alloc(p->source, POOL_CLASS_SIZE(cls), POOL_MIN_SIZE);
+}
+
+/*
+ * Returns a block of SIZE bytes, as passed to pool_alloc(), to its class's
+ * free list.
+ */
+static inline void pool_free(pool* p, void* ptr, size_t size) {
+  POOL_ASSERT(p != NULL);
+  POOL_ASSERT(ptr != NULL);
+
+  int cls = pool_class(size);
+  struct pool_block* block = (struct pool_block*)ptr;
+
+  POOL_ASSERT(cls >= 0);
+
+  SLIST_ELEM_INIT(block, link);
+  SLIST_PUSH_FRONT(&p->free[cls], block, link);
+}
+
+#endif
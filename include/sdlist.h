@@ -0,0 +1,252 @@
+/*
+ * Implementation of a doubly linked list headed by a sentinel.
+ *
+ * This is dlist with the special cases taken out.  The list itself is a link,
+ * the sentinel, that sits in the ring of elements' links between the back and
+ * the front, so an empty list is the sentinel linked to itself and every
+ * element always has a real neighbor on both sides.  Pushing and removing
+ * never check for an empty list, a lone element or the ends, and popping
+ * only picks between the front element and NULL at the very end, which
+ * compilers turn into a conditional move.
+ *
+ * Links point at links rather than elements, so getting from a link back to
+ * its element takes the element's type, and an element's link doesn't need
+ * the list to be removed.  An element that isn't in a list is linked to
+ * itself.
+ */
+
+#ifndef __CONVOY_SDLIST_H__
+#define __CONVOY_SDLIST_H__
+
+#include <stddef.h>
+
+/*
+ * Used to give macros a void return value.
+ */
+#define SDLIST_VOID ((void)0)
+
+#ifdef SDLIST_ASSERTS
+#include <assert.h>
+#define SDLIST_ASSERT(...) assert(__VA_ARGS__)
+#else
+#define SDLIST_ASSERT(...) SDLIST_VOID
+#endif
+
+/*
+ * A link in a list, either an element's or the sentinel.
+ */
+struct sdlist_link {
+  struct sdlist_link* next;
+  struct sdlist_link* prev;
+};
+
+/*
+ * Declares a new list type.
+ *
+ * Usage:
+ *
+ *   SDLIST_DECLARE(point_deque);
+ */
+#define SDLIST_DECLARE(LIST_TYPE) \
+  typedef struct LIST_TYPE {      \
+    struct sdlist_link head;      \
+  } LIST_TYPE
+
+/*
+ * Declares a link in a struct for use with a list.
+ *
+ * Usage:
+ *
+ *   struct point {
+ *     SDLIST_DECLARE_LINK(linkname);
+ *     int x;
+ *     int y;
+ *   };
+ */
+#define SDLIST_DECLARE_LINK(LINK) struct sdlist_link LINK
+
+/*
+ * Gets the element of type struct ELEM_TYPE that holds the link at address
+ * LINKP, whose name in the struct is LINK.
+ */
+#define SDLIST_ELEM(LINKP, ELEM_TYPE, LINK)    \
+  ((struct ELEM_TYPE*)(void*)((char*)(LINKP) - \
+                              offsetof(struct ELEM_TYPE, LINK)))
+
+/*
+ * Initializes a list.
+ */
+#define SDLIST_INIT(LIST)             \
+  ((LIST)->head.next = &(LIST)->head, \
+   (LIST)->head.prev = &(LIST)->head, \
+                                      \
+   SDLIST_VOID)
+
+/*
+ * Statically initializes a list named NAME.  The sentinel links to itself,
+ * so the initializer needs the list's name.
+ *
+ * Usage:
+ *
+ *   static point_deque deq = SDLIST_STATIC_INIT(deq);
+ */
+#define SDLIST_STATIC_INIT(NAME) \
+  { .head = { .next = &(NAME).head, .prev = &(NAME).head } }
+
+/*
+ * Initializes the list link of an element.
+ */
+#define SDLIST_ELEM_INIT(ELEM, LINK)  \
+  ((ELEM)->LINK.next = &(ELEM)->LINK, \
+   (ELEM)->LINK.prev = &(ELEM)->LINK, \
+                                      \
+   SDLIST_VOID)
+
+/*
+ * Checks if a list is empty.
+ */
+#define SDLIST_IS_EMPTY(LIST) ((LIST)->head.next == &(LIST)->head)
+
+/*
+ * Checks if an element is inserted into a list.
+ *
+ * Does not search any lists, runs in constant time.
+ */
+#define SDLIST_IS_ELEM_INSERTED(ELEM, LINK) \
+  ((ELEM)->LINK.next != &(ELEM)->LINK)
+
+/*
+ * Gets the first element in a list, or NULL if the list is empty.
+ */
+#define SDLIST_PEEK_FRONT(LIST, ELEM_TYPE, LINK) \
+  (SDLIST_IS_EMPTY(LIST) ? NULL                  \
+                         : SDLIST_ELEM((LIST)->head.next, ELEM_TYPE, LINK))
+
+/*
+ * Gets the last element in a list, or NULL if the list is empty.
+ */
+#define SDLIST_PEEK_BACK(LIST, ELEM_TYPE, LINK) \
+  (SDLIST_IS_EMPTY(LIST) ? NULL                 \
+                         : SDLIST_ELEM((LIST)->head.prev, ELEM_TYPE, LINK))
+
+/*
+ * Links the unlinked link NEW in between the adjacent links PREV and NEXT.
+ * PREV and NEXT are only evaluated once, before anything changes.
+ */
+#define SDLIST_SPLICE_(PREV, NEW, NEXT) \
+  ((NEW)->prev = (PREV),                \
+   (NEW)->next = (NEXT),                \
+   (NEW)->prev->next = (NEW),           \
+   (NEW)->next->prev = (NEW),           \
+                                        \
+   SDLIST_VOID)
+
+/*
+ * Unlinks the link L from its neighbors and links it to itself.  Unlinking
+ * the sentinel of an empty list leaves it as it was.
+ */
+#define SDLIST_UNLINK_(L)       \
+  ((L)->prev->next = (L)->next, \
+   (L)->next->prev = (L)->prev, \
+   (L)->next = (L),             \
+   (L)->prev = (L),             \
+                                \
+   SDLIST_VOID)
+
+/*
+ * Inserts an element at the front of a list.
+ */
+#define SDLIST_PUSH_FRONT(LIST, ELEM, LINK)             \
+  (SDLIST_ASSERT(!SDLIST_IS_ELEM_INSERTED(ELEM, LINK)), \
+                                                        \
+   SDLIST_SPLICE_(&(LIST)->head, &(ELEM)->LINK, (LIST)->head.next))
+
+/*
+ * Inserts an element at the back of a list.
+ */
+#define SDLIST_PUSH_BACK(LIST, ELEM, LINK)              \
+  (SDLIST_ASSERT(!SDLIST_IS_ELEM_INSERTED(ELEM, LINK)), \
+                                                        \
+   SDLIST_SPLICE_((LIST)->head.prev, &(ELEM)->LINK, &(LIST)->head))
+
+/*
+ * Inserts a new element NEW after an existing list element INS.
+ */
+#define SDLIST_INSERT_NEXT(INS, NEW, LINK)             \
+  (SDLIST_ASSERT(SDLIST_IS_ELEM_INSERTED(INS, LINK)),  \
+   SDLIST_ASSERT(!SDLIST_IS_ELEM_INSERTED(NEW, LINK)), \
+                                                       \
+   SDLIST_SPLICE_(&(INS)->LINK, &(NEW)->LINK, (INS)->LINK.next))
+
+/*
+ * Inserts a new element NEW before an existing list element INS.
+ */
+#define SDLIST_INSERT_PREV(INS, NEW, LINK)             \
+  (SDLIST_ASSERT(SDLIST_IS_ELEM_INSERTED(INS, LINK)),  \
+   SDLIST_ASSERT(!SDLIST_IS_ELEM_INSERTED(NEW, LINK)), \
+                                                       \
+   SDLIST_SPLICE_((INS)->LINK.prev, &(NEW)->LINK, &(INS)->LINK))
+
+/*
+ * Removes an element ELEM from whatever list it is in.
+ */
+#define SDLIST_REMOVE(ELEM, LINK)                      \
+  (SDLIST_ASSERT(SDLIST_IS_ELEM_INSERTED(ELEM, LINK)), \
+                                                       \
+   SDLIST_UNLINK_(&(ELEM)->LINK))
+
+/*
+ * Unlinks the link L, which is HEAD's next or prev, and returns the address
+ * OFFSET bytes before it, or NULL if L is HEAD itself.
+ */
+static inline void* sdlist_pop_(struct sdlist_link* head,
+                                struct sdlist_link* l,
+                                size_t offset) {
+  SDLIST_UNLINK_(l);
+  return (l == head) ? NULL : (void*)((char*)l - offset);
+}
+
+/*
+ * Pops the first element off of LIST and sets DEST to it, or to NULL if the
+ * list is empty.
+ *
+ * Usage:
+ *
+ *   ELEM_TYPE* var;
+ *   SDLIST_POP_FRONT(list, var, point, linkname);
+ */
+#define SDLIST_POP_FRONT(LIST, DEST, ELEM_TYPE, LINK)                     \
+  ((DEST) = (struct ELEM_TYPE*)sdlist_pop_(                               \
+     &(LIST)->head, (LIST)->head.next, offsetof(struct ELEM_TYPE, LINK)), \
+                                                                          \
+   SDLIST_VOID)
+
+/*
+ * Pops the last element off of LIST and sets DEST to it, or to NULL if the
+ * list is empty.
+ */
+#define SDLIST_POP_BACK(LIST, DEST, ELEM_TYPE, LINK)                      \
+  ((DEST) = (struct ELEM_TYPE*)sdlist_pop_(                               \
+     &(LIST)->head, (LIST)->head.prev, offsetof(struct ELEM_TYPE, LINK)), \
+                                                                          \
+   SDLIST_VOID)
+
+/*
+ * Iterates through all elements of a list.
+ *
+ * CURR will hold the address of the element currently being iterated over.
+ * BODY is the code fragment to execute on each iteration, and may not remove
+ * CURR.
+ */
+#define SDLIST_FOREACH(CURR, LIST, ELEM_TYPE, LINK, BODY)   \
+  {                                                         \
+    struct sdlist_link* link_;                              \
+                                                            \
+    for (link_ = (LIST)->head.next; link_ != &(LIST)->head; \
+         link_ = link_->next) {                             \
+      (CURR) = SDLIST_ELEM(link_, ELEM_TYPE, LINK);         \
+      BODY;                                                 \
+    }                                                       \
+  }
+
+#endif
@@ -13,12 +13,75 @@
 #define SLIST_ASSERT(...) SLIST_VOID
 #endif
 
+/*
+ * USDT probes, for bpftrace, perf or SystemTap to attach to in a running
+ * process.  Define CONVOY_USDT to compile them in where sys/sdt.h is
+ * available; otherwise they compile to nothing.  An unattached probe is a
+ * single nop.  See tools/usdt/lists.bt.
+ *
+ *   convoy:slist_push(list, elem)  an element was pushed onto either end
+ *   convoy:slist_pop(list, elem)   an element, or NULL, was popped off
+ */
+#if defined(CONVOY_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+
+static inline void slist_probe_push_(const void* list, const void* elem) {
+  DTRACE_PROBE2(convoy, slist_push, list, elem);
+}
+
+static inline void slist_probe_pop_(const void* list, const void* elem) {
+  DTRACE_PROBE2(convoy, slist_pop, list, elem);
+}
+
+#define SLIST_PROBE_PUSH(LIST, ELEM) slist_probe_push_((LIST), (ELEM))
+#define SLIST_PROBE_POP(LIST, ELEM) slist_probe_pop_((LIST), (ELEM))
+#endif
+#endif
+
+#ifndef SLIST_PROBE_PUSH
+#define SLIST_PROBE_PUSH(LIST, ELEM) SLIST_VOID
+#define SLIST_PROBE_POP(LIST, ELEM) SLIST_VOID
+#endif
+
 #include <stddef.h>
+#include <stdint.h>
+
+/*
+ * When SLIST_COUNTED is defined, every list also keeps a count of its
+ * elements, so SLIST_COUNT() and SLIST_FOOTPRINT() run in O(1) time.
+ */
+#ifdef SLIST_COUNTED
+#define SLIST_COUNT_FIELD size_t count;
+#define SLIST_COUNT_STATIC_INIT .count = 0,
+#define SLIST_COUNT_RESET(LIST) ((LIST)->count = 0)
+#define SLIST_COUNT_ADD(LIST, N) ((LIST)->count += (N))
+#define SLIST_COUNT_SUB(LIST, N) ((LIST)->count -= (N))
+
+/*
+ * Gets the number of elements in a list.
+ */
+#define SLIST_COUNT(LIST) ((LIST)->count)
+
+/*
+ * Gets the number of bytes taken up by a list and its elements, counting
+ * each element as sizeof(*(LIST)->front).
+ */
+#define SLIST_FOOTPRINT(LIST) \
+  (sizeof(*(LIST)) + (LIST)->count * sizeof(*(LIST)->front))
+#else
+#define SLIST_COUNT_FIELD
+#define SLIST_COUNT_STATIC_INIT
+#define SLIST_COUNT_RESET(LIST) SLIST_VOID
+#define SLIST_COUNT_ADD(LIST, N) SLIST_VOID
+#define SLIST_COUNT_SUB(LIST, N) SLIST_VOID
+#endif
 
 /*
  * Declares a new list type.
  *
- * ELEM_TYPE must be the name of a struct type with a declared link.
+ * ELEM_TYPE must be the name of a struct type with a declared link.  When
+ * SLIST_COUNTED is defined, the list also carries a size_t named count.
  *
  * Usage:
  *
@@ -29,6 +92,7 @@
   typedef struct LIST_TYPE {                \
     struct ELEM_TYPE* front;                \
     struct ELEM_TYPE* back;                 \
+    SLIST_COUNT_FIELD                       \
   } LIST_TYPE
 
 /*
@@ -49,17 +113,18 @@
 /*
  * Initializes a list.
  */
-#define SLIST_INIT(LIST) \
-  ((LIST)->front = NULL, \
-   (LIST)->back = NULL,  \
-                         \
+#define SLIST_INIT(LIST)    \
+  ((LIST)->front = NULL,    \
+   (LIST)->back = NULL,     \
+   SLIST_COUNT_RESET(LIST), \
+                            \
    SLIST_VOID)
 
 /*
  * Statically initializes a list.
  */
 #define SLIST_STATIC_INIT \
-  { .front = NULL, .back = NULL, }
+  { .front = NULL, .back = NULL, SLIST_COUNT_STATIC_INIT }
 
 /*
  * Initializes the list link of an element.
@@ -136,6 +201,7 @@
                                   (LIST)->front = NULL,                       \
                                   (LIST)->back = NULL,                        \
                                                                               \
+                                  SLIST_COUNT_SUB(LIST, 1),                   \
                                   /* Clean up the old node's link. */         \
                                   SLIST_ELEM_INIT(DEST, LINK))                \
                                : ((DEST) = (LIST)->front,                     \
@@ -146,8 +212,40 @@
                                   /* Make the back point to the new front. */ \
                                   (LIST)->back->LINK = (LIST)->front,         \
                                                                               \
+                                  SLIST_COUNT_SUB(LIST, 1),                   \
                                   /* Clean up the old node's link. */         \
-                                  SLIST_ELEM_INIT(DEST, LINK)))
+                                  SLIST_ELEM_INIT(DEST, LINK)),               \
+                                                                              \
+   SLIST_PROBE_POP(LIST, DEST))
+
+/*
+ * Pops the element after PREV, an element of LIST, off of it and sets DEST
+ * to it.  In a list of one element, that is PREV itself.
+ *
+ * Usage:
+ *
+ *   ELEM_TYPE* var;
+ *   SLIST_POP_NEXT(list, prev, var, linkname);
+ */
+#define SLIST_POP_NEXT(LIST, PREV, DEST, LINK)                             \
+  (SLIST_CHECK(LIST, LINK),                                                \
+   SLIST_ASSERT(SLIST_IS_ELEM_INSERTED(PREV, LINK)),                       \
+                                                                           \
+   (DEST) = (PREV)->LINK,                                                  \
+   ((DEST) == (PREV))                                                      \
+     ? ((LIST)->front = NULL,                                              \
+        (LIST)->back = NULL)                                               \
+     : ((PREV)->LINK = (DEST)->LINK,                                       \
+                                                                           \
+        /* Move the ends off of DEST, if it was one. */                    \
+        ((LIST)->front == (DEST)) ? ((LIST)->front = (DEST)->LINK) : NULL, \
+        ((LIST)->back == (DEST)) ? ((LIST)->back = (PREV)) : NULL),        \
+                                                                           \
+   SLIST_COUNT_SUB(LIST, 1),                                               \
+   /* Clean up the old node's link. */                                     \
+   SLIST_ELEM_INIT(DEST, LINK),                                            \
+                                                                           \
+   SLIST_PROBE_POP(LIST, DEST))
 
 /*
  * Pushes an element onto the front of a list.
@@ -171,6 +269,9 @@
    /* Update the back to point to the new front. */         \
    (LIST)->back->LINK = (LIST)->front,                      \
                                                             \
+   SLIST_COUNT_ADD(LIST, 1),                                \
+   SLIST_PROBE_PUSH(LIST, ELEM),                            \
+                                                            \
    SLIST_VOID)
 
 /*
@@ -195,8 +296,51 @@
    /* Update the new back to point to the front. */        \
    (LIST)->back->LINK = (LIST)->front,                     \
                                                            \
+   SLIST_COUNT_ADD(LIST, 1),                               \
+   SLIST_PROBE_PUSH(LIST, ELEM),                           \
+                                                           \
    SLIST_VOID)
 
+/*
+ * Rotates a list forward by one, so that its front becomes its back.  Since
+ * the list is circular, this only moves the list's ends, and no links.
+ */
+#define SLIST_ROTATE_FORWARD(LIST, LINK)                                  \
+  (SLIST_CHECK(LIST, LINK),                                               \
+                                                                          \
+   /* An empty list's back is NULL like its front, so always store it. */ \
+   (LIST)->back = (LIST)->front,                                          \
+   ((LIST)->back != NULL) ? ((LIST)->front = (LIST)->back->LINK) : NULL,  \
+                                                                          \
+   SLIST_VOID)
+
+/*
+ * Rotates a list so that ELEM, one of its elements, is its back, and the
+ * element after it its front.  This only moves the list's ends, and no links.
+ */
+#define SLIST_ROTATE_AFTER(LIST, ELEM, LINK)         \
+  (SLIST_CHECK(LIST, LINK),                          \
+   SLIST_ASSERT(SLIST_IS_ELEM_INSERTED(ELEM, LINK)), \
+                                                     \
+   (LIST)->back = (ELEM),                            \
+   (LIST)->front = (ELEM)->LINK,                     \
+                                                     \
+   SLIST_VOID)
+
+/*
+ * Sets DEST to the front of a list and rotates it to the back, to take turns
+ * among a list's elements without popping and pushing them.  Sets DEST to
+ * NULL if the list is empty.
+ *
+ * Usage:
+ *
+ *   ELEM_TYPE* var;
+ *   SLIST_ROUND_ROBIN(list, var, linkname);
+ */
+#define SLIST_ROUND_ROBIN(LIST, DEST, LINK) \
+  ((DEST) = (LIST)->front,                  \
+   SLIST_ROTATE_FORWARD(LIST, LINK))
+
 /*
  * Iterates through all elements of a list.
  *
@@ -221,8 +365,221 @@
   }
 
 /*
- * Checks the validity of a list.
+ * Measures the number of bytes taken up by a list and its elements, as
+ * sizeof(*(LIST)) plus FN(CURR) for every element, and sets DEST to it.  FN
+ * should count anything the element owns along with the element itself.
+ *
+ * CURR will hold the address of the element currently being measured.
+ *
+ * Usage:
+ *
+ *   size_t bytes;
+ *   ELEM_TYPE* var;
+ *   SLIST_FOOTPRINT_DEEP(bytes, var, list, linkname, elem_size);
+ */
+#define SLIST_FOOTPRINT_DEEP(DEST, CURR, LIST, LINK, FN) \
+  {                                                      \
+    (DEST) = sizeof(*(LIST));                            \
+    SLIST_FOREACH(CURR, LIST, LINK, (DEST) += FN(CURR)); \
+  }
+
+/*
+ * Sorts a list by an unsigned integer key of up to 64 bits, in place.
+ *
+ * This is an LSD radix sort: every pass deals the elements out by one byte of
+ * their keys into 256 bucket chains strung through their links, and then
+ * strings the chains back together.  It is stable, allocates nothing beyond
+ * the buckets on the stack, and runs in O(n) time per pass.  Bytes that are
+ * the same in every key are skipped, so e.g. 64-bit keys that all fit in 24
+ * bits take 3 passes.
+ *
+ * ELEM_TYPE is the name of the elements' struct type.  KEY is a function or
+ * macro that takes an element and returns its key, and is called once per
+ * element per pass plus once more.
+ *
+ * Usage:
+ *
+ *   #define EXPIRY(TIMER) ((TIMER)->expiry)
+ *   SLIST_RADIX_SORT(list, timer, linkname, EXPIRY);
+ */
+#define SLIST_RADIX_SORT(LIST, ELEM_TYPE, LINK, KEY)                         \
+  {                                                                          \
+    struct ELEM_TYPE* heads_[256];                                           \
+    struct ELEM_TYPE* tails_[256];                                           \
+    struct ELEM_TYPE* curr_;                                                 \
+    struct ELEM_TYPE* back_;                                                 \
+    uint64_t ones_ = 0;                                                      \
+    uint64_t alls_ = ~(uint64_t)0;                                           \
+    uint64_t key_;                                                           \
+    unsigned shift_;                                                         \
+    unsigned byte_;                                                          \
+                                                                             \
+    SLIST_CHECK(LIST, LINK);                                                 \
+    if (!SLIST_IS_EMPTY(LIST)) {                                             \
+      /* Cut the circle, and find the bits that differ between keys. */      \
+      (LIST)->back->LINK = NULL;                                             \
+      for (curr_ = (LIST)->front; curr_ != NULL; curr_ = curr_->LINK) {      \
+        key_ = (uint64_t)KEY(curr_);                                         \
+        ones_ |= key_;                                                       \
+        alls_ &= key_;                                                       \
+      }                                                                      \
+      ones_ ^= alls_;                                                        \
+                                                                             \
+      for (shift_ = 0; shift_ < 64 && (ones_ >> shift_) != 0; shift_ += 8) { \
+        if (((ones_ >> shift_) & 0xff) == 0) {                               \
+          continue;                                                          \
+        }                                                                    \
+                                                                             \
+        for (byte_ = 0; byte_ < 256; ++byte_) {                              \
+          heads_[byte_] = NULL;                                              \
+        }                                                                    \
+        for (curr_ = (LIST)->front; curr_ != NULL; curr_ = curr_->LINK) {    \
+          byte_ = (unsigned)(((uint64_t)KEY(curr_) >> shift_) & 0xff);       \
+          if (heads_[byte_] == NULL) {                                       \
+            heads_[byte_] = curr_;                                           \
+          } else {                                                           \
+            tails_[byte_]->LINK = curr_;                                     \
+          }                                                                  \
+          tails_[byte_] = curr_;                                             \
+        }                                                                    \
+                                                                             \
+        back_ = NULL;                                                        \
+        for (byte_ = 0; byte_ < 256; ++byte_) {                              \
+          if (heads_[byte_] != NULL) {                                       \
+            if (back_ == NULL) {                                             \
+              (LIST)->front = heads_[byte_];                                 \
+            } else {                                                         \
+              back_->LINK = heads_[byte_];                                   \
+            }                                                                \
+            back_ = tails_[byte_];                                           \
+          }                                                                  \
+        }                                                                    \
+        back_->LINK = NULL;                                                  \
+        (LIST)->back = back_;                                                \
+      }                                                                      \
+                                                                             \
+      /* Close the circle again. */                                          \
+      (LIST)->back->LINK = (LIST)->front;                                    \
+    }                                                                        \
+  }
+
+/*
+ * Removes every element of a list for which PRED holds, in one pass, and
+ * calls ON_REMOVE on each one after unlinking it, so ON_REMOVE may free it.
+ * The survivors keep their order, and the ends and circular link are fixed
+ * up once at the end.
+ *
+ * ELEM_TYPE is the name of the elements' struct type.  PRED and ON_REMOVE
+ * are functions or macros that take an element.
+ *
+ * Usage:
+ *
+ *   #define EXPIRED(TIMER) ((TIMER)->expiry <= now)
+ *   SLIST_REMOVE_IF(list, timer, linkname, EXPIRED, free);
  */
+#define SLIST_REMOVE_IF(LIST, ELEM_TYPE, LINK, PRED, ON_REMOVE)   \
+  {                                                               \
+    struct ELEM_TYPE* curr_;                                      \
+    struct ELEM_TYPE* next_;                                      \
+    struct ELEM_TYPE* back_ = NULL;                               \
+                                                                  \
+    SLIST_CHECK(LIST, LINK);                                      \
+    if (!SLIST_IS_EMPTY(LIST)) {                                  \
+      /* Cut the circle, and relink the survivors as we go. */    \
+      (LIST)->back->LINK = NULL;                                  \
+      for (curr_ = (LIST)->front; curr_ != NULL; curr_ = next_) { \
+        next_ = curr_->LINK;                                      \
+        if (PRED(curr_)) {                                        \
+          SLIST_ELEM_INIT(curr_, LINK);                           \
+          SLIST_COUNT_SUB(LIST, 1);                               \
+          ON_REMOVE(curr_);                                       \
+        } else {                                                  \
+          if (back_ == NULL) {                                    \
+            (LIST)->front = curr_;                                \
+          } else {                                                \
+            back_->LINK = curr_;                                  \
+          }                                                       \
+          back_ = curr_;                                          \
+        }                                                         \
+      }                                                           \
+                                                                  \
+      /* Close the circle again, if anything is left. */          \
+      if (back_ != NULL) {                                        \
+        back_->LINK = (LIST)->front;                              \
+      } else {                                                    \
+        (LIST)->front = NULL;                                     \
+      }                                                           \
+      (LIST)->back = back_;                                       \
+    }                                                             \
+  }
+
+/*
+ * Moves every element of LIST for which PRED holds onto the back of DEST, in
+ * one pass.  The elements keep their order in both lists, and the ends and
+ * circular links of both are fixed up once at the end.
+ *
+ * ELEM_TYPE is the name of the elements' struct type.  PRED is a function or
+ * macro that takes an element.
+ *
+ * Usage:
+ *
+ *   #define IS_URGENT(PKT) ((PKT)->prio > 7)
+ *   SLIST_PARTITION(list, urgent, packet, linkname, IS_URGENT);
+ */
+#define SLIST_PARTITION(LIST, DEST, ELEM_TYPE, LINK, PRED)        \
+  {                                                               \
+    struct ELEM_TYPE* curr_;                                      \
+    struct ELEM_TYPE* next_;                                      \
+    struct ELEM_TYPE* back_ = NULL;                               \
+    struct ELEM_TYPE* moved_;                                     \
+                                                                  \
+    SLIST_CHECK(LIST, LINK);                                      \
+    SLIST_CHECK(DEST, LINK);                                      \
+    SLIST_ASSERT((LIST) != (DEST));                               \
+    if (!SLIST_IS_EMPTY(LIST)) {                                  \
+      /* Cut both circles, and deal the elements out as we go. */ \
+      (LIST)->back->LINK = NULL;                                  \
+      moved_ = (DEST)->back;                                      \
+      for (curr_ = (LIST)->front; curr_ != NULL; curr_ = next_) { \
+        next_ = curr_->LINK;                                      \
+        if (PRED(curr_)) {                                        \
+          if (moved_ == NULL) {                                   \
+            (DEST)->front = curr_;                                \
+          } else {                                                \
+            moved_->LINK = curr_;                                 \
+          }                                                       \
+          moved_ = curr_;                                         \
+          SLIST_COUNT_SUB(LIST, 1);                               \
+          SLIST_COUNT_ADD(DEST, 1);                               \
+        } else {                                                  \
+          if (back_ == NULL) {                                    \
+            (LIST)->front = curr_;                                \
+          } else {                                                \
+            back_->LINK = curr_;                                  \
+          }                                                       \
+          back_ = curr_;                                          \
+        }                                                         \
+      }                                                           \
+                                                                  \
+      /* Close both circles again, where anything is left. */     \
+      if (back_ != NULL) {                                        \
+        back_->LINK = (LIST)->front;                              \
+      } else {                                                    \
+        (LIST)->front = NULL;                                     \
+      }                                                           \
+      (LIST)->back = back_;                                       \
+      if (moved_ != NULL) {                                       \
+        moved_->LINK = (DEST)->front;                             \
+      }                                                           \
+      (DEST)->back = moved_;                                      \
+    }                                                             \
+  }
+
+/*
+ * Checks the validity of a list.  Without SLIST_ASSERTS this is a no-op, so
+ * that it doesn't leave behind an expression with no effect.
+ */
+#ifdef SLIST_ASSERTS
 #define SLIST_CHECK(LIST, LINK)                               \
   (((LIST)->front == NULL || (LIST)->back == NULL)            \
      ? (SLIST_ASSERT((LIST)->front == NULL),                  \
@@ -233,5 +590,8 @@
        ? (SLIST_ASSERT((LIST)->front == (LIST)->back),        \
           SLIST_ASSERT((LIST)->front->LINK == (LIST)->front)) \
        : (SLIST_VOID))
+#else
+#define SLIST_CHECK(LIST, LINK) SLIST_VOID
+#endif
 
 #endif
@@ -0,0 +1,618 @@
+/*
+ * Implementation of a set of 32-bit unsigned integers stored as a sorted
+ * array.  The set does not own its storage, the caller hands it a buffer and
+ * its capacity with SORTSET_INIT().
+ *
+ * Sorted sets are meant for static or rarely-changing collections of ids,
+ * where they cost 4 bytes per key instead of a full node.  Intersections and
+ * unions run on SSE4.1 or AVX2 when the compiler targets them, and otherwise
+ * fall back to scalar merges.
+ */
+
+#ifndef __CONVOY_SORTSET_H__
+#define __CONVOY_SORTSET_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Used to give macros a void return value.
+ */
+#define SORTSET_VOID ((void)0)
+
+#ifdef SORTSET_ASSERTS
+#include <assert.h>
+#define SORTSET_ASSERT(...) assert(__VA_ARGS__)
+#else
+#define SORTSET_ASSERT(...) SORTSET_VOID
+#endif
+
+/*
+ * When one input is at least this many times larger than the other, set
+ * operations gallop through the larger input instead of merging.
+ */
+#ifndef SORTSET_GALLOP_RATIO
+#define SORTSET_GALLOP_RATIO 32
+#endif
+
+/*
+ * A sorted set of unique 32-bit ids.
+ */
+typedef struct sortset {
+  uint32_t* ids;
+  size_t len;
+  size_t cap;
+} sortset;
+
+/*
+ * Initializes a sorted set over the buffer BUF, which has room for CAP ids.
+ */
+#define SORTSET_INIT(SET, BUF, CAP) \
+  ((SET)->ids = (BUF),              \
+   (SET)->len = 0,                  \
+   (SET)->cap = (CAP),              \
+                                    \
+   SORTSET_VOID)
+
+/*
+ * Statically initializes a sorted set.
+ */
+#define SORTSET_STATIC_INIT(BUF, CAP) \
+  { .ids = (BUF), .len = 0, .cap = (CAP) }
+
+/*
+ * Checks whether a sorted set is empty.
+ */
+#define SORTSET_IS_EMPTY(SET) ((SET)->len == 0)
+
+/*
+ * Fills a sorted set from the keys of a splat tree of type SPLAT_TYPE, which
+ * needs a SORTSET_SPLAT_LIB().
+ *
+ * The tree is walked in order by its _walk(), so this takes no extra space
+ * and leaves the tree exactly as it found it.  Keys must be non-negative and
+ * fit in 32 bits.  If the set runs out of room the remaining keys are
+ * dropped, but the walk still finishes so the tree is restored.
+ *
+ * Usage:
+ *
+ *   SORTSET_FROM_SPLAT(&set, &tree, splat);
+ */
+#define SORTSET_FROM_SPLAT(SET, TREE, SPLAT_TYPE) \
+  ((SET)->len = 0,                                \
+   SPLAT_TYPE##_walk((TREE), SPLAT_TYPE##_sortset_append_, (SET)))
+
+/*
+ * Appends an id to the end of a sorted set.
+ *
+ * ID must be greater than every id already in the set.  Returns false if the
+ * set is full.
+ */
+static inline bool sortset_append(sortset* set, uint32_t id) {
+  SORTSET_ASSERT(set != NULL);
+  SORTSET_ASSERT(set->len == 0 || set->ids[set->len - 1] < id);
+
+  if (set->len == set->cap) {
+    return false;
+  }
+  set->ids[set->len++] = id;
+  return true;
+}
+
+/*
+ * Defines the callback that SORTSET_FROM_SPLAT() hands to the _walk() of a
+ * splat tree of type SPLAT_TYPE.
+ *
+ * Usage:
+ *
+ *   SPLAT_LIB(splat, block, int, CMP, link, key)
+ *   SORTSET_SPLAT_LIB(splat, block, key)
+ */
+#define SORTSET_SPLAT_LIB(SPLAT_TYPE, ELEM_TYPE, KEY)              \
+  static void SPLAT_TYPE##_sortset_append_(struct ELEM_TYPE* elem, \
+                                           size_t depth,           \
+                                           void* set) {            \
+    (void)depth;                                                   \
+    sortset_append((sortset*)set, (uint32_t)elem->KEY);            \
+  }
+
+static inline int sortset_cmp_(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*)a;
+  uint32_t y = *(const uint32_t*)b;
+
+  return (x > y) - (x < y);
+}
+
+/*
+ * Fills a sorted set from an unordered array of ids, dropping duplicates.
+ *
+ * At most the set's capacity worth of ids are copied out of SRC.  Returns the
+ * new length of the set.
+ */
+static inline size_t sortset_from_array(sortset* set,
+                                        const uint32_t* src,
+                                        size_t n) {
+  SORTSET_ASSERT(set != NULL);
+  SORTSET_ASSERT(src != NULL || n == 0);
+
+  size_t i;
+  size_t len = 0;
+
+  if (n > set->cap) {
+    n = set->cap;
+  }
+  for (i = 0; i < n; ++i) {
+    set->ids[i] = src[i];
+  }
+  qsort(set->ids, n, sizeof(*set->ids), sortset_cmp_);
+
+  for (i = 0; i < n; ++i) {
+    if (len == 0 || set->ids[len - 1] != set->ids[i]) {
+      set->ids[len++] = set->ids[i];
+    }
+  }
+  set->len = len;
+  return len;
+}
+
+/*
+ * Finds the index of the first id not less than KEY, starting the search at
+ * index LO.  Returns LEN if there is no such id.
+ *
+ * The search doubles its stride until it overshoots and then binary searches
+ * the last stride, so it costs O(log d) where d is the distance moved.
+ */
+static inline size_t sortset_gallop(const uint32_t* ids,
+                                    size_t len,
+                                    size_t lo,
+                                    uint32_t key) {
+  size_t step = 1;
+  size_t hi;
+
+  if (lo >= len || ids[lo] >= key) {
+    return lo;
+  }
+
+  /* ids[lo] < key holds throughout. */
+  hi = lo + step;
+  while (hi < len && ids[hi] < key) {
+    lo = hi;
+    step <<= 1;
+    hi = lo + step;
+  }
+  if (hi > len) {
+    hi = len;
+  }
+
+  /* Binary search in (lo, hi]. */
+  while (lo + 1 < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (ids[mid] < key) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return hi;
+}
+
+/*
+ * Checks whether a sorted set contains an id.
+ */
+static inline bool sortset_contains(const sortset* set, uint32_t id) {
+  SORTSET_ASSERT(set != NULL);
+
+  size_t i = sortset_gallop(set->ids, set->len, 0, id);
+  return i < set->len && set->ids[i] == id;
+}
+
+/*
+ * Intersects a small array with a much larger one by galloping through the
+ * larger array.  Returns the number of ids written to OUT.
+ */
+static inline size_t sortset_intersect_gallop_(uint32_t* out,
+                                               const uint32_t* small,
+                                               size_t ns,
+                                               const uint32_t* large,
+                                               size_t nl) {
+  size_t i;
+  size_t j = 0;
+  size_t o = 0;
+
+  for (i = 0; i < ns && j < nl; ++i) {
+    j = sortset_gallop(large, nl, j, small[i]);
+    if (j < nl && large[j] == small[i]) {
+      out[o++] = small[i];
+    }
+  }
+  return o;
+}
+
+/*
+ * Intersects two arrays with a plain merge, starting at indices I and J and
+ * writing at index O.  Returns the new output length.
+ */
+static inline size_t sortset_intersect_merge_(uint32_t* out,
+                                              size_t o,
+                                              const uint32_t* a,
+                                              size_t i,
+                                              size_t na,
+                                              const uint32_t* b,
+                                              size_t j,
+                                              size_t nb) {
+  while (i < na && j < nb) {
+    if (a[i] < b[j]) {
+      ++i;
+    } else if (a[i] > b[j]) {
+      ++j;
+    } else {
+      out[o++] = a[i];
+      ++i;
+      ++j;
+    }
+  }
+  return o;
+}
+
+#if defined(__AVX2__)
+
+/*
+ * Intersects blocks of 8 ids at a time, comparing every id of a block of A
+ * against every rotation of a block of B.
+ */
+static inline size_t sortset_intersect_simd_(uint32_t* out,
+                                             const uint32_t* a,
+                                             size_t na,
+                                             const uint32_t* b,
+                                             size_t nb) {
+  const __m256i rot1 = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+  const __m256i rot2 = _mm256_setr_epi32(2, 3, 4, 5, 6, 7, 0, 1);
+  const __m256i rot3 = _mm256_setr_epi32(3, 4, 5, 6, 7, 0, 1, 2);
+  const __m256i rot4 = _mm256_setr_epi32(4, 5, 6, 7, 0, 1, 2, 3);
+  size_t i = 0;
+  size_t j = 0;
+  size_t o = 0;
+
+  while (i + 8 <= na && j + 8 <= nb) {
+    __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i*)(b + j));
+    __m256i vb4 = _mm256_permutevar8x32_epi32(vb, rot4);
+    __m256i eq = _mm256_or_si256(
+      _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi32(va, vb),
+                        _mm256_cmpeq_epi32(
+                          va, _mm256_permutevar8x32_epi32(vb, rot1))),
+        _mm256_or_si256(
+          _mm256_cmpeq_epi32(va, _mm256_permutevar8x32_epi32(vb, rot2)),
+          _mm256_cmpeq_epi32(va, _mm256_permutevar8x32_epi32(vb, rot3)))),
+      _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi32(va, vb4),
+                        _mm256_cmpeq_epi32(
+                          va, _mm256_permutevar8x32_epi32(vb4, rot1))),
+        _mm256_or_si256(
+          _mm256_cmpeq_epi32(va, _mm256_permutevar8x32_epi32(vb4, rot2)),
+          _mm256_cmpeq_epi32(va, _mm256_permutevar8x32_epi32(vb4, rot3)))));
+    unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(eq));
+    uint32_t amax = a[i + 7];
+    uint32_t bmax = b[j + 7];
+
+    while (mask != 0) {
+      out[o++] = a[i + (size_t)__builtin_ctz(mask)];
+      mask &= mask - 1;
+    }
+
+    /* Advance whichever block ends first, or both if they end together. */
+    i += (amax <= bmax) ? 8 : 0;
+    j += (bmax <= amax) ? 8 : 0;
+  }
+
+  return sortset_intersect_merge_(out, o, a, i, na, b, j, nb);
+}
+
+#elif defined(__SSE4_1__)
+
+/*
+ * Intersects blocks of 4 ids at a time, comparing every id of a block of A
+ * against every rotation of a block of B.
+ */
+static inline size_t sortset_intersect_simd_(uint32_t* out,
+                                             const uint32_t* a,
+                                             size_t na,
+                                             const uint32_t* b,
+                                             size_t nb) {
+  size_t i = 0;
+  size_t j = 0;
+  size_t o = 0;
+
+  while (i + 4 <= na && j + 4 <= nb) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+    __m128i eq = _mm_or_si128(
+      _mm_or_si128(
+        _mm_cmpeq_epi32(va, vb),
+        _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+      _mm_or_si128(
+        _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+        _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+    unsigned mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(eq));
+    uint32_t amax = a[i + 3];
+    uint32_t bmax = b[j + 3];
+
+    while (mask != 0) {
+      out[o++] = a[i + (size_t)__builtin_ctz(mask)];
+      mask &= mask - 1;
+    }
+
+    /* Advance whichever block ends first, or both if they end together. */
+    i += (amax <= bmax) ? 4 : 0;
+    j += (bmax <= amax) ? 4 : 0;
+  }
+
+  return sortset_intersect_merge_(out, o, a, i, na, b, j, nb);
+}
+
+#endif
+
+/*
+ * Intersects two sorted sets, storing the result in DST.
+ *
+ * DST must have room for the smaller of the two inputs, and may be the same
+ * set as A or B.  Returns the length of the result.
+ */
+static inline size_t sortset_intersect(sortset* dst,
+                                       const sortset* a,
+                                       const sortset* b) {
+  SORTSET_ASSERT(dst != NULL);
+  SORTSET_ASSERT(a != NULL);
+  SORTSET_ASSERT(b != NULL);
+  SORTSET_ASSERT(dst->cap >= (a->len < b->len ? a->len : b->len));
+
+  const uint32_t* ai = a->ids;
+  const uint32_t* bi = b->ids;
+  size_t na = a->len;
+  size_t nb = b->len;
+
+  if (na * SORTSET_GALLOP_RATIO <= nb) {
+    dst->len = sortset_intersect_gallop_(dst->ids, ai, na, bi, nb);
+  } else if (nb * SORTSET_GALLOP_RATIO <= na) {
+    dst->len = sortset_intersect_gallop_(dst->ids, bi, nb, ai, na);
+  } else {
+#if defined(__AVX2__) || defined(__SSE4_1__)
+    dst->len = sortset_intersect_simd_(dst->ids, ai, na, bi, nb);
+#else
+    dst->len = sortset_intersect_merge_(dst->ids, 0, ai, 0, na, bi, 0, nb);
+#endif
+  }
+  return dst->len;
+}
+
+/*
+ * Appends an id to OUT unless it repeats the last id written.
+ */
+#define SORTSET_EMIT_(OUT, O, ID)           \
+  do {                                      \
+    if ((O) == 0 || (OUT)[(O)-1] != (ID)) { \
+      (OUT)[(O)++] = (ID);                  \
+    }                                       \
+  } while (0)
+
+/*
+ * Merges up to three sorted runs into OUT, dropping duplicates.  Returns the
+ * new output length.
+ */
+static inline size_t sortset_union_merge_(uint32_t* out,
+                                          size_t o,
+                                          const uint32_t* a,
+                                          size_t na,
+                                          const uint32_t* b,
+                                          size_t nb,
+                                          const uint32_t* c,
+                                          size_t nc) {
+  size_t i = 0;
+  size_t j = 0;
+  size_t k = 0;
+
+  while (i < na || j < nb || k < nc) {
+    uint32_t id = UINT32_MAX;
+    if (i < na && a[i] <= id) {
+      id = a[i];
+    }
+    if (j < nb && b[j] <= id) {
+      id = b[j];
+    }
+    if (k < nc && c[k] <= id) {
+      id = c[k];
+    }
+
+    i += (i < na && a[i] == id);
+    j += (j < nb && b[j] == id);
+    k += (k < nc && c[k] == id);
+
+    SORTSET_EMIT_(out, o, id);
+  }
+  return o;
+}
+
+#if defined(__SSE4_1__)
+
+/*
+ * Merges two sorted vectors with a bitonic network, leaving the four smallest
+ * ids in *LO and the four largest in *HI, both sorted.
+ */
+static inline void sortset_merge4_(__m128i a,
+                                   __m128i b,
+                                   __m128i* lo,
+                                   __m128i* hi) {
+  __m128i tmp = _mm_min_epu32(a, b);
+  __m128i max = _mm_max_epu32(a, b);
+  __m128i min;
+
+  tmp = _mm_alignr_epi8(tmp, tmp, 4);
+  min = _mm_min_epu32(tmp, max);
+  max = _mm_max_epu32(tmp, max);
+  tmp = _mm_alignr_epi8(min, min, 4);
+  min = _mm_min_epu32(tmp, max);
+  max = _mm_max_epu32(tmp, max);
+  tmp = _mm_alignr_epi8(min, min, 4);
+  min = _mm_min_epu32(tmp, max);
+  max = _mm_max_epu32(tmp, max);
+
+  *lo = _mm_alignr_epi8(min, min, 4);
+  *hi = max;
+}
+
+/*
+ * Unions two arrays 4 ids at a time, always feeding the merge network the
+ * next block from whichever input has the smaller head.
+ */
+static inline size_t sortset_union_simd_(uint32_t* out,
+                                         const uint32_t* a,
+                                         size_t na,
+                                         const uint32_t* b,
+                                         size_t nb) {
+  uint32_t held[4];
+  __m128i lo;
+  __m128i hi;
+  size_t i = 4;
+  size_t j = 4;
+  size_t o = 0;
+  size_t n;
+
+  if (na < 4 || nb < 4) {
+    return sortset_union_merge_(out, 0, a, na, b, nb, NULL, 0);
+  }
+
+  sortset_merge4_(_mm_loadu_si128((const __m128i*)a),
+                  _mm_loadu_si128((const __m128i*)b),
+                  &lo,
+                  &hi);
+  for (;;) {
+    _mm_storeu_si128((__m128i*)held, lo);
+    for (n = 0; n < 4; ++n) {
+      SORTSET_EMIT_(out, o, held[n]);
+    }
+
+    /*
+     * Stop as soon as the input with the smaller head can't supply a full
+     * block, otherwise its tail could be emitted out of order.
+     */
+    __m128i next;
+    if (i < na && (j == nb || a[i] <= b[j])) {
+      if (i + 4 > na) {
+        break;
+      }
+      next = _mm_loadu_si128((const __m128i*)(a + i));
+      i += 4;
+    } else if (j < nb) {
+      if (j + 4 > nb) {
+        break;
+      }
+      next = _mm_loadu_si128((const __m128i*)(b + j));
+      j += 4;
+    } else {
+      break;
+    }
+    sortset_merge4_(next, hi, &lo, &hi);
+  }
+
+  /*
+   * The held block may be interleaved with what is left of both inputs, but
+   * everything emitted so far is below all of it.
+   */
+  _mm_storeu_si128((__m128i*)held, hi);
+  return sortset_union_merge_(out, o, held, 4, a + i, na - i, b + j, nb - j);
+}
+
+#endif
+
+/*
+ * Unions two sorted sets, storing the result in DST.
+ *
+ * DST must have room for both inputs combined, and must not be the same set
+ * as A or B.  Returns the length of the result.
+ */
+static inline size_t sortset_union(sortset* dst,
+                                   const sortset* a,
+                                   const sortset* b) {
+  SORTSET_ASSERT(dst != NULL);
+  SORTSET_ASSERT(a != NULL);
+  SORTSET_ASSERT(b != NULL);
+  SORTSET_ASSERT(dst != a && dst != b);
+  SORTSET_ASSERT(dst->cap >= a->len + b->len);
+
+#if defined(__SSE4_1__)
+  dst->len = sortset_union_simd_(dst->ids, a->ids, a->len, b->ids, b->len);
+#else
+  dst->len =
+    sortset_union_merge_(dst->ids, 0, a->ids, a->len, b->ids, b->len, NULL, 0);
+#endif
+  return dst->len;
+}
+
+/*
+ * Intersects K sorted sets, storing the result in DST.
+ *
+ * The smallest set is copied into DST first and then intersected with the
+ * others in order of increasing size, stopping early once the result is
+ * empty.  DST must have room for the smallest input and must not be one of
+ * the inputs.  Returns the length of the result.
+ */
+static inline size_t sortset_intersect_many(sortset* dst,
+                                            const sortset* const* sets,
+                                            size_t k) {
+  SORTSET_ASSERT(dst != NULL);
+  SORTSET_ASSERT(sets != NULL || k == 0);
+
+  size_t i;
+  size_t n;
+  size_t prev = 0;
+  size_t prev_len = 0;
+
+  dst->len = 0;
+  if (k == 0) {
+    return 0;
+  }
+
+  /*
+   * Pick sets in (length, index) order without sorting, since K is small and
+   * SETS is not ours to reorder.
+   */
+  for (n = 0; n < k; ++n) {
+    size_t best = k;
+    for (i = 0; i < k; ++i) {
+      size_t len = sets[i]->len;
+      if (n > 0 && (len < prev_len || (len == prev_len && i <= prev))) {
+        continue;
+      }
+      if (best == k || len < sets[best]->len) {
+        best = i;
+      }
+    }
+    SORTSET_ASSERT(best < k);
+
+    if (n == 0) {
+      SORTSET_ASSERT(dst->cap >= sets[best]->len);
+      for (i = 0; i < sets[best]->len; ++i) {
+        dst->ids[i] = sets[best]->ids[i];
+      }
+      dst->len = sets[best]->len;
+    } else {
+      sortset_intersect(dst, dst, sets[best]);
+    }
+    if (dst->len == 0) {
+      break;
+    }
+
+    prev = best;
+    prev_len = sets[best]->len;
+  }
+  return dst->len;
+}
+
+#endif
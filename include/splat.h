@@ -9,15 +9,188 @@
 #endif
 
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * USDT probes, for bpftrace, perf or SystemTap to attach to in a running
+ * process.  Define CONVOY_USDT to compile them in where sys/sdt.h is
+ * available; otherwise they compile to nothing.  An unattached probe is a
+ * single nop.  See tools/usdt/splat.bt.
+ *
+ *   convoy:splat_splay(tree, depth)  a splay descended DEPTH levels
+ */
+#if defined(CONVOY_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+
+static inline void splat_probe_splay_(const void* tree, size_t depth) {
+  DTRACE_PROBE2(convoy, splat_splay, tree, depth);
+}
+
+#define SPLAT_PROBE_SPLAY(TREE, DEPTH) splat_probe_splay_((TREE), (DEPTH))
+#endif
+#endif
+
+#ifndef SPLAT_PROBE_SPLAY
+#define SPLAT_PROBE_SPLAY(TREE, DEPTH) ((void)0)
+#endif
+
+/*
+ * The shape of a splay tree, as measured by a tree library's _shape().
+ *
+ * Depths count from zero at the root, so the average depth of an element is
+ * total_depth / count.
+ */
+struct splat_shape {
+  size_t count;
+  size_t height;
+  size_t total_depth;
+};
+
+#ifdef SPLAT_STATS
+#include <stdio.h>
+
+/*
+ * Number of buckets in the splay depth histogram.  Bucket k counts splays
+ * that descended between 2^k - 1 and 2^(k+1) - 2 levels.
+ */
+#define SPLAT_STATS_BUCKETS 32
+
+/*
+ * Running counters kept in every splay tree when SPLAT_STATS is defined.
+ */
+struct splat_stats {
+  unsigned long long inserts;
+  unsigned long long searches;
+  unsigned long long removes;
+  unsigned long long comparisons;
+  unsigned long long rotations;
+  unsigned long long splays;
+  unsigned long long splay_depth;
+  unsigned long long depths[SPLAT_STATS_BUCKETS];
+};
+
+static inline void splat_stats_splay(struct splat_stats* stats, size_t depth) {
+  size_t bucket = 0;
+
+  while (bucket + 1 < SPLAT_STATS_BUCKETS && (depth + 1) >> (bucket + 1)) {
+    ++bucket;
+  }
+  ++stats->splays;
+  stats->splay_depth += depth;
+  ++stats->depths[bucket];
+}
+
+/*
+ * Writes a tree's counters and shape to OUT in the Prometheus text format,
+ * with every sample labelled tree="NAME".
+ */
+static inline void splat_stats_write(FILE* out,
+                                     const char* name,
+                                     const struct splat_stats* stats,
+                                     const struct splat_shape* shape) {
+  unsigned long long cumulative = 0;
+  size_t i;
+
+  fprintf(out, "splat_operations_total{tree=\"%s\",op=\"insert\"} %llu\n",
+          name, stats->inserts);
+  fprintf(out, "splat_operations_total{tree=\"%s\",op=\"search\"} %llu\n",
+          name, stats->searches);
+  fprintf(out, "splat_operations_total{tree=\"%s\",op=\"remove\"} %llu\n",
+          name, stats->removes);
+  fprintf(out, "splat_comparisons_total{tree=\"%s\"} %llu\n", name,
+          stats->comparisons);
+  fprintf(out, "splat_rotations_total{tree=\"%s\"} %llu\n", name,
+          stats->rotations);
+
+  for (i = 0; i < SPLAT_STATS_BUCKETS; ++i) {
+    cumulative += stats->depths[i];
+    fprintf(out, "splat_splay_depth_bucket{tree=\"%s\",le=\"%llu\"} %llu\n",
+            name, (2ULL << i) - 2, cumulative);
+  }
+  fprintf(out, "splat_splay_depth_bucket{tree=\"%s\",le=\"+Inf\"} %llu\n",
+          name, stats->splays);
+  fprintf(out, "splat_splay_depth_sum{tree=\"%s\"} %llu\n", name,
+          stats->splay_depth);
+  fprintf(out, "splat_splay_depth_count{tree=\"%s\"} %llu\n", name,
+          stats->splays);
+
+  fprintf(out, "splat_nodes{tree=\"%s\"} %zu\n", name, shape->count);
+  fprintf(out, "splat_height{tree=\"%s\"} %zu\n", name, shape->height);
+  fprintf(out, "splat_average_depth{tree=\"%s\"} %g\n", name,
+          shape->count ? (double)shape->total_depth / shape->count : 0.0);
+}
+
+#define SPLAT_STATS_FIELD struct splat_stats stats;
+#define SPLAT_STATS_RESET(TREE) \
+  memset(&(TREE)->stats, 0, sizeof((TREE)->stats))
+#define SPLAT_STATS_ADD(TREE, FIELD, N) ((TREE)->stats.FIELD += (N))
+#define SPLAT_STATS_SPLAY(TREE, DEPTH) splat_stats_splay(&(TREE)->stats, DEPTH)
+
+/*
+ * Generates SPLAT_TYPE##_stats_print(), which measures the tree's shape and
+ * writes it out along with the tree's counters.
+ */
+#define SPLAT_STATS_LIB(SPLAT_TYPE)                     \
+  void SPLAT_TYPE##_stats_print(SPLAT_TYPE* tree,       \
+                                FILE* out,              \
+                                const char* name) {     \
+    struct splat_shape shape;                           \
+                                                        \
+    SPLAT_TYPE##_shape(tree, &shape);                   \
+    splat_stats_write(out, name, &tree->stats, &shape); \
+  }
+#else
+#define SPLAT_STATS_FIELD
+#define SPLAT_STATS_RESET(TREE) ((void)0)
+#define SPLAT_STATS_ADD(TREE, FIELD, N) ((void)0)
+#define SPLAT_STATS_SPLAY(TREE, DEPTH) ((void)(DEPTH))
+#define SPLAT_STATS_LIB(SPLAT_TYPE)
+#endif
+
+/*
+ * When SPLAT_COUNTED is defined, every splay tree also keeps a count of its
+ * elements, so SPLAT_COUNT() and SPLAT_FOOTPRINT() run in O(1) time.
+ */
+#ifdef SPLAT_COUNTED
+#define SPLAT_COUNT_FIELD size_t count;
+#define SPLAT_COUNT_STATIC_INIT .count = 0,
+#define SPLAT_COUNT_RESET(TREE) ((TREE)->count = 0)
+#define SPLAT_COUNT_ADD(TREE, N) ((TREE)->count += (N))
+#define SPLAT_COUNT_SUB(TREE, N) ((TREE)->count -= (N))
+
+/*
+ * Gets the number of elements in a splay tree.
+ */
+#define SPLAT_COUNT(TREE) ((TREE)->count)
+
+/*
+ * Gets the number of bytes taken up by a splay tree and its elements,
+ * counting each element as sizeof(*(TREE)->root).
+ */
+#define SPLAT_FOOTPRINT(TREE) \
+  (sizeof(*(TREE)) + (TREE)->count * sizeof(*(TREE)->root))
+#else
+#define SPLAT_COUNT_FIELD
+#define SPLAT_COUNT_STATIC_INIT
+#define SPLAT_COUNT_RESET(TREE) ((void)0)
+#define SPLAT_COUNT_ADD(TREE, N) ((void)0)
+#define SPLAT_COUNT_SUB(TREE, N) ((void)0)
+#endif
 
 /*
  * Declares a new splay tree type.
  *
- * ELEM_TYPE must be the name of a struct type
+ * ELEM_TYPE must be the name of a struct type.  When SPLAT_STATS is defined,
+ * the tree also carries a struct splat_stats named stats, and when
+ * SPLAT_COUNTED is defined, a size_t named count.
  */
 #define SPLAT_NEW(SPLAT_TYPE, ELEM_TYPE) \
   typedef struct SPLAT_TYPE {            \
     struct ELEM_TYPE* root;              \
+    SPLAT_STATS_FIELD                    \
+    SPLAT_COUNT_FIELD                    \
   } SPLAT_TYPE
 
 /*
@@ -34,18 +207,20 @@
 /*
  * Initializes a splay tree.
  */
-#define SPLAT_INIT(TREE)    \
-  do {                      \
-    assert((TREE) != NULL); \
-                            \
-    (TREE)->root = NULL;    \
+#define SPLAT_INIT(TREE)     \
+  do {                       \
+    assert((TREE) != NULL);  \
+                             \
+    (TREE)->root = NULL;     \
+    SPLAT_STATS_RESET(TREE); \
+    SPLAT_COUNT_RESET(TREE); \
   } while (0)
 
 /*
  * Statically initializes a splay tree.
  */
 #define SPLAT_STATIC_INIT \
-  { .root = NULL }
+  { .root = NULL, SPLAT_COUNT_STATIC_INIT }
 
 /*
  * Initializes the splay tree link of an element.
@@ -58,9 +233,368 @@
     (ELEM)->LINK.next = NULL;       \
   } while (0)
 
+/*
+ * A string key with its first 8 bytes and its length cached inline.
+ *
+ * Used as KEY_TYPE with SPLAT_STR_LIB().  Most comparisons during a splay are
+ * decided by the prefix alone, so they never touch the string's own memory.
+ * The string must outlive the key, the key does not copy it.
+ */
+typedef struct splat_strkey {
+  uint64_t prefix;
+  size_t len;
+  const char* str;
+} splat_strkey;
+
+/*
+ * Makes a string key from LEN bytes at STR.
+ */
+static inline splat_strkey splat_strkey_make(const char* str, size_t len) {
+  unsigned char buf[8] = { 0 };
+  splat_strkey key;
+  size_t i;
+
+  memcpy(buf, str, len < sizeof(buf) ? len : sizeof(buf));
+
+  /* Big-endian, so the prefixes compare like the strings do. */
+  key.prefix = 0;
+  for (i = 0; i < sizeof(buf); ++i) {
+    key.prefix = (key.prefix << 8) | buf[i];
+  }
+  key.len = len;
+  key.str = str;
+
+  return key;
+}
+
+/*
+ * Makes a string key from a NUL-terminated string.
+ */
+#define SPLAT_STRKEY(STR) splat_strkey_make((STR), strlen(STR))
+
+/*
+ * Compares two string keys the way memcmp() would, with shorter strings
+ * ordered before longer strings that they prefix.
+ */
+static inline int splat_strkey_cmp(splat_strkey a, splat_strkey b) {
+  size_t len;
+  int c;
+
+  if (a.prefix != b.prefix) {
+    return (a.prefix > b.prefix) - (a.prefix < b.prefix);
+  }
+
+  /* The first 8 bytes tie, so only the tails can break it. */
+  len = a.len < b.len ? a.len : b.len;
+  if (len > 8) {
+    c = memcmp(a.str + 8, b.str + 8, len - 8);
+    if (c != 0) {
+      return c;
+    }
+  }
+  return (a.len > b.len) - (a.len < b.len);
+}
+
+/*
+ * Defines a new splay tree library keyed by strings.
+ *
+ * KEY must be a splat_strkey field of ELEM_TYPE, filled in with
+ * splat_strkey_make() or SPLAT_STRKEY().  Searches and removals take a
+ * splat_strkey as well.
+ */
+#define SPLAT_STR_LIB(SPLAT_TYPE, ELEM_TYPE, LINK, KEY) \
+  SPLAT_LIB(SPLAT_TYPE, ELEM_TYPE, splat_strkey, splat_strkey_cmp, LINK, KEY)
+
+/*
+ * Branchless three-way comparisons for integer keys, for use as CMP.
+ *
+ * SPLAT_CMP_INT() works on any integer type but evaluates its arguments
+ * twice.  The functions below take their type from their name.
+ */
+#define SPLAT_CMP_INT(A, B) (((A) > (B)) - ((A) < (B)))
+
+static inline int splat_cmp_i32(int32_t a, int32_t b) {
+  return (a > b) - (a < b);
+}
+
+static inline int splat_cmp_i64(int64_t a, int64_t b) {
+  return (a > b) - (a < b);
+}
+
+static inline int splat_cmp_u32(uint32_t a, uint32_t b) {
+  return (a > b) - (a < b);
+}
+
+static inline int splat_cmp_u64(uint64_t a, uint64_t b) {
+  return (a > b) - (a < b);
+}
+
+/*
+ * Distance in bytes from an element's prev link to its next link.
+ */
+#define SPLAT_LINK_GAP(ELEM_TYPE, LINK)    \
+  (offsetof(struct ELEM_TYPE, LINK.next) - \
+   offsetof(struct ELEM_TYPE, LINK.prev))
+
+/*
+ * Gets the address of an element's prev link if DIR is 0, or of its next
+ * link if DIR is 1.  The address is computed from the link offsets rather
+ * than selected, so there is no branch for the compiler to keep.
+ */
+#define SPLAT_CHILD(ELEM_TYPE, ELEM, LINK, DIR)     \
+  ((struct ELEM_TYPE**)((char*)&(ELEM)->LINK.prev + \
+                        (size_t)(DIR) * SPLAT_LINK_GAP(ELEM_TYPE, LINK)))
+
+/*
+ * Gets element A if Z is 1, or element B if Z is 0.  The choice is made by
+ * masking the addresses rather than by comparing Z, so the compiler has no
+ * branch to turn it back into.
+ */
+#define SPLAT_PICK(ELEM_TYPE, Z, A, B)                      \
+  ((struct ELEM_TYPE*)(((uintptr_t)(A) & -(uintptr_t)(Z)) | \
+                       ((uintptr_t)(B) & ((uintptr_t)(Z)-1))))
+
+/*
+ * Generates a tree library's top-down splay, used by SPLAT_LIB().
+ */
+#define SPLAT_BRANCHY_SPLAY(SPLAT_TYPE, ELEM_TYPE, KEY_TYPE, CMP, LINK, KEY) \
+  static void SPLAT_TYPE##_splay(SPLAT_TYPE* tree, KEY_TYPE key) {           \
+    struct ELEM_TYPE assembler;                                              \
+    struct ELEM_TYPE* prev = &assembler;                                     \
+    struct ELEM_TYPE* next = &assembler;                                     \
+    size_t depth = 0;                                                        \
+                                                                             \
+    assert(tree != NULL);                                                    \
+                                                                             \
+    assembler.LINK.prev = NULL;                                              \
+    assembler.LINK.next = NULL;                                              \
+                                                                             \
+    struct ELEM_TYPE* elem = tree->root;                                     \
+    while (1) {                                                              \
+      int c = CMP(key, elem->KEY);                                           \
+      SPLAT_STATS_ADD(tree, comparisons, 1);                                 \
+      if (c < 0) {                                                           \
+        if (elem->LINK.prev == NULL) {                                       \
+          break;                                                             \
+        }                                                                    \
+        SPLAT_STATS_ADD(tree, comparisons, 1);                               \
+        if (CMP(key, elem->LINK.prev->KEY) < 0) {                            \
+          elem = SPLAT_TYPE##_rotate_next(elem);                             \
+          SPLAT_STATS_ADD(tree, rotations, 1);                               \
+          ++depth;                                                           \
+          if (elem->LINK.prev == NULL) {                                     \
+            break;                                                           \
+          }                                                                  \
+        }                                                                    \
+        /* Link next. */                                                     \
+        next->LINK.prev = elem;                                              \
+        next = elem;                                                         \
+        elem = elem->LINK.prev;                                              \
+        ++depth;                                                             \
+      } else if (c > 0) {                                                    \
+        if (elem->LINK.next == NULL) {                                       \
+          break;                                                             \
+        }                                                                    \
+        SPLAT_STATS_ADD(tree, comparisons, 1);                               \
+        if (CMP(key, elem->LINK.next->KEY) > 0) {                            \
+          elem = SPLAT_TYPE##_rotate_prev(elem);                             \
+          SPLAT_STATS_ADD(tree, rotations, 1);                               \
+          ++depth;                                                           \
+          if (elem->LINK.next == NULL) {                                     \
+            break;                                                           \
+          }                                                                  \
+        }                                                                    \
+        /* Link prev. */                                                     \
+        prev->LINK.next = elem;                                              \
+        prev = elem;                                                         \
+        elem = elem->LINK.next;                                              \
+        ++depth;                                                             \
+      } else {                                                               \
+        break;                                                               \
+      }                                                                      \
+    }                                                                        \
+    /* Assemble. */                                                          \
+    prev->LINK.next = elem->LINK.prev;                                       \
+    next->LINK.prev = elem->LINK.next;                                       \
+    elem->LINK.prev = assembler.LINK.next;                                   \
+    elem->LINK.next = assembler.LINK.prev;                                   \
+                                                                             \
+    tree->root = elem;                                                       \
+    SPLAT_STATS_SPLAY(tree, depth);                                          \
+    SPLAT_PROBE_SPLAY(tree, depth);                                          \
+  }
+
+/*
+ * Generates the same splay as SPLAT_BRANCHY_SPLAY(), with the two
+ * mirrored halves folded into one that works on a direction index, and the
+ * zig-zig rotation done by selecting the links it writes.  This trades the
+ * data-dependent branches on the comparisons for address arithmetic and
+ * masks.  Only the checks that end the descent, on a match or a leaf, still
+ * branch.
+ */
+#define SPLAT_CMOV_SPLAY(SPLAT_TYPE, ELEM_TYPE, KEY_TYPE, CMP, LINK, KEY)  \
+  static void SPLAT_TYPE##_splay(SPLAT_TYPE* tree, KEY_TYPE key) {         \
+    struct ELEM_TYPE assembler;                                            \
+    struct ELEM_TYPE* tails[2];                                            \
+    struct ELEM_TYPE* elem;                                                \
+    struct ELEM_TYPE* child;                                               \
+    struct ELEM_TYPE* inner;                                               \
+    struct ELEM_TYPE* outer;                                               \
+    size_t depth = 0;                                                      \
+    int c;                                                                 \
+    int d;                                                                 \
+    int z;                                                                 \
+                                                                           \
+    assert(tree != NULL);                                                  \
+                                                                           \
+    assembler.LINK.prev = NULL;                                            \
+    assembler.LINK.next = NULL;                                            \
+                                                                           \
+    /*                                                                     \
+     * tails[0] is the leftmost element of the tree being built from       \
+     * elements greater than the key, tails[1] the rightmost of the lesser \
+     * one.  Direction 1 means next, so tails[d] grows along direction d.  \
+     */                                                                    \
+    tails[0] = &assembler;                                                 \
+    tails[1] = &assembler;                                                 \
+                                                                           \
+    elem = tree->root;                                                     \
+    while (1) {                                                            \
+      c = CMP(key, elem->KEY);                                             \
+      SPLAT_STATS_ADD(tree, comparisons, 1);                               \
+      if (c == 0) {                                                        \
+        break;                                                             \
+      }                                                                    \
+      d = c > 0;                                                           \
+      child = *SPLAT_CHILD(ELEM_TYPE, elem, LINK, d);                      \
+      if (child == NULL) {                                                 \
+        break;                                                             \
+      }                                                                    \
+      c = CMP(key, child->KEY);                                            \
+      SPLAT_STATS_ADD(tree, comparisons, 1);                               \
+                                                                           \
+      /*                                                                   \
+       * Rotate child up if the key lies past it along direction d too.    \
+       * Both links are written either way, with values selected so that   \
+       * they are left as they were when there is no rotation.             \
+       */                                                                  \
+      z = (c > 0) - (c < 0) == 2 * d - 1;                                  \
+      inner = *SPLAT_CHILD(ELEM_TYPE, child, LINK, !d);                    \
+      outer = *SPLAT_CHILD(ELEM_TYPE, child, LINK, d);                     \
+      *SPLAT_CHILD(ELEM_TYPE, elem, LINK, d) =                             \
+        SPLAT_PICK(ELEM_TYPE, z, inner, child);                            \
+      *SPLAT_CHILD(ELEM_TYPE, child, LINK, !d) =                           \
+        SPLAT_PICK(ELEM_TYPE, z, elem, inner);                             \
+      elem = SPLAT_PICK(ELEM_TYPE, z, child, elem);                        \
+      child = SPLAT_PICK(ELEM_TYPE, z, outer, child);                      \
+      SPLAT_STATS_ADD(tree, rotations, z);                                 \
+      depth += z;                                                          \
+      if (child == NULL) {                                                 \
+        break;                                                             \
+      }                                                                    \
+      /* Link along direction d. */                                        \
+      *SPLAT_CHILD(ELEM_TYPE, tails[d], LINK, d) = elem;                   \
+      tails[d] = elem;                                                     \
+      elem = child;                                                        \
+      ++depth;                                                             \
+    }                                                                      \
+    /* Assemble. */                                                        \
+    tails[1]->LINK.next = elem->LINK.prev;                                 \
+    tails[0]->LINK.prev = elem->LINK.next;                                 \
+    elem->LINK.prev = assembler.LINK.next;                                 \
+    elem->LINK.next = assembler.LINK.prev;                                 \
+                                                                           \
+    tree->root = elem;                                                     \
+    SPLAT_STATS_SPLAY(tree, depth);                                        \
+    SPLAT_PROBE_SPLAY(tree, depth);                                        \
+  }
+
+/*
+ * Define SPLAT_BRANCHLESS to build every tree library with the conditional
+ * move splay.
+ */
+#ifdef SPLAT_BRANCHLESS
+#define SPLAT_SPLAY SPLAT_CMOV_SPLAY
+#else
+#define SPLAT_SPLAY SPLAT_BRANCHY_SPLAY
+#endif
+
+/*
+ * Generates the functions built on a tree library's _walk(), shared by
+ * SPLAT_LIB() and SPLAT_IDX_LIB().
+ */
+#define SPLAT_WALK_LIB_(SPLAT_TYPE, ELEM_TYPE)                                \
+  static void SPLAT_TYPE##_shape_visit_(struct ELEM_TYPE* elem,               \
+                                        size_t depth,                         \
+                                        void* ctx) {                          \
+    struct splat_shape* shape = (struct splat_shape*)ctx;                     \
+                                                                              \
+    (void)elem;                                                               \
+    ++shape->count;                                                           \
+    shape->total_depth += depth;                                              \
+    if (depth + 1 > shape->height) {                                          \
+      shape->height = depth + 1;                                              \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Measures the shape of the tree: its size, its height, and the total      \
+   * depth of its elements.  Takes O(n) time and O(1) space, like _walk().    \
+   */                                                                         \
+  void SPLAT_TYPE##_shape(SPLAT_TYPE* tree, struct splat_shape* shape) {      \
+    assert(tree != NULL);                                                     \
+    assert(shape != NULL);                                                    \
+                                                                              \
+    shape->count = 0;                                                         \
+    shape->height = 0;                                                        \
+    shape->total_depth = 0;                                                   \
+    SPLAT_TYPE##_walk(tree, SPLAT_TYPE##_shape_visit_, shape);                \
+  }                                                                           \
+                                                                              \
+  struct SPLAT_TYPE##_footprint_ctx_ {                                        \
+    size_t (*fn)(const struct ELEM_TYPE*);                                    \
+    size_t total;                                                             \
+  };                                                                          \
+                                                                              \
+  static void SPLAT_TYPE##_footprint_visit_(struct ELEM_TYPE* elem,           \
+                                            size_t depth,                     \
+                                            void* ctx) {                      \
+    struct SPLAT_TYPE##_footprint_ctx_* fp =                                  \
+      (struct SPLAT_TYPE##_footprint_ctx_*)ctx;                               \
+                                                                              \
+    (void)depth;                                                              \
+    fp->total += (fp->fn != NULL) ? fp->fn(elem) : sizeof(*elem);             \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Measures the number of bytes taken up by the tree and its elements, as   \
+   * sizeof(SPLAT_TYPE) plus FN of every element.  FN should count anything   \
+   * the element owns along with the element itself.  FN may be NULL, which   \
+   * counts each element as sizeof(struct ELEM_TYPE).  Takes O(n) time and    \
+   * O(1) space, like _walk().                                                \
+   */                                                                         \
+  size_t SPLAT_TYPE##_footprint_deep(SPLAT_TYPE* tree,                        \
+                                     size_t (*fn)(const struct ELEM_TYPE*)) { \
+    struct SPLAT_TYPE##_footprint_ctx_ fp;                                    \
+                                                                              \
+    assert(tree != NULL);                                                     \
+                                                                              \
+    fp.fn = fn;                                                               \
+    fp.total = sizeof(*tree);                                                 \
+    SPLAT_TYPE##_walk(tree, SPLAT_TYPE##_footprint_visit_, &fp);              \
+    return fp.total;                                                          \
+  }                                                                           \
+                                                                              \
+  SPLAT_STATS_LIB(SPLAT_TYPE)
+
 /*
  * Defines a new splay tree library.
  *
+ * When SPLAT_STATS is defined, every operation also updates the tree's
+ * counters, and the library gets a _stats_print() function.  When
+ * SPLAT_COUNTED is defined, every insert and remove also updates the tree's
+ * count.
+ *
  * @param SPLAT_TYPE the type of the splay tree
  * @param ELEM_TYPE the type of the tree's elements
  * @param KEY_TYPE the type of the elements' keys
@@ -92,65 +626,15 @@
     return temp;                                                              \
   }                                                                           \
                                                                               \
-  static void SPLAT_TYPE##_splay(SPLAT_TYPE* tree, KEY_TYPE key) {            \
-    struct ELEM_TYPE assembler;                                               \
-    struct ELEM_TYPE* prev = &assembler;                                      \
-    struct ELEM_TYPE* next = &assembler;                                      \
-                                                                              \
-    assert(tree != NULL);                                                     \
-                                                                              \
-    assembler.LINK.prev = NULL;                                               \
-    assembler.LINK.next = NULL;                                               \
-                                                                              \
-    struct ELEM_TYPE* elem = tree->root;                                      \
-    while (1) {                                                               \
-      int c = CMP(key, elem->KEY);                                            \
-      if (c < 0) {                                                            \
-        if (elem->LINK.prev == NULL) {                                        \
-          break;                                                              \
-        }                                                                     \
-        if (CMP(key, elem->LINK.prev->KEY) < 0) {                             \
-          elem = SPLAT_TYPE##_rotate_next(elem);                              \
-          if (elem->LINK.prev == NULL) {                                      \
-            break;                                                            \
-          }                                                                   \
-        }                                                                     \
-        /* Link next. */                                                      \
-        next->LINK.prev = elem;                                               \
-        next = elem;                                                          \
-        elem = elem->LINK.prev;                                               \
-      } else if (c > 0) {                                                     \
-        if (elem->LINK.next == NULL) {                                        \
-          break;                                                              \
-        }                                                                     \
-        if (CMP(key, elem->LINK.next->KEY) > 0) {                             \
-          elem = SPLAT_TYPE##_rotate_prev(elem);                              \
-          if (elem->LINK.next == NULL) {                                      \
-            break;                                                            \
-          }                                                                   \
-        }                                                                     \
-        /* Link prev. */                                                      \
-        prev->LINK.next = elem;                                               \
-        prev = elem;                                                          \
-        elem = elem->LINK.next;                                               \
-      } else {                                                                \
-        break;                                                                \
-      }                                                                       \
-    }                                                                         \
-    /* Assemble. */                                                           \
-    prev->LINK.next = elem->LINK.prev;                                        \
-    next->LINK.prev = elem->LINK.next;                                        \
-    elem->LINK.prev = assembler.LINK.next;                                    \
-    elem->LINK.next = assembler.LINK.prev;                                    \
-                                                                              \
-    tree->root = elem;                                                        \
-  }                                                                           \
+  SPLAT_SPLAY(SPLAT_TYPE, ELEM_TYPE, KEY_TYPE, CMP, LINK, KEY)                \
                                                                               \
   void SPLAT_TYPE##_insert(SPLAT_TYPE* tree, struct ELEM_TYPE* elem) {        \
     assert(tree != NULL);                                                     \
     assert(elem != NULL);                                                     \
                                                                               \
+    SPLAT_STATS_ADD(tree, inserts, 1);                                        \
     if (tree->root == NULL) {                                                 \
+      SPLAT_COUNT_ADD(tree, 1);                                               \
       tree->root = elem;                                                      \
       return;                                                                 \
     }                                                                         \
@@ -158,6 +642,7 @@
     SPLAT_TYPE##_splay(tree, elem->KEY);                                      \
                                                                               \
     int c = CMP(elem->KEY, tree->root->KEY);                                  \
+    SPLAT_STATS_ADD(tree, comparisons, 1);                                    \
                                                                               \
     if (c == 0) {                                                             \
       return;                                                                 \
@@ -172,17 +657,111 @@
       tree->root->LINK.next = NULL;                                           \
     }                                                                         \
                                                                               \
+    SPLAT_COUNT_ADD(tree, 1);                                                 \
+    tree->root = elem;                                                        \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Inserts an element next to HINT, which should be the element inserted or \
+   * found last.  When HINT is still the root and the new key falls between   \
+   * it and its neighbor, the element is linked in as the new root in O(1)    \
+   * without splaying.  Otherwise this is the same as _insert().  HINT may be \
+   * NULL.                                                                    \
+   */                                                                         \
+  void SPLAT_TYPE##_insert_hint(SPLAT_TYPE* tree,                             \
+                                struct ELEM_TYPE* hint,                       \
+                                struct ELEM_TYPE* elem) {                     \
+    struct ELEM_TYPE* root;                                                   \
+    struct ELEM_TYPE* near;                                                   \
+                                                                              \
+    assert(tree != NULL);                                                     \
+    assert(elem != NULL);                                                     \
+                                                                              \
+    root = tree->root;                                                        \
+    if (hint == NULL || hint != root) {                                       \
+      SPLAT_TYPE##_insert(tree, elem);                                        \
+      return;                                                                 \
+    }                                                                         \
+                                                                              \
+    int c = CMP(elem->KEY, root->KEY);                                        \
+    SPLAT_STATS_ADD(tree, comparisons, 1);                                    \
+                                                                              \
+    if (c > 0) {                                                              \
+      /* The successor is root's next unless that has a prev subtree. */      \
+      near = root->LINK.next;                                                 \
+      if (near != NULL) {                                                     \
+        if (near->LINK.prev != NULL) {                                        \
+          SPLAT_TYPE##_insert(tree, elem);                                    \
+          return;                                                             \
+        }                                                                     \
+        SPLAT_STATS_ADD(tree, comparisons, 1);                                \
+        if (CMP(elem->KEY, near->KEY) >= 0) {                                 \
+          SPLAT_TYPE##_insert(tree, elem);                                    \
+          return;                                                             \
+        }                                                                     \
+      }                                                                       \
+      elem->LINK.prev = root;                                                 \
+      elem->LINK.next = near;                                                 \
+      root->LINK.next = NULL;                                                 \
+    } else if (c < 0) {                                                       \
+      /* Ditto for the predecessor. */                                        \
+      near = root->LINK.prev;                                                 \
+      if (near != NULL) {                                                     \
+        if (near->LINK.next != NULL) {                                        \
+          SPLAT_TYPE##_insert(tree, elem);                                    \
+          return;                                                             \
+        }                                                                     \
+        SPLAT_STATS_ADD(tree, comparisons, 1);                                \
+        if (CMP(elem->KEY, near->KEY) <= 0) {                                 \
+          SPLAT_TYPE##_insert(tree, elem);                                    \
+          return;                                                             \
+        }                                                                     \
+      }                                                                       \
+      elem->LINK.next = root;                                                 \
+      elem->LINK.prev = near;                                                 \
+      root->LINK.prev = NULL;                                                 \
+    } else {                                                                  \
+      SPLAT_STATS_ADD(tree, inserts, 1);                                      \
+      return;                                                                 \
+    }                                                                         \
+                                                                              \
+    SPLAT_STATS_ADD(tree, inserts, 1);                                        \
+    SPLAT_COUNT_ADD(tree, 1);                                                 \
+    tree->root = elem;                                                        \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Inserts an element whose key is greater than every key in the tree.      \
+   * After an _insert_max() the new maximum is the root, so a run of them     \
+   * costs O(1) each and never compares keys.                                 \
+   */                                                                         \
+  void SPLAT_TYPE##_insert_max(SPLAT_TYPE* tree, struct ELEM_TYPE* elem) {    \
+    assert(tree != NULL);                                                     \
+    assert(elem != NULL);                                                     \
+                                                                              \
+    if (tree->root != NULL && tree->root->LINK.next != NULL) {                \
+      SPLAT_TYPE##_splay(tree, elem->KEY);                                    \
+    }                                                                         \
+    assert(tree->root == NULL || tree->root->LINK.next == NULL);              \
+    assert(tree->root == NULL || CMP(elem->KEY, tree->root->KEY) > 0);        \
+                                                                              \
+    SPLAT_STATS_ADD(tree, inserts, 1);                                        \
+    SPLAT_COUNT_ADD(tree, 1);                                                 \
+    elem->LINK.prev = tree->root;                                             \
+    elem->LINK.next = NULL;                                                   \
     tree->root = elem;                                                        \
   }                                                                           \
                                                                               \
   struct ELEM_TYPE* SPLAT_TYPE##_search(SPLAT_TYPE* tree, KEY_TYPE key) {     \
     assert(tree != NULL);                                                     \
                                                                               \
+    SPLAT_STATS_ADD(tree, searches, 1);                                       \
     if (tree->root == NULL) {                                                 \
       return NULL;                                                            \
     }                                                                         \
     SPLAT_TYPE##_splay(tree, key);                                            \
                                                                               \
+    SPLAT_STATS_ADD(tree, comparisons, 1);                                    \
     if (CMP(key, tree->root->KEY) == 0) {                                     \
       return tree->root;                                                      \
     }                                                                         \
@@ -196,6 +775,8 @@
     if (removed == NULL) {                                                    \
       return NULL;                                                            \
     }                                                                         \
+    SPLAT_STATS_ADD(tree, removes, 1);                                        \
+    SPLAT_COUNT_SUB(tree, 1);                                                 \
     if (tree->root->LINK.prev == NULL) {                                      \
       tree->root = tree->root->LINK.next;                                     \
     } else {                                                                  \
@@ -206,6 +787,773 @@
     }                                                                         \
                                                                               \
     return removed;                                                           \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Removes every element from the tree, calling FN on each one in key       \
+   * order.  FN may be NULL.  Runs in O(n) time and O(1) space by rotating    \
+   * left children up until the tree is a vine.  Links are reset before FN    \
+   * is called, so FN may free or reinsert the element.                       \
+   */                                                                         \
+  void SPLAT_TYPE##_clear(SPLAT_TYPE* tree, void (*fn)(struct ELEM_TYPE*)) {  \
+    struct ELEM_TYPE* elem;                                                   \
+    struct ELEM_TYPE* next;                                                   \
+                                                                              \
+    assert(tree != NULL);                                                     \
+                                                                              \
+    elem = tree->root;                                                        \
+    tree->root = NULL;                                                        \
+    SPLAT_COUNT_RESET(tree);                                                  \
+    while (elem != NULL) {                                                    \
+      if (elem->LINK.prev != NULL) {                                          \
+        elem = SPLAT_TYPE##_rotate_next(elem);                                \
+        continue;                                                             \
+      }                                                                       \
+      next = elem->LINK.next;                                                 \
+      elem->LINK.next = NULL;                                                 \
+      if (fn != NULL) {                                                       \
+        fn(elem);                                                             \
+      }                                                                       \
+      elem = next;                                                            \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Left-rotates every other element down the next links of a vine, COUNT    \
+   * times, starting below ROOT.  One pass of Day-Stout-Warren.               \
+   */                                                                         \
+  static void SPLAT_TYPE##_compress(struct ELEM_TYPE* root, size_t count) {   \
+    struct ELEM_TYPE* scan = root;                                            \
+    struct ELEM_TYPE* child;                                                  \
+                                                                              \
+    while (count-- > 0) {                                                     \
+      child = scan->LINK.next;                                                \
+      scan->LINK.next = SPLAT_TYPE##_rotate_prev(child);                      \
+      scan = scan->LINK.next;                                                 \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Removes every element for which PRED returns non-zero, then rebuilds     \
+   * the remaining elements into a balanced tree.  PRED sees the elements in  \
+   * key order, with their links already reset, so it may free the ones it    \
+   * removes.  Runs in O(n) time and O(1) space.  Returns the number of       \
+   * elements removed.                                                        \
+   */                                                                         \
+  size_t SPLAT_TYPE##_remove_if(SPLAT_TYPE* tree,                             \
+                                int (*pred)(struct ELEM_TYPE*)) {             \
+    struct ELEM_TYPE vine;                                                    \
+    struct ELEM_TYPE* tail = &vine;                                           \
+    struct ELEM_TYPE* elem;                                                   \
+    struct ELEM_TYPE* next;                                                   \
+    size_t kept = 0;                                                          \
+    size_t removed = 0;                                                       \
+    size_t full;                                                              \
+                                                                              \
+    assert(tree != NULL);                                                     \
+    assert(pred != NULL);                                                     \
+                                                                              \
+    vine.LINK.prev = NULL;                                                    \
+    vine.LINK.next = NULL;                                                    \
+                                                                              \
+    /* Flatten into a sorted vine of the survivors. */                        \
+    elem = tree->root;                                                        \
+    while (elem != NULL) {                                                    \
+      if (elem->LINK.prev != NULL) {                                          \
+        elem = SPLAT_TYPE##_rotate_next(elem);                                \
+        continue;                                                             \
+      }                                                                       \
+      next = elem->LINK.next;                                                 \
+      elem->LINK.next = NULL;                                                 \
+      if (pred(elem)) {                                                       \
+        ++removed;                                                            \
+      } else {                                                                \
+        tail->LINK.next = elem;                                               \
+        tail = elem;                                                          \
+        ++kept;                                                               \
+      }                                                                       \
+      elem = next;                                                            \
+    }                                                                         \
+                                                                              \
+    /* Fold the vine into a balanced tree. */                                 \
+    full = 1;                                                                 \
+    while (full <= kept + 1) {                                                \
+      full <<= 1;                                                             \
+    }                                                                         \
+    full = (full >> 1) - 1;                                                   \
+    SPLAT_TYPE##_compress(&vine, kept - full);                                \
+    while (full > 1) {                                                        \
+      full >>= 1;                                                             \
+      SPLAT_TYPE##_compress(&vine, full);                                     \
+    }                                                                         \
+                                                                              \
+    tree->root = vine.LINK.next;                                              \
+    SPLAT_COUNT_SUB(tree, removed);                                           \
+    return removed;                                                           \
+  }                                                                           \
+                                                                              \
+  /*                                                                          \
+   * Calls FN on every element in order, with the element's depth below the   \
+   * root and CTX.  Walks the tree with Morris threading, so it takes O(n)    \
+   * time and O(1) space and leaves the tree as it found it.  Some links are  \
+   * threaded back up the tree while FN runs, so FN must neither follow nor   \
+   * change them.                                                             \
+   */                                                                         \
+  void SPLAT_TYPE##_walk(SPLAT_TYPE* tree,                                    \
+                         void (*fn)(struct ELEM_TYPE*, size_t, void*),        \
+                         void* ctx) {                                         \
+    struct ELEM_TYPE* elem;                                                   \
+    struct ELEM_TYPE* pred;                                                   \
+    size_t depth = 0;                                                         \
+    size_t steps;                                                             \
+                                                                              \
+    assert(tree != NULL);                                                     \
+    assert(fn != NULL);                                                       \
+                                                                              \
+    elem = tree->root;                                                        \
+    while (elem != NULL) {                                                    \
+      if (elem->LINK.prev != NULL) {                                          \
+        /* Find the in-order predecessor of the current element. */           \
+        pred = elem->LINK.prev;                                               \
+        steps = 1;                                                            \
+        while (pred->LINK.next != NULL && pred->LINK.next != elem) {          \
+          pred = pred->LINK.next;                                             \
+          ++steps;                                                            \
+        }                                                                     \
+        if (pred->LINK.next == NULL) {                                        \
+          /* Thread the predecessor back to us and descend. */                \
+          pred->LINK.next = elem;                                             \
+          elem = elem->LINK.prev;                                             \
+          ++depth;                                                            \
+          continue;                                                           \
+        }                                                                     \
+        /* Came back up the thread from pred, undo the descent. */            \
+        pred->LINK.next = NULL;                                               \
+        depth -= steps + 1;                                                   \
+      }                                                                       \
+                                                                              \
+      fn(elem, depth, ctx);                                                   \
+      elem = elem->LINK.next;                                                 \
+      ++depth;                                                                \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  SPLAT_WALK_LIB_(SPLAT_TYPE, ELEM_TYPE)
+
+/*
+ * Pooled splay trees.
+ *
+ * These link elements with 32-bit indices into a caller-owned pool instead of
+ * pointers, halving the size of a link.  Nothing in the pool refers to its own
+ * address, so a pool can be copied, mapped or persisted as-is, and the tree
+ * pointed at the new copy by assigning its pool field.
+ *
+ * Slot SPLAT_IDX_NIL (0) of every pool is reserved: it stands in for NULL,
+ * and the tree scribbles on its link while splaying.  Pools may hold at most
+ * UINT32_MAX elements.
+ */
+
+/*
+ * The index that stands in for NULL in a pooled tree.
+ */
+#define SPLAT_IDX_NIL ((uint32_t)0)
+
+/*
+ * Declares a new pooled splay tree type.
+ *
+ * ELEM_TYPE must be the name of a struct type.  Like SPLAT_NEW(), the tree
+ * also carries stats when SPLAT_STATS is defined, and a count when
+ * SPLAT_COUNTED is defined.
+ */
+#define SPLAT_IDX_NEW(SPLAT_TYPE, ELEM_TYPE) \
+  typedef struct SPLAT_TYPE {                \
+    struct ELEM_TYPE* pool;                  \
+    uint32_t root;                           \
+    SPLAT_STATS_FIELD                        \
+    SPLAT_COUNT_FIELD                        \
+  } SPLAT_TYPE
+
+/*
+ * Declares a link in a struct for use with a pooled splay tree.
+ */
+#define SPLAT_IDX_LINK(LINK) \
+  struct {                   \
+    uint32_t prev;           \
+    uint32_t next;           \
+  } LINK
+
+/*
+ * Initializes a pooled splay tree over the array POOL.
+ */
+#define SPLAT_IDX_INIT(TREE, POOL) \
+  do {                             \
+    assert((TREE) != NULL);        \
+    assert((POOL) != NULL);        \
+                                   \
+    (TREE)->pool = (POOL);         \
+    (TREE)->root = SPLAT_IDX_NIL;  \
+    SPLAT_STATS_RESET(TREE);       \
+    SPLAT_COUNT_RESET(TREE);       \
+  } while (0)
+
+/*
+ * Statically initializes a pooled splay tree over the array POOL.
+ */
+#define SPLAT_IDX_STATIC_INIT(POOL) \
+  { .pool = (POOL), .root = SPLAT_IDX_NIL, SPLAT_COUNT_STATIC_INIT }
+
+/*
+ * Initializes the pooled splay tree link of an element.
+ */
+#define SPLAT_IDX_ELEM_INIT(ELEM, LINK) \
+  do {                                  \
+    assert((ELEM) != NULL);             \
+                                        \
+    (ELEM)->LINK.prev = SPLAT_IDX_NIL;  \
+    (ELEM)->LINK.next = SPLAT_IDX_NIL;  \
+  } while (0)
+
+#ifdef SPLAT_COUNTED
+/*
+ * Gets the number of bytes taken up by a pooled splay tree and its elements,
+ * counting each element as sizeof(*(TREE)->pool).  Slots of the pool that
+ * aren't in the tree aren't counted.  SPLAT_COUNT() works on pooled trees
+ * as it is.
+ */
+#define SPLAT_IDX_FOOTPRINT(TREE) \
+  (sizeof(*(TREE)) + (TREE)->count * sizeof(*(TREE)->pool))
+#endif
+
+/*
+ * Gets the address of the prev link of element I of POOL if DIR is 0, or of
+ * its next link if DIR is 1, like SPLAT_CHILD().
+ */
+#define SPLAT_IDX_CHILD(ELEM_TYPE, POOL, I, LINK, DIR) \
+  ((uint32_t*)((char*)&(POOL)[I].LINK.prev +           \
+               (size_t)(DIR) * SPLAT_LINK_GAP(ELEM_TYPE, LINK)))
+
+/*
+ * Gets index A if Z is 1, or index B if Z is 0, like SPLAT_PICK().
+ */
+#define SPLAT_IDX_PICK(Z, A, B) \
+  (((A) & -(uint32_t)(Z)) | ((B) & ((uint32_t)(Z)-1)))
+
+/*
+ * Generates a pooled tree library's top-down splay, used by SPLAT_IDX_LIB().
+ * The nil slot doubles as the assembler.
+ */
+#define SPLAT_IDX_BRANCHY(SPLAT_TYPE, ELEM_TYPE, KEY_TYPE, CMP, LINK, KEY) \
+  static void SPLAT_TYPE##_splay(SPLAT_TYPE* tree, KEY_TYPE key) {         \
+    struct ELEM_TYPE* pool;                                                \
+    uint32_t prev = SPLAT_IDX_NIL;                                         \
+    uint32_t next = SPLAT_IDX_NIL;                                         \
+    size_t depth = 0;                                                      \
+                                                                           \
+    assert(tree != NULL);                                                  \
+                                                                           \
+    pool = tree->pool;                                                     \
+    pool[SPLAT_IDX_NIL].LINK.prev = SPLAT_IDX_NIL;                         \
+    pool[SPLAT_IDX_NIL].LINK.next = SPLAT_IDX_NIL;                         \
+                                                                           \
+    uint32_t elem = tree->root;                                            \
+    while (1) {                                                            \
+      int c = CMP(key, pool[elem].KEY);                                    \
+      SPLAT_STATS_ADD(tree, comparisons, 1);                               \
+      if (c < 0) {                                                         \
+        if (pool[elem].LINK.prev == SPLAT_IDX_NIL) {                       \
+          break;                                                           \
+        }                                                                  \
+        SPLAT_STATS_ADD(tree, comparisons, 1);                             \
+        if (CMP(key, pool[pool[elem].LINK.prev].KEY) < 0) {                \
+          elem = SPLAT_TYPE##_rotate_next(pool, elem);                     \
+          SPLAT_STATS_ADD(tree, rotations, 1);                             \
+          ++depth;                                                         \
+          if (pool[elem].LINK.prev == SPLAT_IDX_NIL) {                     \
+            break;                                                         \
+          }                                                                \
+        }                                                                  \
+        /* Link next. */                                                   \
+        pool[next].LINK.prev = elem;                                       \
+        next = elem;                                                       \
+        elem = pool[elem].LINK.prev;                                       \
+        ++depth;                                                           \
+      } else if (c > 0) {                                                  \
+        if (pool[elem].LINK.next == SPLAT_IDX_NIL) {                       \
+          break;                                                           \
+        }                                                                  \
+        SPLAT_STATS_ADD(tree, comparisons, 1);                             \
+        if (CMP(key, pool[pool[elem].LINK.next].KEY) > 0) {                \
+          elem = SPLAT_TYPE##_rotate_prev(pool, elem);                     \
+          SPLAT_STATS_ADD(tree, rotations, 1);                             \
+          ++depth;                                                         \
+          if (pool[elem].LINK.next == SPLAT_IDX_NIL) {                     \
+            break;                                                         \
+          }                                                                \
+        }                                                                  \
+        /* Link prev. */                                                   \
+        pool[prev].LINK.next = elem;                                       \
+        prev = elem;                                                       \
+        elem = pool[elem].LINK.next;                                       \
+        ++depth;                                                           \
+      } else {                                                             \
+        break;                                                             \
+      }                                                                    \
+    }                                                                      \
+    /* Assemble. */                                                        \
+    pool[prev].LINK.next = pool[elem].LINK.prev;                           \
+    pool[next].LINK.prev = pool[elem].LINK.next;                           \
+    pool[elem].LINK.prev = pool[SPLAT_IDX_NIL].LINK.next;                  \
+    pool[elem].LINK.next = pool[SPLAT_IDX_NIL].LINK.prev;                  \
+                                                                           \
+    tree->root = elem;                                                     \
+    SPLAT_STATS_SPLAY(tree, depth);                                        \
+    SPLAT_PROBE_SPLAY(tree, depth);                                        \
   }
 
+/*
+ * Generates the same splay as SPLAT_IDX_BRANCHY() the way
+ * SPLAT_CMOV_SPLAY() does for pointer trees.
+ */
+#define SPLAT_IDX_CMOV(SPLAT_TYPE, ELEM_TYPE, KEY_TYPE, CMP, LINK, KEY)    \
+  static void SPLAT_TYPE##_splay(SPLAT_TYPE* tree, KEY_TYPE key) {         \
+    struct ELEM_TYPE* pool;                                                \
+    uint32_t tails[2];                                                     \
+    uint32_t elem;                                                         \
+    uint32_t child;                                                        \
+    uint32_t inner;                                                        \
+    uint32_t outer;                                                        \
+    size_t depth = 0;                                                      \
+    int c;                                                                 \
+    int d;                                                                 \
+    uint32_t z;                                                            \
+                                                                           \
+    assert(tree != NULL);                                                  \
+                                                                           \
+    pool = tree->pool;                                                     \
+    pool[SPLAT_IDX_NIL].LINK.prev = SPLAT_IDX_NIL;                         \
+    pool[SPLAT_IDX_NIL].LINK.next = SPLAT_IDX_NIL;                         \
+    tails[0] = SPLAT_IDX_NIL;                                              \
+    tails[1] = SPLAT_IDX_NIL;                                              \
+                                                                           \
+    elem = tree->root;                                                     \
+    while (1) {                                                            \
+      c = CMP(key, pool[elem].KEY);                                        \
+      SPLAT_STATS_ADD(tree, comparisons, 1);                               \
+      if (c == 0) {                                                        \
+        break;                                                             \
+      }                                                                    \
+      d = c > 0;                                                           \
+      child = *SPLAT_IDX_CHILD(ELEM_TYPE, pool, elem, LINK, d);            \
+      if (child == SPLAT_IDX_NIL) {                                        \
+        break;                                                             \
+      }                                                                    \
+      c = CMP(key, pool[child].KEY);                                       \
+      SPLAT_STATS_ADD(tree, comparisons, 1);                               \
+                                                                           \
+      /* Rotate child up if the key lies past it along direction d too. */ \
+      z = (c > 0) - (c < 0) == 2 * d - 1;                                  \
+      inner = *SPLAT_IDX_CHILD(ELEM_TYPE, pool, child, LINK, !d);          \
+      outer = *SPLAT_IDX_CHILD(ELEM_TYPE, pool, child, LINK, d);           \
+      *SPLAT_IDX_CHILD(ELEM_TYPE, pool, elem, LINK, d) =                   \
+        SPLAT_IDX_PICK(z, inner, child);                                   \
+      *SPLAT_IDX_CHILD(ELEM_TYPE, pool, child, LINK, !d) =                 \
+        SPLAT_IDX_PICK(z, elem, inner);                                    \
+      elem = SPLAT_IDX_PICK(z, child, elem);                               \
+      child = SPLAT_IDX_PICK(z, outer, child);                             \
+      SPLAT_STATS_ADD(tree, rotations, z);                                 \
+      depth += z;                                                          \
+      if (child == SPLAT_IDX_NIL) {                                        \
+        break;                                                             \
+      }                                                                    \
+      /* Link along direction d. */                                        \
+      *SPLAT_IDX_CHILD(ELEM_TYPE, pool, tails[d], LINK, d) = elem;         \
+      tails[d] = elem;                                                     \
+      elem = child;                                                        \
+      ++depth;                                                             \
+    }                                                                      \
+    /* Assemble. */                                                        \
+    pool[tails[1]].LINK.next = pool[elem].LINK.prev;                       \
+    pool[tails[0]].LINK.prev = pool[elem].LINK.next;                       \
+    pool[elem].LINK.prev = pool[SPLAT_IDX_NIL].LINK.next;                  \
+    pool[elem].LINK.next = pool[SPLAT_IDX_NIL].LINK.prev;                  \
+                                                                           \
+    tree->root = elem;                                                     \
+    SPLAT_STATS_SPLAY(tree, depth);                                        \
+    SPLAT_PROBE_SPLAY(tree, depth);                                        \
+  }
+
+#ifdef SPLAT_BRANCHLESS
+#define SPLAT_IDX_SPLAY SPLAT_IDX_CMOV
+#else
+#define SPLAT_IDX_SPLAY SPLAT_IDX_BRANCHY
+#endif
+
+/*
+ * Defines a new pooled splay tree library.
+ *
+ * Takes the same parameters as SPLAT_LIB() and generates the same functions,
+ * with elements still passed in and out as pointers into the tree's pool.
+ * SPLAT_STATS, SPLAT_COUNTED and SPLAT_BRANCHLESS apply as they do there.
+ *
+ * @param SPLAT_TYPE the type of the splay tree
+ * @param ELEM_TYPE the type of the tree's elements
+ * @param KEY_TYPE the type of the elements' keys
+ * @param CMP a compare function/macro that works on keys
+ * @param LINK the name of the link field
+ * @param KEY the name of the key field
+ */
+#define SPLAT_IDX_LIB(SPLAT_TYPE, ELEM_TYPE, KEY_TYPE, CMP, LINK, KEY)       \
+                                                                             \
+  static uint32_t SPLAT_TYPE##_rotate_prev(struct ELEM_TYPE* pool,           \
+                                           uint32_t elem) {                  \
+    assert(elem != SPLAT_IDX_NIL);                                           \
+    assert(pool[elem].LINK.next != SPLAT_IDX_NIL);                           \
+                                                                             \
+    uint32_t temp = pool[elem].LINK.next;                                    \
+    pool[elem].LINK.next = pool[temp].LINK.prev;                             \
+    pool[temp].LINK.prev = elem;                                             \
+                                                                             \
+    return temp;                                                             \
+  }                                                                          \
+                                                                             \
+  static uint32_t SPLAT_TYPE##_rotate_next(struct ELEM_TYPE* pool,           \
+                                           uint32_t elem) {                  \
+    assert(elem != SPLAT_IDX_NIL);                                           \
+    assert(pool[elem].LINK.prev != SPLAT_IDX_NIL);                           \
+                                                                             \
+    uint32_t temp = pool[elem].LINK.prev;                                    \
+    pool[elem].LINK.prev = pool[temp].LINK.next;                             \
+    pool[temp].LINK.next = elem;                                             \
+                                                                             \
+    return temp;                                                             \
+  }                                                                          \
+                                                                             \
+  SPLAT_IDX_SPLAY(SPLAT_TYPE, ELEM_TYPE, KEY_TYPE, CMP, LINK, KEY)           \
+                                                                             \
+  static uint32_t SPLAT_TYPE##_index_(SPLAT_TYPE* tree,                      \
+                                      struct ELEM_TYPE* elem) {              \
+    assert(elem > tree->pool && elem - tree->pool <= UINT32_MAX);            \
+                                                                             \
+    return (uint32_t)(elem - tree->pool);                                    \
+  }                                                                          \
+                                                                             \
+  void SPLAT_TYPE##_insert(SPLAT_TYPE* tree, struct ELEM_TYPE* elem) {       \
+    struct ELEM_TYPE* root;                                                  \
+    uint32_t idx;                                                            \
+                                                                             \
+    assert(tree != NULL);                                                    \
+    assert(elem != NULL);                                                    \
+                                                                             \
+    idx = SPLAT_TYPE##_index_(tree, elem);                                   \
+    SPLAT_STATS_ADD(tree, inserts, 1);                                       \
+    if (tree->root == SPLAT_IDX_NIL) {                                       \
+      SPLAT_COUNT_ADD(tree, 1);                                              \
+      tree->root = idx;                                                      \
+      return;                                                                \
+    }                                                                        \
+                                                                             \
+    SPLAT_TYPE##_splay(tree, elem->KEY);                                     \
+                                                                             \
+    root = &tree->pool[tree->root];                                          \
+    int c = CMP(elem->KEY, root->KEY);                                       \
+    SPLAT_STATS_ADD(tree, comparisons, 1);                                   \
+                                                                             \
+    if (c == 0) {                                                            \
+      return;                                                                \
+    }                                                                        \
+    if (c < 0) {                                                             \
+      elem->LINK.prev = root->LINK.prev;                                     \
+      elem->LINK.next = tree->root;                                          \
+      root->LINK.prev = SPLAT_IDX_NIL;                                       \
+    } else {                                                                 \
+      elem->LINK.next = root->LINK.next;                                     \
+      elem->LINK.prev = tree->root;                                          \
+      root->LINK.next = SPLAT_IDX_NIL;                                       \
+    }                                                                        \
+                                                                             \
+    SPLAT_COUNT_ADD(tree, 1);                                                \
+    tree->root = idx;                                                        \
+  }                                                                          \
+                                                                             \
+  /*                                                                         \
+   * Inserts an element next to HINT, like SPLAT_LIB()'s _insert_hint().     \
+   */                                                                        \
+  void SPLAT_TYPE##_insert_hint(SPLAT_TYPE* tree,                            \
+                                struct ELEM_TYPE* hint,                      \
+                                struct ELEM_TYPE* elem) {                    \
+    struct ELEM_TYPE* pool;                                                  \
+    struct ELEM_TYPE* root;                                                  \
+    uint32_t near;                                                           \
+                                                                             \
+    assert(tree != NULL);                                                    \
+    assert(elem != NULL);                                                    \
+                                                                             \
+    pool = tree->pool;                                                       \
+    if (hint == NULL || tree->root == SPLAT_IDX_NIL ||                       \
+        hint != &pool[tree->root]) {                                         \
+      SPLAT_TYPE##_insert(tree, elem);                                       \
+      return;                                                                \
+    }                                                                        \
+    root = hint;                                                             \
+                                                                             \
+    int c = CMP(elem->KEY, root->KEY);                                       \
+    SPLAT_STATS_ADD(tree, comparisons, 1);                                   \
+                                                                             \
+    if (c > 0) {                                                             \
+      /* The successor is root's next unless that has a prev subtree. */     \
+      near = root->LINK.next;                                                \
+      if (near != SPLAT_IDX_NIL) {                                           \
+        if (pool[near].LINK.prev != SPLAT_IDX_NIL) {                         \
+          SPLAT_TYPE##_insert(tree, elem);                                   \
+          return;                                                            \
+        }                                                                    \
+        SPLAT_STATS_ADD(tree, comparisons, 1);                               \
+        if (CMP(elem->KEY, pool[near].KEY) >= 0) {                           \
+          SPLAT_TYPE##_insert(tree, elem);                                   \
+          return;                                                            \
+        }                                                                    \
+      }                                                                      \
+      elem->LINK.prev = tree->root;                                          \
+      elem->LINK.next = near;                                                \
+      root->LINK.next = SPLAT_IDX_NIL;                                       \
+    } else if (c < 0) {                                                      \
+      /* Ditto for the predecessor. */                                       \
+      near = root->LINK.prev;                                                \
+      if (near != SPLAT_IDX_NIL) {                                           \
+        if (pool[near].LINK.next != SPLAT_IDX_NIL) {                         \
+          SPLAT_TYPE##_insert(tree, elem);                                   \
+          return;                                                            \
+        }                                                                    \
+        SPLAT_STATS_ADD(tree, comparisons, 1);                               \
+        if (CMP(elem->KEY, pool[near].KEY) <= 0) {                           \
+          SPLAT_TYPE##_insert(tree, elem);                                   \
+          return;                                                            \
+        }                                                                    \
+      }                                                                      \
+      elem->LINK.next = tree->root;                                          \
+      elem->LINK.prev = near;                                                \
+      root->LINK.prev = SPLAT_IDX_NIL;                                       \
+    } else {                                                                 \
+      SPLAT_STATS_ADD(tree, inserts, 1);                                     \
+      return;                                                                \
+    }                                                                        \
+                                                                             \
+    SPLAT_STATS_ADD(tree, inserts, 1);                                       \
+    SPLAT_COUNT_ADD(tree, 1);                                                \
+    tree->root = SPLAT_TYPE##_index_(tree, elem);                            \
+  }                                                                          \
+                                                                             \
+  /*                                                                         \
+   * Inserts an element whose key is greater than every key in the tree,     \
+   * like SPLAT_LIB()'s _insert_max().                                       \
+   */                                                                        \
+  void SPLAT_TYPE##_insert_max(SPLAT_TYPE* tree, struct ELEM_TYPE* elem) {   \
+    assert(tree != NULL);                                                    \
+    assert(elem != NULL);                                                    \
+                                                                             \
+    if (tree->root != SPLAT_IDX_NIL &&                                       \
+        tree->pool[tree->root].LINK.next != SPLAT_IDX_NIL) {                 \
+      SPLAT_TYPE##_splay(tree, elem->KEY);                                   \
+    }                                                                        \
+    assert(tree->root == SPLAT_IDX_NIL ||                                    \
+           tree->pool[tree->root].LINK.next == SPLAT_IDX_NIL);               \
+    assert(tree->root == SPLAT_IDX_NIL ||                                    \
+           CMP(elem->KEY, tree->pool[tree->root].KEY) > 0);                  \
+                                                                             \
+    SPLAT_STATS_ADD(tree, inserts, 1);                                       \
+    SPLAT_COUNT_ADD(tree, 1);                                                \
+    elem->LINK.prev = tree->root;                                            \
+    elem->LINK.next = SPLAT_IDX_NIL;                                         \
+    tree->root = SPLAT_TYPE##_index_(tree, elem);                            \
+  }                                                                          \
+                                                                             \
+  struct ELEM_TYPE* SPLAT_TYPE##_search(SPLAT_TYPE* tree, KEY_TYPE key) {    \
+    assert(tree != NULL);                                                    \
+                                                                             \
+    SPLAT_STATS_ADD(tree, searches, 1);                                      \
+    if (tree->root == SPLAT_IDX_NIL) {                                       \
+      return NULL;                                                           \
+    }                                                                        \
+    SPLAT_TYPE##_splay(tree, key);                                           \
+                                                                             \
+    SPLAT_STATS_ADD(tree, comparisons, 1);                                   \
+    if (CMP(key, tree->pool[tree->root].KEY) == 0) {                         \
+      return &tree->pool[tree->root];                                        \
+    }                                                                        \
+    return NULL;                                                             \
+  }                                                                          \
+                                                                             \
+  struct ELEM_TYPE* SPLAT_TYPE##_remove(SPLAT_TYPE* tree, KEY_TYPE key) {    \
+    uint32_t temp;                                                           \
+    struct ELEM_TYPE* removed = SPLAT_TYPE##_search(tree, key);              \
+                                                                             \
+    if (removed == NULL) {                                                   \
+      return NULL;                                                           \
+    }                                                                        \
+    SPLAT_STATS_ADD(tree, removes, 1);                                       \
+    SPLAT_COUNT_SUB(tree, 1);                                                \
+    if (removed->LINK.prev == SPLAT_IDX_NIL) {                               \
+      tree->root = removed->LINK.next;                                       \
+    } else {                                                                 \
+      temp = removed->LINK.next;                                             \
+      tree->root = removed->LINK.prev;                                       \
+      SPLAT_TYPE##_splay(tree, key);                                         \
+      tree->pool[tree->root].LINK.next = temp;                               \
+    }                                                                        \
+                                                                             \
+    return removed;                                                          \
+  }                                                                          \
+                                                                             \
+  /*                                                                         \
+   * Removes every element from the tree, calling FN on each one in key      \
+   * order.  FN may be NULL.  Runs in O(n) time and O(1) space.              \
+   */                                                                        \
+  void SPLAT_TYPE##_clear(SPLAT_TYPE* tree, void (*fn)(struct ELEM_TYPE*)) { \
+    struct ELEM_TYPE* pool;                                                  \
+    uint32_t elem;                                                           \
+    uint32_t next;                                                           \
+                                                                             \
+    assert(tree != NULL);                                                    \
+                                                                             \
+    pool = tree->pool;                                                       \
+    elem = tree->root;                                                       \
+    tree->root = SPLAT_IDX_NIL;                                              \
+    SPLAT_COUNT_RESET(tree);                                                 \
+    while (elem != SPLAT_IDX_NIL) {                                          \
+      if (pool[elem].LINK.prev != SPLAT_IDX_NIL) {                           \
+        elem = SPLAT_TYPE##_rotate_next(pool, elem);                         \
+        continue;                                                            \
+      }                                                                      \
+      next = pool[elem].LINK.next;                                           \
+      pool[elem].LINK.next = SPLAT_IDX_NIL;                                  \
+      if (fn != NULL) {                                                      \
+        fn(&pool[elem]);                                                     \
+      }                                                                      \
+      elem = next;                                                           \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  /*                                                                         \
+   * Left-rotates every other element down the next links of a vine, COUNT   \
+   * times, starting below ROOT.  One pass of Day-Stout-Warren.              \
+   */                                                                        \
+  static void SPLAT_TYPE##_compress(struct ELEM_TYPE* pool,                  \
+                                    uint32_t root,                           \
+                                    size_t count) {                          \
+    uint32_t scan = root;                                                    \
+    uint32_t child;                                                          \
+                                                                             \
+    while (count-- > 0) {                                                    \
+      child = pool[scan].LINK.next;                                          \
+      pool[scan].LINK.next = SPLAT_TYPE##_rotate_prev(pool, child);          \
+      scan = pool[scan].LINK.next;                                           \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  /*                                                                         \
+   * Removes every element for which PRED returns non-zero, then rebuilds    \
+   * the remaining elements into a balanced tree, like SPLAT_LIB()'s         \
+   * _remove_if().  The nil slot heads the vine while it is rebuilt.         \
+   */                                                                        \
+  size_t SPLAT_TYPE##_remove_if(SPLAT_TYPE* tree,                            \
+                                int (*pred)(struct ELEM_TYPE*)) {            \
+    struct ELEM_TYPE* pool;                                                  \
+    uint32_t tail = SPLAT_IDX_NIL;                                           \
+    uint32_t elem;                                                           \
+    uint32_t next;                                                           \
+    size_t kept = 0;                                                         \
+    size_t removed = 0;                                                      \
+    size_t full;                                                             \
+                                                                             \
+    assert(tree != NULL);                                                    \
+    assert(pred != NULL);                                                    \
+                                                                             \
+    pool = tree->pool;                                                       \
+    pool[SPLAT_IDX_NIL].LINK.prev = SPLAT_IDX_NIL;                           \
+    pool[SPLAT_IDX_NIL].LINK.next = SPLAT_IDX_NIL;                           \
+                                                                             \
+    /* Flatten into a sorted vine of the survivors. */                       \
+    elem = tree->root;                                                       \
+    while (elem != SPLAT_IDX_NIL) {                                          \
+      if (pool[elem].LINK.prev != SPLAT_IDX_NIL) {                           \
+        elem = SPLAT_TYPE##_rotate_next(pool, elem);                         \
+        continue;                                                            \
+      }                                                                      \
+      next = pool[elem].LINK.next;                                           \
+      pool[elem].LINK.next = SPLAT_IDX_NIL;                                  \
+      if (pred(&pool[elem])) {                                               \
+        ++removed;                                                           \
+      } else {                                                               \
+        pool[tail].LINK.next = elem;                                         \
+        tail = elem;                                                         \
+        ++kept;                                                              \
+      }                                                                      \
+      elem = next;                                                           \
+    }                                                                        \
+                                                                             \
+    /* Fold the vine into a balanced tree. */                                \
+    full = 1;                                                                \
+    while (full <= kept + 1) {                                               \
+      full <<= 1;                                                            \
+    }                                                                        \
+    full = (full >> 1) - 1;                                                  \
+    SPLAT_TYPE##_compress(pool, SPLAT_IDX_NIL, kept - full);                 \
+    while (full > 1) {                                                       \
+      full >>= 1;                                                            \
+      SPLAT_TYPE##_compress(pool, SPLAT_IDX_NIL, full);                      \
+    }                                                                        \
+                                                                             \
+    tree->root = pool[SPLAT_IDX_NIL].LINK.next;                              \
+    SPLAT_COUNT_SUB(tree, removed);                                          \
+    return removed;                                                          \
+  }                                                                          \
+                                                                             \
+  /*                                                                         \
+   * Calls FN on every element in order, with the element's depth below the  \
+   * root and CTX, like SPLAT_LIB()'s _walk().                               \
+   */                                                                        \
+  void SPLAT_TYPE##_walk(SPLAT_TYPE* tree,                                   \
+                         void (*fn)(struct ELEM_TYPE*, size_t, void*),       \
+                         void* ctx) {                                        \
+    struct ELEM_TYPE* pool;                                                  \
+    uint32_t elem;                                                           \
+    uint32_t pred;                                                           \
+    size_t depth = 0;                                                        \
+    size_t steps;                                                            \
+                                                                             \
+    assert(tree != NULL);                                                    \
+    assert(fn != NULL);                                                      \
+                                                                             \
+    pool = tree->pool;                                                       \
+    elem = tree->root;                                                       \
+    while (elem != SPLAT_IDX_NIL) {                                          \
+      if (pool[elem].LINK.prev != SPLAT_IDX_NIL) {                           \
+        /* Find the in-order predecessor of the current element. */          \
+        pred = pool[elem].LINK.prev;                                         \
+        steps = 1;                                                           \
+        while (pool[pred].LINK.next != SPLAT_IDX_NIL &&                      \
+               pool[pred].LINK.next != elem) {                               \
+          pred = pool[pred].LINK.next;                                       \
+          ++steps;                                                           \
+        }                                                                    \
+        if (pool[pred].LINK.next == SPLAT_IDX_NIL) {                         \
+          /* Thread the predecessor back to us and descend. */               \
+          pool[pred].LINK.next = elem;                                       \
+          elem = pool[elem].LINK.prev;                                       \
+          ++depth;                                                           \
+          continue;                                                          \
+        }                                                                    \
+        /* Came back up the thread from pred, undo the descent. */           \
+        pool[pred].LINK.next = SPLAT_IDX_NIL;                                \
+        depth -= steps + 1;                                                  \
+      }                                                                      \
+                                                                             \
+      fn(&pool[elem], depth, ctx);                                           \
+      elem = pool[elem].LINK.next;                                           \
+      ++depth;                                                               \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  SPLAT_WALK_LIB_(SPLAT_TYPE, ELEM_TYPE)
+
 #endif
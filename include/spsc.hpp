@@ -0,0 +1,142 @@
+/*
+ * Implementation of a bounded single-producer, single-consumer channel.
+ *
+ * The layout follows circbuf: N slots stored in place with front and back
+ * indices, where the limit is exclusive so the channel holds N - 1 elements.
+ * Unlike circbuf, slots are raw storage, so elements are constructed in place
+ * on push and moved out and destroyed on pop.  Nothing is default
+ * constructed, nothing is copied, and move-only types work.
+ *
+ * One thread may push and one other thread may pop concurrently.
+ */
+
+#ifndef __CONVOY_SPSC_HPP__
+#define __CONVOY_SPSC_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace convoy {
+
+/*
+ * Size used to keep the producer's and the consumer's indices on separate
+ * cache lines.
+ */
+inline constexpr std::size_t cache_line_size = 64;
+
+template <class T, std::size_t N>
+class spsc_channel {
+  static_assert(N > 1, "the limit is exclusive, so it must be at least 2");
+
+ public:
+  spsc_channel() noexcept = default;
+  spsc_channel(const spsc_channel&) = delete;
+  spsc_channel& operator=(const spsc_channel&) = delete;
+
+  /*
+   * Destroys any elements still in the channel.
+   */
+  ~spsc_channel() {
+    std::size_t back = back_.load(std::memory_order_acquire);
+    for (std::size_t i = front_.load(std::memory_order_relaxed); i != back;
+         i = rotate_right(i)) {
+      slot(i)->~T();
+    }
+  }
+
+  static constexpr std::size_t capacity() noexcept { return N - 1; }
+
+  /*
+   * Constructs an element at the back from ARGS.  Returns false, without
+   * touching ARGS, if the channel is full.  Producer only.
+   */
+  template <class... Args>
+  bool try_emplace(Args&&... args) noexcept(
+    std::is_nothrow_constructible_v<T, Args&&...>) {
+    std::size_t back = back_.load(std::memory_order_relaxed);
+    std::size_t next = rotate_right(back);
+
+    if (next == cached_front_) {
+      cached_front_ = front_.load(std::memory_order_acquire);
+      if (next == cached_front_) {
+        return false;
+      }
+    }
+
+    ::new (static_cast<void*>(slots_[back].bytes))
+      T(std::forward<Args>(args)...);
+    back_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool try_push(T&& elem) noexcept(std::is_nothrow_move_constructible_v<T>) {
+    return try_emplace(std::move(elem));
+  }
+
+  bool try_push(const T& elem) noexcept(
+    std::is_nothrow_copy_constructible_v<T>) {
+    return try_emplace(elem);
+  }
+
+  /*
+   * Moves the front element out, or returns nullopt if the channel is empty.
+   * Consumer only.
+   */
+  std::optional<T> try_pop() noexcept(
+    std::is_nothrow_move_constructible_v<T>) {
+    std::size_t front = front_.load(std::memory_order_relaxed);
+
+    if (front == cached_back_) {
+      cached_back_ = back_.load(std::memory_order_acquire);
+      if (front == cached_back_) {
+        return std::nullopt;
+      }
+    }
+
+    T* elem = slot(front);
+    std::optional<T> out(std::move(*elem));
+    elem->~T();
+    front_.store(rotate_right(front), std::memory_order_release);
+    return out;
+  }
+
+  /*
+   * Checks whether the channel is empty.  Only exact when called by the
+   * consumer.
+   */
+  bool empty() const noexcept {
+    return front_.load(std::memory_order_relaxed) ==
+           back_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static constexpr std::size_t rotate_right(std::size_t i) noexcept {
+    return (i + 1) % N;
+  }
+
+  T* slot(std::size_t i) noexcept {
+    return std::launder(reinterpret_cast<T*>(slots_[i].bytes));
+  }
+
+  struct storage {
+    alignas(T) unsigned char bytes[sizeof(T)];
+  };
+
+  /* Written by the consumer. */
+  alignas(cache_line_size) std::atomic<std::size_t> front_{ 0 };
+  std::size_t cached_back_ = 0;
+
+  /* Written by the producer. */
+  alignas(cache_line_size) std::atomic<std::size_t> back_{ 0 };
+  std::size_t cached_front_ = 0;
+
+  alignas(cache_line_size) storage slots_[N];
+};
+
+}  // namespace convoy
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * Implementation of a triple buffer, a single-slot mailbox for publishing the
+ * latest value of some state from one thread to another.
+ *
+ * Like circbuf, the buffers are stored in place in a type produced by
+ * TRIBUF_DECLARE().  At any time the writer owns one buffer, the reader owns
+ * another, and the third sits in the middle holding the last published value.
+ * Publishing swaps the writer's buffer with the middle one, and reading
+ * swaps the middle one with the reader's if it holds something newer.  Both
+ * sides are wait-free, a single atomic exchange each, and neither ever sees
+ * a value the other is still working on.  Values the reader never got to are
+ * simply overwritten.
+ *
+ * The writer fills its buffer in place, so nothing is copied beyond the
+ * writer's own write.  One thread may write and one other thread may read
+ * concurrently.
+ *
+ * The atomics are the GCC/Clang __atomic builtins.
+ */
+
+#ifndef __CONVOY_TRIBUF_H__
+#define __CONVOY_TRIBUF_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Used to give macros a void return value.
+ */
+#define TRIBUF_VOID ((void)0)
+
+#ifdef TRIBUF_ASSERTS
+#include <assert.h>
+#define TRIBUF_ASSERT(...) assert(__VA_ARGS__)
+#else
+#define TRIBUF_ASSERT(...) TRIBUF_VOID
+#endif
+
+/*
+ * Size used to keep the writer's and the reader's state, and the buffers, on
+ * separate cache lines.
+ */
+#define TRIBUF_CACHE_LINE 64
+
+/*
+ * The bits of the shared state that hold the middle buffer's index.
+ */
+#define TRIBUF_INDEX 0x3
+
+/*
+ * The bit of the shared state that is set when the middle buffer holds a
+ * value the reader hasn't taken yet.
+ */
+#define TRIBUF_FRESH 0x4
+
+/*
+ * Declares a new triple buffer type.
+ *
+ * TB_TYPE is the name of the new type.  ELEM_TYPE is the type name of the
+ * values to publish.  The type is aligned to a cache line, and each buffer
+ * starts on a cache line of its own.  Static and automatic triple buffers
+ * get that alignment from the compiler, but one on the heap must come from
+ * aligned_alloc() or the like, since malloc() only aligns for the standard
+ * types.
+ */
+#define TRIBUF_DECLARE(TB_TYPE, ELEM_TYPE)                             \
+  typedef struct __attribute__((aligned(TRIBUF_CACHE_LINE))) TB_TYPE { \
+    struct __attribute__((aligned(TRIBUF_CACHE_LINE))) {               \
+      ELEM_TYPE elem;                                                  \
+    } bufs[3];                                                         \
+    /* Shared, only touched atomically. */                             \
+    unsigned char state;                                               \
+    char pad0_[TRIBUF_CACHE_LINE - 1];                                 \
+    /* Written by the writer. */                                       \
+    unsigned char back;                                                \
+    char pad1_[TRIBUF_CACHE_LINE - 1];                                 \
+    /* Written by the reader. */                                       \
+    unsigned char front;                                               \
+  } TB_TYPE
+
+/*
+ * Initializes a triple buffer.  Until the first value is published, the
+ * reader sees whatever its buffer held before.
+ */
+#define TRIBUF_INIT(TB) \
+  ((TB)->state = 1,     \
+   (TB)->back = 0,      \
+   (TB)->front = 2,     \
+                        \
+   TRIBUF_VOID)
+
+/*
+ * Statically initializes a triple buffer.  The reader sees a zeroed value
+ * until the first value is published.
+ */
+#define TRIBUF_STATIC_INIT \
+  { .state = 1, .back = 0, .front = 2 }
+
+/*
+ * Gets a pointer to the writer's buffer, to fill in place before calling
+ * TRIBUF_PUBLISH().  The buffer holds a stale value, not the last one
+ * published.  Writer only.
+ */
+#define TRIBUF_WRITE_BUF(TB)       \
+  (TRIBUF_ASSERT((TB)->back <= 2), \
+                                   \
+   &(TB)->bufs[(TB)->back].elem)
+
+/*
+ * Publishes the writer's buffer, and takes the middle buffer in its place.
+ * Never blocks.  Writer only.
+ */
+#define TRIBUF_PUBLISH(TB)                                              \
+  (TRIBUF_ASSERT((TB)->back <= 2),                                      \
+                                                                        \
+   /* Releases the new value, and acquires the reader's last use of the \
+    * buffer we get back. */                                            \
+   (TB)->back = __atomic_exchange_n(&(TB)->state,                       \
+                                    (unsigned char)((TB)->back |        \
+                                                    TRIBUF_FRESH),      \
+                                    __ATOMIC_ACQ_REL) &                 \
+                TRIBUF_INDEX,                                           \
+                                                                        \
+   TRIBUF_VOID)
+
+/*
+ * Copies ELEM into the writer's buffer and publishes it.  Writer only.
+ */
+#define TRIBUF_WRITE(TB, ELEM)     \
+  (*TRIBUF_WRITE_BUF(TB) = (ELEM), \
+                                   \
+   TRIBUF_PUBLISH(TB))
+
+/*
+ * Checks whether a value has been published since the reader last took one.
+ * Reader only.
+ */
+#define TRIBUF_HAS_FRESH(TB) \
+  ((__atomic_load_n(&(TB)->state, __ATOMIC_RELAXED) & TRIBUF_FRESH) != 0)
+
+/*
+ * Takes the newest published value, if the reader doesn't already have it.
+ * Never blocks.  Returns true if the reader's buffer changed.  Reader only.
+ */
+#define TRIBUF_UPDATE(TB)                                                  \
+  (TRIBUF_ASSERT((TB)->front <= 2),                                        \
+                                                                           \
+   (!TRIBUF_HAS_FRESH(TB))                                                 \
+     ? false                                                               \
+     : (/* Acquires the new value, and releases our use of the old one. */ \
+        (TB)->front = __atomic_exchange_n(&(TB)->state,                    \
+                                          (TB)->front,                     \
+                                          __ATOMIC_ACQ_REL) &              \
+                      TRIBUF_INDEX,                                        \
+                                                                           \
+        true))
+
+/*
+ * Gets a pointer to the newest published value.  The value stays put until
+ * the reader's next TRIBUF_READ() or TRIBUF_UPDATE().  Reader only.
+ */
+#define TRIBUF_READ(TB) (TRIBUF_UPDATE(TB), &(TB)->bufs[(TB)->front].elem)
+
+/*
+ * Gets a pointer to the value the reader took last, without looking for a
+ * newer one.  Reader only.
+ */
+#define TRIBUF_PEEK(TB)             \
+  (TRIBUF_ASSERT((TB)->front <= 2), \
+                                    \
+   &(TB)->bufs[(TB)->front].elem)
+
+#endif
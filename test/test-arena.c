@@ -0,0 +1,55 @@
+#define ARENA_ASSERTS
+
+#include "arena.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BUF_SIZE 256
+
+static unsigned char buf[BUF_SIZE + 64];
+
+int main(void) {
+  /* Start from a 64-byte boundary so the padding below is predictable. */
+  unsigned char* base = buf + (-(uintptr_t)buf & 63);
+  arena a = ARENA_STATIC_INIT(base, BUF_SIZE);
+
+  assert(ARENA_REMAINING(&a) == BUF_SIZE);
+
+  unsigned char* c = arena_alloc(&a, 1, 1);
+  assert(c == base);
+
+  /* Padding is inserted to satisfy alignment. */
+  uint64_t* u = arena_alloc(&a, sizeof(*u), 8);
+  assert((uintptr_t)u % 8 == 0);
+  assert((unsigned char*)u == base + 8);
+  assert(a.used == 16);
+
+  size_t mark = ARENA_MARK(&a);
+  assert(arena_alloc(&a, 64, 64) == base + 64);
+  assert(a.used == 128);
+  ARENA_RELEASE(&a, mark);
+  assert(a.used == 16);
+
+  /* Running out of room, including through padding alone. */
+  assert(arena_alloc(&a, BUF_SIZE - 15, 1) == NULL);
+  assert(arena_alloc(&a, BUF_SIZE - 16, 1) == base + 16);
+  assert(ARENA_REMAINING(&a) == 0);
+  assert(arena_alloc(&a, 0, 1) == base + BUF_SIZE);
+  assert(arena_alloc(&a, 1, 1) == NULL);
+
+  ARENA_RESET(&a);
+  a.used = 1;
+  assert(arena_alloc(&a, BUF_SIZE - 64, 64) == base + 64);
+  assert(arena_alloc(&a, 0, 128) == NULL);
+
+  arena b;
+  ARENA_INIT(&b, base, 8);
+  assert(arena_alloc(&b, 8, 16) == base);
+  assert(arena_alloc(&b, 1, 1) == NULL);
+
+  printf("[ %zu ]\n", a.used);
+
+  return 0;
+}
@@ -0,0 +1,175 @@
+#define CONVOY_ASSERTS
+
+#include "cochan.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+static std::size_t allocations = 0;
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+#define COUNT 10000
+
+static convoy::task produce(convoy::channel<int, 4>& chan, int first, int n) {
+  for (int i = first; i < first + n; ++i) {
+    co_await chan.push(i);
+  }
+}
+
+static convoy::task consume(convoy::channel<int, 4>& chan, int n, long& sum) {
+  int last = -1;
+  for (int i = 0; i < n; ++i) {
+    int x = co_await chan.pop();
+    assert(x == last + 1);
+    last = x;
+    sum += x;
+  }
+}
+
+static convoy::task relay(convoy::channel<std::unique_ptr<int>, 2>& in,
+                          convoy::channel<std::unique_ptr<int>, 2>& out,
+                          int n) {
+  for (int i = 0; i < n; ++i) {
+    std::unique_ptr<int> p = co_await in.pop();
+    *p += 1;
+    co_await out.push(std::move(p));
+  }
+}
+
+static convoy::task send_ptrs(convoy::channel<std::unique_ptr<int>, 2>& chan,
+                              int n) {
+  for (int i = 0; i < n; ++i) {
+    co_await chan.push(std::make_unique<int>(i));
+  }
+}
+
+static convoy::task recv_ptrs(convoy::channel<std::unique_ptr<int>, 2>& chan,
+                              int n, int& seen) {
+  for (int i = 0; i < n; ++i) {
+    std::unique_ptr<int> p = co_await chan.pop();
+    assert(*p == i + 1);
+    ++seen;
+  }
+}
+
+static convoy::task select_loop(convoy::channel<int, 2>& a,
+                                convoy::channel<int, 8>& b, int n,
+                                int (&from)[2]) {
+  for (int i = 0; i < n; ++i) {
+    auto [index, x] = co_await convoy::select(a, b);
+    assert(x == static_cast<int>(index) * 1000 + from[index]);
+    ++from[index];
+  }
+}
+
+template <std::size_t N>
+static convoy::task send_offset(convoy::channel<int, N>& chan, int base,
+                                int n) {
+  for (int i = 0; i < n; ++i) {
+    co_await chan.push(base + i);
+  }
+}
+
+struct exit_counter {
+  int& count;
+  ~exit_counter() { ++count; }
+};
+
+static convoy::task wait_forever(convoy::channel<int, 4>& chan, int& exited) {
+  exit_counter guard{ exited };
+  co_await chan.pop();
+}
+
+int main() {
+  /* A producer and a consumer take turns through a small ring. */
+  {
+    convoy::channel<int, 4> chan;
+    convoy::executor exec;
+    long sum = 0;
+
+    exec.spawn(consume(chan, COUNT, sum));
+    exec.spawn(produce(chan, 0, COUNT));
+    assert(exec.live() == 2);
+
+    /* Frames are allocated on creation; the channel never allocates. */
+    std::size_t before = allocations;
+    exec.run();
+    assert(allocations == before);
+
+    assert(sum == (long)COUNT * (COUNT - 1) / 2);
+    assert(exec.live() == 0);
+    assert(chan.empty());
+  }
+
+  /* Move-only elements through two single-slot channels. */
+  {
+    convoy::channel<std::unique_ptr<int>, 2> in;
+    convoy::channel<std::unique_ptr<int>, 2> out;
+    convoy::executor exec;
+    int seen = 0;
+
+    exec.spawn(recv_ptrs(out, 100, seen));
+    exec.spawn(relay(in, out, 100));
+    exec.spawn(send_ptrs(in, 100));
+    exec.run();
+    assert(seen == 100);
+    assert(exec.live() == 0);
+  }
+
+  /* Select cancels its other receivers once one channel delivers. */
+  {
+    convoy::channel<int, 2> a;
+    convoy::channel<int, 8> b;
+    convoy::executor exec;
+    int from[2] = { 0, 0 };
+
+    exec.spawn(select_loop(a, b, 200, from));
+    exec.spawn(send_offset(a, 0, 100));
+    exec.spawn(send_offset(b, 1000, 100));
+    exec.run();
+    assert(from[0] == 100);
+    assert(from[1] == 100);
+    assert(a.empty() && b.empty());
+    assert(exec.live() == 0);
+
+    /* No receiver is left parked, so pushing just buffers. */
+    std::optional<int> x;
+    assert(a.try_push(7));
+    assert(a.size() == 1);
+    assert(a.try_pop(x) && *x == 7);
+  }
+
+  /* Tasks still waiting are destroyed along with their executor. */
+  {
+    int exited = 0;
+    convoy::channel<int, 4> chan;
+    {
+      convoy::executor exec;
+      exec.spawn(wait_forever(chan, exited));
+      exec.spawn(wait_forever(chan, exited));
+      exec.run();
+      assert(exec.live() == 2);
+      assert(exited == 0);
+    }
+    assert(exited == 2);
+    assert(chan.try_push(1));
+    assert(chan.size() == 1);
+  }
+
+  puts("[ ok ]");
+
+  return 0;
+}
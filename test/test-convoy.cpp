@@ -0,0 +1,201 @@
+#define CONVOY_ASSERTS
+
+#include "convoy.hpp"
+#include "dlist.h"
+#include "slist.h"
+#include "splat.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static std::size_t allocations = 0;
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+struct block {
+  DLIST_DECLARE_LINK(block, dlink);
+  SLIST_DECLARE_LINK(block, slink);
+  SPLAT_LINK(block, link);
+  int key;
+};
+
+using deque = convoy::intrusive_dlist<block, &block::dlink>;
+using queue = convoy::intrusive_slist<block, &block::slink>;
+using tree = convoy::splay_tree<block, int, &block::key>;
+
+struct host {
+  SPLAT_LINK(host, link);
+  std::string name;
+};
+
+using hosts = convoy::splay_tree<host, std::string, &host::name, std::less<>>;
+using ring = convoy::circbuf<std::string, 5>;
+
+static_assert(std::ranges::bidirectional_range<deque>);
+static_assert(std::ranges::forward_range<queue>);
+static_assert(std::ranges::bidirectional_range<ring>);
+static_assert(std::ranges::bidirectional_range<const ring>);
+static_assert(std::ranges::bidirectional_range<tree>);
+static_assert(std::is_nothrow_move_constructible_v<deque>);
+static_assert(std::is_nothrow_move_constructible_v<queue>);
+static_assert(std::is_nothrow_move_constructible_v<ring>);
+static_assert(std::is_nothrow_move_constructible_v<tree>);
+
+/* The C++ lists are layout-compatible with the C ones. */
+DLIST_DECLARE(c_deque, block);
+static_assert(sizeof(deque) == sizeof(c_deque));
+
+template <class Range>
+static std::vector<int> keys(Range&& range) {
+  std::vector<int> out;
+  for (block& blk : range) {
+    out.push_back(blk.key);
+  }
+  return out;
+}
+
+int main() {
+  block blocks[8] = {};
+  for (int i = 0; i < 8; ++i) {
+    blocks[i].key = i;
+  }
+
+  deque deq;
+  assert(deq.empty());
+  assert(deq.pop_front() == nullptr);
+  deq.push_back(blocks[1]);
+  deq.push_front(blocks[0]);
+  deq.push_back(blocks[3]);
+  deq.insert_next(blocks[1], blocks[2]);
+  assert((keys(deq) == std::vector<int>{ 0, 1, 2, 3 }));
+  assert((keys(deq | std::views::reverse) == std::vector<int>{ 3, 2, 1, 0 }));
+  assert(std::ranges::distance(deq) == 4);
+
+  /* The C macros see the same list. */
+  c_deque* c_view = reinterpret_cast<c_deque*>(&deq);
+  block* popped;
+  DLIST_POP_BACK(c_view, popped, dlink);
+  assert(popped == &blocks[3]);
+
+  deq.remove(blocks[1]);
+  assert(!deque::is_linked(blocks[1]));
+  assert((keys(deq) == std::vector<int>{ 0, 2 }));
+
+  deque moved(std::move(deq));
+  assert(deq.empty());
+  assert(moved.pop_back() == &blocks[2]);
+  assert(moved.pop_front() == &blocks[0]);
+  assert(moved.empty());
+
+  queue qu;
+  qu.push_back(blocks[4]);
+  qu.push_back(blocks[5]);
+  qu.push_front(blocks[3]);
+  assert((keys(qu) == std::vector<int>{ 3, 4, 5 }));
+  auto found = std::ranges::find(qu, 4, &block::key);
+  assert(&*found == &blocks[4]);
+  assert(qu.pop_front() == &blocks[3]);
+  assert(qu.pop_front() == &blocks[4]);
+  assert(qu.pop_front() == &blocks[5]);
+  assert(qu.pop_front() == nullptr);
+
+  ring rb;
+  assert(ring::capacity() == 4);
+  assert(rb.push_back(std::string("b")));
+  assert(rb.push_front(std::string("a")));
+  assert(rb.push_back(std::string("c")));
+  assert(rb.push_back(std::string("d")));
+  assert(!rb.push_back(std::string("e")));
+  assert(rb.size() == 4);
+  std::string joined;
+  for (const std::string& s : std::as_const(rb)) {
+    joined += s;
+  }
+  assert(joined == "abcd");
+
+  std::string out;
+  assert(rb.pop_back(out) && out == "d");
+  assert(rb.pop_front(out) && out == "a");
+  ring rb2(std::move(rb));
+  assert(rb.empty());
+  assert(rb2.size() == 2 && rb2.front() == "b" && rb2.back() == "c");
+  ring& self = rb2;
+  rb2 = std::move(self);
+  assert(rb2.size() == 2 && rb2.front() == "b" && rb2.back() == "c");
+  rb = std::move(rb2);
+  assert(rb2.empty());
+  assert(rb.size() == 2 && rb.front() == "b" && rb.back() == "c");
+
+  tree tr;
+  for (int i : { 5, 1, 7, 3, 0, 6, 2, 4 }) {
+    assert(tr.insert(blocks[i]).second);
+  }
+  block dup = {};
+  dup.key = 3;
+  assert(!tr.insert(dup).second);
+  assert((keys(tr) == std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7 }));
+  assert((keys(tr | std::views::reverse) ==
+          std::vector<int>{ 7, 6, 5, 4, 3, 2, 1, 0 }));
+  assert(tr.find(6)->key == 6);
+  assert(tr.find(9) == tr.end());
+  assert(tr.contains(0));
+
+  assert(tr.erase(3) == &blocks[3]);
+  assert(tr.erase(3) == nullptr);
+  assert(tr.lower_bound(3)->key == 4);
+  assert(tr.lower_bound(8) == tr.end());
+  assert(std::ranges::count_if(tr, [](const block& b) { return b.key % 2; }) ==
+         3);
+
+  int cleared = 0;
+  tr.clear([&](block& b) {
+    assert(b.key == (cleared < 3 ? cleared : cleared + 1));
+    ++cleared;
+  });
+  assert(cleared == 7);
+  assert(tr.empty());
+
+  /* Names past the small-string buffer, so a temporary would allocate. */
+  host hs[4] = {};
+  hs[0].name = "alpha.example.internal";
+  hs[1].name = "bravo.example.internal";
+  hs[2].name = "charlie.example.internal";
+  hs[3].name = "delta.example.internal";
+  hosts ht;
+  for (host& h : hs) {
+    assert(ht.insert(h).second);
+  }
+
+  std::size_t before = allocations;
+  std::string_view sv = "charlie.example.internal";
+  assert(ht.find(sv) == ht.find("charlie.example.internal"));
+  assert(&*ht.find(sv) == &hs[2]);
+  assert(ht.contains("alpha.example.internal"));
+  assert(!ht.contains(std::string_view("echo.example.internal")));
+  assert(ht.lower_bound("c")->name == hs[2].name);
+  assert(ht.erase(std::string_view("bravo.example.internal")) == &hs[1]);
+  assert(!ht.contains("bravo.example.internal"));
+  assert(allocations == before);
+  ht.clear();
+
+  puts("[ ok ]");
+
+  return 0;
+}
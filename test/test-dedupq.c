@@ -0,0 +1,191 @@
+#define CIRCBUF_ASSERTS
+#define DEDUPQ_ASSERTS
+
+#include "dedupq.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+DEDUPQ_DECLARE(idq, uint64_t, 8);
+DEDUPQ_LIB(idq, uint64_t, dedupq_hash_u64, DEDUPQ_EQ)
+
+/* Every key hashes into one of four slots, so probe runs wrap and collide. */
+#define WEAK_HASH(KEY) ((KEY) & 3)
+
+DEDUPQ_DECLARE(weakq, uint64_t, 64);
+DEDUPQ_LIB(weakq, uint64_t, WEAK_HASH, DEDUPQ_EQ)
+
+static uint64_t hash_str(const char* s) {
+  uint64_t h = 14695981039346656037ULL;
+
+  while (*s != '\0') {
+    h = (h ^ (unsigned char)*s++) * 1099511628211ULL;
+  }
+  return h;
+}
+
+#define STR_EQ(A, B) (strcmp((A), (B)) == 0)
+
+DEDUPQ_DECLARE(strq, const char*, 16);
+DEDUPQ_LIB(strq, const char*, hash_str, STR_EQ)
+
+static void test_basic(void) {
+  idq q = DEDUPQ_STATIC_INIT(8);
+  uint64_t key;
+
+  DEDUPQ_INIT(&q);
+  assert(DEDUPQ_ISEMPTY(&q));
+  assert(!idq_pop(&q, &key));
+
+  assert(idq_push(&q, 5));
+  assert(idq_push(&q, 9));
+  assert(idq_push(&q, 5));
+  assert(idq_push(&q, 9));
+  assert(DEDUPQ_COUNT(&q) == 2);
+  assert(idq_contains(&q, 5));
+  assert(!idq_contains(&q, 7));
+
+  assert(idq_pop(&q, &key));
+  assert(key == 5);
+  assert(!idq_contains(&q, 5));
+
+  /* Once popped, a key can be queued again, behind the others. */
+  assert(idq_push(&q, 5));
+  assert(DEDUPQ_COUNT(&q) == 2);
+  assert(idq_pop(&q, &key));
+  assert(key == 9);
+  assert(idq_pop(&q, &key));
+  assert(key == 5);
+  assert(DEDUPQ_ISEMPTY(&q));
+}
+
+static void test_full(void) {
+  idq q;
+  uint64_t key;
+  uint64_t i;
+
+  DEDUPQ_INIT(&q);
+  for (i = 0; i < 7; ++i) {
+    assert(idq_push(&q, i * 100));
+  }
+  assert(DEDUPQ_ISFULL(&q));
+
+  /* A full queue turns new keys away but still absorbs duplicates. */
+  assert(!idq_push(&q, 1));
+  assert(idq_push(&q, 300));
+  assert(DEDUPQ_COUNT(&q) == 7);
+
+  for (i = 0; i < 7; ++i) {
+    assert(idq_pop(&q, &key));
+    assert(key == i * 100);
+  }
+  assert(!idq_contains(&q, 1));
+  assert(DEDUPQ_ISEMPTY(&q));
+}
+
+static void test_batch(void) {
+  static const uint64_t keys[] = { 1, 2, 1, 3, 2, 4, 5, 6, 7, 8, 9 };
+  idq q;
+  uint64_t out[16];
+
+  DEDUPQ_INIT(&q);
+  assert(idq_push_n(&q, keys, 0) == 0);
+
+  /* 1, 2, 3, 4, 5, 6, 7 fill the queue, and 8 doesn't fit. */
+  assert(idq_push_n(&q, keys, 11) == 9);
+  assert(DEDUPQ_COUNT(&q) == 7);
+
+  assert(idq_pop_n(&q, out, 3) == 3);
+  assert(out[0] == 1 && out[1] == 2 && out[2] == 3);
+  assert(idq_push_n(&q, keys + 9, 2) == 2);
+  assert(idq_pop_n(&q, out, 16) == 6);
+  assert(out[0] == 4 && out[5] == 9);
+  assert(idq_pop_n(&q, out, 16) == 0);
+}
+
+/*
+ * Pushes and pops pseudorandom keys, mostly duplicates, against a plain array
+ * of the pending keys.
+ */
+static void test_model(void) {
+  weakq q;
+  uint64_t model[63];
+  size_t len = 0;
+  uint64_t state = 1;
+  uint64_t key;
+  bool pending;
+  size_t i;
+  size_t j;
+  int n;
+
+  DEDUPQ_INIT(&q);
+  for (n = 0; n < 200000; ++n) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    key = (state >> 33) % 96;
+
+    if ((state >> 20) % 3 != 0) {
+      pending = false;
+      for (i = 0; i < len; ++i) {
+        pending = pending || model[i] == key;
+      }
+      if (pending || len < 63) {
+        assert(weakq_push(&q, key));
+        if (!pending) {
+          model[len++] = key;
+        }
+      } else {
+        assert(!weakq_push(&q, key));
+      }
+    } else if (len > 0) {
+      assert(weakq_pop(&q, &key));
+      assert(key == model[0]);
+      memmove(model, model + 1, --len * sizeof(model[0]));
+    } else {
+      assert(!weakq_pop(&q, &key));
+    }
+
+    assert(DEDUPQ_COUNT(&q) == len);
+    if (n % 1000 == 0) {
+      for (key = 0; key < 96; ++key) {
+        pending = false;
+        for (j = 0; j < len; ++j) {
+          pending = pending || model[j] == key;
+        }
+        assert(weakq_contains(&q, key) == pending);
+      }
+    }
+  }
+}
+
+static void test_strings(void) {
+  strq q;
+  char buf[] = "alpha";
+  const char* key;
+
+  DEDUPQ_INIT(&q);
+  assert(strq_push(&q, "alpha"));
+  assert(strq_push(&q, "beta"));
+
+  /* Keys are compared with EQ, not by address. */
+  assert(strq_push(&q, buf));
+  assert(DEDUPQ_COUNT(&q) == 2);
+
+  assert(strq_pop(&q, &key));
+  assert(strcmp(key, "alpha") == 0);
+  assert(!strq_contains(&q, buf));
+  assert(strq_contains(&q, "beta"));
+}
+
+int main(void) {
+  test_basic();
+  test_full();
+  test_batch();
+  test_model();
+  test_strings();
+
+  puts("[ ok ]");
+  return 0;
+}
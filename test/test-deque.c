@@ -49,6 +49,47 @@ static block_t* popb(deque* deq) {
   return blk;
 }
 
+static void test_rotate(void) {
+  deque d = DLIST_STATIC_INIT;
+  block_t b[3] = { BLOCK_STATIC_INIT(0), BLOCK_STATIC_INIT(1),
+                   BLOCK_STATIC_INIT(2) };
+  block_t* res;
+  int i;
+
+  /* Rotating an empty list does nothing. */
+  DLIST_ROTATE_FORWARD(&d, link);
+  DLIST_ROTATE_BACKWARD(&d, link);
+  DLIST_ROUND_ROBIN(&d, res, link);
+  assert(res == NULL);
+  assert(DLIST_IS_EMPTY(&d));
+
+  for (i = 0; i < 3; ++i) {
+    pushb(&d, &b[i]);
+  }
+
+  DLIST_ROTATE_FORWARD(&d, link);
+  assert(peekf(&d) == &b[1]);
+  assert(peekb(&d) == &b[0]);
+  DLIST_ROTATE_BACKWARD(&d, link);
+  DLIST_ROTATE_BACKWARD(&d, link);
+  assert(peekf(&d) == &b[2]);
+  assert(peekb(&d) == &b[1]);
+  DLIST_ROTATE_TO(&d, &b[1], link);
+  assert(peekf(&d) == &b[1]);
+  assert(peekb(&d) == &b[0]);
+
+  /* Round robin takes turns, and the list still works as a list. */
+  for (i = 0; i < 7; ++i) {
+    DLIST_ROUND_ROBIN(&d, res, link);
+    assert(res == &b[(i + 1) % 3]);
+    assert(peekb(&d) == res);
+  }
+  rem(&d, &b[1]);
+  assert(popf(&d) == &b[2]);
+  assert(popf(&d) == &b[0]);
+  assert(DLIST_IS_EMPTY(&d));
+}
+
 int main(void) {
   deque d = DLIST_STATIC_INIT;
   deque* deq = &d;
@@ -124,5 +165,7 @@ int main(void) {
 
   printf("]\n");
 
+  test_rotate();
+
   return 0;
 }
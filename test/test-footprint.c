@@ -0,0 +1,327 @@
+#define DLIST_ASSERTS
+#define DLIST_COUNTED
+#define SLIST_ASSERTS
+#define SLIST_COUNTED
+#define SPLAT_ASSERTS
+#define SPLAT_COUNTED
+#define FOOTPRINT_ASSERTS
+
+#include "circbuf.h"
+#include "dlist.h"
+#include "footprint.h"
+#include "slist.h"
+#include "splat.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+CIRCBUF_DECLARE(ring, int, 16);
+
+typedef struct job {
+  DLIST_DECLARE_LINK(job, dlink);
+  SLIST_DECLARE_LINK(job, slink);
+  SPLAT_LINK(job, link);
+  int key;
+  const char* name;
+} job_t;
+
+DLIST_DECLARE(job_deque, job);
+SLIST_DECLARE(job_queue, job);
+SPLAT_NEW(job_tree, job);
+
+SPLAT_LIB(job_tree, job, int, SPLAT_CMP_INT, link, key)
+
+typedef struct slot {
+  SPLAT_IDX_LINK(link);
+  int key;
+} slot_t;
+
+SPLAT_IDX_NEW(slots, slot);
+
+SPLAT_IDX_LIB(slots, slot, int, SPLAT_CMP_INT, link, key)
+
+#define JOBS 8
+
+static job_t jobs[JOBS];
+
+static const char* names[JOBS] = {
+  "a", "bb", "ccc", "dddd", "eeeee", "ffffff", "ggggggg", "hhhhhhhh",
+};
+
+/*
+ * Counts a job along with the name it points to.
+ */
+static size_t job_size(const job_t* j) {
+  return sizeof(*j) + strlen(j->name) + 1;
+}
+
+static int is_odd(job_t* j) {
+  return j->key % 2;
+}
+
+static int slot_is_odd(slot_t* s) {
+  return s->key % 2;
+}
+
+static size_t ring_size(const void* r) {
+  return CIRCBUF_FOOTPRINT((const ring*)r);
+}
+
+static size_t deque_size(const void* deq) {
+  return DLIST_FOOTPRINT((const job_deque*)deq);
+}
+
+static size_t tree_size(const void* tree) {
+  return SPLAT_FOOTPRINT((const job_tree*)tree);
+}
+
+static void test_circbuf(void) {
+  static ring r = CIRCBUF_STATIC_INIT(16);
+  char constant[CIRCBUF_FOOTPRINT(&r)];
+
+  assert(sizeof(constant) == sizeof(ring));
+  assert(CIRCBUF_PUSH_BACK(&r, 1));
+  assert(CIRCBUF_FOOTPRINT(&r) == sizeof(ring));
+}
+
+static void test_dlist(void) {
+  job_deque deq;
+  job_t* j;
+  size_t bytes;
+  size_t names_bytes = 0;
+  int i;
+
+  DLIST_INIT(&deq);
+  assert(DLIST_COUNT(&deq) == 0);
+  assert(DLIST_FOOTPRINT(&deq) == sizeof(deq));
+
+  for (i = 0; i < JOBS; ++i) {
+    DLIST_ELEM_INIT(&jobs[i], dlink);
+  }
+  DLIST_PUSH_BACK(&deq, &jobs[1], dlink);
+  DLIST_PUSH_FRONT(&deq, &jobs[0], dlink);
+  DLIST_INSERT_NEXT(&deq, &jobs[1], &jobs[3], dlink);
+  DLIST_INSERT_PREV(&deq, &jobs[3], &jobs[2], dlink);
+  assert(DLIST_COUNT(&deq) == 4);
+  assert(DLIST_FOOTPRINT(&deq) == sizeof(deq) + 4 * sizeof(job_t));
+
+  DLIST_FOOTPRINT_DEEP(bytes, j, &deq, dlink, job_size);
+  for (i = 0; i < 4; ++i) {
+    names_bytes += strlen(names[i]) + 1;
+  }
+  assert(bytes == sizeof(deq) + 4 * sizeof(job_t) + names_bytes);
+
+  DLIST_REMOVE(&deq, &jobs[2], dlink);
+  assert(DLIST_COUNT(&deq) == 3);
+  DLIST_POP_FRONT(&deq, j, dlink);
+  assert(j == &jobs[0]);
+  DLIST_POP_BACK(&deq, j, dlink);
+  assert(j == &jobs[3]);
+  DLIST_POP_BACK(&deq, j, dlink);
+  assert(j == &jobs[1]);
+  assert(DLIST_IS_EMPTY(&deq));
+  assert(DLIST_COUNT(&deq) == 0);
+  DLIST_POP_BACK(&deq, j, dlink);
+  assert(j == NULL);
+  assert(DLIST_COUNT(&deq) == 0);
+
+  DLIST_FOOTPRINT_DEEP(bytes, j, &deq, dlink, job_size);
+  assert(bytes == sizeof(deq));
+}
+
+static void test_slist(void) {
+  job_queue queue = SLIST_STATIC_INIT;
+  job_t* j;
+  size_t bytes;
+  int i;
+
+  assert(SLIST_COUNT(&queue) == 0);
+  for (i = 0; i < JOBS; ++i) {
+    SLIST_ELEM_INIT(&jobs[i], slink);
+    if (i % 2) {
+      SLIST_PUSH_BACK(&queue, &jobs[i], slink);
+    } else {
+      SLIST_PUSH_FRONT(&queue, &jobs[i], slink);
+    }
+  }
+  assert(SLIST_COUNT(&queue) == JOBS);
+  assert(SLIST_FOOTPRINT(&queue) == sizeof(queue) + JOBS * sizeof(job_t));
+
+  SLIST_FOOTPRINT_DEEP(bytes, j, &queue, slink, job_size);
+  assert(bytes == sizeof(queue) + JOBS * sizeof(job_t) + 44);
+
+  for (i = JOBS; i > 0; --i) {
+    SLIST_POP_FRONT(&queue, j, slink);
+    assert(j != NULL);
+    assert(SLIST_COUNT(&queue) == (size_t)i - 1);
+  }
+  SLIST_POP_FRONT(&queue, j, slink);
+  assert(j == NULL);
+  assert(SLIST_COUNT(&queue) == 0);
+}
+
+static void test_splat(void) {
+  job_tree tree;
+  job_t dup;
+  int i;
+
+  SPLAT_INIT(&tree);
+  assert(SPLAT_COUNT(&tree) == 0);
+  assert(job_tree_footprint_deep(&tree, NULL) == sizeof(tree));
+
+  for (i = 0; i < 4; ++i) {
+    SPLAT_ELEM_INIT(&jobs[i], link);
+    job_tree_insert(&tree, &jobs[i]);
+  }
+  SPLAT_ELEM_INIT(&jobs[4], link);
+  job_tree_insert_hint(&tree, &jobs[3], &jobs[4]);
+  for (i = 5; i < JOBS; ++i) {
+    SPLAT_ELEM_INIT(&jobs[i], link);
+    job_tree_insert_max(&tree, &jobs[i]);
+  }
+  assert(SPLAT_COUNT(&tree) == JOBS);
+
+  /* A duplicate key is not inserted. */
+  SPLAT_ELEM_INIT(&dup, link);
+  dup.key = 3;
+  job_tree_insert(&tree, &dup);
+  assert(SPLAT_COUNT(&tree) == JOBS);
+
+  assert(SPLAT_FOOTPRINT(&tree) == sizeof(tree) + JOBS * sizeof(job_t));
+  assert(job_tree_footprint_deep(&tree, NULL) == SPLAT_FOOTPRINT(&tree));
+  assert(job_tree_footprint_deep(&tree, job_size) ==
+         SPLAT_FOOTPRINT(&tree) + 44);
+
+  /* The walk leaves the tree as it found it. */
+  for (i = 0; i < JOBS; ++i) {
+    assert(job_tree_search(&tree, i) == &jobs[i]);
+  }
+
+  assert(job_tree_remove(&tree, 2) == &jobs[2]);
+  assert(job_tree_remove(&tree, 2) == NULL);
+  assert(SPLAT_COUNT(&tree) == JOBS - 1);
+
+  assert(job_tree_remove_if(&tree, is_odd) == 4);
+  assert(SPLAT_COUNT(&tree) == 3);
+  assert(job_tree_footprint_deep(&tree, NULL) == SPLAT_FOOTPRINT(&tree));
+
+  job_tree_clear(&tree, NULL);
+  assert(SPLAT_COUNT(&tree) == 0);
+  assert(SPLAT_FOOTPRINT(&tree) == sizeof(tree));
+}
+
+static void test_splat_idx(void) {
+  static slot_t pool[JOBS + 1];
+  slots tree = SPLAT_IDX_STATIC_INIT(pool);
+  int i;
+
+  assert(SPLAT_COUNT(&tree) == 0);
+  assert(SPLAT_IDX_FOOTPRINT(&tree) == sizeof(tree));
+
+  for (i = 1; i <= JOBS; ++i) {
+    pool[i].key = i;
+    SPLAT_IDX_ELEM_INIT(&pool[i], link);
+    slots_insert_max(&tree, &pool[i]);
+  }
+  slots_insert(&tree, &pool[3]);
+  assert(SPLAT_COUNT(&tree) == JOBS);
+
+  /* Only the slots in the tree count, not the nil slot. */
+  assert(SPLAT_IDX_FOOTPRINT(&tree) == sizeof(tree) + JOBS * sizeof(slot_t));
+  assert(slots_footprint_deep(&tree, NULL) == SPLAT_IDX_FOOTPRINT(&tree));
+
+  assert(slots_remove(&tree, 2) == &pool[2]);
+  assert(SPLAT_COUNT(&tree) == JOBS - 1);
+  assert(slots_remove_if(&tree, slot_is_odd) == 4);
+  assert(SPLAT_COUNT(&tree) == 3);
+  assert(slots_footprint_deep(&tree, NULL) == SPLAT_IDX_FOOTPRINT(&tree));
+
+  slots_clear(&tree, NULL);
+  assert(SPLAT_IDX_FOOTPRINT(&tree) == sizeof(tree));
+}
+
+static void test_registry(void) {
+  footprint_registry reg = FOOTPRINT_STATIC_INIT;
+  struct footprint_entry entries[3];
+  static ring r;
+  job_deque deq = DLIST_STATIC_INIT;
+  job_tree tree = SPLAT_STATIC_INIT;
+  char line[128];
+  char want[128];
+  FILE* out;
+  size_t total;
+  int i;
+
+  assert(footprint_total(&reg) == 0);
+
+  CIRCBUF_INIT(&r, 16);
+  for (i = 0; i < JOBS; ++i) {
+    DLIST_ELEM_INIT(&jobs[i], dlink);
+    DLIST_PUSH_BACK(&deq, &jobs[i], dlink);
+    SPLAT_ELEM_INIT(&jobs[i], link);
+    job_tree_insert(&tree, &jobs[i]);
+  }
+
+  footprint_register(&reg, &entries[0], "ring", &r, ring_size);
+  footprint_register(&reg, &entries[1], "deque", &deq, deque_size);
+  footprint_register(&reg, &entries[2], "tree", &tree, tree_size);
+
+  total = sizeof(r) + sizeof(deq) + sizeof(tree) + 2 * JOBS * sizeof(job_t);
+  assert(footprint_total(&reg) == total);
+
+  out = tmpfile();
+  assert(out != NULL);
+  assert(footprint_dump(&reg, out) == total);
+  rewind(out);
+
+  snprintf(want, sizeof(want),
+           "convoy_footprint_bytes{container=\"ring\"} %zu\n", sizeof(r));
+  assert(fgets(line, sizeof(line), out) != NULL);
+  assert(strcmp(line, want) == 0);
+  snprintf(want, sizeof(want),
+           "convoy_footprint_bytes{container=\"deque\"} %zu\n",
+           deque_size(&deq));
+  assert(fgets(line, sizeof(line), out) != NULL);
+  assert(strcmp(line, want) == 0);
+  snprintf(want, sizeof(want),
+           "convoy_footprint_bytes{container=\"tree\"} %zu\n",
+           tree_size(&tree));
+  assert(fgets(line, sizeof(line), out) != NULL);
+  assert(strcmp(line, want) == 0);
+  snprintf(want, sizeof(want), "convoy_footprint_bytes_total %zu\n", total);
+  assert(fgets(line, sizeof(line), out) != NULL);
+  assert(strcmp(line, want) == 0);
+  assert(fgets(line, sizeof(line), out) == NULL);
+  fclose(out);
+
+  footprint_unregister(&reg, &entries[1]);
+  assert(footprint_total(&reg) == total - deque_size(&deq));
+  footprint_unregister(&reg, &entries[0]);
+  footprint_unregister(&reg, &entries[2]);
+  assert(footprint_total(&reg) == 0);
+
+  footprint_init(&reg);
+  footprint_register(&reg, &entries[0], "ring", &r, ring_size);
+  assert(footprint_total(&reg) == sizeof(r));
+}
+
+int main(void) {
+  int i;
+
+  for (i = 0; i < JOBS; ++i) {
+    jobs[i].key = i;
+    jobs[i].name = names[i];
+  }
+
+  test_circbuf();
+  test_dlist();
+  test_slist();
+  test_splat();
+  test_splat_idx();
+  test_registry();
+
+  puts("[ ok ]");
+  return 0;
+}
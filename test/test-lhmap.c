@@ -0,0 +1,277 @@
+#define DLIST_ASSERTS
+#define LHMAP_ASSERTS
+
+#include "lhmap.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct entry {
+  LHMAP_DECLARE_LINK(entry, link);
+  uint64_t key;
+  int value;
+} entry_t;
+
+LHMAP_DECLARE(emap, entry, 16);
+LHMAP_LIB(emap, entry, uint64_t, lhmap_hash_u64, LHMAP_EQ, link, key)
+
+/* Every key hashes alike, so all of them share one chain. */
+#define SAME_HASH(KEY) ((void)(KEY), 0)
+
+LHMAP_DECLARE(cmap, entry, 4);
+LHMAP_LIB(cmap, entry, uint64_t, SAME_HASH, LHMAP_EQ, link, key)
+
+/* Every key hashes into one of four buckets, with different hashes. */
+#define WEAK_HASH(KEY) ((KEY) & 3)
+
+LHMAP_DECLARE(wmap, entry, 4);
+LHMAP_LIB(wmap, entry, uint64_t, WEAK_HASH, LHMAP_EQ, link, key)
+
+#define COUNT 64
+
+static entry_t entries[COUNT];
+
+static void reset(void) {
+  size_t i;
+
+  for (i = 0; i < COUNT; ++i) {
+    entries[i].key = i * 7;
+    entries[i].value = (int)i;
+    LHMAP_ELEM_INIT(&entries[i], link);
+  }
+}
+
+/*
+ * Checks that a map holds exactly the N entries in WANT, in order, and that
+ * each of them can be found by its key.
+ */
+#define CHECK(MAP_TYPE, MAP, WANT, N)                    \
+  {                                                      \
+    entry_t* curr_;                                      \
+    size_t i_ = 0;                                       \
+                                                         \
+    LHMAP_FOREACH(curr_, MAP, link, {                    \
+      assert(i_ < (N));                                  \
+      assert(curr_ == &entries[(WANT)[i_]]);             \
+      assert(MAP_TYPE##_find(MAP, curr_->key) == curr_); \
+      ++i_;                                              \
+    });                                                  \
+    assert(i_ == (N));                                   \
+    assert(LHMAP_COUNT(MAP) == (N));                     \
+    assert(LHMAP_IS_EMPTY(MAP) == ((N) == 0));           \
+  }
+
+static void test_basic(void) {
+  emap map = LHMAP_STATIC_INIT;
+  entry_t dup;
+
+  reset();
+  assert(LHMAP_IS_EMPTY(&map));
+  assert(emap_find(&map, 0) == NULL);
+  assert(emap_pop_front(&map) == NULL);
+
+  assert(emap_insert(&map, &entries[2]) == NULL);
+  assert(emap_insert(&map, &entries[0]) == NULL);
+  assert(emap_insert(&map, &entries[1]) == NULL);
+  {
+    static const size_t want[] = { 2, 0, 1 };
+    CHECK(emap, &map, want, 3);
+  }
+  assert(LHMAP_PEEK_FRONT(&map, link) == &entries[2]);
+  assert(LHMAP_PEEK_BACK(&map, link) == &entries[1]);
+  assert(emap_find(&map, 3) == NULL);
+
+  /* A duplicate key gives back the entry holding it, and isn't inserted. */
+  dup.key = entries[0].key;
+  LHMAP_ELEM_INIT(&dup, link);
+  assert(emap_insert(&map, &dup) == &entries[0]);
+  assert(!LHMAP_IS_ELEM_INSERTED(&dup, link));
+  assert(LHMAP_COUNT(&map) == 3);
+
+  assert(emap_remove(&map, entries[0].key) == &entries[0]);
+  assert(!LHMAP_IS_ELEM_INSERTED(&entries[0], link));
+  assert(emap_remove(&map, entries[0].key) == NULL);
+  {
+    static const size_t want[] = { 2, 1 };
+    CHECK(emap, &map, want, 2);
+  }
+
+  /* Reinserting puts the entry at the back. */
+  assert(emap_insert(&map, &entries[0]) == NULL);
+  {
+    static const size_t want[] = { 2, 1, 0 };
+    CHECK(emap, &map, want, 3);
+  }
+
+  assert(emap_pop_front(&map) == &entries[2]);
+  assert(emap_pop_front(&map) == &entries[1]);
+  assert(emap_pop_front(&map) == &entries[0]);
+  assert(emap_pop_front(&map) == NULL);
+  assert(LHMAP_IS_EMPTY(&map) && LHMAP_COUNT(&map) == 0);
+
+  LHMAP_INIT(&map);
+  assert(LHMAP_IS_EMPTY(&map) && LHMAP_COUNT(&map) == 0);
+}
+
+static void test_move_to_back(void) {
+  emap map;
+  size_t i;
+
+  reset();
+  LHMAP_INIT(&map);
+  for (i = 0; i < 4; ++i) {
+    emap_insert(&map, &entries[i]);
+  }
+
+  /* From the front, from the middle, and from the back. */
+  emap_move_to_back(&map, &entries[0]);
+  {
+    static const size_t want[] = { 1, 2, 3, 0 };
+    CHECK(emap, &map, want, 4);
+  }
+  emap_move_to_back(&map, &entries[2]);
+  {
+    static const size_t want[] = { 1, 3, 0, 2 };
+    CHECK(emap, &map, want, 4);
+  }
+  emap_move_to_back(&map, &entries[2]);
+  {
+    static const size_t want[] = { 1, 3, 0, 2 };
+    CHECK(emap, &map, want, 4);
+  }
+
+  /* A lone entry stays put. */
+  LHMAP_INIT(&map);
+  reset();
+  emap_insert(&map, &entries[5]);
+  emap_move_to_back(&map, &entries[5]);
+  {
+    static const size_t want[] = { 5 };
+    CHECK(emap, &map, want, 1);
+  }
+}
+
+/*
+ * Erases entries from the head, the middle and the tail of a single chain.
+ */
+static void test_chain(void) {
+  cmap map;
+  size_t i;
+
+  reset();
+  LHMAP_INIT(&map);
+  for (i = 0; i < 6; ++i) {
+    assert(cmap_insert(&map, &entries[i]) == NULL);
+  }
+  {
+    static const size_t want[] = { 0, 1, 2, 3, 4, 5 };
+    CHECK(cmap, &map, want, 6);
+  }
+
+  /* The newest entry is at the head of the chain, the oldest at its tail. */
+  cmap_erase(&map, &entries[5]);
+  cmap_erase(&map, &entries[2]);
+  cmap_erase(&map, &entries[0]);
+  {
+    static const size_t want[] = { 1, 3, 4 };
+    CHECK(cmap, &map, want, 3);
+  }
+  assert(cmap_find(&map, entries[0].key) == NULL);
+  assert(cmap_find(&map, entries[2].key) == NULL);
+  assert(cmap_find(&map, entries[5].key) == NULL);
+
+  cmap_erase(&map, &entries[3]);
+  cmap_erase(&map, &entries[4]);
+  cmap_erase(&map, &entries[1]);
+  assert(LHMAP_IS_EMPTY(&map) && LHMAP_COUNT(&map) == 0);
+  for (i = 0; i < 4; ++i) {
+    assert(map.buckets[i] == NULL);
+  }
+}
+
+/*
+ * Runs random inserts, removes, moves and pops against a map with a few
+ * crowded buckets, and against an array that keeps the entries in order.
+ */
+static void test_random(void) {
+  wmap map;
+  entry_t dup;
+  size_t order[COUNT];
+  size_t n = 0;
+  uint64_t seed = 1;
+  uint64_t r;
+  entry_t* res;
+  size_t step;
+  size_t e;
+  size_t i;
+
+  reset();
+  LHMAP_INIT(&map);
+  LHMAP_ELEM_INIT(&dup, link);
+  for (step = 0; step < 20000; ++step) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    r = seed >> 33;
+    e = (size_t)(r / 8 % COUNT);
+
+    /* Where E is in the order, or N if it isn't in the map. */
+    for (i = 0; i < n && order[i] != e; ++i) {
+    }
+
+    switch (r % 8) {
+      case 0:
+      case 1:
+      case 2:
+        if (i == n) {
+          assert(wmap_insert(&map, &entries[e]) == NULL);
+          order[n++] = e;
+        } else {
+          dup.key = entries[e].key;
+          assert(wmap_insert(&map, &dup) == &entries[e]);
+        }
+        break;
+      case 3:
+      case 4:
+        res = wmap_remove(&map, entries[e].key);
+        assert(res == (i < n ? &entries[e] : NULL));
+        if (i < n) {
+          for (--n; i < n; ++i) {
+            order[i] = order[i + 1];
+          }
+        }
+        break;
+      case 5:
+      case 6:
+        if (i < n) {
+          wmap_move_to_back(&map, &entries[e]);
+          for (; i + 1 < n; ++i) {
+            order[i] = order[i + 1];
+          }
+          order[n - 1] = e;
+        }
+        break;
+      default:
+        res = wmap_pop_front(&map);
+        if (n == 0) {
+          assert(res == NULL);
+        } else {
+          assert(res == &entries[order[0]]);
+          for (--n, i = 0; i < n; ++i) {
+            order[i] = order[i + 1];
+          }
+        }
+        break;
+    }
+    CHECK(wmap, &map, order, n);
+  }
+}
+
+int main(void) {
+  test_basic();
+  test_move_to_back();
+  test_chain();
+  test_random();
+
+  puts("[ ok ]");
+  return 0;
+}
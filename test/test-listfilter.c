@@ -0,0 +1,211 @@
+#define DLIST_ASSERTS
+#define SLIST_ASSERTS
+
+#include "dlist.h"
+#include "slist.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+typedef struct block {
+  DLIST_DECLARE_LINK(block, dlink);
+  SLIST_DECLARE_LINK(block, slink);
+  unsigned elem;
+} block_t;
+
+DLIST_DECLARE(deque, block);
+SLIST_DECLARE(queue, block);
+
+#define COUNT 12
+
+static block_t blocks[COUNT];
+
+/* The elements whose bit is set in the current mask. */
+static unsigned mask;
+#define PICKED(BLK) ((mask >> (BLK)->elem) & 1)
+
+static size_t removals;
+
+static void on_remove(block_t* blk) {
+  assert(PICKED(blk));
+  ++removals;
+}
+
+static size_t picked(void) {
+  size_t n = 0;
+  unsigned bits;
+
+  for (bits = mask; bits != 0; bits &= bits - 1) {
+    ++n;
+  }
+  return n;
+}
+
+/*
+ * Checks that a deque holds exactly the elements whose bit is set in WANT,
+ * in order, with its links holding together both ways.
+ */
+static void check_deque(deque* deq, unsigned want) {
+  block_t* curr;
+  block_t* prev = NULL;
+  unsigned seen = 0;
+
+  DLIST_FOREACH(curr, deq, dlink, {
+    assert(prev == NULL || prev->elem < curr->elem);
+    assert(curr->dlink.next->dlink.prev == curr);
+    assert(curr->dlink.prev->dlink.next == curr);
+    seen |= 1u << curr->elem;
+    prev = curr;
+  });
+  assert(seen == want);
+  assert(deq->back == prev);
+}
+
+static void check_queue(queue* qu, unsigned want) {
+  block_t* curr;
+  block_t* prev = NULL;
+  unsigned seen = 0;
+
+  SLIST_FOREACH(curr, qu, slink, {
+    assert(prev == NULL || prev->elem < curr->elem);
+    seen |= 1u << curr->elem;
+    prev = curr;
+  });
+  assert(seen == want);
+  assert(qu->back == prev);
+}
+
+static void fill(deque* deq, queue* qu) {
+  size_t i;
+
+  DLIST_INIT(deq);
+  SLIST_INIT(qu);
+  for (i = 0; i < COUNT; ++i) {
+    blocks[i].elem = (unsigned)i;
+    DLIST_ELEM_INIT(&blocks[i], dlink);
+    SLIST_ELEM_INIT(&blocks[i], slink);
+    DLIST_PUSH_BACK(deq, &blocks[i], dlink);
+    SLIST_PUSH_BACK(qu, &blocks[i], slink);
+  }
+}
+
+/*
+ * Removes the elements picked by every mask over a few elements, and a few
+ * patterns over all of them.
+ */
+static void test_remove_if(void) {
+  static const unsigned masks[] = { 0x000, 0xfff, 0x001, 0x800, 0x801,
+                                    0x7fe, 0x555, 0xaaa, 0x0f0, 0xf0f };
+  const unsigned all = (1u << COUNT) - 1;
+  deque deq;
+  queue qu;
+  size_t i;
+
+  for (i = 0; i < sizeof(masks) / sizeof(masks[0]); ++i) {
+    mask = masks[i];
+
+    fill(&deq, &qu);
+    removals = 0;
+    DLIST_REMOVE_IF(&deq, block, dlink, PICKED, on_remove);
+    check_deque(&deq, all & ~mask);
+    assert(removals == picked());
+
+    removals = 0;
+    SLIST_REMOVE_IF(&qu, block, slink, PICKED, on_remove);
+    check_queue(&qu, all & ~mask);
+    assert(removals == picked());
+  }
+
+  /* An empty list stays empty. */
+  DLIST_INIT(&deq);
+  SLIST_INIT(&qu);
+  DLIST_REMOVE_IF(&deq, block, dlink, PICKED, on_remove);
+  SLIST_REMOVE_IF(&qu, block, slink, PICKED, on_remove);
+  assert(DLIST_IS_EMPTY(&deq));
+  assert(SLIST_IS_EMPTY(&qu));
+}
+
+static void test_partition(void) {
+  const unsigned all = (1u << COUNT) - 1;
+  deque deq;
+  deque picked;
+  deque rest;
+  queue qu;
+  queue spicked;
+  queue srest;
+
+  /* Into empty lists. */
+  mask = 0x0a3;
+  fill(&deq, &qu);
+  DLIST_INIT(&picked);
+  SLIST_INIT(&spicked);
+  DLIST_PARTITION(&deq, &picked, block, dlink, PICKED);
+  SLIST_PARTITION(&qu, &spicked, block, slink, PICKED);
+  check_deque(&deq, all & ~mask);
+  check_deque(&picked, mask);
+  check_queue(&qu, all & ~mask);
+  check_queue(&spicked, mask);
+
+  /* Onto the backs of lists that already hold the lower elements. */
+  mask = 0xf00;
+  DLIST_PARTITION(&deq, &picked, block, dlink, PICKED);
+  SLIST_PARTITION(&qu, &spicked, block, slink, PICKED);
+  check_deque(&deq, all & ~0x0a3u & ~mask);
+  check_deque(&picked, 0x0a3u | mask);
+  check_queue(&qu, all & ~0x0a3u & ~mask);
+  check_queue(&spicked, 0x0a3u | mask);
+
+  /* Everything, and then nothing. */
+  mask = all;
+  DLIST_INIT(&rest);
+  SLIST_INIT(&srest);
+  DLIST_PARTITION(&deq, &rest, block, dlink, PICKED);
+  SLIST_PARTITION(&qu, &srest, block, slink, PICKED);
+  check_deque(&deq, 0);
+  check_deque(&rest, all & ~0x0a3u & ~0xf00u);
+  check_queue(&qu, 0);
+  check_queue(&srest, all & ~0x0a3u & ~0xf00u);
+
+  mask = 0;
+  DLIST_PARTITION(&picked, &deq, block, dlink, PICKED);
+  SLIST_PARTITION(&spicked, &qu, block, slink, PICKED);
+  check_deque(&picked, 0x0a3u | 0xf00u);
+  check_queue(&spicked, 0x0a3u | 0xf00u);
+  assert(DLIST_IS_EMPTY(&deq));
+  assert(SLIST_IS_EMPTY(&qu));
+}
+
+static void test_pop_next(void) {
+  deque deq;
+  queue qu;
+  block_t* res;
+
+  fill(&deq, &qu);
+
+  /* From the middle, then the back, then the front off of the back. */
+  SLIST_POP_NEXT(&qu, &blocks[3], res, slink);
+  assert(res == &blocks[4]);
+  assert(!SLIST_IS_ELEM_INSERTED(res, slink));
+  SLIST_POP_NEXT(&qu, &blocks[10], res, slink);
+  assert(res == &blocks[11]);
+  SLIST_POP_NEXT(&qu, &blocks[10], res, slink);
+  assert(res == &blocks[0]);
+  check_queue(&qu, 0x7ee);
+
+  /* A lone element is its own next. */
+  SLIST_INIT(&qu);
+  SLIST_ELEM_INIT(&blocks[5], slink);
+  SLIST_PUSH_BACK(&qu, &blocks[5], slink);
+  SLIST_POP_NEXT(&qu, &blocks[5], res, slink);
+  assert(res == &blocks[5]);
+  assert(SLIST_IS_EMPTY(&qu));
+}
+
+int main(void) {
+  test_remove_if();
+  test_partition();
+  test_pop_next();
+
+  puts("[ ok ]");
+  return 0;
+}
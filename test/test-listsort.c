@@ -0,0 +1,130 @@
+#define DLIST_ASSERTS
+#define SLIST_ASSERTS
+
+#include "dlist.h"
+#include "slist.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct block {
+  DLIST_DECLARE_LINK(block, dlink);
+  SLIST_DECLARE_LINK(block, slink);
+  uint64_t key;
+  size_t id;
+} block_t;
+
+DLIST_DECLARE(deque, block);
+SLIST_DECLARE(queue, block);
+
+#define KEY(BLK) ((BLK)->key)
+
+#define COUNT 5000
+
+static block_t blocks[COUNT];
+
+static uint64_t rand64(uint64_t* state) {
+  *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return *state ^ (*state >> 29);
+}
+
+/*
+ * Checks that a sorted deque is in key order, with equal keys still in the
+ * order they were pushed in, and that its links hold together both ways.
+ */
+static void check_deque(deque* deq, size_t n) {
+  block_t* curr;
+  block_t* prev = NULL;
+  size_t seen = 0;
+
+  DLIST_FOREACH(curr, deq, dlink, {
+    if (prev != NULL) {
+      assert(prev->key <= curr->key);
+      assert(prev->key < curr->key || prev->id < curr->id);
+      assert(curr->dlink.prev == prev);
+    }
+    assert(curr->dlink.next->dlink.prev == curr);
+    prev = curr;
+    ++seen;
+  });
+  assert(seen == n);
+  assert(n == 0 || deq->front->dlink.prev == deq->back);
+  assert(n == 0 || deq->back->dlink.next == deq->front);
+}
+
+static void check_queue(queue* qu, size_t n) {
+  block_t* curr;
+  block_t* prev = NULL;
+  size_t seen = 0;
+
+  SLIST_FOREACH(curr, qu, slink, {
+    if (prev != NULL) {
+      assert(prev->key <= curr->key);
+      assert(prev->key < curr->key || prev->id < curr->id);
+    }
+    prev = curr;
+    ++seen;
+  });
+  assert(seen == n);
+  assert(n == 0 || qu->back == prev);
+  assert(n == 0 || qu->back->slink == qu->front);
+}
+
+/*
+ * Sorts N blocks whose keys are random under MASK, and then checks that the
+ * lists still work as lists.
+ */
+static void test_sort(size_t n, uint64_t mask, uint64_t seed) {
+  deque deq = DLIST_STATIC_INIT;
+  queue qu = SLIST_STATIC_INIT;
+  block_t* blk;
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    blocks[i].key = rand64(&seed) & mask;
+    blocks[i].id = i;
+    DLIST_ELEM_INIT(&blocks[i], dlink);
+    SLIST_ELEM_INIT(&blocks[i], slink);
+    DLIST_PUSH_BACK(&deq, &blocks[i], dlink);
+    SLIST_PUSH_BACK(&qu, &blocks[i], slink);
+  }
+
+  DLIST_RADIX_SORT(&deq, block, dlink, KEY);
+  SLIST_RADIX_SORT(&qu, block, slink, KEY);
+  check_deque(&deq, n);
+  check_queue(&qu, n);
+
+  /* Sorting again changes nothing, since the sort is stable. */
+  DLIST_RADIX_SORT(&deq, block, dlink, KEY);
+  check_deque(&deq, n);
+
+  for (i = 0; i < n; ++i) {
+    DLIST_POP_BACK(&deq, blk, dlink);
+    assert(blk != NULL);
+    SLIST_POP_FRONT(&qu, blk, slink);
+    assert(blk != NULL);
+  }
+  assert(DLIST_IS_EMPTY(&deq));
+  assert(SLIST_IS_EMPTY(&qu));
+}
+
+int main(void) {
+  test_sort(0, UINT64_MAX, 1);
+  test_sort(1, UINT64_MAX, 2);
+  test_sort(2, UINT64_MAX, 3);
+  test_sort(COUNT, UINT64_MAX, 4);
+
+  /* Few distinct keys, to check stability. */
+  test_sort(COUNT, 0x7, 5);
+
+  /* Keys that only differ in their middle bytes, so most passes are skipped. */
+  test_sort(COUNT, 0xff0000ULL, 6);
+  test_sort(COUNT, 0xffff00000000ULL, 7);
+
+  /* All keys the same, so there's nothing to sort. */
+  test_sort(COUNT, 0, 8);
+
+  puts("[ ok ]");
+  return 0;
+}
@@ -0,0 +1,92 @@
+#define LSLIST_ASSERTS
+
+#include "lslist.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+typedef struct block {
+  LSLIST_DECLARE_LINK(block, next);
+  int elem;
+} block_t;
+
+LSLIST_DECLARE(queue, block);
+
+static queue qu = LSLIST_STATIC_INIT;
+
+/*
+ * Checks that QU holds exactly the N elements in WANT, in order.
+ */
+static void check(const int* want, int n) {
+  block_t* curr;
+  block_t* back = NULL;
+  int i = 0;
+
+  LSLIST_FOREACH(curr, &qu, next, {
+    assert(i < n);
+    assert(curr->elem == want[i]);
+    back = curr;
+    ++i;
+  });
+  assert(i == n);
+  assert(LSLIST_PEEK_BACK(&qu) == back);
+  assert(LSLIST_IS_EMPTY(&qu) == (n == 0));
+}
+
+int main(void) {
+  block_t b[4];
+  block_t* res;
+  int i;
+
+  for (i = 0; i < 4; ++i) {
+    b[i].elem = i;
+    LSLIST_ELEM_INIT(&b[i], next);
+  }
+
+  LSLIST_POP_FRONT(&qu, res, next);
+  assert(res == NULL);
+  check(NULL, 0);
+
+  /* Pushing onto the back of an empty list sets the front too. */
+  LSLIST_PUSH_BACK(&qu, &b[1], next);
+  assert(LSLIST_PEEK_FRONT(&qu) == &b[1]);
+  LSLIST_PUSH_BACK(&qu, &b[2], next);
+  LSLIST_PUSH_FRONT(&qu, &b[0], next);
+  LSLIST_PUSH_BACK(&qu, &b[3], next);
+  {
+    static const int want[] = { 0, 1, 2, 3 };
+    check(want, 4);
+  }
+
+  /* Popping the back from after its predecessor moves the back. */
+  LSLIST_POP_NEXT(&qu, &b[2], res, next);
+  assert(res == &b[3]);
+  LSLIST_POP_NEXT(&qu, &b[0], res, next);
+  assert(res == &b[1]);
+  {
+    static const int want[] = { 0, 2 };
+    check(want, 2);
+  }
+
+  LSLIST_POP_FRONT(&qu, res, next);
+  assert(res == &b[0]);
+  assert(res->next == NULL);
+  LSLIST_POP_FRONT(&qu, res, next);
+  assert(res == &b[2]);
+  check(NULL, 0);
+
+  /* Pushing onto the front of an empty list sets the back too. */
+  LSLIST_PUSH_FRONT(&qu, &b[3], next);
+  assert(LSLIST_PEEK_BACK(&qu) == &b[3]);
+  LSLIST_PUSH_BACK(&qu, &b[1], next);
+  {
+    static const int want[] = { 3, 1 };
+    check(want, 2);
+  }
+
+  LSLIST_INIT(&qu);
+  check(NULL, 0);
+
+  puts("[ ok ]");
+  return 0;
+}
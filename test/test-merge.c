@@ -0,0 +1,180 @@
+#define CIRCBUF_ASSERTS
+#define MERGE_ASSERTS
+
+#include "merge.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct event {
+  uint64_t ts;
+  uint32_t source;
+} event_t;
+
+CIRCBUF_DECLARE(stream, event_t, 16);
+
+#define TS(E) ((E).ts)
+#define CMP(A, B) (((A) > (B)) - ((A) < (B)))
+
+MERGE_DECLARE(merger, stream, uint64_t, 64);
+MERGE_LIB(merger, stream, event_t, uint64_t, TS, CMP)
+
+static stream streams[64];
+static stream* inputs[64];
+
+static void push(size_t source, uint64_t ts) {
+  event_t e = { .ts = ts, .source = (uint32_t)source };
+
+  assert(CIRCBUF_PUSH_BACK(&streams[source], e));
+}
+
+static void reset(size_t n) {
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    CIRCBUF_INIT(&streams[i], 16);
+    inputs[i] = &streams[i];
+  }
+}
+
+static void test_basic(void) {
+  merger m;
+  event_t out[16];
+  size_t i;
+
+  reset(3);
+  push(0, 1);
+  push(0, 4);
+  push(0, 7);
+  push(1, 2);
+  push(1, 5);
+  push(2, 3);
+  push(2, 6);
+  merger_init(&m, inputs, 3, 0);
+  for (i = 0; i < 3; ++i) {
+    merger_close(&m, i);
+  }
+
+  assert(merger_pop_n(&m, out, 16) == 7);
+  for (i = 0; i < 7; ++i) {
+    assert(out[i].ts == i + 1);
+    assert(out[i].source == i % 3);
+  }
+  assert(merger_is_done(&m));
+  assert(merger_pop_n(&m, out, 16) == 0);
+}
+
+static void test_watermarks(void) {
+  merger m;
+  event_t e;
+
+  reset(2);
+  push(0, 10);
+  push(0, 20);
+  merger_init(&m, inputs, 2, 0);
+
+  /* Input 1 is empty, and might still deliver anything from 0 up. */
+  assert(!merger_pop(&m, &e));
+  assert(!merger_is_done(&m));
+
+  /* Raising its watermark lets everything up to it through. */
+  merger_watermark(&m, 1, 15);
+  assert(merger_pop(&m, &e));
+  assert(e.ts == 10);
+  assert(!merger_pop(&m, &e));
+
+  /* Elements pushed onto a waiting input are picked up without notice. */
+  push(1, 15);
+  push(1, 20);
+  push(1, 25);
+  assert(merger_pop(&m, &e));
+  assert(e.ts == 15 && e.source == 1);
+  assert(merger_pop(&m, &e));
+  assert(e.ts == 20 && e.source == 0);
+
+  /*
+   * Input 0 is empty now, but having delivered 20 it can't go back below it,
+   * so the merge keeps flowing up to there and waits on it past that.
+   */
+  assert(merger_pop(&m, &e));
+  assert(e.ts == 20 && e.source == 1);
+  assert(!merger_pop(&m, &e));
+  merger_close(&m, 0);
+  assert(merger_pop(&m, &e));
+  assert(e.ts == 25);
+  assert(!merger_pop(&m, &e));
+  assert(!merger_is_done(&m));
+  merger_close(&m, 1);
+  assert(merger_is_done(&m));
+}
+
+/*
+ * Feeds N inputs random nondecreasing timestamps a few at a time, raising
+ * watermarks as it goes, and checks that the merge comes out sorted and
+ * complete.
+ */
+static void test_random(size_t n, uint64_t seed) {
+  merger m;
+  uint64_t next[64];
+  uint64_t pushed = 0;
+  uint64_t popped = 0;
+  uint64_t last = 0;
+  uint64_t r;
+  size_t round;
+  size_t i;
+  event_t e;
+
+  reset(n);
+  for (i = 0; i < n; ++i) {
+    next[i] = 0;
+  }
+  merger_init(&m, inputs, n, 0);
+
+  for (round = 0; round < 200; ++round) {
+    for (i = 0; i < n; ++i) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      r = seed >> 33;
+      while (r % 4 != 0 && !CIRCBUF_ISFULL(&streams[i])) {
+        next[i] += r % 7;
+        push(i, next[i]);
+        ++pushed;
+        r /= 4;
+      }
+      if (r % 3 == 0 && CIRCBUF_ISEMPTY(&streams[i])) {
+        next[i] += r % 5;
+        merger_watermark(&m, i, next[i]);
+      }
+    }
+    while (merger_pop(&m, &e)) {
+      assert(e.ts >= last);
+      last = e.ts;
+      ++popped;
+    }
+  }
+
+  for (i = 0; i < n; ++i) {
+    merger_close(&m, i);
+  }
+  while (merger_pop(&m, &e)) {
+    assert(e.ts >= last);
+    last = e.ts;
+    ++popped;
+  }
+  assert(merger_is_done(&m));
+  assert(popped == pushed);
+}
+
+int main(void) {
+  size_t n;
+
+  test_basic();
+  test_watermarks();
+  for (n = 1; n <= 64; ++n) {
+    test_random(n, n);
+  }
+
+  puts("[ ok ]");
+  return 0;
+}
@@ -0,0 +1,155 @@
+#define _POSIX_C_SOURCE 200809L
+
+#define MPHF_ASSERTS
+#define SPLAT_ASSERTS
+
+#include "mphf.h"
+#include "splat.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define NUM_KEYS 1000000
+#define NUM_BLOCKS 1000
+
+typedef struct block {
+  SPLAT_LINK(block, link);
+  int key;
+} block_t;
+
+SPLAT_NEW(splat, block);
+
+#define CMP(a,b) (((a) <= (b)) ? (-(a < b)) : 1)
+
+SPLAT_LIB(splat, block, int, CMP, link, key)
+MPHF_SPLAT_LIB(splat, block, key)
+
+static uint64_t keys[NUM_KEYS];
+static unsigned char hit[NUM_KEYS];
+static block_t blocks[NUM_BLOCKS];
+static block_t* payload[NUM_BLOCKS];
+
+static uint64_t rng = 88172645463325252u;
+
+static uint64_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+/*
+ * Checks that every key gets its own index.
+ */
+static void check_bijection(const mphf* m, const uint64_t* set, size_t n) {
+  size_t i;
+
+  memset(hit, 0, n);
+  for (i = 0; i < n; ++i) {
+    size_t index = mphf_lookup(m, set[i]);
+    assert(index < n);
+    assert(!hit[index]);
+    hit[index] = 1;
+  }
+}
+
+int main(void) {
+  mphf_config config = MPHF_CONFIG_STATIC_INIT;
+  mphf m;
+  mphf serial;
+  size_t i;
+
+  for (i = 0; i < NUM_KEYS; ++i) {
+    keys[i] = next_rand();
+  }
+
+  /* A parallel build gives the same function as a serial one. */
+  config.threads = 4;
+  assert(mphf_build(&m, keys, NUM_KEYS, &config));
+  check_bijection(&m, keys, NUM_KEYS);
+
+  config.threads = 1;
+  assert(mphf_build(&serial, keys, NUM_KEYS, &config));
+  assert(serial.nlevels == m.nlevels);
+  assert(serial.nfallback == m.nfallback);
+  assert(memcmp(serial.bits, m.bits, m.levels[m.nlevels] / 8) == 0);
+  mphf_free(&serial);
+
+  size_t size = mphf_serialized_size(&m);
+  double bits_per_key = (double)size * 8 / NUM_KEYS;
+  assert(bits_per_key < 4.0);
+
+  /* Round trip through an mmap()ed file. */
+  FILE* f = tmpfile();
+  assert(f != NULL);
+  assert(mphf_write(&m, f));
+  assert(fflush(f) == 0);
+  assert((size_t)ftell(f) == size);
+
+  void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+  assert(map != MAP_FAILED);
+  mphf view;
+  assert(mphf_view(&view, map, size));
+  assert(!mphf_view(&view, map, size - 8));
+  for (i = 0; i < NUM_KEYS; i += 97) {
+    assert(mphf_lookup(&view, keys[i]) == mphf_lookup(&m, keys[i]));
+  }
+  mphf_free(&view);
+
+  /* Headers whose counts don't add up are rejected. */
+  uint64_t* copy = (uint64_t*)malloc(size);
+  struct mphf_file_header* header = (struct mphf_file_header*)copy;
+  assert(copy != NULL);
+  memcpy(copy, map, size);
+  assert(mphf_view(&view, copy, size));
+  header->nfallback = UINT64_MAX - m.levels[m.nlevels] / 64;
+  header->nkeys = UINT64_MAX;
+  assert(!mphf_view(&view, copy, size));
+  memcpy(copy, map, size);
+  ++header->nkeys;
+  assert(!mphf_view(&view, copy, size));
+  free(copy);
+  munmap(map, size);
+  fclose(f);
+  mphf_free(&m);
+
+  /* Duplicates can never be separated. */
+  keys[1] = keys[0];
+  assert(!mphf_build(&m, keys, 1000, &config));
+
+  assert(mphf_build(&m, keys, 0, &config));
+  assert(mphf_lookup(&m, 42) == MPHF_NONE);
+  mphf_free(&m);
+
+  /* Replace a splat tree with an index into a dense payload array. */
+  splat tree = SPLAT_STATIC_INIT;
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    blocks[i].key = (int)(i * 7919 % 100003);
+    SPLAT_ELEM_INIT(&blocks[i], link);
+    splat_insert(&tree, &blocks[i]);
+  }
+  size_t len;
+  MPHF_KEYS_FROM_SPLAT(&tree, splat, keys, NUM_KEYS, len);
+  assert(len == NUM_BLOCKS);
+  for (i = 1; i < len; ++i) {
+    assert(keys[i - 1] < keys[i]);
+  }
+  assert(mphf_build(&m, keys, len, &config));
+  check_bijection(&m, keys, len);
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    payload[mphf_lookup(&m, (uint64_t)blocks[i].key)] = &blocks[i];
+  }
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    int key = (int)(i * 7919 % 100003);
+    assert(payload[mphf_lookup(&m, (uint64_t)key)]->key == key);
+    assert(splat_search(&tree, key) == &blocks[i]);
+  }
+  mphf_free(&m);
+
+  printf("[ %.2f bits/key ]\n", bits_per_key);
+
+  return 0;
+}
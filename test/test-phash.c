@@ -0,0 +1,38 @@
+#include "phash-keys.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+static const int* find(const char* key) {
+  return headers_lookup(key, strlen(key));
+}
+
+int main(void) {
+  size_t i;
+
+  /* Every key lands in exactly the slot it was placed in. */
+  for (i = 0; i < HEADERS_SIZE; ++i) {
+    const struct headers_entry* e = &headers_entries[i];
+    assert(headers_lookup(e->key, e->len) == &e->value);
+  }
+
+  assert(*find("Accept") == 0);
+  assert(*find("Content-Type") == 16);
+  assert(*find("Warning") == 51);
+  assert(*find("X-Request-Id") == 1000);
+  assert(*find("X-Quote\"d") == 1002);
+
+  /* Misses still take one probe, and fail on the key compare. */
+  assert(find("") == NULL);
+  assert(find("accept") == NULL);
+  assert(find("Accept-") == NULL);
+  assert(find("X-Forwarded-Fo") == NULL);
+
+  /* Keys needn't be NUL-terminated. */
+  assert(*headers_lookup("Accept-Ranges", 6) == 0);
+
+  printf("[ %d %d ]\n", HEADERS_SIZE, HEADERS_BUCKETS);
+
+  return 0;
+}
@@ -0,0 +1,213 @@
+#include "pmr.hpp"
+#include "slist.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Tracks what is outstanding against new/delete.
+ */
+class counting_resource : public std::pmr::memory_resource {
+ public:
+  std::size_t outstanding = 0;
+  std::size_t calls = 0;
+
+ protected:
+  void* do_allocate(std::size_t bytes, std::size_t align) override {
+    outstanding += bytes;
+    ++calls;
+    return std::pmr::new_delete_resource()->allocate(bytes, align);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t align) override {
+    outstanding -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+  }
+
+  bool do_is_equal(
+    const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+struct job {
+  SLIST_DECLARE_LINK(job, link);
+  int id;
+};
+
+SLIST_DECLARE(job_queue, job);
+
+#define THREADS 4
+#define ROUNDS 20000
+
+int main() {
+  counting_resource upstream;
+
+  /* A request's worth of containers and convoy elements in one arena. */
+  {
+    alignas(std::max_align_t) unsigned char buf[1024];
+    convoy::arena_resource request(buf, sizeof(buf), &upstream);
+
+    std::size_t calls;
+    {
+      std::pmr::vector<int> ids(&request);
+      for (int i = 0; i < 1000; ++i) {
+        ids.push_back(i);
+      }
+      std::pmr::unordered_map<int, std::pmr::string> names(&request);
+      names[1] = "a name long enough to need its own allocation";
+
+      job_queue jobs = SLIST_STATIC_INIT;
+      for (int i = 0; i < 100; ++i) {
+        void* mem = request.allocate(sizeof(job), alignof(job));
+        job* j = new (mem) job{ SLIST_LINK_STATIC_INIT, i };
+        SLIST_PUSH_BACK(&jobs, j, link);
+      }
+      assert(SLIST_PEEK_BACK(&jobs, link)->id == 99);
+
+      /* The buffer overflowed into upstream chunks. */
+      assert(upstream.outstanding > 0);
+      calls = upstream.calls;
+    }
+    request.release();
+    assert(upstream.outstanding == 0);
+
+    /* Released memory is reused, starting from the buffer again. */
+    void* p = request.allocate(16, 16);
+    assert(p == buf);
+    assert(upstream.calls == calls);
+
+    /* Over-aligned requests work too. */
+    void* q = request.allocate(1, 256);
+    assert(reinterpret_cast<std::uintptr_t>(q) % 256 == 0);
+  }
+  assert(upstream.outstanding == 0);
+
+  /* Pooled blocks are recycled within a size class. */
+  {
+    convoy::pool_resource pool(&upstream);
+
+    void* a = pool.allocate(24);
+    pool.deallocate(a, 24);
+    assert(pool.allocate(32) == a);
+    pool.deallocate(a, 32);
+
+    /* Big and over-aligned requests go straight upstream. */
+    std::size_t before = upstream.outstanding;
+    void* big = pool.allocate(POOL_MAX_SIZE + 1);
+    assert(upstream.outstanding == before + POOL_MAX_SIZE + 1);
+    pool.deallocate(big, POOL_MAX_SIZE + 1);
+    void* wide = pool.allocate(64, 64);
+    assert(reinterpret_cast<std::uintptr_t>(wide) % 64 == 0);
+    pool.deallocate(wide, 64, 64);
+    assert(upstream.outstanding == before);
+
+    std::pmr::unordered_map<int, std::pmr::string> map(&pool);
+    for (int i = 0; i < 10000; ++i) {
+      map[i] = std::pmr::string(std::to_string(i) + " and some padding");
+    }
+    for (int i = 0; i < 10000; i += 2) {
+      map.erase(i);
+    }
+    assert(map.size() == 5000);
+    assert(map[9999] == "9999 and some padding");
+  }
+  assert(upstream.outstanding == 0);
+
+  /*
+   * A thread going back and forth between two pools keeps reusing the same
+   * blocks in each, rather than carving new ones on every switch.
+   */
+  {
+    counting_resource upstream_a;
+    counting_resource upstream_b;
+    convoy::pool_resource a(&upstream_a);
+    convoy::pool_resource b(&upstream_b);
+
+    for (int i = 0; i < 100000; ++i) {
+      a.deallocate(a.allocate(24), 24);
+      b.deallocate(b.allocate(24), 24);
+    }
+    assert(upstream_a.calls == 1);
+    assert(upstream_b.calls == 1);
+
+    /* With more pools than cache slots, evicted caches go back home. */
+    std::vector<convoy::pool_resource*> pools;
+    for (std::size_t i = 0; i < 2 * convoy::pool_resource::cache_slots; ++i) {
+      pools.push_back(new convoy::pool_resource(&upstream_a));
+    }
+    std::size_t calls = upstream_a.calls;
+    for (int i = 0; i < 10000; ++i) {
+      for (convoy::pool_resource* pool : pools) {
+        pool->deallocate(pool->allocate(24), 24);
+      }
+    }
+    assert(upstream_a.calls == calls + pools.size());
+
+    /* Caches for pools that are gone are dropped without touching them. */
+    for (convoy::pool_resource*& pool : pools) {
+      delete pool;
+      pool = new convoy::pool_resource(&upstream_b);
+    }
+    for (convoy::pool_resource* pool : pools) {
+      pool->deallocate(pool->allocate(24), 24);
+      delete pool;
+    }
+  }
+
+  /* Threads share one pool, freeing blocks other threads allocated. */
+  {
+    convoy::pool_resource pool;
+    std::vector<std::thread> threads;
+    std::vector<int*> handoff[THREADS];
+
+    for (int t = 0; t < THREADS; ++t) {
+      threads.emplace_back([&, t] {
+        std::vector<std::pair<void*, std::size_t>> held;
+        for (int i = 0; i < ROUNDS; ++i) {
+          std::size_t size = 8 + static_cast<std::size_t>(i % 13) * 24;
+          void* p = pool.allocate(size);
+          *static_cast<int*>(p) = t;
+          held.emplace_back(p, size);
+          if (held.size() == 64) {
+            for (auto [q, n] : held) {
+              assert(*static_cast<int*>(q) == t);
+              pool.deallocate(q, n);
+            }
+            held.clear();
+          }
+        }
+        for (auto [q, n] : held) {
+          pool.deallocate(q, n);
+        }
+        for (int i = 0; i < 100; ++i) {
+          int* p = static_cast<int*>(pool.allocate(sizeof(int)));
+          *p = t;
+          handoff[t].push_back(p);
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+
+    /* Free everything from the main thread. */
+    for (int t = 0; t < THREADS; ++t) {
+      for (int* p : handoff[t]) {
+        assert(*p == t);
+        pool.deallocate(p, sizeof(int));
+      }
+    }
+  }
+
+  puts("[ ok ]");
+
+  return 0;
+}
@@ -0,0 +1,66 @@
+#define POOL_ASSERTS
+
+#include "pool.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BUF_SIZE 8192
+
+static unsigned char buf[BUF_SIZE + POOL_MIN_SIZE];
+
+int main(void) {
+  unsigned char* base = buf + (-(uintptr_t)buf & (POOL_MIN_SIZE - 1));
+  arena a = ARENA_STATIC_INIT(base, BUF_SIZE);
+  pool p;
+
+  pool_init(&p, &a);
+
+  assert(pool_class(0) == 0);
+  assert(pool_class(16) == 0);
+  assert(pool_class(17) == 1);
+  assert(pool_class(POOL_MAX_SIZE) == POOL_CLASSES - 1);
+  assert(pool_class(POOL_MAX_SIZE + 1) == -1);
+  assert(pool_alloc(&p, POOL_MAX_SIZE + 1) == NULL);
+
+  /* Fresh blocks are carved from the arena, aligned and rounded up. */
+  void* x = pool_alloc(&p, 24);
+  void* y = pool_alloc(&p, 24);
+  assert((uintptr_t)x % POOL_MIN_SIZE == 0);
+  assert((unsigned char*)y == (unsigned char*)x + 32);
+  memset(x, 0xab, 24);
+
+  /* Freed blocks are reused last in, first out, per class. */
+  pool_free(&p, x, 24);
+  pool_free(&p, y, 24);
+  size_t used = a.used;
+  assert(pool_alloc(&p, 20) == y);
+  assert(pool_alloc(&p, 32) == x);
+  assert(a.used == used);
+
+  void* z = pool_alloc(&p, 16);
+  assert(z != x && z != y);
+  assert(a.used == used + 16);
+
+  /* Only the arena running dry makes allocation fail. */
+  size_t count = 0;
+  void* last = NULL;
+  void* blk;
+  while ((blk = pool_alloc(&p, POOL_MAX_SIZE)) != NULL) {
+    last = blk;
+    ++count;
+  }
+  assert(count == (BUF_SIZE - used - 16) / POOL_MAX_SIZE);
+  pool_free(&p, last, POOL_MAX_SIZE);
+  assert(pool_alloc(&p, POOL_MAX_SIZE) == last);
+  assert(ARENA_REMAINING(&a) < POOL_MAX_SIZE);
+
+  pool_free(&p, z, 16);
+  assert(pool_alloc(&p, 16) == z);
+
+  printf("[ %zu ]\n", count);
+
+  return 0;
+}
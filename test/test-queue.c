@@ -14,6 +14,44 @@ SLIST_DECLARE(queue, block);
 
 static queue qu = SLIST_STATIC_INIT;
 
+static void test_rotate(void) {
+  queue q = SLIST_STATIC_INIT;
+  block_t b[3];
+  block_t* res;
+  int i;
+
+  /* Rotating an empty list does nothing. */
+  SLIST_ROTATE_FORWARD(&q, next);
+  SLIST_ROUND_ROBIN(&q, res, next);
+  assert(res == NULL);
+  assert(SLIST_IS_EMPTY(&q));
+
+  for (i = 0; i < 3; ++i) {
+    b[i].elem = i;
+    SLIST_ELEM_INIT(&b[i], next);
+    SLIST_PUSH_BACK(&q, &b[i], next);
+  }
+
+  SLIST_ROTATE_FORWARD(&q, next);
+  assert(SLIST_PEEK_FRONT(&q, next) == &b[1]);
+  assert(SLIST_PEEK_BACK(&q, next) == &b[0]);
+  SLIST_ROTATE_AFTER(&q, &b[2], next);
+  assert(SLIST_PEEK_FRONT(&q, next) == &b[0]);
+  assert(SLIST_PEEK_BACK(&q, next) == &b[2]);
+
+  /* Round robin takes turns, and the list still works as a list. */
+  for (i = 0; i < 7; ++i) {
+    SLIST_ROUND_ROBIN(&q, res, next);
+    assert(res == &b[i % 3]);
+    assert(SLIST_PEEK_BACK(&q, next) == res);
+  }
+  for (i = 1; i < 4; ++i) {
+    SLIST_POP_FRONT(&q, res, next);
+    assert(res == &b[i % 3]);
+  }
+  assert(SLIST_IS_EMPTY(&q));
+}
+
 int main(void) {
   block_t b0 = { .next = SLIST_LINK_STATIC_INIT, .elem = 0 };
   block_t b1 = { .next = SLIST_LINK_STATIC_INIT, .elem = 1 };
@@ -46,5 +84,7 @@ int main(void) {
 
   printf("]\n");
 
+  test_rotate();
+
   return 0;
 }
@@ -0,0 +1,101 @@
+#define SDLIST_ASSERTS
+
+#include "sdlist.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+typedef struct block {
+  int elem;
+  SDLIST_DECLARE_LINK(link);
+} block_t;
+
+SDLIST_DECLARE(deque);
+
+static deque deq = SDLIST_STATIC_INIT(deq);
+
+/*
+ * Checks that DEQ holds exactly the N elements in WANT, in order, linked
+ * together both ways.
+ */
+static void check(const int* want, int n) {
+  block_t* curr;
+  int i = 0;
+
+  SDLIST_FOREACH(curr, &deq, block, link, {
+    assert(i < n);
+    assert(curr->elem == want[i]);
+    assert(curr->link.next->prev == &curr->link);
+    assert(curr->link.prev->next == &curr->link);
+    ++i;
+  });
+  assert(i == n);
+  assert(SDLIST_IS_EMPTY(&deq) == (n == 0));
+}
+
+int main(void) {
+  block_t b[5];
+  block_t* res;
+  int i;
+
+  for (i = 0; i < 5; ++i) {
+    b[i].elem = i;
+    SDLIST_ELEM_INIT(&b[i], link);
+    assert(!SDLIST_IS_ELEM_INSERTED(&b[i], link));
+  }
+
+  /* Popping an empty list gives NULL and leaves it empty. */
+  check(NULL, 0);
+  SDLIST_POP_FRONT(&deq, res, block, link);
+  assert(res == NULL);
+  SDLIST_POP_BACK(&deq, res, block, link);
+  assert(res == NULL);
+  assert(SDLIST_PEEK_FRONT(&deq, block, link) == NULL);
+  assert(SDLIST_PEEK_BACK(&deq, block, link) == NULL);
+  check(NULL, 0);
+
+  SDLIST_PUSH_BACK(&deq, &b[1], link);
+  SDLIST_PUSH_BACK(&deq, &b[2], link);
+  SDLIST_PUSH_FRONT(&deq, &b[0], link);
+  {
+    static const int want[] = { 0, 1, 2 };
+    check(want, 3);
+  }
+  assert(SDLIST_PEEK_FRONT(&deq, block, link) == &b[0]);
+  assert(SDLIST_PEEK_BACK(&deq, block, link) == &b[2]);
+
+  SDLIST_INSERT_NEXT(&b[2], &b[4], link);
+  SDLIST_INSERT_PREV(&b[4], &b[3], link);
+  {
+    static const int want[] = { 0, 1, 2, 3, 4 };
+    check(want, 5);
+  }
+
+  /* Removing needs no list, from the ends or the middle. */
+  SDLIST_REMOVE(&b[0], link);
+  SDLIST_REMOVE(&b[4], link);
+  SDLIST_REMOVE(&b[2], link);
+  assert(!SDLIST_IS_ELEM_INSERTED(&b[2], link));
+  {
+    static const int want[] = { 1, 3 };
+    check(want, 2);
+  }
+
+  SDLIST_POP_BACK(&deq, res, block, link);
+  assert(res == &b[3]);
+  assert(!SDLIST_IS_ELEM_INSERTED(res, link));
+  SDLIST_POP_FRONT(&deq, res, block, link);
+  assert(res == &b[1]);
+  check(NULL, 0);
+
+  /* A lone element can be removed too. */
+  SDLIST_PUSH_FRONT(&deq, &b[2], link);
+  SDLIST_REMOVE(&b[2], link);
+  check(NULL, 0);
+
+  SDLIST_INIT(&deq);
+  check(NULL, 0);
+
+  puts("[ ok ]");
+  return 0;
+}
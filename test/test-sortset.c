@@ -0,0 +1,209 @@
+#define SORTSET_ASSERTS
+#define SPLAT_ASSERTS
+
+#include "sortset.h"
+#include "splat.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#define MAX_IDS 4096
+
+typedef struct block {
+  SPLAT_LINK(block, link);
+  int key;
+} block_t;
+
+SPLAT_NEW(splat, block);
+
+#define CMP(a,b) (((a) <= (b)) ? (-(a < b)) : 1)
+
+SPLAT_LIB(splat, block, int, CMP, link, key)
+SORTSET_SPLAT_LIB(splat, block, key)
+
+static uint32_t abuf[MAX_IDS];
+static uint32_t bbuf[MAX_IDS];
+static uint32_t cbuf[MAX_IDS];
+static uint32_t dbuf[2 * MAX_IDS];
+static uint32_t raw[MAX_IDS];
+
+static block_t blocks[MAX_IDS];
+
+static uint32_t rng = 12345;
+
+static uint32_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static void fill(sortset* set, size_t n, uint32_t range) {
+  size_t i;
+  for (i = 0; i < n; ++i) {
+    raw[i] = next_rand() % range;
+  }
+  sortset_from_array(set, raw, n);
+}
+
+static bool is_sorted_set(const sortset* set) {
+  size_t i;
+  for (i = 1; i < set->len; ++i) {
+    if (set->ids[i - 1] >= set->ids[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void check_intersect(const sortset* a, const sortset* b) {
+  sortset d = SORTSET_STATIC_INIT(dbuf, 2 * MAX_IDS);
+  size_t i;
+  size_t n = 0;
+
+  sortset_intersect(&d, a, b);
+  assert(is_sorted_set(&d));
+
+  for (i = 0; i < a->len; ++i) {
+    if (sortset_contains(b, a->ids[i])) {
+      assert(n < d.len);
+      assert(d.ids[n] == a->ids[i]);
+      ++n;
+    }
+  }
+  assert(n == d.len);
+}
+
+static void check_union(const sortset* a, const sortset* b) {
+  sortset d = SORTSET_STATIC_INIT(dbuf, 2 * MAX_IDS);
+  size_t i;
+  size_t n = a->len;
+
+  sortset_union(&d, a, b);
+  assert(is_sorted_set(&d));
+
+  for (i = 0; i < b->len; ++i) {
+    n += !sortset_contains(a, b->ids[i]);
+  }
+  assert(n == d.len);
+
+  for (i = 0; i < a->len; ++i) {
+    assert(sortset_contains(&d, a->ids[i]));
+  }
+  for (i = 0; i < b->len; ++i) {
+    assert(sortset_contains(&d, b->ids[i]));
+  }
+}
+
+/*
+ * Checks that this CPU has the instructions the test was compiled for.  The
+ * -msse4.1 and -mavx2 builds exit with 77 without one, which meson counts as
+ * a skip.
+ */
+static bool cpu_supported(void) {
+#if defined(__AVX2__)
+  return __builtin_cpu_supports("avx2");
+#elif defined(__SSE4_1__)
+  return __builtin_cpu_supports("sse4.1");
+#else
+  return true;
+#endif
+}
+
+int main(void) {
+  if (!cpu_supported()) {
+    return 77;
+  }
+
+  sortset a = SORTSET_STATIC_INIT(abuf, MAX_IDS);
+  sortset b = SORTSET_STATIC_INIT(bbuf, MAX_IDS);
+  sortset c = SORTSET_STATIC_INIT(cbuf, MAX_IDS);
+  sortset d = SORTSET_STATIC_INIT(dbuf, 2 * MAX_IDS);
+  size_t i;
+  int round;
+
+  assert(SORTSET_IS_EMPTY(&a));
+  assert(!sortset_contains(&a, 0));
+
+  uint32_t dups[] = { 5, 3, 5, 1, 3, 9 };
+  assert(sortset_from_array(&a, dups, 6) == 4);
+  assert(is_sorted_set(&a));
+  assert(sortset_contains(&a, 9));
+  assert(!sortset_contains(&a, 4));
+
+  assert(sortset_gallop(a.ids, a.len, 0, 0) == 0);
+  assert(sortset_gallop(a.ids, a.len, 0, 4) == 2);
+  assert(sortset_gallop(a.ids, a.len, 1, 9) == 3);
+  assert(sortset_gallop(a.ids, a.len, 0, 10) == a.len);
+
+  /*
+   * Merge and galloping paths, with ragged lengths.  The SIMD kernels take
+   * the merge's place in the -msse4.1 and -mavx2 builds of this test.
+   */
+  for (round = 0; round < 200; ++round) {
+    fill(&a, 1 + next_rand() % MAX_IDS, 8192);
+    fill(&b, next_rand() % 64, 8192);
+    check_intersect(&a, &b);
+    check_intersect(&b, &a);
+    check_union(&a, &b);
+    check_union(&b, &a);
+
+    fill(&b, 1 + next_rand() % MAX_IDS, 8192);
+    check_intersect(&a, &b);
+    check_union(&a, &b);
+  }
+
+  /* Intersecting in place. */
+  fill(&a, MAX_IDS, 4096);
+  fill(&b, MAX_IDS, 4096);
+  sortset_intersect(&d, &a, &b);
+  size_t expect = d.len;
+  sortset_intersect(&a, &a, &b);
+  assert(a.len == expect);
+  assert(is_sorted_set(&a));
+
+  /* K-way intersection picks the smallest set first. */
+  for (i = 0; i < MAX_IDS; ++i) {
+    raw[i] = (uint32_t)i;
+  }
+  sortset_from_array(&a, raw, MAX_IDS);
+  for (i = 0; i < MAX_IDS / 2; ++i) {
+    raw[i] = (uint32_t)(i * 2);
+  }
+  sortset_from_array(&b, raw, MAX_IDS / 2);
+  for (i = 0; i < MAX_IDS / 3; ++i) {
+    raw[i] = (uint32_t)(i * 3);
+  }
+  sortset_from_array(&c, raw, MAX_IDS / 3);
+
+  const sortset* many[] = { &a, &b, &c };
+  sortset_intersect_many(&d, many, 3);
+  assert(is_sorted_set(&d));
+  for (i = 0; i < d.len; ++i) {
+    assert(d.ids[i] % 6 == 0);
+  }
+  assert(d.len == (MAX_IDS / 3 + 1) / 2);
+
+  /* Building from a splat tree leaves the tree intact. */
+  splat tree = SPLAT_STATIC_INIT;
+  for (i = 0; i < 100; ++i) {
+    blocks[i].key = (int)((i * 37) % 100);
+    SPLAT_ELEM_INIT(&blocks[i], link);
+    splat_insert(&tree, &blocks[i]);
+  }
+  sortset small = SORTSET_STATIC_INIT(abuf, 10);
+  SORTSET_FROM_SPLAT(&small, &tree, splat);
+  assert(small.len == 10);
+  assert(small.ids[9] == 9);
+
+  SORTSET_FROM_SPLAT(&a, &tree, splat);
+  assert(a.len == 100);
+  for (i = 0; i < a.len; ++i) {
+    assert(a.ids[i] == i);
+    assert(splat_search(&tree, (int)i) == &blocks[(i * 73) % 100]);
+  }
+
+  printf("[ %zu %zu ]\n", a.len, d.len);
+
+  return 0;
+}
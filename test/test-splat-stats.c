@@ -0,0 +1,245 @@
+#define SPLAT_ASSERTS
+#define SPLAT_STATS
+
+#include "splat.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct block {
+  SPLAT_LINK(block, link);
+  int key;
+} block_t;
+
+SPLAT_NEW(splat, block);
+
+SPLAT_LIB(splat, block, int, SPLAT_CMP_INT, link, key)
+
+typedef struct slot {
+  SPLAT_IDX_LINK(link);
+  int key;
+} slot_t;
+
+SPLAT_IDX_NEW(slots, slot);
+
+SPLAT_IDX_LIB(slots, slot, int, SPLAT_CMP_INT, link, key)
+
+#define NUM_BLOCKS 1000
+
+static block_t blocks[NUM_BLOCKS];
+static slot_t pool[NUM_BLOCKS + 1];
+
+static void block_init(block_t* blk, int key) {
+  blk->key = key;
+  SPLAT_ELEM_INIT(blk, link);
+}
+
+static void test_counters(void) {
+  splat tree;
+  struct splat_shape shape;
+  int i;
+
+  SPLAT_INIT(&tree);
+  assert(tree.stats.inserts == 0 && tree.stats.splays == 0);
+
+  /* Sequential inserts leave the tree shaped like a list, without rotating. */
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    block_init(&blocks[i], i);
+    splat_insert(&tree, &blocks[i]);
+  }
+  assert(tree.stats.inserts == NUM_BLOCKS);
+  assert(tree.stats.rotations == 0);
+  splat_shape(&tree, &shape);
+  assert(shape.count == NUM_BLOCKS);
+  assert(shape.height == NUM_BLOCKS);
+  assert(shape.total_depth == NUM_BLOCKS * (NUM_BLOCKS - 1) / 2);
+
+  /* Searching for the bottom of the list splays it all the way up. */
+  assert(splat_search(&tree, 0) == &blocks[0]);
+  assert(tree.stats.searches == 1);
+  assert(tree.stats.rotations > 0);
+  assert(tree.stats.splays >= tree.stats.searches);
+  assert(tree.stats.splay_depth >= NUM_BLOCKS - 1);
+
+  assert(splat_remove(&tree, 0) == &blocks[0]);
+  assert(splat_remove(&tree, 0) == NULL);
+
+  /* Removes search first, and only count when they find something. */
+  assert(tree.stats.removes == 1);
+  assert(tree.stats.searches == 3);
+
+  SPLAT_INIT(&tree);
+  assert(tree.stats.inserts == 0 && tree.stats.removes == 0);
+  assert(tree.stats.rotations == 0 && tree.stats.splay_depth == 0);
+}
+
+static void test_hint(void) {
+  splat tree;
+  block_t* hint = NULL;
+  unsigned long long rotations;
+  block_t extra;
+  int i;
+
+  /* Hinted inserts of nearly sorted keys splay rarely and shallowly. */
+  SPLAT_INIT(&tree);
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    /* Swap neighboring pairs: 1, 0, 3, 2, ... */
+    block_init(&blocks[i], i ^ 1);
+    splat_insert_hint(&tree, hint, &blocks[i]);
+    hint = &blocks[i];
+  }
+  assert(tree.stats.rotations <= NUM_BLOCKS);
+
+  /* Reverse sorted keys always land next to the hint. */
+  SPLAT_INIT(&tree);
+  hint = NULL;
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    block_init(&blocks[i], NUM_BLOCKS - i);
+    splat_insert_hint(&tree, hint, &blocks[i]);
+    hint = &blocks[i];
+  }
+  assert(tree.stats.rotations == 0);
+
+  /* A stale hint falls back to a plain insert, which splays. */
+  assert(splat_search(&tree, NUM_BLOCKS / 2) != NULL);
+  rotations = tree.stats.rotations;
+  block_init(&extra, 0);
+  splat_insert_hint(&tree, hint, &extra);
+  assert(tree.stats.inserts == NUM_BLOCKS + 1);
+  assert(tree.stats.rotations > rotations);
+}
+
+static void test_pooled(void) {
+  splat tree;
+  slots slots_tree;
+  struct splat_shape shape;
+  struct splat_shape pooled_shape;
+  int i;
+
+  /* A pooled tree splays the same way, so it counts the same. */
+  SPLAT_INIT(&tree);
+  SPLAT_IDX_INIT(&slots_tree, pool);
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    block_init(&blocks[i], (i * 37) % NUM_BLOCKS);
+    splat_insert(&tree, &blocks[i]);
+    pool[i + 1].key = (i * 37) % NUM_BLOCKS;
+    SPLAT_IDX_ELEM_INIT(&pool[i + 1], link);
+    slots_insert(&slots_tree, &pool[i + 1]);
+  }
+  for (i = 0; i < NUM_BLOCKS; i += 7) {
+    assert(splat_search(&tree, i) != NULL);
+    assert(slots_search(&slots_tree, i) != NULL);
+  }
+  assert(splat_remove(&tree, 3) != NULL);
+  assert(slots_remove(&slots_tree, 3) != NULL);
+
+  assert(slots_tree.stats.inserts == tree.stats.inserts);
+  assert(slots_tree.stats.searches == tree.stats.searches);
+  assert(slots_tree.stats.removes == tree.stats.removes);
+  assert(slots_tree.stats.comparisons == tree.stats.comparisons);
+  assert(slots_tree.stats.rotations == tree.stats.rotations);
+  assert(slots_tree.stats.splays == tree.stats.splays);
+  assert(slots_tree.stats.splay_depth == tree.stats.splay_depth);
+
+  splat_shape(&tree, &shape);
+  slots_shape(&slots_tree, &pooled_shape);
+  assert(pooled_shape.count == NUM_BLOCKS - 1);
+  assert(pooled_shape.height == shape.height);
+  assert(pooled_shape.total_depth == shape.total_depth);
+}
+
+/*
+ * Reads the next line of OUT and checks that it is WANT.
+ */
+static void expect_line(FILE* out, const char* want) {
+  char line[128];
+
+  assert(fgets(line, sizeof(line), out) != NULL);
+  assert(strcmp(line, want) == 0);
+}
+
+static void test_print(void) {
+  splat tree;
+  struct splat_shape shape;
+  unsigned long long cumulative = 0;
+  char want[128];
+  FILE* out;
+  size_t k;
+  int i;
+
+  SPLAT_INIT(&tree);
+  for (i = 0; i < 16; ++i) {
+    block_init(&blocks[i], (i * 7) % 16);
+    splat_insert(&tree, &blocks[i]);
+  }
+  for (i = 0; i < 16; i += 3) {
+    assert(splat_search(&tree, i) != NULL);
+  }
+  assert(splat_remove(&tree, 5) != NULL);
+  splat_shape(&tree, &shape);
+
+  out = tmpfile();
+  assert(out != NULL);
+  splat_stats_print(&tree, out, "t");
+  rewind(out);
+
+  snprintf(want, sizeof(want),
+           "splat_operations_total{tree=\"t\",op=\"insert\"} %llu\n",
+           tree.stats.inserts);
+  expect_line(out, want);
+  snprintf(want, sizeof(want),
+           "splat_operations_total{tree=\"t\",op=\"search\"} %llu\n",
+           tree.stats.searches);
+  expect_line(out, want);
+  snprintf(want, sizeof(want),
+           "splat_operations_total{tree=\"t\",op=\"remove\"} %llu\n",
+           tree.stats.removes);
+  expect_line(out, want);
+  snprintf(want, sizeof(want), "splat_comparisons_total{tree=\"t\"} %llu\n",
+           tree.stats.comparisons);
+  expect_line(out, want);
+  snprintf(want, sizeof(want), "splat_rotations_total{tree=\"t\"} %llu\n",
+           tree.stats.rotations);
+  expect_line(out, want);
+
+  /* The histogram is cumulative, and ends with every splay. */
+  for (k = 0; k < SPLAT_STATS_BUCKETS; ++k) {
+    cumulative += tree.stats.depths[k];
+    snprintf(want, sizeof(want),
+             "splat_splay_depth_bucket{tree=\"t\",le=\"%llu\"} %llu\n",
+             (2ULL << k) - 2, cumulative);
+    expect_line(out, want);
+  }
+  assert(cumulative == tree.stats.splays);
+  snprintf(want, sizeof(want),
+           "splat_splay_depth_bucket{tree=\"t\",le=\"+Inf\"} %llu\n",
+           tree.stats.splays);
+  expect_line(out, want);
+  snprintf(want, sizeof(want), "splat_splay_depth_sum{tree=\"t\"} %llu\n",
+           tree.stats.splay_depth);
+  expect_line(out, want);
+  snprintf(want, sizeof(want), "splat_splay_depth_count{tree=\"t\"} %llu\n",
+           tree.stats.splays);
+  expect_line(out, want);
+
+  expect_line(out, "splat_nodes{tree=\"t\"} 15\n");
+  snprintf(want, sizeof(want), "splat_height{tree=\"t\"} %zu\n",
+           shape.height);
+  expect_line(out, want);
+  snprintf(want, sizeof(want), "splat_average_depth{tree=\"t\"} %g\n",
+           (double)shape.total_depth / shape.count);
+  expect_line(out, want);
+  assert(fgets(want, sizeof(want), out) == NULL);
+  fclose(out);
+}
+
+int main(void) {
+  test_counters();
+  test_hint();
+  test_pooled();
+  test_print();
+
+  puts("[ ok ]");
+  return 0;
+}
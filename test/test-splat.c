@@ -4,6 +4,7 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
 typedef struct block {
   SPLAT_LINK(block, link);
@@ -19,6 +20,34 @@ SPLAT_LIB(splat, block, int, CMP, link, key)
 
 static splat tree = SPLAT_STATIC_INIT;
 
+typedef struct host {
+  SPLAT_LINK(host, link);
+  splat_strkey name;
+} host_t;
+
+SPLAT_NEW(hosts, host);
+
+SPLAT_STR_LIB(hosts, host, link, name)
+
+typedef struct slot {
+  SPLAT_IDX_LINK(link);
+  int key;
+} slot_t;
+
+SPLAT_IDX_NEW(slots, slot);
+
+SPLAT_IDX_LIB(slots, slot, int, CMP, link, key)
+
+#define NUM_SLOTS 1000
+
+static slot_t pool[NUM_SLOTS];
+static slot_t pool_copy[NUM_SLOTS];
+
+#define NUM_BLOCKS 100000
+
+static block_t blocks[NUM_BLOCKS];
+static int visited = 0;
+
 static void block_init(block_t *blk, int key, int val) {
   assert(blk != NULL);
 
@@ -43,6 +72,38 @@ static void print(block_t *tree, int depth, int indent) {
   print(tree->link.next, depth + indent, indent);
 }
 
+static int height(block_t *tree) {
+  if (tree == NULL) {
+    return 0;
+  }
+
+  int prev = height(tree->link.prev);
+  int next = height(tree->link.next);
+  return 1 + (prev > next ? prev : next);
+}
+
+static int is_odd(block_t *blk) {
+  assert(blk->link.prev == NULL);
+  assert(blk->link.next == NULL);
+
+  return blk->key % 2;
+}
+
+static int slot_is_odd(slot_t *s) {
+  assert(s->link.prev == SPLAT_IDX_NIL);
+  assert(s->link.next == SPLAT_IDX_NIL);
+
+  return s->key % 2;
+}
+
+static void count(block_t *blk) {
+  assert(blk->link.prev == NULL);
+  assert(blk->link.next == NULL);
+  assert(blk->key == visited * 2);
+
+  ++visited;
+}
+
 int main(void) {
   block_t b0;
   block_init(&b0, 1, 0);
@@ -78,5 +139,177 @@ int main(void) {
 
   assert(res == NULL);
 
+  assert(SPLAT_CMP_INT(-1, 1) == -1);
+  assert(SPLAT_CMP_INT(2u, 2u) == 0);
+  assert(splat_cmp_i32(INT32_MIN, INT32_MAX) == -1);
+  assert(splat_cmp_i64(0, INT64_MIN) == 1);
+  assert(splat_cmp_u32(UINT32_MAX, 0) == 1);
+  assert(splat_cmp_u64(0, UINT64_MAX) == -1);
+
+  /* Sequential inserts leave the tree shaped like a list. */
+  int i;
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    block_init(&blocks[i], i, i);
+    splat_insert(&tree, &blocks[i]);
+  }
+  struct splat_shape shape;
+  splat_shape(&tree, &shape);
+  assert(shape.count == NUM_BLOCKS);
+  assert(shape.height == NUM_BLOCKS);
+
+  assert(splat_remove_if(&tree, is_odd) == NUM_BLOCKS / 2);
+  assert(height(tree.root) <= 16);
+
+  splat_shape(&tree, &shape);
+  assert(shape.count == NUM_BLOCKS / 2);
+  assert(shape.height == (size_t)height(tree.root));
+
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    res = splat_search(&tree, i);
+    assert(res == ((i % 2) ? NULL : &blocks[i]));
+  }
+
+  /* Hinted inserts of nearly sorted keys. */
+  splat_clear(&tree, NULL);
+  block_t *hint = NULL;
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    /* Swap neighboring pairs: 1, 0, 3, 2, ... */
+    block_init(&blocks[i], i ^ 1, i);
+    splat_insert_hint(&tree, hint, &blocks[i]);
+    hint = &blocks[i];
+  }
+  splat_shape(&tree, &shape);
+  assert(shape.count == NUM_BLOCKS);
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    assert(splat_search(&tree, i ^ 1) == &blocks[i]);
+  }
+
+  /* Reverse sorted keys always land next to the hint. */
+  splat_clear(&tree, NULL);
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    block_init(&blocks[i], NUM_BLOCKS - i, i);
+    splat_insert_hint(&tree, hint, &blocks[i]);
+    hint = &blocks[i];
+  }
+
+  /* A stale hint falls back to a plain insert. */
+  assert(splat_search(&tree, NUM_BLOCKS / 2) != NULL);
+  block_t extra;
+  block_init(&extra, 0, 0);
+  splat_insert_hint(&tree, hint, &extra);
+  assert(splat_search(&tree, 0) == &extra);
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    assert(splat_search(&tree, NUM_BLOCKS - i) == &blocks[i]);
+  }
+
+  splat_clear(&tree, NULL);
+  for (i = 0; i < NUM_BLOCKS; ++i) {
+    block_init(&blocks[i], 2 * i, i);
+    splat_insert_max(&tree, &blocks[i]);
+    if (i % 1000 == 0) {
+      assert(splat_search(&tree, i) != NULL);
+    }
+  }
+  splat_shape(&tree, &shape);
+  assert(shape.count == NUM_BLOCKS);
+
+  splat_clear(&tree, count);
+  assert(tree.root == NULL);
+  assert(visited == NUM_BLOCKS);
+
+  /* String keys order like memcmp, with shorter prefixes first. */
+  static const char* names[] = {
+    "example.com", "example.co", "example.com.au", "example.org",
+    "a", "", "abcdefgh", "abcdefghi", "abcdefgh\xff",
+  };
+  const size_t num_names = sizeof(names) / sizeof(names[0]);
+  host_t host_blocks[sizeof(names) / sizeof(names[0])];
+  hosts names_tree = SPLAT_STATIC_INIT;
+  size_t j;
+  size_t k;
+
+  for (j = 0; j < num_names; ++j) {
+    host_blocks[j].name = SPLAT_STRKEY(names[j]);
+    SPLAT_ELEM_INIT(&host_blocks[j], link);
+    hosts_insert(&names_tree, &host_blocks[j]);
+  }
+  for (j = 0; j < num_names; ++j) {
+    for (k = 0; k < num_names; ++k) {
+      int c = splat_strkey_cmp(host_blocks[j].name, host_blocks[k].name);
+      int s = strcmp(names[j], names[k]);
+      assert((c > 0) == (s > 0) && (c < 0) == (s < 0));
+    }
+    assert(hosts_search(&names_tree, SPLAT_STRKEY(names[j])) ==
+           &host_blocks[j]);
+  }
+  assert(hosts_search(&names_tree, SPLAT_STRKEY("example.c")) == NULL);
+  assert(hosts_search(&names_tree, splat_strkey_make("abcdefghi", 8)) ==
+         &host_blocks[6]);
+  assert(hosts_remove(&names_tree, SPLAT_STRKEY("example.org")) ==
+         &host_blocks[3]);
+  assert(hosts_search(&names_tree, SPLAT_STRKEY("example.org")) == NULL);
+  hosts_clear(&names_tree, NULL);
+
+  /* Pooled trees keep working after the pool is copied elsewhere. */
+  slots slots_tree = SPLAT_IDX_STATIC_INIT(pool);
+  assert(sizeof(pool[0].link) == 2 * sizeof(uint32_t));
+
+  for (i = 1; i < NUM_SLOTS; ++i) {
+    pool[i].key = (i * 37) % NUM_SLOTS;
+    SPLAT_IDX_ELEM_INIT(&pool[i], link);
+    slots_insert(&slots_tree, &pool[i]);
+  }
+  for (i = 1; i < NUM_SLOTS; ++i) {
+    assert(slots_search(&slots_tree, (i * 37) % NUM_SLOTS) == &pool[i]);
+  }
+  assert(slots_search(&slots_tree, 0) == NULL);
+  assert(slots_remove(&slots_tree, 37) == &pool[1]);
+  assert(slots_search(&slots_tree, 37) == NULL);
+
+  memcpy(pool_copy, pool, sizeof(pool));
+  slots_tree.pool = pool_copy;
+  for (i = 2; i < NUM_SLOTS; ++i) {
+    assert(slots_search(&slots_tree, (i * 37) % NUM_SLOTS) == &pool_copy[i]);
+  }
+  slots_clear(&slots_tree, NULL);
+  assert(slots_tree.root == SPLAT_IDX_NIL);
+  assert(slots_search(&slots_tree, 74) == NULL);
+
+  /* Pooled trees take hints, maxima and bulk removes like pointer trees. */
+  struct splat_shape pooled_shape;
+  slot_t* slots_hint = NULL;
+  SPLAT_IDX_INIT(&slots_tree, pool);
+  for (i = 1; i < NUM_SLOTS / 2; ++i) {
+    pool[i].key = i * 2;
+    SPLAT_IDX_ELEM_INIT(&pool[i], link);
+    slots_insert_hint(&slots_tree, slots_hint, &pool[i]);
+    slots_hint = &pool[i];
+  }
+  for (i = NUM_SLOTS / 2; i < NUM_SLOTS; ++i) {
+    pool[i].key = i * 2;
+    SPLAT_IDX_ELEM_INIT(&pool[i], link);
+    slots_insert_max(&slots_tree, &pool[i]);
+  }
+  slots_shape(&slots_tree, &pooled_shape);
+  assert(pooled_shape.count == NUM_SLOTS - 1);
+  assert(pooled_shape.height == NUM_SLOTS - 1);
+
+  for (i = 1; i < NUM_SLOTS; ++i) {
+    pool[i].key += i % 2;
+  }
+  assert(slots_remove_if(&slots_tree, slot_is_odd) == NUM_SLOTS / 2);
+  slots_shape(&slots_tree, &pooled_shape);
+  assert(pooled_shape.count == NUM_SLOTS / 2 - 1);
+  assert(pooled_shape.height <= 9);
+  for (i = 2; i < NUM_SLOTS; i += 2) {
+    assert(slots_search(&slots_tree, i * 2) == &pool[i]);
+  }
+  slots_clear(&slots_tree, NULL);
+
+  splat_clear(&tree, NULL);
+  assert(tree.root == NULL);
+  assert(splat_remove_if(&tree, is_odd) == 0);
+  assert(tree.root == NULL);
+
   return 0;
 }
@@ -0,0 +1,80 @@
+#include "spsc.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Counts live instances, and refuses to be default constructed or copied.
+ */
+struct tracked {
+  static int live;
+
+  explicit tracked(int v) : value(v) { ++live; }
+  tracked(tracked&& other) noexcept : value(other.value) { ++live; }
+  tracked(const tracked&) = delete;
+  ~tracked() { --live; }
+
+  int value;
+};
+
+int tracked::live = 0;
+
+int main() {
+  {
+    convoy::spsc_channel<tracked, 4> chan;
+    assert(chan.capacity() == 3);
+    assert(chan.empty());
+    assert(tracked::live == 0);
+
+    assert(chan.try_emplace(1));
+    assert(chan.try_emplace(2));
+    assert(chan.try_push(tracked(3)));
+    assert(!chan.try_emplace(4));
+    assert(tracked::live == 3);
+
+    std::optional<tracked> out = chan.try_pop();
+    assert(out && out->value == 1);
+    out.reset();
+    assert(tracked::live == 2);
+  }
+  /* The elements left in the channel were destroyed with it. */
+  assert(tracked::live == 0);
+
+  convoy::spsc_channel<std::unique_ptr<int>, 2> ptrs;
+  assert(ptrs.try_push(std::make_unique<int>(7)));
+  std::unique_ptr<int> p = std::move(*ptrs.try_pop());
+  assert(*p == 7);
+  assert(!ptrs.try_pop());
+
+  /* Heap-owning payloads cross threads without being copied. */
+  constexpr int count = 100000;
+  convoy::spsc_channel<std::vector<std::string>, 64> chan;
+
+  std::thread producer([&] {
+    for (int i = 0; i < count; ++i) {
+      std::vector<std::string> payload{ std::to_string(i), "payload" };
+      while (!chan.try_push(std::move(payload))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  for (int i = 0; i < count; ++i) {
+    std::optional<std::vector<std::string>> got;
+    while (!(got = chan.try_pop())) {
+      std::this_thread::yield();
+    }
+    assert(got->size() == 2);
+    assert((*got)[0] == std::to_string(i));
+  }
+  producer.join();
+  assert(chan.empty());
+
+  puts("[ ok ]");
+
+  return 0;
+}
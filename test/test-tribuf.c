@@ -0,0 +1,153 @@
+#define TRIBUF_ASSERTS
+
+#include "tribuf.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A snapshot that is only consistent if it was written and read whole.
+ */
+typedef struct snapshot {
+  uint64_t seq;
+  uint64_t words[15];
+} snapshot_t;
+
+TRIBUF_DECLARE(mailbox, snapshot_t);
+
+/*
+ * A value that ends partway through a cache line.
+ */
+typedef struct ragged {
+  char bytes[72];
+} ragged_t;
+
+TRIBUF_DECLARE(ragged_box, ragged_t);
+
+#define WRITES 1000000
+
+static void fill(snapshot_t* snap, uint64_t seq) {
+  size_t i;
+
+  snap->seq = seq;
+  for (i = 0; i < 15; ++i) {
+    snap->words[i] = seq * (i + 1);
+  }
+}
+
+static bool consistent(const snapshot_t* snap) {
+  size_t i;
+
+  for (i = 0; i < 15; ++i) {
+    if (snap->words[i] != snap->seq * (i + 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#define LINE_OF(TB, FIELD) \
+  (((uintptr_t)&(TB)->FIELD - (uintptr_t)(TB)) / TRIBUF_CACHE_LINE)
+
+/*
+ * Checks that a triple buffer is aligned, even on the stack, and that its
+ * buffers and its three bytes of state each get cache lines of their own.
+ */
+static void test_layout(void) {
+  ragged_box box;
+  ragged_box* tb = &box;
+
+  assert((uintptr_t)tb % TRIBUF_CACHE_LINE == 0);
+  assert((uintptr_t)&tb->bufs[1] % TRIBUF_CACHE_LINE == 0);
+  assert((uintptr_t)&tb->bufs[2] % TRIBUF_CACHE_LINE == 0);
+  assert(LINE_OF(tb, bufs[0].elem.bytes[71]) < LINE_OF(tb, bufs[1]));
+  assert(LINE_OF(tb, bufs[1].elem.bytes[71]) < LINE_OF(tb, bufs[2]));
+  assert(LINE_OF(tb, bufs[2].elem.bytes[71]) < LINE_OF(tb, state));
+  assert(LINE_OF(tb, state) < LINE_OF(tb, back));
+  assert(LINE_OF(tb, back) < LINE_OF(tb, front));
+}
+
+static void test_single(void) {
+  static mailbox mb = TRIBUF_STATIC_INIT;
+  snapshot_t snap;
+  const snapshot_t* read;
+
+  /* Nothing has been published yet, so the reader sees zeroes. */
+  assert(!TRIBUF_HAS_FRESH(&mb));
+  read = TRIBUF_READ(&mb);
+  assert(read->seq == 0);
+
+  fill(TRIBUF_WRITE_BUF(&mb), 1);
+  TRIBUF_PUBLISH(&mb);
+  assert(TRIBUF_HAS_FRESH(&mb));
+  read = TRIBUF_READ(&mb);
+  assert(read->seq == 1);
+  assert(consistent(read));
+  assert(!TRIBUF_HAS_FRESH(&mb));
+  assert(!TRIBUF_UPDATE(&mb));
+  assert(TRIBUF_PEEK(&mb) == read);
+
+  /* Only the latest of several unread values is kept. */
+  fill(&snap, 2);
+  TRIBUF_WRITE(&mb, snap);
+  fill(&snap, 3);
+  TRIBUF_WRITE(&mb, snap);
+  fill(&snap, 4);
+  TRIBUF_WRITE(&mb, snap);
+
+  /* The value the reader holds doesn't change until it asks. */
+  assert(TRIBUF_PEEK(&mb)->seq == 1);
+  assert(TRIBUF_UPDATE(&mb));
+  assert(TRIBUF_PEEK(&mb)->seq == 4);
+  assert(TRIBUF_READ(&mb)->seq == 4);
+}
+
+static void* writer(void* arg) {
+  mailbox* mb = (mailbox*)arg;
+  uint64_t seq;
+
+  for (seq = 1; seq <= WRITES; ++seq) {
+    fill(TRIBUF_WRITE_BUF(mb), seq);
+    TRIBUF_PUBLISH(mb);
+  }
+  return NULL;
+}
+
+static void test_threads(void) {
+  static mailbox mb;
+  pthread_t thread;
+  const snapshot_t* read;
+  uint64_t last = 0;
+  size_t changes = 0;
+
+  TRIBUF_INIT(&mb);
+  fill(TRIBUF_PEEK(&mb), 0);
+
+  assert(pthread_create(&thread, NULL, writer, &mb) == 0);
+  while (last < WRITES) {
+    read = TRIBUF_READ(&mb);
+    assert(consistent(read));
+    assert(read->seq >= last);
+    if (read->seq != last) {
+      ++changes;
+    }
+    last = read->seq;
+  }
+  assert(pthread_join(thread, NULL) == 0);
+
+  assert(changes > 0);
+  assert(!TRIBUF_UPDATE(&mb));
+  assert(TRIBUF_PEEK(&mb)->seq == WRITES);
+}
+
+int main(void) {
+  test_layout();
+  test_single();
+  test_threads();
+
+  puts("[ ok ]");
+  return 0;
+}
@@ -0,0 +1,374 @@
+/*
+ * Generates a header with a minimal perfect hash table for a fixed set of
+ * keys, using hash and displace.
+ *
+ * Usage:
+ *
+ *   phgen NAME INPUT OUTPUT
+ *
+ * Each line of INPUT is a key, optionally followed by whitespace and a C
+ * expression for its int value; a key without one gets its line's index
+ * among the keys.  Blank lines and lines starting with '#' are skipped.
+ *
+ * OUTPUT declares NAME_entries, a const array with one slot per key, and
+ * NAME_lookup(), which returns a pointer to a key's value or NULL.
+ *
+ * Keys are hashed into buckets of about PHGEN_LAMBDA keys each.  Buckets are
+ * placed largest first, and each searches for a displacement that sends all
+ * of its keys to free slots.  If some bucket can't find one, the whole
+ * thing starts over with the next seed.
+ */
+
+#include "phash.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PHGEN_LAMBDA 4
+#define PHGEN_MAX_DISP (UINT32_C(1) << 20)
+#define PHGEN_MAX_SEEDS 1000
+
+struct key {
+  char* str;
+  size_t len;
+  char* value;
+  uint64_t hash;
+};
+
+struct bucket {
+  size_t index;
+  size_t count;
+  size_t* keys;
+};
+
+static void die(const char* msg, const char* arg) {
+  fprintf(stderr, "phgen: %s%s\n", msg, arg);
+  exit(1);
+}
+
+static void* xmalloc(size_t size) {
+  void* p = malloc(size != 0 ? size : 1);
+  if (p == NULL) {
+    die("out of memory", "");
+  }
+  return p;
+}
+
+static char* xstrndup(const char* str, size_t len) {
+  char* copy = xmalloc(len + 1);
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+/*
+ * Reads the keys out of PATH, returning how many there are.
+ */
+static size_t read_keys(const char* path, struct key** out) {
+  FILE* f = fopen(path, "r");
+  char line[4096];
+  size_t n = 0;
+  size_t cap = 16;
+  struct key* keys = xmalloc(cap * sizeof(*keys));
+
+  if (f == NULL) {
+    die("can't open ", path);
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    char* p = line;
+    char* end = line + strlen(line);
+    char* key;
+
+    while (end > p && isspace((unsigned char)end[-1])) {
+      *--end = '\0';
+    }
+    while (isspace((unsigned char)*p)) {
+      ++p;
+    }
+    if (*p == '\0' || *p == '#') {
+      continue;
+    }
+
+    key = p;
+    while (*p != '\0' && !isspace((unsigned char)*p)) {
+      ++p;
+    }
+    if (n == cap) {
+      cap *= 2;
+      keys = realloc(keys, cap * sizeof(*keys));
+      if (keys == NULL) {
+        die("out of memory", "");
+      }
+    }
+    keys[n].str = xstrndup(key, (size_t)(p - key));
+    keys[n].len = (size_t)(p - key);
+
+    while (isspace((unsigned char)*p)) {
+      ++p;
+    }
+    if (*p != '\0') {
+      keys[n].value = xstrndup(p, strlen(p));
+    } else {
+      char index[32];
+      snprintf(index, sizeof(index), "%zu", n);
+      keys[n].value = xstrndup(index, strlen(index));
+    }
+    ++n;
+  }
+  fclose(f);
+
+  *out = keys;
+  return n;
+}
+
+static int by_key(const void* a, const void* b) {
+  const struct key* x = a;
+  const struct key* y = b;
+  int c = memcmp(x->str, y->str, x->len < y->len ? x->len : y->len);
+
+  if (c != 0) {
+    return c;
+  }
+  return (x->len > y->len) - (x->len < y->len);
+}
+
+static int by_count_desc(const void* a, const void* b) {
+  const struct bucket* x = a;
+  const struct bucket* y = b;
+
+  if (x->count != y->count) {
+    return (x->count < y->count) - (x->count > y->count);
+  }
+  return (x->index > y->index) - (x->index < y->index);
+}
+
+/*
+ * Tries to place every key with SEED, filling in DISP and SLOTS.  Returns
+ * false if some bucket has no displacement that works, or if two keys hash
+ * the same.
+ */
+static bool place(struct key* keys,
+                  size_t n,
+                  uint64_t seed,
+                  size_t nbuckets,
+                  uint32_t* disp,
+                  size_t* slots) {
+  struct bucket* buckets = xmalloc(nbuckets * sizeof(*buckets));
+  size_t* members = xmalloc(n * sizeof(*members));
+  size_t* taken = xmalloc(PHGEN_LAMBDA * 4 * sizeof(*taken));
+  bool* used = xmalloc(n * sizeof(*used));
+  bool ok = true;
+  size_t i;
+  size_t j;
+
+  for (i = 0; i < nbuckets; ++i) {
+    buckets[i].index = i;
+    buckets[i].count = 0;
+  }
+  for (i = 0; i < n; ++i) {
+    keys[i].hash = phash_bytes(keys[i].str, keys[i].len, seed);
+    ++buckets[phash_bucket(keys[i].hash, nbuckets)].count;
+    used[i] = false;
+  }
+
+  /* Lay out each bucket's keys contiguously in MEMBERS. */
+  for (i = 0, j = 0; i < nbuckets; ++i) {
+    buckets[i].keys = members + j;
+    j += buckets[i].count;
+    buckets[i].count = 0;
+  }
+  for (i = 0; i < n; ++i) {
+    struct bucket* b = &buckets[phash_bucket(keys[i].hash, nbuckets)];
+    b->keys[b->count++] = i;
+  }
+  qsort(buckets, nbuckets, sizeof(*buckets), by_count_desc);
+
+  for (i = 0; ok && i < nbuckets; ++i) {
+    struct bucket* b = &buckets[i];
+    uint32_t d;
+
+    disp[b->index] = 0;
+    if (b->count == 0) {
+      continue;
+    }
+    if (b->count > PHGEN_LAMBDA * 4) {
+      ok = false;
+      break;
+    }
+    for (d = 0; d < PHGEN_MAX_DISP; ++d) {
+      size_t k;
+      for (k = 0; k < b->count; ++k) {
+        size_t slot = phash_slot(keys[b->keys[k]].hash, d, n);
+        size_t m = 0;
+        if (used[slot]) {
+          break;
+        }
+        while (m < k && taken[m] != slot) {
+          ++m;
+        }
+        if (m < k) {
+          break;
+        }
+        taken[k] = slot;
+      }
+      if (k == b->count) {
+        break;
+      }
+    }
+    if (d == PHGEN_MAX_DISP) {
+      ok = false;
+      break;
+    }
+    disp[b->index] = d;
+    for (j = 0; j < b->count; ++j) {
+      used[taken[j]] = true;
+      slots[taken[j]] = b->keys[j];
+    }
+  }
+
+  free(used);
+  free(taken);
+  free(members);
+  free(buckets);
+  return ok;
+}
+
+static void write_string(FILE* f, const char* str, size_t len) {
+  size_t i;
+
+  fputc('"', f);
+  for (i = 0; i < len; ++i) {
+    unsigned char c = (unsigned char)str[i];
+    if (c == '"' || c == '\\') {
+      fprintf(f, "\\%c", c);
+    } else if (isprint(c)) {
+      fputc(c, f);
+    } else {
+      fprintf(f, "\\%03o", c);
+    }
+  }
+  fputc('"', f);
+}
+
+static void write_header(const char* path,
+                         const char* name,
+                         const char* input,
+                         const struct key* keys,
+                         size_t n,
+                         uint64_t seed,
+                         size_t nbuckets,
+                         const uint32_t* disp,
+                         const size_t* slots) {
+  FILE* f = fopen(path, "w");
+  char* upper = xstrndup(name, strlen(name));
+  size_t i;
+
+  if (f == NULL) {
+    die("can't write ", path);
+  }
+  for (i = 0; upper[i] != '\0'; ++i) {
+    upper[i] = (char)toupper((unsigned char)upper[i]);
+  }
+
+  fprintf(f, "/*\n * Generated by phgen from %s.  Do not edit.\n */\n\n",
+          input);
+  fprintf(f, "#ifndef __PHGEN_%s_H__\n", upper);
+  fprintf(f, "#define __PHGEN_%s_H__\n\n", upper);
+  fprintf(f, "#include \"phash.h\"\n\n");
+  fprintf(f, "#include <stddef.h>\n#include <stdint.h>\n");
+  fprintf(f, "#include <string.h>\n\n");
+
+  fprintf(f, "#define %s_SIZE %zu\n", upper, n);
+  fprintf(f, "#define %s_BUCKETS %zu\n", upper, nbuckets);
+  fprintf(f, "#define %s_SEED UINT64_C(%llu)\n\n", upper,
+          (unsigned long long)seed);
+
+  fprintf(f, "static const uint32_t %s_disp[%s_BUCKETS] = {\n", name, upper);
+  for (i = 0; i < nbuckets; ++i) {
+    fprintf(f, "  %lu,\n", (unsigned long)disp[i]);
+  }
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "static const struct %s_entry {\n", name);
+  fprintf(f, "  const char* key;\n  size_t len;\n  int value;\n");
+  fprintf(f, "} %s_entries[%s_SIZE] = {\n", name, upper);
+  for (i = 0; i < n; ++i) {
+    const struct key* k = &keys[slots[i]];
+    fprintf(f, "  { ");
+    write_string(f, k->str, k->len);
+    fprintf(f, ", %zu, %s },\n", k->len, k->value);
+  }
+  fprintf(f, "};\n\n");
+
+  fprintf(f, "/*\n * Finds the value for KEY, or returns NULL if it isn't ");
+  fprintf(f, "in the table.\n */\n");
+  fprintf(f, "static inline const int* %s_lookup(const char* key, ", name);
+  fprintf(f, "size_t len) {\n");
+  fprintf(f, "  uint64_t h = phash_bytes(key, len, %s_SEED);\n", upper);
+  fprintf(f, "  uint32_t d = %s_disp[phash_bucket(h, %s_BUCKETS)];\n",
+          name, upper);
+  fprintf(f, "  const struct %s_entry* e =\n", name);
+  fprintf(f, "    &%s_entries[phash_slot(h, d, %s_SIZE)];\n\n", name, upper);
+  fprintf(f, "  if (e->len != len || memcmp(e->key, key, len) != 0) {\n");
+  fprintf(f, "    return NULL;\n  }\n  return &e->value;\n}\n\n#endif\n");
+
+  free(upper);
+  if (fclose(f) != 0) {
+    die("can't write ", path);
+  }
+}
+
+int main(int argc, char** argv) {
+  struct key* keys;
+  size_t n;
+  size_t nbuckets;
+  uint32_t* disp;
+  size_t* slots;
+  uint64_t seed;
+  size_t i;
+
+  if (argc != 4) {
+    fprintf(stderr, "usage: phgen NAME INPUT OUTPUT\n");
+    return 1;
+  }
+
+  n = read_keys(argv[2], &keys);
+  if (n == 0) {
+    die("no keys in ", argv[2]);
+  }
+
+  /* Values were fixed on reading, so sorting doesn't change them. */
+  qsort(keys, n, sizeof(*keys), by_key);
+  for (i = 1; i < n; ++i) {
+    if (by_key(&keys[i - 1], &keys[i]) == 0) {
+      die("duplicate key ", keys[i].str);
+    }
+  }
+
+  nbuckets = (n + PHGEN_LAMBDA - 1) / PHGEN_LAMBDA;
+  disp = xmalloc(nbuckets * sizeof(*disp));
+  slots = xmalloc(n * sizeof(*slots));
+  for (seed = 0; seed < PHGEN_MAX_SEEDS; ++seed) {
+    if (place(keys, n, seed, nbuckets, disp, slots)) {
+      break;
+    }
+  }
+  if (seed == PHGEN_MAX_SEEDS) {
+    die("no perfect hash found for ", argv[2]);
+  }
+
+  write_header(argv[3], argv[1], argv[2], keys, n, seed, nbuckets, disp, slots);
+
+  for (i = 0; i < n; ++i) {
+    free(keys[i].str);
+    free(keys[i].value);
+  }
+  free(keys);
+  free(slots);
+  free(disp);
+  return 0;
+}